@@ -213,16 +213,177 @@ int DiskBasicGroupItem::Compare(DiskBasicGroupItem **item1, DiskBasicGroupItem *
 #include <wx/arrimpl.cpp>
 WX_DEFINE_OBJARRAY(DiskBasicGroupItems);
 
+//////////////////////////////////////////////////////////////////////
+//
+//
+//
+DiskBasicGroupExtent::DiskBasicGroupExtent()
+{
+	m_group = 0;
+	m_count = 0;
+	m_next = 0;
+	m_sector_start = 0;
+	m_sector_end = 0;
+	m_sectors_per_group = 0;
+	p_user_data = NULL;
+}
+DiskBasicGroupExtent::DiskBasicGroupExtent(const DiskBasicGroupExtent &src)
+{
+	p_user_data = NULL;
+	*this = src;
+}
+/// @param[in] n_group グループ番号
+/// @param[in] n_next  次のグループ番号（任意）
+/// @param[in] n_start グループ内の開始セクタ番号
+/// @param[in] n_end   グループ内の終了セクタ番号
+/// @param[in] n_user  機種依存データ
+DiskBasicGroupExtent::DiskBasicGroupExtent(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user)
+{
+	m_group = n_group;
+	m_count = 1;
+	m_next = n_next;
+	m_sector_start = n_start;
+	m_sector_end = n_end;
+	m_sectors_per_group = n_end - n_start + 1;
+	p_user_data = n_user;
+}
+/// デストラクタ
+DiskBasicGroupExtent::~DiskBasicGroupExtent()
+{
+	delete p_user_data;
+}
+/// @brief 代入
+DiskBasicGroupExtent &DiskBasicGroupExtent::operator=(const DiskBasicGroupExtent &src)
+{
+	if (this == &src) return *this;
+	m_group = src.m_group;
+	m_count = src.m_count;
+	m_next = src.m_next;
+	m_sector_start = src.m_sector_start;
+	m_sector_end = src.m_sector_end;
+	m_sectors_per_group = src.m_sectors_per_group;
+	delete p_user_data;
+	p_user_data = NULL;
+	if (src.p_user_data) {
+		p_user_data = src.p_user_data->Clone();
+	}
+	return *this;
+}
+/// 連続していれば最後につなげる
+/// @param[in] n_group グループ番号
+/// @param[in] n_next  次のグループ番号（任意）
+/// @param[in] n_start グループ内の開始セクタ番号
+/// @param[in] n_end   グループ内の終了セクタ番号
+/// @param[in] n_user  機種依存データ
+/// @return つなげたらtrue
+bool DiskBasicGroupExtent::Append(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, const DiskBasicGroupUserData *n_user)
+{
+	// 機種依存データがあるときはまとめない
+	if (p_user_data || n_user) return false;
+	// グループ番号が連続しているか
+	if (m_count == 0 || n_group != m_group + m_count || m_next != n_group) return false;
+	// セクタ番号が連続しているか
+	if (m_sector_end < m_sector_start || n_end < n_start || n_start != m_sector_end + 1) return false;
+	// 最終グループ以外はセクタ数が同じであること
+	if (GetSectorEnd(m_count - 1) - GetSectorStart(m_count - 1) + 1 != m_sectors_per_group) return false;
+	if (n_end - n_start + 1 > m_sectors_per_group) return false;
+
+	m_count++;
+	m_next = n_next;
+	m_sector_end = n_end;
+	return true;
+}
+/// セクタ番号からグループの位置を返す
+/// @param[in] sector_num セクタ番号
+/// @return 位置
+size_t DiskBasicGroupExtent::FindBySector(int sector_num) const
+{
+	if (sector_num <= m_sector_start || m_sectors_per_group <= 0) return 0;
+	size_t idx = (size_t)((sector_num - m_sector_start) / m_sectors_per_group);
+	return idx < m_count ? idx : m_count - 1;
+}
+/// 指定位置のアイテムを作成
+/// @param[in]  idx  位置
+/// @param[out] item アイテム
+void DiskBasicGroupExtent::GetItem(size_t idx, DiskBasicGroupItem &item) const
+{
+	item = DiskBasicGroupItem(GetGroup(idx), GetNextGroup(idx), GetSectorStart(idx), GetSectorEnd(idx), p_user_data ? p_user_data->Clone() : NULL);
+}
+
+WX_DEFINE_OBJARRAY(DiskBasicGroupExtents);
+
+//////////////////////////////////////////////////////////////////////
+//
+// 連続した空きグループ
+//
+/// グループ数でソートする際の比較 同じ数ならグループ番号順
+int DiskBasicGroupRun::CompareByCount(DiskBasicGroupRun **item1, DiskBasicGroupRun **item2)
+{
+	if ((*item1)->m_count != (*item2)->m_count) return ((*item1)->m_count > (*item2)->m_count ? 1 : -1);
+	return CompareByGroup(item1, item2);
+}
+/// グループ番号でソートする際の比較
+int DiskBasicGroupRun::CompareByGroup(DiskBasicGroupRun **item1, DiskBasicGroupRun **item2)
+{
+	return ((*item1)->m_group == (*item2)->m_group ? 0 : ((*item1)->m_group > (*item2)->m_group ? 1 : -1));
+}
+
+WX_DEFINE_OBJARRAY(DiskBasicGroupRuns);
+
 //////////////////////////////////////////////////////////////////////
 //
 //
 //
 DiskBasicGroups::DiskBasicGroups()
 {
+	p_items = new DiskBasicGroupItems;
+	m_count = 0;
 	m_nums = 0;
 	m_size = 0;
 	m_size_per_group = 0;
 }
+DiskBasicGroups::DiskBasicGroups(const DiskBasicGroups &src)
+{
+	p_items = new DiskBasicGroupItems;
+	*this = src;
+}
+DiskBasicGroups::~DiskBasicGroups()
+{
+	delete p_items;
+}
+/// @brief 代入
+DiskBasicGroups &DiskBasicGroups::operator=(const DiskBasicGroups &src)
+{
+	if (this == &src) return *this;
+	m_extents = src.m_extents;
+	p_items->Empty();
+	m_count = src.m_count;
+	m_nums = src.m_nums;
+	m_size = src.m_size;
+	m_size_per_group = src.m_size_per_group;
+	return *this;
+}
+/// 追加
+///
+/// 直前のグループと連続していればまとめる
+/// @param[in] n_group グループ番号
+/// @param[in] n_next  次のグループ番号（任意）
+/// @param[in] n_start グループ内の開始セクタ番号
+/// @param[in] n_end   グループ内の終了セクタ番号
+/// @param[in] n_user  機種依存データ
+void DiskBasicGroups::AddExtent(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user)
+{
+	// 展開済みなら展開したリストにも追加
+	if (m_count > 0 && p_items->Count() == m_count) {
+		p_items->Add(DiskBasicGroupItem(n_group, n_next, n_start, n_end, n_user ? n_user->Clone() : NULL));
+	}
+	m_count++;
+
+	if (m_extents.Count() > 0 && m_extents.Last().Append(n_group, n_next, n_start, n_end, n_user)) {
+		return;
+	}
+	m_extents.Add(DiskBasicGroupExtent(n_group, n_next, n_start, n_end, n_user));
+}
 /// 追加
 /// @param[in] n_group グループ番号
 /// @param[in] n_next  次のグループ番号（任意）
@@ -231,7 +392,7 @@ DiskBasicGroups::DiskBasicGroups()
 /// @param[in] n_user  機種依存データ
 void DiskBasicGroups::Add(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user)
 {
-	m_items.Add(DiskBasicGroupItem(n_group, n_next, n_start, n_end, n_user));
+	AddExtent(n_group, n_next, n_start, n_end, n_user);
 }
 /// 追加
 /// @param[in] n_group グループ番号
@@ -240,20 +401,25 @@ void DiskBasicGroups::Add(wxUint32 n_group, wxUint32 n_next, int n_start, int n_
 /// @param[in] n_user  機種依存データ
 void DiskBasicGroups::Add(wxUint32 n_group, wxUint32 n_next, int n_start, DiskBasicGroupUserData *n_user)
 {
-	m_items.Add(DiskBasicGroupItem(n_group, n_next, n_start, n_user));
+	AddExtent(n_group, n_next, n_start, n_start, n_user);
 }
 /// 追加
 /// @param[in] n_item アイテム
 void DiskBasicGroups::Add(const DiskBasicGroupItem &n_item)
 {
-	m_items.Add(n_item);
+	const DiskBasicGroupUserData *user = n_item.GetUserDataPtr();
+	AddExtent(n_item.GetGroup(), n_item.GetNextGroup(), n_item.GetSectorStart(), n_item.GetSectorEnd(), user ? user->Clone() : NULL);
 }
 /// 追加
 /// @param[in] n_items アイテムリスト
 void DiskBasicGroups::Add(const DiskBasicGroups &n_items)
 {
-	for(size_t i=0; i<n_items.Count(); i++) {
-		m_items.Add(n_items.Item(i));
+	for(size_t i=0; i<n_items.m_extents.Count(); i++) {
+		const DiskBasicGroupExtent *ext = &n_items.m_extents.Item(i);
+		const DiskBasicGroupUserData *user = ext->GetUserData();
+		for(size_t n=0; n<ext->Count(); n++) {
+			AddExtent(ext->GetGroup(n), ext->GetNextGroup(n), ext->GetSectorStart(n), ext->GetSectorEnd(n), user ? user->Clone() : NULL);
+		}
 	}
 	m_nums += n_items.m_nums;
 	m_size += n_items.m_size;
@@ -261,7 +427,9 @@ void DiskBasicGroups::Add(const DiskBasicGroups &n_items)
 /// クリア
 void DiskBasicGroups::Empty()
 {
-	m_items.Empty();
+	m_extents.Empty();
+	p_items->Empty();
+	m_count = 0;
 	m_nums = 0;
 	m_size = 0;
 	m_size_per_group = 0;
@@ -269,27 +437,76 @@ void DiskBasicGroups::Empty()
 /// アイテム数
 size_t DiskBasicGroups::Count() const
 {
-	return m_items.Count();
+	return m_count;
+}
+/// グループ単位に展開
+void DiskBasicGroups::Expand() const
+{
+	if (p_items->Count() == m_count) return;
+
+	p_items->Empty();
+	p_items->Alloc(m_count);
+	for(size_t i=0; i<m_extents.Count(); i++) {
+		const DiskBasicGroupExtent *ext = &m_extents.Item(i);
+		for(size_t n=0; n<ext->Count(); n++) {
+			DiskBasicGroupItem item;
+			ext->GetItem(n, item);
+			p_items->Add(item);
+		}
+	}
+}
+/// 展開したリストから作り直す
+void DiskBasicGroups::RebuildExtents()
+{
+	m_extents.Empty();
+	m_count = 0;
+	DiskBasicGroupItems *items = p_items;
+	p_items = new DiskBasicGroupItems;
+	for(size_t i=0; i<items->Count(); i++) {
+		Add(items->Item(i));
+	}
+	delete items;
 }
 /// リストからアイテムを削除
 void DiskBasicGroups::RemoveAt(size_t idx)
 {
-	m_items.RemoveAt(idx);
+	Expand();
+	p_items->RemoveAt(idx);
+	RebuildExtents();
 }
 /// 最終アイテム
 DiskBasicGroupItem &DiskBasicGroups::Last() const
 {
-	return m_items.Last();
+	Expand();
+	return p_items->Last();
 }
 /// アイテム
 DiskBasicGroupItem &DiskBasicGroups::Item(size_t idx) const
 {
-	return m_items.Item(idx);
+	Expand();
+	return p_items->Item(idx);
 }
 /// アイテム
 DiskBasicGroupItem *DiskBasicGroups::ItemPtr(size_t idx) const
 {
-	return &m_items.Item(idx);
+	Expand();
+	return &p_items->Item(idx);
+}
+/// リストを返す
+const DiskBasicGroupItems &DiskBasicGroups::GetItems() const
+{
+	Expand();
+	return *p_items;
+}
+/// 最後のグループの次のグループ番号を設定
+/// @param[in] val 次のグループ番号
+void DiskBasicGroups::SetLastNextGroup(wxUint32 val)
+{
+	if (m_extents.Count() == 0) return;
+	m_extents.Last().SetNextGroup(val);
+	if (p_items->Count() == m_count) {
+		p_items->Last().SetNextGroup(val);
+	}
 }
 /// グループ数を足す
 int DiskBasicGroups::AddNums(int val)
@@ -308,7 +525,9 @@ int DiskBasicGroups::AddSize(int val)
 /// グループ番号でソート
 void DiskBasicGroups::SortItems()
 {
-	m_items.Sort(&DiskBasicGroupItem::Compare);
+	Expand();
+	p_items->Sort(&DiskBasicGroupItem::Compare);
+	RebuildExtents();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -346,6 +346,8 @@ public:
 	int GetSectorEnd() const { return m_sector_end; }
 	/// @brief 機種依存データを返す
 	const DiskBasicGroupUserData &GetUserData() const { return *p_user_data; }
+	/// @brief 機種依存データを返す(ないときはNULL)
+	const DiskBasicGroupUserData *GetUserDataPtr() const { return p_user_data; }
 	/// @brief 次のグループ番号を設定
 	void SetNextGroup(wxUint32 val) { m_next = val; }
 	/// @brief グループ内の開始セクタ番号を設定
@@ -363,22 +365,127 @@ WX_DECLARE_OBJARRAY(DiskBasicGroupItem, DiskBasicGroupItems);
 
 //////////////////////////////////////////////////////////////////////
 
+/// @brief 連続したグループ番号をまとめて保持
+///
+/// グループ番号とセクタ番号がともに連続していて、
+/// 最終グループ以外のセクタ数が同じグループを１つにまとめる。
+///
+/// @sa DiskBasicGroups
+class DiskBasicGroupExtent
+{
+private:
+	wxUint32 m_group;			///< 開始グループ番号
+	wxUint32 m_count;			///< グループ数
+	wxUint32 m_next;			///< 最終グループの次のグループ番号
+	int m_sector_start;			///< 開始セクタ番号
+	int m_sector_end;			///< 終了セクタ番号
+	int m_sectors_per_group;	///< １グループのセクタ数(最終グループ以外)
+	DiskBasicGroupUserData *p_user_data;	///< 機種依存データ(あるときはまとめない)
+public:
+	DiskBasicGroupExtent();
+	DiskBasicGroupExtent(const DiskBasicGroupExtent &);
+	DiskBasicGroupExtent(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user = NULL);
+	~DiskBasicGroupExtent();
+	/// @brief 代入
+	DiskBasicGroupExtent &operator=(const DiskBasicGroupExtent &);
+	/// @brief 連続していれば最後につなげる
+	bool Append(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, const DiskBasicGroupUserData *n_user);
+
+	/// @brief グループ数を返す
+	size_t Count() const { return m_count; }
+	/// @brief 開始グループ番号を返す
+	wxUint32 GetGroup() const { return m_group; }
+	/// @brief 最終グループの次のグループ番号を返す
+	wxUint32 GetNextGroup() const { return m_next; }
+	/// @brief 開始セクタ番号を返す
+	int GetSectorStart() const { return m_sector_start; }
+	/// @brief 終了セクタ番号を返す
+	int GetSectorEnd() const { return m_sector_end; }
+	/// @brief 機種依存データを返す
+	const DiskBasicGroupUserData *GetUserData() const { return p_user_data; }
+
+	/// @brief 指定位置のグループ番号を返す
+	wxUint32 GetGroup(size_t idx) const { return m_group + (wxUint32)idx; }
+	/// @brief 指定位置の次のグループ番号を返す
+	wxUint32 GetNextGroup(size_t idx) const { return idx + 1 < m_count ? m_group + (wxUint32)idx + 1 : m_next; }
+	/// @brief 指定位置のグループ内の開始セクタ番号を返す
+	int GetSectorStart(size_t idx) const { return m_sector_start + (int)idx * m_sectors_per_group; }
+	/// @brief 指定位置のグループ内の終了セクタ番号を返す
+	int GetSectorEnd(size_t idx) const { return idx + 1 < m_count ? GetSectorStart(idx) + m_sectors_per_group - 1 : m_sector_end; }
+	/// @brief セクタ番号からグループの位置を返す
+	size_t FindBySector(int sector_num) const;
+	/// @brief 指定位置のアイテムを作成
+	void GetItem(size_t idx, DiskBasicGroupItem &item) const;
+
+	/// @brief 最終グループの次のグループ番号を設定
+	void SetNextGroup(wxUint32 val) { m_next = val; }
+};
+
+/// @class DiskBasicGroupExtents
+///
+/// @brief 連続したグループ DiskBasicGroupExtent のリスト
+WX_DECLARE_OBJARRAY(DiskBasicGroupExtent, DiskBasicGroupExtents);
+
+//////////////////////////////////////////////////////////////////////
+
+/// @brief 連続した空きグループ
+class DiskBasicGroupRun
+{
+private:
+	wxUint32 m_group;	///< 開始グループ番号
+	int m_count;		///< グループ数
+public:
+	DiskBasicGroupRun() { m_group = 0; m_count = 0; }
+	DiskBasicGroupRun(wxUint32 n_group, int n_count) { m_group = n_group; m_count = n_count; }
+	~DiskBasicGroupRun() {}
+	/// @brief 開始グループ番号を返す
+	wxUint32 GetGroup() const { return m_group; }
+	/// @brief グループ数を返す
+	int GetCount() const { return m_count; }
+	/// @brief グループ数でソートする際の比較
+	static int CompareByCount(DiskBasicGroupRun **item1, DiskBasicGroupRun **item2);
+	/// @brief グループ番号でソートする際の比較
+	static int CompareByGroup(DiskBasicGroupRun **item1, DiskBasicGroupRun **item2);
+};
+
+/// @class DiskBasicGroupRuns
+///
+/// @brief 連続した空きグループ DiskBasicGroupRun のリスト
+WX_DECLARE_OBJARRAY(DiskBasicGroupRun, DiskBasicGroupRuns);
+
+//////////////////////////////////////////////////////////////////////
+
 /// @brief グループ番号のリストを保持
 ///
 /// ディスク内ファイルのチェインをこのリストに保持する
 ///
-/// @sa DiskBasicGroupItem , DiskBasicDirItem
+/// 連続したグループはまとめて DiskBasicGroupExtent で保持する。
+/// Item()などでグループ単位にアクセスした時に初めて展開する。
+///
+/// @sa DiskBasicGroupItem , DiskBasicGroupExtent , DiskBasicDirItem
 class DiskBasicGroups
 {
 private:
-	DiskBasicGroupItems	m_items;			///< グループ番号のリスト
+	DiskBasicGroupExtents	m_extents;		///< 連続したグループのリスト
+	DiskBasicGroupItems	*p_items;			///< グループ単位に展開したリスト
+	size_t				m_count;			///< リスト内のグループ数
 	int					m_nums;				///< グループ数
 	size_t				m_size;				///< グループ内の占有サイズ
 	size_t				m_size_per_group;	///< １グループのサイズ
 
+	/// @brief 追加
+	void	AddExtent(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user);
+	/// @brief グループ単位に展開
+	void	Expand() const;
+	/// @brief 展開したリストから作り直す
+	void	RebuildExtents();
+
 public:
 	DiskBasicGroups();
-	~DiskBasicGroups() {}
+	DiskBasicGroups(const DiskBasicGroups &);
+	~DiskBasicGroups();
+	/// @brief 代入
+	DiskBasicGroups &operator=(const DiskBasicGroups &);
 
 	/// @brief 追加
 	void	Add(wxUint32 n_group, wxUint32 n_next, int n_start, int n_end, DiskBasicGroupUserData *n_user = NULL);
@@ -401,7 +508,13 @@ public:
 	/// @brief リストアイテムを返す
 	DiskBasicGroupItem *ItemPtr(size_t idx) const;
 	/// @brief リストを返す
-	const DiskBasicGroupItems &GetItems() const { return m_items; }
+	const DiskBasicGroupItems &GetItems() const;
+	/// @brief 連続したグループの数を返す
+	size_t	GetExtentCount() const { return m_extents.Count(); }
+	/// @brief 連続したグループを返す
+	const DiskBasicGroupExtent &GetExtent(size_t idx) const { return m_extents.Item(idx); }
+	/// @brief 最後のグループの次のグループ番号を設定
+	void	SetLastNextGroup(wxUint32 val);
 
 	/// @brief グループ数を返す
 	int		GetNums() const { return m_nums; }
@@ -13,8 +13,66 @@
 #include "basicfmt.h"
 #include "basictype.h"
 #include "../charcodes.h"
+#include "../config.h"
 
 
+//////////////////////////////////////////////////////////////////////
+//
+// ディレクトリツリーの走査結果
+//
+DiskBasicDirTreeInfo::DiskBasicDirTreeInfo()
+{
+	Clear();
+}
+
+/// クリア
+void DiskBasicDirTreeInfo::Clear()
+{
+	m_dirs = 0;
+	m_files = 0;
+	m_failed = 0;
+	m_depth = 0;
+	m_sizes.clear();
+}
+
+/// ディレクトリを追加
+/// @param [in] dir_item ディレクトリ
+/// @param [in] depth    階層 起点が0
+void DiskBasicDirTreeInfo::AddDirectory(const DiskBasicDirItem *dir_item, int depth)
+{
+	m_dirs++;
+	m_sizes[dir_item] = 0;
+	if (m_depth < depth) m_depth = depth;
+}
+
+/// ファイルを追加
+/// @param [in] dir_item ファイルのあるディレクトリ
+/// @param [in] size     ファイルサイズ
+void DiskBasicDirTreeInfo::AddFile(const DiskBasicDirItem *dir_item, wxInt64 size)
+{
+	m_files++;
+	m_sizes[dir_item] += size;
+}
+
+/// サブディレクトリのサイズを親に加える
+/// @param [in] dir_item 親ディレクトリ
+/// @param [in] sub_item サブディレクトリ
+void DiskBasicDirTreeInfo::AddSubDirectorySize(const DiskBasicDirItem *dir_item, const DiskBasicDirItem *sub_item)
+{
+	m_sizes[dir_item] += GetSize(sub_item);
+}
+
+/// ディレクトリ配下のファイルサイズ合計
+/// @param [in] dir_item ディレクトリ
+/// @return サイズ 走査していないディレクトリは0
+wxInt64 DiskBasicDirTreeInfo::GetSize(const DiskBasicDirItem *dir_item) const
+{
+	DiskBasicDirTreeSizes::const_iterator it = m_sizes.find(dir_item);
+	if (it == m_sizes.end()) return 0;
+	return it->second;
+}
+
+//////////////////////////////////////////////////////////////////////
 //
 //
 //
@@ -314,6 +372,36 @@ DiskBasicDirItem *DiskBasicDir::GetEmptyItem(DiskBasicDirItem *dir_item, DiskBas
 	return type->GetEmptyDirectoryItem(dir_item, children, pitem, next_item);
 }
 
+/// 一致したアイテムのうち一覧の先頭に近いものを返す
+/// @param [in]  dir_item     検索対象のディレクトリアイテム
+/// @param [in]  index        名前検索用インデックス
+/// @param [in]  matches      一致したアイテム
+/// @param [out] next_item    一致したアイテムの次位置にあるアイテム
+/// @return NULL: ない
+DiskBasicDirItem *DiskBasicDir::SelectFirstItem(const DiskBasicDirItem *dir_item, const DiskBasicDirNameIndex *index, const DiskBasicDirItems &matches, DiskBasicDirItem **next_item)
+{
+	DiskBasicDirItem *match_item = NULL;
+	int match_pos = -1;
+	for(size_t i = 0; i < matches.Count(); i++) {
+		DiskBasicDirItem *item = matches.Item(i);
+		int pos = index->GetPosition(item);
+		if (match_pos < 0 || pos < match_pos) {
+			match_item = item;
+			match_pos = pos;
+		}
+	}
+	if (match_item && next_item) {
+		const DiskBasicDirItems *items = dir_item->GetChildren();
+		size_t pos = (size_t)(match_pos + 1);
+		if (pos < items->Count()) {
+			*next_item = items->Item(pos);
+		} else {
+			*next_item = NULL;
+		}
+	}
+	return match_item;
+}
+
 /// 現在のディレクトリ内に同じファイル名が既に存在するか
 /// @param [in]  filename     ファイル名
 /// @param [in]  icase        大文字小文字を区別しないか(case insensitive)
@@ -334,26 +422,20 @@ DiskBasicDirItem *DiskBasicDir::FindFileOnCurrent(const DiskBasicFileName &filen
 /// @return NULL: ない
 DiskBasicDirItem *DiskBasicDir::FindFile(const DiskBasicDirItem *dir_item, const DiskBasicFileName &filename, bool icase, DiskBasicDirItem *exclude_item, DiskBasicDirItem **next_item)
 {
-	DiskBasicDirItem *match_item = NULL;
-	const DiskBasicDirItems *items = dir_item->GetChildren();
-	if (items) {
-		for(size_t pos = 0; pos <items->Count(); pos++) {
-			DiskBasicDirItem *item = items->Item(pos);
-			if (item != exclude_item && item->IsSameFileName(filename, icase)) {
-				match_item = item;
-				if (next_item) {
-					pos++;
-					if (pos < items->Count()) {
-						*next_item = items->Item(pos);
-					} else {
-						*next_item = NULL;
-					}
-				}
-				break;
-			}
+	DiskBasicDirNameIndex *index = dir_item->GetNameIndex();
+	if (!index) return NULL;
+
+	// インデックスから候補を探して、改めて比較する
+	DiskBasicDirItems candidates;
+	DiskBasicDirItems matches;
+	index->FindFiles(filename.GetName(), candidates);
+	for(size_t i = 0; i < candidates.Count(); i++) {
+		DiskBasicDirItem *item = candidates.Item(i);
+		if (item != exclude_item && item->IsSameFileName(filename, icase)) {
+			matches.Add(item);
 		}
 	}
-	return match_item;
+	return SelectFirstItem(dir_item, index, matches, next_item);
 }
 
 /// 現在のディレクトリ内に同じファイル名が既に存在するか
@@ -376,26 +458,20 @@ DiskBasicDirItem *DiskBasicDir::FindFileOnCurrent(const DiskBasicDirItem *target
 /// @return NULL: ない
 DiskBasicDirItem *DiskBasicDir::FindFile(const DiskBasicDirItem *dir_item, const DiskBasicDirItem *target_item, bool icase, DiskBasicDirItem *exclude_item, DiskBasicDirItem **next_item)
 {
-	DiskBasicDirItem *match_item = NULL;
-	const DiskBasicDirItems *items = dir_item->GetChildren();
-	if (items) {
-		for(size_t pos = 0; pos <items->Count(); pos++) {
-			DiskBasicDirItem *item = items->Item(pos);
-			if (item != exclude_item && item->IsSameFileName(target_item, icase)) {
-				match_item = item;
-				if (next_item) {
-					pos++;
-					if (pos < items->Count()) {
-						*next_item = items->Item(pos);
-					} else {
-						*next_item = NULL;
-					}
-				}
-				break;
-			}
+	DiskBasicDirNameIndex *index = dir_item->GetNameIndex();
+	if (!index) return NULL;
+
+	// インデックスから候補を探して、改めて比較する
+	DiskBasicDirItems candidates;
+	DiskBasicDirItems matches;
+	index->FindFiles(target_item, candidates);
+	for(size_t i = 0; i < candidates.Count(); i++) {
+		DiskBasicDirItem *item = candidates.Item(i);
+		if (item != exclude_item && item->IsSameFileName(target_item, icase)) {
+			matches.Add(item);
 		}
 	}
-	return match_item;
+	return SelectFirstItem(dir_item, index, matches, next_item);
 }
 
 /// 現在のディレクトリ内に同じファイル名(拡張子除く)が既に存在するか
@@ -418,26 +494,20 @@ DiskBasicDirItem *DiskBasicDir::FindNameOnCurrent(const wxString &name, bool ica
 /// @return NULL: ない
 DiskBasicDirItem *DiskBasicDir::FindName(const DiskBasicDirItem *dir_item, const wxString &name, bool icase, DiskBasicDirItem *exclude_item, DiskBasicDirItem **next_item)
 {
-	DiskBasicDirItem *match_item = NULL;
-	const DiskBasicDirItems *items = dir_item->GetChildren();
-	if (items) {
-		for(size_t pos = 0; pos <items->Count(); pos++) {
-			DiskBasicDirItem *item = items->Item(pos);
-			if (item != exclude_item && item->IsSameName(name, icase)) {
-				match_item = item;
-				if (next_item) {
-					pos++;
-					if (pos < items->Count()) {
-						*next_item = items->Item(pos);
-					} else {
-						*next_item = NULL;
-					}
-				}
-				break;
-			}
+	DiskBasicDirNameIndex *index = dir_item->GetNameIndex();
+	if (!index) return NULL;
+
+	// インデックスから候補を探して、改めて比較する
+	DiskBasicDirItems candidates;
+	DiskBasicDirItems matches;
+	index->FindNames(name, candidates);
+	for(size_t i = 0; i < candidates.Count(); i++) {
+		DiskBasicDirItem *item = candidates.Item(i);
+		if (item != exclude_item && item->IsSameName(name, icase)) {
+			matches.Add(item);
 		}
 	}
-	return match_item;
+	return SelectFirstItem(dir_item, index, matches, next_item);
 }
 
 /// 現在のディレクトリ内の属性に一致するファイルを検索
@@ -630,6 +700,92 @@ bool DiskBasicDir::Reassign(DiskBasicDirItem *dir_item)
 	return Reassign(type, dir_item);
 }
 
+/// 配下のサブディレクトリをすべてアサイン
+///
+/// 階層ごとに、まだ読んでいないディレクトリのエリアをまとめて先読みに出してから
+/// 順にアサインする。先読みはディスクイメージ側のスレッドが行うので、
+/// ディレクトリの解析中に次のディレクトリのセクタが読み込まれる。
+/// アイテムやFATは共有しているので、解析そのものはこのスレッドで行う。
+///
+/// @param [in,out] dir_item 起点のディレクトリ
+/// @param [out]    info     走査結果
+/// @return false 起点のディレクトリをアサインできない
+bool DiskBasicDir::AssignTree(DiskBasicDirItem *dir_item, DiskBasicDirTreeInfo &info)
+{
+	info.Clear();
+	if (!dir_item) return false;
+
+	DiskBasicDirItems level;	// 現在の階層
+	DiskBasicDirItems dirs;		// アサインしたディレクトリ 浅い順
+	IntHashMap visited;			// 読んだディレクトリの開始グループ ループ対策
+
+	level.Add(dir_item);
+	visited[(int)dir_item->GetStartGroup(0)] = 0;
+	for(int depth = 0; level.Count() > 0; depth++) {
+		// この階層のディレクトリエリアをまとめて先読み
+		for(size_t i = 0; i < level.Count(); i++) {
+			if (!level.Item(i)->GetChildren()) ReadAheadDirectory(level.Item(i));
+		}
+
+		DiskBasicDirItems next_level;
+		for(size_t i = 0; i < level.Count(); i++) {
+			DiskBasicDirItem *item = level.Item(i);
+			if (!Assign(item)) {
+				if (depth == 0) return false;
+				info.AddFailed();
+				continue;
+			}
+			dirs.Add(item);
+			info.AddDirectory(item, depth);
+
+			DiskBasicDirItems *children = item->GetChildren();
+			if (!children) continue;
+
+			for(size_t n = 0; n < children->Count(); n++) {
+				DiskBasicDirItem *child = children->Item(n);
+				if (!child->IsUsedAndVisible()) continue;
+
+				if (!child->IsDirectory()) {
+					info.AddFile(item, child->GetFileSize());
+					continue;
+				}
+				// カレントや親ディレクトリは除く
+				if (!child->IsVisibleOnTree()) continue;
+				// 深すぎる、または既に読んだディレクトリは除く
+				if (depth >= gConfig.GetDirDepth()) continue;
+				int start_group = (int)child->GetStartGroup(0);
+				if (visited.find(start_group) != visited.end()) continue;
+				visited[start_group] = depth;
+
+				next_level.Add(child);
+			}
+		}
+		level = next_level;
+	}
+
+	// 深い方から親ディレクトリにサイズを加える
+	for(size_t i = dirs.Count(); i > 1; i--) {
+		DiskBasicDirItem *item = dirs.Item(i - 1);
+		if (item->GetParent()) info.AddSubDirectorySize(item->GetParent(), item);
+	}
+	return true;
+}
+
+/// ディレクトリエリアを先読みする
+/// @param [in] dir_item ディレクトリ
+void DiskBasicDir::ReadAheadDirectory(DiskBasicDirItem *dir_item)
+{
+	DiskBasicType *type = basic->GetType();
+	if (type->IsRootDirectory(dir_item->GetStartGroup(0))) return;
+
+	DiskBasicGroups groups;
+	dir_item->GetAllGroups(groups);
+	for(size_t i = 0; i < groups.GetExtentCount(); i++) {
+		const DiskBasicGroupExtent &ext = groups.GetExtent(i);
+		basic->ReadAhead(ext.GetSectorStart(), ext.GetSectorEnd() - ext.GetSectorStart() + 1);
+	}
+}
+
 /// ルートディレクトリを初期化
 void DiskBasicDir::ClearRoot()
 {
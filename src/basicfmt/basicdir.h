@@ -22,11 +22,54 @@ class DiskBasicType;
 class DiskBasicFormat;
 class DiskBasicFat;
 class DiskBasicDirItems;
+class DiskBasicDirNameIndex;
 class DiskBasicFileName;
 class DiskBasicGroups;
 
 //////////////////////////////////////////////////////////////////////
 
+/// @brief ディレクトリ → 配下のファイルサイズ合計
+WX_DECLARE_HASH_MAP(const DiskBasicDirItem *, wxInt64, wxPointerHash, wxPointerEqual, DiskBasicDirTreeSizes);
+
+/// @brief ディレクトリツリーの走査結果
+class DiskBasicDirTreeInfo
+{
+private:
+	int		m_dirs;		///< ディレクトリ数(起点を含む)
+	int		m_files;	///< ファイル数
+	int		m_failed;	///< 読めなかったディレクトリ数
+	int		m_depth;	///< 最も深い階層
+	DiskBasicDirTreeSizes m_sizes;	///< ディレクトリごとの配下のファイルサイズ合計
+
+public:
+	DiskBasicDirTreeInfo();
+	~DiskBasicDirTreeInfo() {}
+
+	/// @brief クリア
+	void	Clear();
+	/// @brief ディレクトリを追加
+	void	AddDirectory(const DiskBasicDirItem *dir_item, int depth);
+	/// @brief ファイルを追加
+	void	AddFile(const DiskBasicDirItem *dir_item, wxInt64 size);
+	/// @brief 読めなかったディレクトリを追加
+	void	AddFailed() { m_failed++; }
+	/// @brief サブディレクトリのサイズを親に加える
+	void	AddSubDirectorySize(const DiskBasicDirItem *dir_item, const DiskBasicDirItem *sub_item);
+
+	/// @brief ディレクトリ数
+	int		GetDirectories() const { return m_dirs; }
+	/// @brief ファイル数
+	int		GetFiles() const { return m_files; }
+	/// @brief 読めなかったディレクトリ数
+	int		GetFailed() const { return m_failed; }
+	/// @brief 最も深い階層
+	int		GetDepth() const { return m_depth; }
+	/// @brief ディレクトリ配下のファイルサイズ合計
+	wxInt64	GetSize(const DiskBasicDirItem *dir_item) const;
+};
+
+//////////////////////////////////////////////////////////////////////
+
 /// @brief ディレクトリアクセス
 class DiskBasicDir
 {
@@ -41,6 +84,11 @@ private:
 	DiskBasicDirItem	*p_curr_item;		///< 現ディレクトリのアイテム
 
 	DiskBasicDir();
+
+	/// @brief ディレクトリエリアを先読みする
+	void ReadAheadDirectory(DiskBasicDirItem *dir_item);
+	/// @brief 一致したアイテムのうち一覧の先頭に近いものを返す
+	DiskBasicDirItem *SelectFirstItem(const DiskBasicDirItem *dir_item, const DiskBasicDirNameIndex *index, const DiskBasicDirItems &matches, DiskBasicDirItem **next_item);
 public:
 	DiskBasicDir(DiskBasic *basic);
 	~DiskBasicDir();
@@ -128,6 +176,8 @@ public:
 	bool		Reassign(DiskBasicType *type, DiskBasicDirItem *dir_item);
 	/// @brief ディレクトリエリアを読み直す
 	bool		Reassign(DiskBasicDirItem *dir_item);
+	/// @brief 配下のサブディレクトリをすべてアサイン
+	bool		AssignTree(DiskBasicDirItem *dir_item, DiskBasicDirTreeInfo &info);
 
 	/// @brief ルートディレクトリを初期化
 	void        ClearRoot();
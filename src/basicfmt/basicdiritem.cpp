@@ -9,6 +9,7 @@
 #include <wx/stream.h>
 #include <wx/xml/xml.h>
 #include "basicfmt.h"
+#include "basicdir.h"
 #include "basictype.h"
 #include "../charcodes.h"
 #include "../config.h"
@@ -26,6 +27,8 @@ DiskBasicDirItem::DiskBasicDirItem()
 	m_parent = NULL;
 	m_children = NULL;
 	m_valid_dir = false;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = 0;
 //	m_position = 0;
@@ -58,6 +61,8 @@ DiskBasicDirItem::DiskBasicDirItem(DiskBasic *basic)
 	m_parent = NULL;
 	m_children = NULL;
 	m_valid_dir = false;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = 0;
 //	m_position = 0;
@@ -79,6 +84,8 @@ DiskBasicDirItem::DiskBasicDirItem(DiskBasic *basic, int n_block_num, int n_posi
 	m_parent = NULL;
 	m_children = NULL;
 	m_valid_dir = false;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = 0;
 //	m_position = n_position;
@@ -104,6 +111,8 @@ DiskBasicDirItem::DiskBasicDirItem(DiskBasic *basic, int n_num, const DiskBasicG
 	m_parent = NULL;
 	m_children = NULL;
 	m_valid_dir = false;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = n_num;
 //	m_position = n_position;
@@ -129,6 +138,8 @@ void DiskBasicDirItem::Reset()
 	m_parent = NULL;
 	m_children = NULL;
 	m_valid_dir = false;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = 0;
 //	m_position = 0;
@@ -186,6 +197,8 @@ void DiskBasicDirItem::Dup(const DiskBasicDirItem &src)
 		m_children = NULL;
 	}
 	m_valid_dir = src.m_valid_dir;
+	p_name_index = NULL;
+	p_free_slots = NULL;
 
 	m_num = src.m_num;
 	m_position = src.m_position;
@@ -228,6 +241,9 @@ void DiskBasicDirItem::AddChild(DiskBasicDirItem *newitem)
 {
 	CreateChildren();
 	m_children->Add(newitem);
+	// 一覧が変わったのでインデックスは作り直す
+	ReleaseNameIndex();
+	ReleaseFreeSlots();
 }
 /// 子ディレクトリ一覧をクリア
 void DiskBasicDirItem::EmptyChildren()
@@ -243,6 +259,73 @@ void DiskBasicDirItem::EmptyChildren()
 	}
 	m_children = NULL;
 	m_valid_dir = false;
+
+	ReleaseNameIndex();
+	ReleaseFreeSlots();
+}
+
+/// 子ディレクトリの名前検索用インデックスを返す
+/// @return NULL:子ディレクトリがない
+/// @note 初めて呼ばれたときに作成する
+DiskBasicDirNameIndex *DiskBasicDirItem::GetNameIndex() const
+{
+	if (!m_children) return NULL;
+	if (p_name_index) return p_name_index;
+
+	// 名前の変換に使うアイテム
+	DiskBasicDirItem *rule = basic->GetDir()->NewItem();
+	if (!rule) return NULL;
+	rule->ClearData();
+
+	p_name_index = new DiskBasicDirNameIndex(rule);
+	for(size_t pos = 0; pos < m_children->Count(); pos++) {
+		p_name_index->Add(m_children->Item(pos), (int)pos);
+	}
+	return p_name_index;
+}
+
+/// 子ディレクトリの名前検索用インデックスを更新
+/// @param [in] item 名前を変更した子アイテム
+void DiskBasicDirItem::UpdateNameIndex(DiskBasicDirItem *item) const
+{
+	if (p_name_index) {
+		p_name_index->Update(item);
+	}
+}
+
+/// 子ディレクトリの名前検索用インデックスを破棄
+void DiskBasicDirItem::ReleaseNameIndex() const
+{
+	delete p_name_index;
+	p_name_index = NULL;
+}
+
+/// 子ディレクトリの未使用アイテムを返す
+/// @return NULL:子ディレクトリがない
+/// @note 初めて呼ばれたときに作成する
+DiskBasicDirFreeSlots *DiskBasicDirItem::GetFreeSlots() const
+{
+	if (!m_children) return NULL;
+	if (!p_free_slots) {
+		p_free_slots = new DiskBasicDirFreeSlots(m_children);
+	}
+	return p_free_slots;
+}
+
+/// 子ディレクトリの未使用アイテムを更新
+/// @param [in] item 使用状態が変わった子アイテム
+void DiskBasicDirItem::UpdateFreeSlot(const DiskBasicDirItem *item) const
+{
+	if (p_free_slots) {
+		p_free_slots->Update(item);
+	}
+}
+
+/// 子ディレクトリの未使用アイテムを破棄
+void DiskBasicDirItem::ReleaseFreeSlots() const
+{
+	delete p_free_slots;
+	p_free_slots = NULL;
 }
 
 /// ディレクトリアイテムのチェック
@@ -273,6 +356,9 @@ void DiskBasicDirItem::Refresh()
 
 	// ファイルサイズを再計算
 	CalcFileSize();
+
+	// 親の名前検索用インデックスを更新
+	if (m_parent) m_parent->UpdateNameIndex(this);
 }
 
 /// アイテムを削除できるか
@@ -367,6 +453,8 @@ void DiskBasicDirItem::SetFileNameStr(const wxString &filename)
 	size_t elen = sizeof(ext);
 	ToNativeFileName(filename, name, nlen, ext, elen);
 	SetNativeFileName(name, sizeof(name), nlen, ext, sizeof(ext), elen);
+
+	if (m_parent) m_parent->UpdateNameIndex(this);
 }
 
 /// ファイル名をそのまま設定
@@ -379,6 +467,8 @@ void DiskBasicDirItem::SetFileNamePlain(const wxString &filename)
 	size_t elen = 0;
 	ToNativeFileName(filename, name, nlen, NULL, elen);
 	SetNativeFileName(name, sizeof(name), nlen, ext, sizeof(ext), 0);
+
+	if (m_parent) m_parent->UpdateNameIndex(this);
 }
 
 /// 拡張子を設定
@@ -390,6 +480,8 @@ void DiskBasicDirItem::SetFileExtPlain(const wxString &fileext)
 	size_t elen = sizeof(ext);
 	ToNativeFileName(fileext, ext, elen, NULL, nlen);
 	SetNativeFileName(NULL, 0, 0, ext, sizeof(ext), elen);
+
+	if (m_parent) m_parent->UpdateNameIndex(this);
 }
 
 /// ファイル名をコピー
@@ -403,6 +495,8 @@ void DiskBasicDirItem::CopyFileName(const DiskBasicDirItem &src)
 	GetFileExtPos(elen);
 	src.GetNativeFileName(name, nlen, ext, elen);
 	SetNativeFileName(name, sizeof(name), nlen, ext, sizeof(ext), elen);
+
+	if (m_parent) m_parent->UpdateNameIndex(this);
 }
 
 /// ファイル名を設定
@@ -419,6 +513,7 @@ void DiskBasicDirItem::SetNativeName(wxUint8 *filename, size_t size, size_t leng
 	if (n != NULL && ns > 0) {
 		if (ns > size) ns = size;
 		memcpy(n, filename, ns);
+		SetModify();
 	}
 }
 
@@ -435,6 +530,7 @@ void DiskBasicDirItem::SetNativeExt(wxUint8 *fileext, size_t size, size_t length
 	if (e != NULL && el > 0) {
 		if (el > size) el = size;
 		memcpy(e, fileext, el);
+		SetModify();
 	}
 }
 
@@ -764,6 +860,68 @@ void DiskBasicDirItem::ToUpper(wxUint8 *str, size_t size) const
 	to_upper(str, size);
 }
 
+/// ファイル名から名前検索用のキーを作成
+/// @param [in] filename ファイル名
+/// @param [in] with_ext 拡張子を分けてキーに含めるか(false:IsSameName()用)
+/// @return キー
+wxString DiskBasicDirItem::MakeNameIndexKey(const wxString &filename, bool with_ext) const
+{
+	wxUint8 name[FILENAME_BUFSIZE], ext[FILEEXT_BUFSIZE];
+	size_t nlen = sizeof(name);
+	size_t elen = with_ext ? sizeof(ext) : 0;
+
+	// ファイル名を内部ファイル名に変換
+	if (!ToNativeFileName(filename, name, nlen, with_ext ? ext : NULL, elen)) {
+		return wxEmptyString;
+	}
+	return MakeNameIndexKey(name, nlen, ext, with_ext ? elen : 0);
+}
+
+/// アイテムのファイル名から名前検索用のキーを作成
+/// @param [in] src      ディレクトリアイテム
+/// @param [in] with_ext 拡張子をキーに含めるか
+/// @return キー
+wxString DiskBasicDirItem::MakeNameIndexKey(const DiskBasicDirItem *src, bool with_ext) const
+{
+	wxUint8 name[FILENAME_BUFSIZE], ext[FILEEXT_BUFSIZE];
+	size_t nlen = sizeof(name);
+	size_t elen = with_ext ? sizeof(ext) : 0;
+
+	src->GetNativeFileName(name, nlen, with_ext ? ext : NULL, elen);
+	return MakeNameIndexKey(name, nlen, ext, with_ext ? elen : 0);
+}
+
+/// 内部ファイル名から名前検索用のキーを作成
+///
+/// 大文字にして末尾の空白や終端コードを除く。
+/// IsSameFileName() で一致するなら必ず同じキーになる。
+///
+/// @param [in,out] name     ファイル名
+/// @param [in]     nlen     ファイル名長さ
+/// @param [in,out] ext      拡張子
+/// @param [in]     elen     拡張子長さ
+/// @return キー
+wxString DiskBasicDirItem::MakeNameIndexKey(wxUint8 *name, size_t nlen, wxUint8 *ext, size_t elen) const
+{
+	wxUint8 codes[5];
+	codes[0] = 0;
+	codes[1] = 0x20;
+	codes[2] = (wxUint8)basic->GetDirTrimmingCode();
+	codes[3] = (wxUint8)basic->GetDirSpaceCode();
+	codes[4] = (wxUint8)basic->GetDirTerminateCode();
+
+	ToUpper(name, nlen);
+	while(nlen > 0 && memchr(codes, name[nlen - 1], sizeof(codes)) != NULL) nlen--;
+	ToUpper(ext, elen);
+	while(elen > 0 && memchr(codes, ext[elen - 1], sizeof(codes)) != NULL) elen--;
+
+	// 名前と拡張子の境界がわかるように長さを前につける
+	wxString key = wxString::Format(wxT("%d:"), (int)nlen);
+	key += wxString::From8BitData((const char *)name, nlen);
+	key += wxString::From8BitData((const char *)ext, elen);
+	return key;
+}
+
 /// ファイル名＋拡張子のサイズ
 /// @return サイズ
 int DiskBasicDirItem::GetFileNameStrSize() const
@@ -1260,6 +1418,12 @@ void DiskBasicDirItem::GetAllGroups(DiskBasicGroups &group_items)
 {
 	group_items.Empty();
 	GetUnitGroups(0, group_items);
+
+	// 未確定ならキャッシュしておく
+	if (IsGroupsDeferred()) {
+		m_groups = group_items;
+		m_flags &= ~GROUPS_DEFERRED;
+	}
 }
 
 /// グループ数をセット
@@ -1357,14 +1521,16 @@ wxUint32 DiskBasicDirItem::GetParentGroup() const
 }
 
 /// グループリストの数を返す
-size_t DiskBasicDirItem::GetGroupCount() const
+size_t DiskBasicDirItem::GetGroupCount()
 {
+	ResolveGroups();
 	return m_groups.Count();
 }
 
 /// グループリストを返す
-const DiskBasicGroups &DiskBasicDirItem::GetGroups() const
+const DiskBasicGroups &DiskBasicDirItem::GetGroups()
 {
+	ResolveGroups();
 	return m_groups;
 }
 
@@ -1372,14 +1538,40 @@ const DiskBasicGroups &DiskBasicDirItem::GetGroups() const
 void DiskBasicDirItem::SetGroups(const DiskBasicGroups &vals)
 {
 	m_groups = vals;
+	m_flags &= ~GROUPS_DEFERRED;
 }
 
 /// グループリストのアイテムを返す
-DiskBasicGroupItem *DiskBasicDirItem::GetGroup(size_t idx) const
+DiskBasicGroupItem *DiskBasicDirItem::GetGroup(size_t idx)
 {
+	ResolveGroups();
 	return m_groups.ItemPtr(idx);
 }
 
+/// グループリストを未確定にする
+///
+/// グループ数とサイズのみ設定しておき、チェインは必要になった時にたどる
+void DiskBasicDirItem::DeferGroups()
+{
+	m_flags |= GROUPS_DEFERRED;
+}
+
+/// グループリストが未確定か
+bool DiskBasicDirItem::IsGroupsDeferred() const
+{
+	return ((m_flags & GROUPS_DEFERRED) != 0);
+}
+
+/// 未確定のグループリストを確定する
+void DiskBasicDirItem::ResolveGroups()
+{
+	if (!IsGroupsDeferred()) return;
+
+	m_flags &= ~GROUPS_DEFERRED;
+	m_groups.Empty();
+	GetUnitGroups(0, m_groups);
+}
+
 /// 作成日付を得る
 /// @param [out] tm 日付
 void DiskBasicDirItem::GetFileCreateDate(TM &tm) const
@@ -1605,6 +1797,7 @@ wxString DiskBasicDirItem::GetFileDateTimeStr() const
 /// ファイルサイズとグループ数を計算する
 void DiskBasicDirItem::CalcFileSize()
 {
+	m_flags &= ~GROUPS_DEFERRED;
 	m_groups.Empty();
 	CalcFileUnitSize(0);
 }
@@ -1645,6 +1838,8 @@ void DiskBasicDirItem::CopyItem(const DiskBasicDirItem &src)
 	m_flags = src.m_flags;
 	// その他の属性
 	m_external_attr = src.m_external_attr;
+
+	if (m_parent) m_parent->UpdateFreeSlot(this);
 }
 
 /// ディレクトリを初期化 未使用にする
@@ -2042,6 +2237,9 @@ bool DiskBasicDirItem::IsUsed() const
 void DiskBasicDirItem::Used(bool val)
 {
 	m_flags = val ? (m_flags | USED_ITEM) : (m_flags & ~USED_ITEM);
+
+	// 親の未使用アイテム一覧に反映
+	if (m_parent) m_parent->UpdateFreeSlot(this);
 }
 
 /// リストに表示するアイテムか
@@ -2179,6 +2377,210 @@ void DiskBasicDirItem::SetCommonDataInAttrDialog(KeyValArray &vals) const
 	vals.Add(wxT("external_attr"), (wxUint32)m_external_attr);
 }
 
+//////////////////////////////////////////////////////////////////////
+//
+// 名前検索用インデックスに登録したアイテムの情報
+//
+DiskBasicDirNameIndexEntry::DiskBasicDirNameIndexEntry()
+{
+	m_pos = -1;
+	m_irregular = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// ディレクトリ内の子アイテムの名前検索用インデックス
+//
+/// @param [in] rule 名前の変換に使うアイテム 所有権はこのクラスに移る
+DiskBasicDirNameIndex::DiskBasicDirNameIndex(DiskBasicDirItem *rule)
+{
+	p_rule = rule;
+}
+DiskBasicDirNameIndex::~DiskBasicDirNameIndex()
+{
+	delete p_rule;
+}
+
+/// アイテムを追加
+/// @param [in] item アイテム
+/// @param [in] pos  子ディレクトリ一覧内の位置
+void DiskBasicDirNameIndex::Add(DiskBasicDirItem *item, int pos)
+{
+	DiskBasicDirNameIndexEntry &entry = m_entries[item];
+	entry.m_pos = pos;
+	Register(item, entry);
+}
+
+/// アイテムのキーを更新
+/// @param [in] item 名前を変更したアイテム
+void DiskBasicDirNameIndex::Update(DiskBasicDirItem *item)
+{
+	DiskBasicDirNameIndexEntries::iterator it = m_entries.find(item);
+	if (it == m_entries.end()) return;
+
+	Unregister(item, it->second);
+	Register(item, it->second);
+}
+
+/// キーに対応するアイテムを登録
+/// @param [in]     item  アイテム
+/// @param [in,out] entry 登録した情報
+void DiskBasicDirNameIndex::Register(DiskBasicDirItem *item, DiskBasicDirNameIndexEntry &entry)
+{
+	// 未使用のアイテムは検索対象外
+	// 使用するときはファイル名を設定するので、そのときに登録される
+	if (!item->IsUsed()) return;
+
+	entry.m_file_key = p_rule->MakeNameIndexKey(item, true);
+	entry.m_name_key = p_rule->MakeNameIndexKey(item, false);
+
+	// 表示名から変換したキーが一致しないアイテムは、名前の変換規則が異なる
+	// (ロングファイル名など) ので、常に比較対象とする
+	entry.m_irregular = (p_rule->MakeNameIndexKey(item->GetFileNameStr(), true) != entry.m_file_key);
+	if (entry.m_irregular) {
+		m_irregular.Add(item);
+		return;
+	}
+
+	m_files[entry.m_file_key].Add(item);
+	m_names[entry.m_name_key].Add(item);
+}
+
+/// キーに対応するアイテムを削除
+/// @param [in]     item  アイテム
+/// @param [in,out] entry 登録した情報
+void DiskBasicDirNameIndex::Unregister(DiskBasicDirItem *item, DiskBasicDirNameIndexEntry &entry)
+{
+	if (entry.m_irregular) {
+		m_irregular.Remove(item);
+		entry.m_irregular = false;
+		return;
+	}
+	DiskBasicDirNameIndexMap *maps[2] = { &m_files, &m_names };
+	const wxString *keys[2] = { &entry.m_file_key, &entry.m_name_key };
+	for(int i=0; i<2; i++) {
+		DiskBasicDirNameIndexMap::iterator it = maps[i]->find(*keys[i]);
+		if (it == maps[i]->end()) continue;
+		int idx = it->second.Index(item);
+		if (idx != wxNOT_FOUND) it->second.RemoveAt(idx);
+		if (it->second.Count() == 0) maps[i]->erase(it);
+	}
+	entry.m_file_key.Empty();
+	entry.m_name_key.Empty();
+}
+
+/// キーに対応するアイテムを候補に加える
+/// @param [in]  map        マップ
+/// @param [in]  key        キー
+/// @param [out] candidates 候補のアイテム
+void DiskBasicDirNameIndex::AddCandidates(const DiskBasicDirNameIndexMap &map, const wxString &key, DiskBasicDirItems &candidates) const
+{
+	DiskBasicDirNameIndexMap::const_iterator it = map.find(key);
+	if (it != map.end()) {
+		for(size_t i=0; i<it->second.Count(); i++) {
+			candidates.Add(it->second.Item(i));
+		}
+	}
+	for(size_t i=0; i<m_irregular.Count(); i++) {
+		candidates.Add(m_irregular.Item(i));
+	}
+}
+
+/// ファイル名＋拡張子が一致する可能性のあるアイテムを返す
+/// @param [in]  filename   ファイル名
+/// @param [out] candidates 候補のアイテム
+void DiskBasicDirNameIndex::FindFiles(const wxString &filename, DiskBasicDirItems &candidates) const
+{
+	AddCandidates(m_files, p_rule->MakeNameIndexKey(filename, true), candidates);
+}
+
+/// ファイル名＋拡張子が一致する可能性のあるアイテムを返す
+/// @param [in]  target_item 検索対象アイテム
+/// @param [out] candidates  候補のアイテム
+void DiskBasicDirNameIndex::FindFiles(const DiskBasicDirItem *target_item, DiskBasicDirItems &candidates) const
+{
+	AddCandidates(m_files, p_rule->MakeNameIndexKey(target_item, true), candidates);
+}
+
+/// ファイル名(拡張子除く)が一致する可能性のあるアイテムを返す
+/// @param [in]  name       ファイル名
+/// @param [out] candidates 候補のアイテム
+void DiskBasicDirNameIndex::FindNames(const wxString &name, DiskBasicDirItems &candidates) const
+{
+	AddCandidates(m_names, p_rule->MakeNameIndexKey(name, false), candidates);
+}
+
+/// 子ディレクトリ一覧内の位置を返す
+/// @param [in] item アイテム
+/// @return 位置 / wxNOT_FOUND
+int DiskBasicDirNameIndex::GetPosition(const DiskBasicDirItem *item) const
+{
+	DiskBasicDirNameIndexEntries::const_iterator it = m_entries.find(item);
+	if (it == m_entries.end()) return wxNOT_FOUND;
+	return it->second.m_pos;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// ディレクトリ内の未使用アイテムの一覧
+//
+/// @param [in] items 子ディレクトリ一覧
+DiskBasicDirFreeSlots::DiskBasicDirFreeSlots(const DiskBasicDirItems *items)
+{
+	m_free.Create(items->Count());
+	m_free_count = 0;
+	m_first = 0;
+	for(size_t pos = 0; pos < items->Count(); pos++) {
+		DiskBasicDirItem *item = items->Item(pos);
+		m_positions[item] = (int)pos;
+		if (!item->IsUsed()) {
+			m_free.Set((wxUint32)pos);
+			m_free_count++;
+		}
+	}
+}
+
+/// アイテムの使用状態を反映
+/// @param [in] item 子アイテム
+void DiskBasicDirFreeSlots::Update(const DiskBasicDirItem *item)
+{
+	DiskBasicDirItemPositions::iterator it = m_positions.find(item);
+	if (it == m_positions.end()) return;
+
+	wxUint32 pos = (wxUint32)it->second;
+	bool is_free = !item->IsUsed();
+	if (is_free == m_free.Test(pos)) return;
+
+	if (is_free) {
+		m_free.Set(pos);
+		m_free_count++;
+		if (pos < m_first) m_first = pos;
+	} else {
+		m_free.Reset(pos);
+		m_free_count--;
+	}
+}
+
+/// 先頭に近い未使用アイテムの位置を返す
+/// @return 位置 / wxNOT_FOUND:空きなし
+int DiskBasicDirFreeSlots::FindFirst()
+{
+	if (m_free_count <= 0) return wxNOT_FOUND;
+
+	for(size_t w = (m_first >> 5); w < m_free.GetWordCount(); w++) {
+		wxUint32 bits = m_free.GetWord(w);
+		if (!bits) continue;
+		size_t pos = (w << 5);
+		while(!(bits & 1)) {
+			bits >>= 1;
+			pos++;
+		}
+		m_first = pos;
+		return (int)pos;
+	}
+	return wxNOT_FOUND;
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 // 属性値を一時的に集めておくクラス
@@ -2270,6 +2672,7 @@ DirItemSectorBoundary::~DirItemSectorBoundary()
 void DirItemSectorBoundary::Clear()
 {
 	for(int i=0; i<2; i++) {
+		s[i].sector = NULL;
 		s[i].data = NULL;
 		s[i].size = 0;
 		s[i].pos  = 0xffff;
@@ -2292,6 +2695,7 @@ bool DirItemSectorBoundary::Set(DiskBasic *basic, DiskImageSector *sector, int p
 	int ssize = sector->GetSectorSize();
 	wxUint8 *sptr = (wxUint8 *)item_data;
 	if (item_data) {
+		s[0].sector = sector;
 		s[0].data = sptr;
 		s[0].size = (int)item_size;
 		s[0].pos  = 0;
@@ -2308,7 +2712,8 @@ bool DirItemSectorBoundary::Set(DiskBasic *basic, DiskImageSector *sector, int p
 			int n_block_num = sector->GetNumber() + 1;
 			DiskImageSector *nsector = basic->GetSector(n_block_num);
 			if (nsector) {
-				sptr = nsector->GetSectorBuffer();
+				s[1].sector = nsector;
+				sptr = (wxUint8 *)nsector->GetSectorBufferForRead();
 				ssize = nsector->GetSectorSize();
 				spos = basic->GetDirStartPosOnSector();
 				spos += (n_block_num % basic->GetSectorsPerGroup()) == 0 ? basic->GetDirStartPosOnGroup() : 0;
@@ -2343,6 +2748,7 @@ void DirItemSectorBoundary::CopyFrom(const directory_t *src_item)
 		wxUint8 *dst = s[i].data;
 		if (dst && src) {
 			memcpy(&dst[s[i].pos], &src[s[i].pos], s[i].size);
+			if (s[i].sector) s[i].sector->SetModify();
 		}
 	}
 }
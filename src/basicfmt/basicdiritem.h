@@ -12,6 +12,8 @@
 #include "basiccommon.h"
 #include <wx/string.h>
 #include <wx/dynarray.h>
+#include <wx/hashmap.h>
+#include "basicfat.h"
 #include "../diskimg/diskimage.h"
 
 
@@ -29,6 +31,8 @@ class IntNameBox;
 class DiskBasicDirItem;
 class DiskBasicDirItems;
 class DiskBasicDirItemAttr;
+class DiskBasicDirNameIndex;
+class DiskBasicDirFreeSlots;
 
 
 //////////////////////////////////////////////////////////////////////
@@ -43,6 +47,11 @@ private:
 	DiskImageDisk *p_disk;	///< ディスク
 	int   m_position;	///< セクタ内の位置（バイト）
 	int	  m_block_num;	///< ディレクトリのあるセクタ番号
+	mutable DiskImageSector *p_sector;	///< ディレクトリのあるセクタ
+	mutable wxUint32 m_generation;	///< 上記セクタを得た時のキャッシュの世代
+
+	/// @brief セクタを返す
+	DiskImageSector *GetSector() const;
 public:
 	DiskBasicDirData();
 	~DiskBasicDirData();
@@ -60,6 +69,10 @@ public:
 //	void Invert(size_t len = 0xfffffff, size_t start = 0);
 	/// @brief データを返す
 	TYPE *Data() const;
+	/// @brief 書き込み用にデータを返す
+	TYPE *DataForWrite() const;
+	/// @brief データのあるセクタを変更済みにする
+	void SetModify() const;
 	/// @brief データが有効か
 	bool IsValid() const;
 	/// @brief 自分でメモリを確保したか
@@ -78,6 +91,8 @@ DiskBasicDirData<TYPE>::DiskBasicDirData()
 	p_disk = NULL;
 	m_block_num = 0;
 	m_position = 0;
+	p_sector = NULL;
+	m_generation = 0;
 }
 
 template <class TYPE>
@@ -96,6 +111,8 @@ void DiskBasicDirData<TYPE>::Delete()
 	p_disk = NULL;
 	m_block_num = 0;
 	m_position = 0;
+	p_sector = NULL;
+	m_generation = 0;
 }
 
 /// メモリ確保
@@ -119,6 +136,20 @@ void DiskBasicDirData<TYPE>::Attach(DiskImageDisk *disk, int block_num, int posi
 	m_position = position;
 }
 
+/// セクタを返す
+///
+/// キャッシュの世代が変わっていなければ前回得たセクタを返す
+template <class TYPE>
+DiskImageSector *DiskBasicDirData<TYPE>::GetSector() const
+{
+	wxUint32 generation = p_disk->GetCacheGeneration();
+	if (!p_sector || generation == 0 || generation != m_generation) {
+		p_sector = p_disk->GetSector(m_block_num);
+		m_generation = generation;
+	}
+	return p_sector;
+}
+
 /// データをコピーする
 /// @param[in] data   元データ
 /// @param[in] len    データサイズ
@@ -131,7 +162,7 @@ bool DiskBasicDirData<TYPE>::Copy(const void *data, size_t len, size_t start)
 	wxUint8 *src = (wxUint8 *)data;
 	if (len > sizeof(TYPE)) len = sizeof(TYPE);
 	if (p_disk) {
-		DiskImageSector *sector = p_disk->GetSector(m_block_num);
+		DiskImageSector *sector = GetSector();
 		sector->Copy(src + start, (int)len, m_position + (int)start);
 	} else if (m_data) {
 		wxUint8 *dst = (wxUint8 *)m_data;
@@ -151,7 +182,7 @@ bool DiskBasicDirData<TYPE>::Fill(int ch, size_t len, size_t start)
 
 	if (len > sizeof(TYPE)) len = sizeof(TYPE);
 	if (p_disk) {
-		DiskImageSector *sector = p_disk->GetSector(m_block_num);
+		DiskImageSector *sector = GetSector();
 		sector->Fill(ch, (int)len, m_position + (int)start);
 	} else if (m_data) {
 		wxUint8 *dst = (wxUint8 *)m_data;
@@ -161,20 +192,47 @@ bool DiskBasicDirData<TYPE>::Fill(int ch, size_t len, size_t start)
 }
 
 /// @brief データを返す
+///
+/// セクタの変更は監視しない。書き換える時は DataForWrite() か SetModify() を使う。
 template <class TYPE>
 TYPE *DiskBasicDirData<TYPE>::Data() const
 {
 	if (!p_disk && !m_data) return NULL;
 
 	if (p_disk) {
-		DiskImageSector *sector = p_disk->GetSector(m_block_num);
-		return (TYPE *)sector->GetSectorBuffer(m_position);
+		DiskImageSector *sector = GetSector();
+		return (TYPE *)sector->GetSectorBufferForRead(m_position);
 	} else if (m_data) {
 		return m_data;
 	}
 	return NULL;
 }
 
+/// @brief 書き込み用にデータを返す(セクタを変更済みにする)
+template <class TYPE>
+TYPE *DiskBasicDirData<TYPE>::DataForWrite() const
+{
+	if (!p_disk && !m_data) return NULL;
+
+	if (p_disk) {
+		DiskImageSector *sector = GetSector();
+		return (TYPE *)sector->GetSectorBufferForWrite(m_position);
+	} else if (m_data) {
+		return m_data;
+	}
+	return NULL;
+}
+
+/// @brief データのあるセクタを変更済みにする
+template <class TYPE>
+void DiskBasicDirData<TYPE>::SetModify() const
+{
+	if (!p_disk) return;
+
+	DiskImageSector *sector = GetSector();
+	if (sector) sector->SetModify();
+}
+
 /// @brief データが有効か
 template <class TYPE>
 bool DiskBasicDirData<TYPE>::IsValid() const
@@ -204,6 +262,7 @@ public:
 		USED_ITEM	 = 0x0001,	///< bit0:使用しているか
 		VISIBLE_LIST = 0x0002,	///< bit1:リストに表示するか
 		VISIBLE_TREE = 0x0004,	///< bit2:ツリーに表示するか
+		GROUPS_DEFERRED = 0x0008,	///< bit3:占有グループが未確定か
 	};
 
 protected:
@@ -213,9 +272,11 @@ protected:
 	DiskBasicDirItem  *m_parent;	///< 親ディレクトリ
 	DiskBasicDirItems *m_children;	///< 子ディレクトリ
 	bool		m_valid_dir;		///< 上記ディレクトリツリーが確定しているか
+	mutable DiskBasicDirNameIndex *p_name_index;	///< 子ディレクトリの名前検索用インデックス
+	mutable DiskBasicDirFreeSlots *p_free_slots;	///< 子ディレクトリの未使用アイテム
 
 	int			m_num;				///< 通し番号
-	int			m_flags;			///< フラグ bit0:使用しているか bit1:リストに表示するか bit2:ツリーに表示するか
+	int			m_flags;			///< フラグ bit0:使用しているか bit1:リストに表示するか bit2:ツリーに表示するか bit3:占有グループが未確定か
 	DiskBasicGroups m_groups;		///< 占有グループ
 	int			m_external_attr;	///< ディレクトリエントリ内に持たない属性を保持する(機種依存)
 
@@ -268,6 +329,8 @@ protected:
 	virtual wxString GetFileExtPlainStr() const;
 	/// @brief ファイル名を変換して内部ファイル名にする 検索用
 	bool			ToNativeFileName(const wxString &filename, wxUint8 *name, size_t &nlen, wxUint8 *ext, size_t &elen) const;
+	/// @brief 内部ファイル名から名前検索用のキーを作成
+	wxString		MakeNameIndexKey(wxUint8 *name, size_t nlen, wxUint8 *ext, size_t elen) const;
 	/// @brief ファイルパスから内部ファイル名を生成する インポート時などのダイアログを出す前
 	wxString		RemakeFileNameAndExtStr(const wxString &filepath) const;
 	/// @brief ファイルパスから内部ファイル名を生成する インポート時などのダイアログを出す前
@@ -339,6 +402,18 @@ public:
 	bool			IsValidDirectory() const { return m_valid_dir; }
 	/// @brief ディレクトリツリーが確定しているか設定
 	void			ValidDirectory(bool val) { m_valid_dir = val; }
+	/// @brief 子ディレクトリの名前検索用インデックスを返す
+	DiskBasicDirNameIndex *GetNameIndex() const;
+	/// @brief 子ディレクトリの名前検索用インデックスを更新
+	void			UpdateNameIndex(DiskBasicDirItem *item) const;
+	/// @brief 子ディレクトリの名前検索用インデックスを破棄
+	void			ReleaseNameIndex() const;
+	/// @brief 子ディレクトリの未使用アイテムを返す
+	DiskBasicDirFreeSlots *GetFreeSlots() const;
+	/// @brief 子ディレクトリの未使用アイテムを更新
+	void			UpdateFreeSlot(const DiskBasicDirItem *item) const;
+	/// @brief 子ディレクトリの未使用アイテムを破棄
+	void			ReleaseFreeSlots() const;
 	//@}
 
 	/// @name 操作
@@ -399,6 +474,10 @@ public:
 	virtual bool	IsSameFileName(const DiskBasicDirItem *src, bool icase) const;
 	/// @brief 小文字を大文字にする
 	virtual void	ToUpper(wxUint8 *str, size_t size) const;
+	/// @brief ファイル名から名前検索用のキーを作成
+	wxString		MakeNameIndexKey(const wxString &filename, bool with_ext) const;
+	/// @brief アイテムのファイル名から名前検索用のキーを作成
+	wxString		MakeNameIndexKey(const DiskBasicDirItem *src, bool with_ext) const;
 	/// @brief ファイル名＋拡張子のサイズ
 	virtual int		GetFileNameStrSize() const;
 	/// @brief ダイアログ入力前のファイル名を変換 大文字にするなど
@@ -492,13 +571,19 @@ public:
 	/// @brief 親のグループ番号を返す(機種依存)
 	virtual wxUint32 GetParentGroup() const;
 	/// @brief グループリストの数を返す
-	size_t			GetGroupCount() const;
+	size_t			GetGroupCount();
 	/// @brief グループリストを返す
-	const DiskBasicGroups &GetGroups() const;
+	const DiskBasicGroups &GetGroups();
 	/// @brief グループリストを設定
 	void SetGroups(const DiskBasicGroups &vals);
 	/// @brief グループリストのアイテムを返す
-	DiskBasicGroupItem *GetGroup(size_t idx) const;
+	DiskBasicGroupItem *GetGroup(size_t idx);
+	/// @brief グループリストを未確定にする
+	void			DeferGroups();
+	/// @brief グループリストが未確定か
+	bool			IsGroupsDeferred() const;
+	/// @brief 未確定のグループリストを確定する
+	void			ResolveGroups();
 	/// @brief チェイン用のセクタをクリア(機種依存)
 	virtual void	ClearChainSector(const DiskBasicDirItem *pitem = NULL) {}
 	/// @brief チェイン用のセクタをセット(機種依存)
@@ -778,6 +863,100 @@ WX_DEFINE_ARRAY(DiskBasicDirItem *, DiskBasicDirItems);
 
 //////////////////////////////////////////////////////////////////////
 
+/// @brief 名前検索用インデックスに登録したアイテムの情報
+class DiskBasicDirNameIndexEntry
+{
+public:
+	int			m_pos;			///< 子ディレクトリ一覧内の位置
+	wxString	m_file_key;		///< ファイル名＋拡張子のキー
+	wxString	m_name_key;		///< ファイル名(拡張子除く)のキー
+	bool		m_irregular;	///< キーで検索できないアイテムか
+
+	DiskBasicDirNameIndexEntry();
+};
+
+/// @brief 名前検索用キー → アイテム
+WX_DECLARE_STRING_HASH_MAP(DiskBasicDirItems, DiskBasicDirNameIndexMap);
+/// @brief アイテム → 登録した情報
+WX_DECLARE_HASH_MAP(const DiskBasicDirItem *, DiskBasicDirNameIndexEntry, wxPointerHash, wxPointerEqual, DiskBasicDirNameIndexEntries);
+
+/// @brief ディレクトリ内の子アイテムの名前検索用インデックス
+///
+/// 大文字にして末尾の空白などを除いた内部ファイル名をキーにする。
+/// キーが一致するのは候補なので、IsSameFileName() などで改めて比較すること。
+class DiskBasicDirNameIndex
+{
+private:
+	DiskBasicDirItem *p_rule;		///< 名前の変換に使うアイテム
+	DiskBasicDirNameIndexMap m_files;	///< ファイル名＋拡張子 → アイテム
+	DiskBasicDirNameIndexMap m_names;	///< ファイル名(拡張子除く) → アイテム
+	DiskBasicDirNameIndexEntries m_entries;	///< 登録したアイテム
+	DiskBasicDirItems m_irregular;	///< キーで検索できないアイテム 常に候補とする
+
+	DiskBasicDirNameIndex() {}
+	DiskBasicDirNameIndex(const DiskBasicDirNameIndex &src) {}
+	DiskBasicDirNameIndex &operator=(const DiskBasicDirNameIndex &src) { return *this; }
+
+	/// @brief キーに対応するアイテムを登録
+	void			Register(DiskBasicDirItem *item, DiskBasicDirNameIndexEntry &entry);
+	/// @brief キーに対応するアイテムを削除
+	void			Unregister(DiskBasicDirItem *item, DiskBasicDirNameIndexEntry &entry);
+	/// @brief キーに対応するアイテムを候補に加える
+	void			AddCandidates(const DiskBasicDirNameIndexMap &map, const wxString &key, DiskBasicDirItems &candidates) const;
+
+public:
+	DiskBasicDirNameIndex(DiskBasicDirItem *rule);
+	~DiskBasicDirNameIndex();
+
+	/// @brief アイテムを追加
+	void			Add(DiskBasicDirItem *item, int pos);
+	/// @brief アイテムのキーを更新
+	void			Update(DiskBasicDirItem *item);
+	/// @brief ファイル名＋拡張子が一致する可能性のあるアイテムを返す
+	void			FindFiles(const wxString &filename, DiskBasicDirItems &candidates) const;
+	/// @brief ファイル名＋拡張子が一致する可能性のあるアイテムを返す
+	void			FindFiles(const DiskBasicDirItem *target_item, DiskBasicDirItems &candidates) const;
+	/// @brief ファイル名(拡張子除く)が一致する可能性のあるアイテムを返す
+	void			FindNames(const wxString &name, DiskBasicDirItems &candidates) const;
+	/// @brief 子ディレクトリ一覧内の位置を返す
+	int				GetPosition(const DiskBasicDirItem *item) const;
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/// @brief アイテム → 子ディレクトリ一覧内の位置
+WX_DECLARE_HASH_MAP(const DiskBasicDirItem *, int, wxPointerHash, wxPointerEqual, DiskBasicDirItemPositions);
+
+/// @brief ディレクトリ内の未使用アイテムの一覧
+///
+/// 子ディレクトリ一覧内の位置をビットで持つ。
+/// アイテムの使用状態が変わるたびに Update() で更新する。
+class DiskBasicDirFreeSlots
+{
+private:
+	DiskBasicGroupBitmap m_free;	///< 未使用のアイテムの位置
+	DiskBasicDirItemPositions m_positions;	///< アイテム → 位置
+	int		m_free_count;	///< 未使用のアイテム数
+	size_t	m_first;		///< これより前に未使用のアイテムはない
+
+	DiskBasicDirFreeSlots() {}
+	DiskBasicDirFreeSlots(const DiskBasicDirFreeSlots &src) {}
+	DiskBasicDirFreeSlots &operator=(const DiskBasicDirFreeSlots &src) { return *this; }
+
+public:
+	DiskBasicDirFreeSlots(const DiskBasicDirItems *items);
+	~DiskBasicDirFreeSlots() {}
+
+	/// @brief アイテムの使用状態を反映
+	void	Update(const DiskBasicDirItem *item);
+	/// @brief 先頭に近い未使用アイテムの位置を返す
+	int		FindFirst();
+	/// @brief 未使用のアイテム数を返す
+	int		GetCount() const { return m_free_count; }
+};
+
+//////////////////////////////////////////////////////////////////////
+
 /// @brief 属性値を一時的に集めておくクラス
 class DiskBasicDirItemAttr
 {
@@ -874,6 +1053,7 @@ class DirItemSectorBoundary
 {
 private:
 	struct {
+		DiskImageSector *sector;
 		wxUint8 *data;
 		int		 size;
 		int		 pos;
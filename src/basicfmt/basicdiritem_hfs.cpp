@@ -245,6 +245,7 @@ void DiskBasicDirItemHFS::SetNativeName(wxUint8 *filename, size_t size, size_t l
 		for(size_t i=0; i<ns; i++) {
 			n[i] = filename[i];
 		}
+		SetModify();
 	}
 }
 
@@ -457,7 +458,7 @@ void DiskBasicDirItemHFS::GetUnitGroupsDir(int fileunit_num, const hfs_cat_dir_r
 			break;
 		}
 
-		wxUint8 *buffer = sector->GetSectorBuffer(); 
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			break;
 		}
@@ -515,18 +516,18 @@ void DiskBasicDirItemHFS::GetUnitGroupsFileExt(int fileunit_num, int fork_type,
 		if (!sector) {
 			break;
 		}
-		wxUint8 *buffer = sector->GetSectorBuffer();
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			break;
 		}
 
-		hfs_node_descriptor_t *node = (hfs_node_descriptor_t *)buffer;
+		const hfs_node_descriptor_t *node = (const hfs_node_descriptor_t *)buffer;
 		if (node->type == ndHdrNode) {
 			// ヘッダノードは常に最初
 			if (idx != 0) {
 				break;
 			}
-			hfs_bt_hdr_rec_t *header = (hfs_bt_hdr_rec_t *)&buffer[0xe];
+			const hfs_bt_hdr_rec_t *header = (const hfs_bt_hdr_rec_t *)&buffer[0xe];
 
 			end_idx = (int)(wxUINT32_SWAP_ON_LE(header->totalNodes) - wxUINT32_SWAP_ON_LE(header->freeNodes));
 			continue;
@@ -550,7 +551,7 @@ void DiskBasicDirItemHFS::GetUnitGroupsFileExt(int fileunit_num, int fork_type,
 //			int pos = (int)rpos;
 
 			// レコードのキー部分
-			hfs_ext_key_rec_t* rec_key = (hfs_ext_key_rec_t *)&buffer[rpos];
+			const hfs_ext_key_rec_t *rec_key = (const hfs_ext_key_rec_t *)&buffer[rpos];
 			if ((fork_type & 0xff) != rec_key->forkType || (wxUint32)file_id != wxUINT32_SWAP_ON_LE(rec_key->id)) {
 				continue;
 			}
@@ -566,7 +567,7 @@ void DiskBasicDirItemHFS::GetUnitGroupsFileExt(int fileunit_num, int fork_type,
 				rpos++;
 			}
 			// レコードのデータ部分
-			hfs_ext_data_rec_t *rec_dat = (hfs_ext_data_rec_t *)&buffer[rpos];
+			const hfs_ext_data_rec_t *rec_dat = (const hfs_ext_data_rec_t *)&buffer[rpos];
 
 			// 拡張レコードからグループを取得
 			GetGroupsFromExtDataRec(rec_dat, group_items);
@@ -593,7 +594,7 @@ void DiskBasicDirItemHFS::GetGroupsFromExtDataRec(const hfs_ext_data_rec_t *exts
 				break;
 			}
 
-			wxUint8 *buffer = sector->GetSectorBuffer(); 
+			const wxUint8 *buffer = sector->GetSectorBufferForRead();
 			if (!buffer) {
 				break;
 			}
@@ -624,7 +625,7 @@ int DiskBasicDirItemHFS::RecalcFileSize(DiskBasicGroups &group_items, int occupi
 	if (!sector) return occupied_size;
 
 	int sector_size = sector->GetSectorSize();
-	wxUint8 *buf = sector->GetSectorBuffer();
+	const wxUint8 *buf = sector->GetSectorBufferForRead();
 	int remain_size = type->CalcDataSizeOnLastSector(this, NULL, NULL, buf, sector_size, sector_size);
 
 	occupied_size = occupied_size - sector_size + remain_size;
@@ -829,6 +830,13 @@ void DiskBasicDirItemHFS::ClearData()
 //	m_data.Fill(basic->GetDeleteCode(), GetDataSize());
 }
 
+/// アイテムの属するセクタを変更済みにする
+void DiskBasicDirItemHFS::SetModify()
+{
+	m_key.SetModify();
+	m_data.SetModify();
+}
+
 /// データをインポートする前に必要な処理
 /// @param [in,out] filename ファイル名
 /// @return false このファイルは対象外とする
@@ -346,6 +346,8 @@ public:
 	virtual void	ClearData();
 	/// @brief セクタ内の位置（バイト）を返す
 	virtual int		GetPosition() const { return m_data.GetPosition(); }
+	/// @brief アイテムの属するセクタを変更済みにする
+	virtual void	SetModify();
 
 	/// @brief データをインポートする前に必要な処理
 	virtual bool	PreImportDataFile(wxString &filename);
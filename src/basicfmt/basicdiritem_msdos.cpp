@@ -173,7 +173,7 @@ int	DiskBasicDirItemMSDOS::GetFileType1() const
 /// 属性１を設定
 void DiskBasicDirItemMSDOS::SetFileType1(int val)
 {
-	m_data.Data()->msdos.type = val & 0xff;
+	m_data.DataForWrite()->msdos.type = val & 0xff;
 }
 
 /// 使用しているアイテムか
@@ -221,6 +221,8 @@ void DiskBasicDirItemMSDOS::SetNativeName(wxUint8 *filename, size_t size, size_t
 		size -= s;
 		num++;
 	} while(num <= 1);
+
+	SetModify();
 }
 
 /// ファイル名を得る
@@ -376,7 +378,7 @@ void DiskBasicDirItemMSDOS::GetFileAttrStrSub(int ftype, wxString &attr) const
 void DiskBasicDirItemMSDOS::SetFileSize(int val)
 {
 	m_groups.SetSize(val);
-	m_data.Data()->msdos.file_size = wxUINT32_SWAP_ON_BE(val);
+	m_data.DataForWrite()->msdos.file_size = wxUINT32_SWAP_ON_BE(val);
 }
 
 /// ファイルサイズを返す
@@ -398,6 +400,18 @@ void DiskBasicDirItemMSDOS::CalcFileUnitSize(int fileunit_num)
 {
 	if (!IsUsed()) return;
 
+	int file_size = GetFileSize();
+	int group_size = basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup();
+	if (fileunit_num == 0 && file_size > 0 && group_size > 0 && !IsDirectory()) {
+		// サイズがわかっているファイルはチェインをたどらない
+		// グループリストは必要になった時に作成する
+		m_groups.SetNums((file_size + group_size - 1) / group_size);
+		m_groups.SetSize(file_size);
+		m_groups.SetSizePerGroup(group_size);
+		DeferGroups();
+		return;
+	}
+
 	GetUnitGroups(fileunit_num, m_groups);
 }
 
@@ -489,7 +503,7 @@ void DiskBasicDirItemMSDOS::SetFileModifyDate(const TM &tm)
 {
 	if (tm.GetYear() >= 0 && tm.GetMonth() >= -1) {
 		wxUint16 wdate = ConvTmToDate(tm);
-		m_data.Data()->msdos.wdate = wxUINT16_SWAP_ON_BE(wdate);
+		m_data.DataForWrite()->msdos.wdate = wxUINT16_SWAP_ON_BE(wdate);
 	}
 }
 
@@ -498,7 +512,7 @@ void DiskBasicDirItemMSDOS::SetFileModifyTime(const TM &tm)
 {
 	if (tm.GetHour() >= 0 && tm.GetMinute() >= 0) {
 		wxUint16 wtime = ConvTmToTime(tm);
-		m_data.Data()->msdos.wtime = wxUINT16_SWAP_ON_BE(wtime); 
+		m_data.DataForWrite()->msdos.wtime = wxUINT16_SWAP_ON_BE(wtime); 
 	}
 }
 
@@ -578,15 +592,21 @@ void DiskBasicDirItemMSDOS::ClearData()
 	m_data.Fill(0, GetDataSize());
 }
 
+/// アイテムの属するセクタを変更済みにする
+void DiskBasicDirItemMSDOS::SetModify()
+{
+	m_data.SetModify();
+}
+
 /// 最初のグループ番号を設定
 void DiskBasicDirItemMSDOS::SetStartGroup(int fileunit_num, wxUint32 val, int size)
 {
 	// MS-DOS
-	m_data.Data()->msdos.start_group = wxUINT16_SWAP_ON_BE(val);
+	m_data.DataForWrite()->msdos.start_group = wxUINT16_SWAP_ON_BE(val);
 	if (type->GetFatType() == DiskBasicTypeFATBase::FAT_TYPE_32) {
 		// FAT32
 		val >>= 16;
-		m_data.Data()->msdos.start_group_hi = wxUINT16_SWAP_ON_BE(val);
+		m_data.DataForWrite()->msdos.start_group_hi = wxUINT16_SWAP_ON_BE(val);
 	}
 }
 
@@ -881,6 +901,8 @@ void DiskBasicDirItemVFAT::SetNativeName(wxUint8 *filename, size_t size, size_t
 		size -= s;
 		num++;
 	} while(num <= 4);
+
+	SetModify();
 }
 
 /// ファイル名を得る
@@ -1216,7 +1238,7 @@ void DiskBasicDirItemVFAT::SetFileCreateDate(const TM &tm)
 {
 	if (tm.GetYear() >= 0 && tm.GetMonth() >= -1) {
 		wxUint16 cdate = ConvTmToDate(tm);
-		m_data.Data()->msdos.cdate = wxUINT16_SWAP_ON_BE(cdate);
+		m_data.DataForWrite()->msdos.cdate = wxUINT16_SWAP_ON_BE(cdate);
 	}
 }
 
@@ -1225,7 +1247,7 @@ void DiskBasicDirItemVFAT::SetFileCreateTime(const TM &tm)
 {
 	if (tm.GetHour() >= 0 && tm.GetMinute() >= 0) {
 		wxUint16 ctime = ConvTmToTime(tm);
-		m_data.Data()->msdos.ctime = wxUINT16_SWAP_ON_BE(ctime); 
+		m_data.DataForWrite()->msdos.ctime = wxUINT16_SWAP_ON_BE(ctime); 
 	}
 }
 
@@ -1249,7 +1271,7 @@ void DiskBasicDirItemVFAT::SetFileAccessDate(const TM &tm)
 {
 	if (tm.GetYear() >= 0 && tm.GetMonth() >= -1) {
 		wxUint16 adate = ConvTmToDate(tm);
-		m_data.Data()->msdos.adate = wxUINT16_SWAP_ON_BE(adate);
+		m_data.DataForWrite()->msdos.adate = wxUINT16_SWAP_ON_BE(adate);
 	}
 }
 
@@ -1258,10 +1280,10 @@ void DiskBasicDirItemVFAT::SetFileAccessDate(const TM &tm)
 void DiskBasicDirItemVFAT::SetStartGroup(int fileunit_num, wxUint32 val, int size)
 {
 	// MS-DOS
-	m_data.Data()->msdos.start_group = wxUINT16_SWAP_ON_BE(val);
+	m_data.DataForWrite()->msdos.start_group = wxUINT16_SWAP_ON_BE(val);
 	// FAT32
 	val >>= 16;
-	m_data.Data()->msdos.start_group_hi = wxUINT16_SWAP_ON_BE(val);
+	m_data.DataForWrite()->msdos.start_group_hi = wxUINT16_SWAP_ON_BE(val);
 }
 
 /// 最初のグループ番号を返す
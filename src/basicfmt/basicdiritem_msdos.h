@@ -172,6 +172,8 @@ public:
 	virtual void	ClearData();
 	/// @brief セクタ内の位置（バイト）を返す
 	virtual int		GetPosition() const { return m_data.GetPosition(); }
+	/// @brief アイテムの属するセクタを変更済みにする
+	virtual void	SetModify();
 
 	/// @brief ファイル名から属性を決定する
 	virtual int		ConvFileTypeFromFileName(const wxString &filename) const;
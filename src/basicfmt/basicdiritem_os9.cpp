@@ -76,12 +76,16 @@ void DiskBasicDirItemOS9FD::Dup(const DiskBasicDirItemOS9FD &src)
 }
 #endif
 /// セクタデータを取得しfdとする
-directory_os9_fd_t *DiskBasicDirItemOS9FD::GetFDFromSector() const
+/// @param [in] for_write 書き換える場合true セクタを変更済みにする
+directory_os9_fd_t *DiskBasicDirItemOS9FD::GetFDFromSector(bool for_write) const
 {
 	directory_os9_fd_t *fd = NULL;
 	if (m_block_num >= 0) {
 		DiskImageSector *sector = basic->GetSector(m_block_num);
-		if (sector) fd = (directory_os9_fd_t *)sector->GetSectorBuffer();
+		if (sector) {
+			if (for_write) fd = (directory_os9_fd_t *)sector->GetSectorBufferForWrite();
+			else fd = (directory_os9_fd_t *)sector->GetSectorBufferForRead();
+		}
 	}
 	return fd;
 }
@@ -138,7 +142,7 @@ wxUint8 DiskBasicDirItemOS9FD::GetATT() const
 void DiskBasicDirItemOS9FD::SetATT(wxUint8 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_ATT = val;
 }
 /// ユーザIDを返す
@@ -152,7 +156,7 @@ wxUint16 DiskBasicDirItemOS9FD::GetOWN() const
 void DiskBasicDirItemOS9FD::SetOWN(wxUint16 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_OWN = wxUINT16_SWAP_ON_LE(val);
 }
 /// セグメントのLSNを返す
@@ -173,14 +177,14 @@ wxUint16 DiskBasicDirItemOS9FD::GetSIZ(int idx) const
 void DiskBasicDirItemOS9FD::SetLSN(int idx, wxUint32 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) SET_OS9_LSN(fd->FD_SEG[idx].LSN, val);
 }
 /// セグメントにセクタ数を設定
 void DiskBasicDirItemOS9FD::SetSIZ(int idx, wxUint16 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_SEG[idx].SIZ = wxUINT16_SWAP_ON_LE(val);
 }
 /// ファイルサイズを返す
@@ -194,7 +198,7 @@ wxUint32 DiskBasicDirItemOS9FD::GetSIZ() const
 void DiskBasicDirItemOS9FD::SetSIZ(wxUint32 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_SIZ = wxUINT32_SWAP_ON_LE(val);
 }
 /// リンク数を返す
@@ -208,7 +212,7 @@ wxUint8 DiskBasicDirItemOS9FD::GetLNK() const
 void DiskBasicDirItemOS9FD::SetLNK(wxUint8 val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_LNK = val;
 }
 /// 更新日付を返す
@@ -222,14 +226,14 @@ const os9_date_t &DiskBasicDirItemOS9FD::GetDAT() const
 void DiskBasicDirItemOS9FD::SetDAT(const os9_date_t &val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_DAT = val;
 }
 /// 更新日付をセット
 void DiskBasicDirItemOS9FD::SetDAT(const os9_cdate_t &val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) {
 		fd->FD_DAT.yy = val.yy;
 		fd->FD_DAT.mm = val.mm;
@@ -247,12 +251,16 @@ const os9_cdate_t &DiskBasicDirItemOS9FD::GetDCR() const
 void DiskBasicDirItemOS9FD::SetDCR(const os9_cdate_t &val)
 {
 	directory_os9_fd_t *fd = p_fd;
-	if (!fd) fd = GetFDFromSector();
+	if (!fd) fd = GetFDFromSector(true);
 	if (fd) fd->FD_DCR = val;
 }
 /// 更新にする
 void DiskBasicDirItemOS9FD::SetModify()
 {
+	if (m_block_num >= 0) {
+		DiskImageSector *sector = basic->GetSector(m_block_num);
+		if (sector) sector->SetModify();
+	}
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -376,6 +384,7 @@ void DiskBasicDirItemOS9::SetNativeName(wxUint8 *filename, size_t size, size_t l
 	size_t s, l;
 	wxUint8 *n = GetFileNamePos(0, s, l);
 	EncodeString(n, l, (const char *)filename, length);
+	SetModify();
 }
 
 /// 文字列の最後のMSBをセット
@@ -439,7 +448,7 @@ void DiskBasicDirItemOS9::Dup(const DiskBasicDirItem &src)
 bool DiskBasicDirItemOS9::Delete()
 {
 	// 削除はエントリの先頭にコードを入れるだけ
-	m_data.Data()->DE_NAM[0] = basic->GetDeleteCode();
+	m_data.DataForWrite()->DE_NAM[0] = basic->GetDeleteCode();
 	Used(false);
 	return true;
 }
@@ -572,8 +581,7 @@ void DiskBasicDirItemOS9::GetUnitGroups(int fileunit_num, DiskBasicGroups &group
 
 		if (i != 0) {
 			if (group_items.Count() > 0) {
-				DiskBasicGroupItem *gitm = &group_items.Last();
-				gitm->SetNextGroup(lsn);
+				group_items.SetLastNextGroup(lsn);
 			}
 		}
 		for(int n = 0; n < siz; n++) {
@@ -729,7 +737,7 @@ void DiskBasicDirItemOS9::SetStartGroup(int fileunit_num, wxUint32 val, int size
 //	if (fd) {
 //		SET_OS9_LSN(fd->FD_SEG[0].LSN, val);
 //	}
-	SET_OS9_LSN(m_data.Data()->DE_LSN, val);
+	SET_OS9_LSN(m_data.DataForWrite()->DE_LSN, val);
 }
 
 /// 最初のグループ番号を返す
@@ -746,7 +754,7 @@ wxUint32 DiskBasicDirItemOS9::GetStartGroup(int fileunit_num) const
 /// 追加のグループ番号をセット FDセクタへのLSNをセット
 void DiskBasicDirItemOS9::SetExtraGroup(wxUint32 val)
 {
-	SET_OS9_LSN(m_data.Data()->DE_LSN, val);
+	SET_OS9_LSN(m_data.DataForWrite()->DE_LSN, val);
 }
 
 /// 追加のグループ番号を返す FDセクタへのLSNを返す
@@ -860,6 +868,7 @@ void DiskBasicDirItemOS9::CopyItem(const DiskBasicDirItem &src)
 void DiskBasicDirItemOS9::SetModify()
 {
 	DiskBasicDirItem::SetModify();
+	m_data.SetModify();
 	fd.SetModify();
 }
 
@@ -50,7 +50,7 @@ private:
 
 	DiskBasicDirItemOS9FD(const DiskBasicDirItemOS9FD &src);
 
-	directory_os9_fd_t *GetFDFromSector() const;
+	directory_os9_fd_t *GetFDFromSector(bool for_write = false) const;
 
 public:
 	DiskBasicDirItemOS9FD();
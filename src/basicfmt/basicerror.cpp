@@ -74,6 +74,12 @@ const char *gDiskBasicErrorMsgs[] = {
 	wxTRANSLATE("Path is too deep."),
 	//	ERR_NO_FOUND_TRACK
 	wxTRANSLATE("No track found. Run \"Initialize\" to create tracks."),
+	//	ERR_DEFRAG_UNSUPPORTED
+	wxTRANSLATE("Defragment process is unsupported."),
+	//	ERR_CHECK_UNSUPPORTED
+	wxTRANSLATE("Checking volume is unsupported."),
+	//	ERR_DEFRAG_CROSS_LINKED
+	wxTRANSLATE("Cannot defragment because some files share groups. Run \"Check Volume\" to see them."),
 
 	//	ERRV_START v:1
 	wxTRANSLATE("Unknown error. code:%d"),
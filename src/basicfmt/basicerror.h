@@ -53,6 +53,9 @@ public:
 		ERR_END_ADDR_TOO_SMALL,
 		ERR_PATH_TOO_DEEP,
 		ERR_NO_FOUND_TRACK,
+		ERR_DEFRAG_UNSUPPORTED,
+		ERR_CHECK_UNSUPPORTED,
+		ERR_DEFRAG_CROSS_LINKED,
 
 		ERRV_START,
 		// 引数あり（要フォーマット）のメッセージはこれ以降に設定
@@ -17,8 +17,8 @@
 //////////////////////////////////////////////////////////////////////
 
 DiskBasicAvailabillity::DiskBasicAvailabillity()
-	: wxArrayInt()
 {
+	m_count = 0;
 	m_free_size = -1;
 	m_free_grps = -1;
 }
@@ -26,7 +26,8 @@ DiskBasicAvailabillity::DiskBasicAvailabillity()
 /// 初期化 空きサイズを 0 にする
 void DiskBasicAvailabillity::Clear()
 {
-	wxArrayInt::Clear();
+	m_words.Clear();
+	m_count = 0;
 	m_free_size = 0;
 	m_free_grps = 0;
 }
@@ -34,7 +35,8 @@ void DiskBasicAvailabillity::Clear()
 /// 初期化 空きサイズを 0 にする
 void DiskBasicAvailabillity::Empty()
 {
-	wxArrayInt::Empty();
+	m_words.Empty();
+	m_count = 0;
 	m_free_size = 0;
 	m_free_grps = 0;
 }
@@ -42,18 +44,34 @@ void DiskBasicAvailabillity::Empty()
 /// 初期化 空きサイズを -1 にする
 void DiskBasicAvailabillity::EmptyInit()
 {
-	wxArrayInt::Empty();
+	m_words.Empty();
+	m_count = 0;
 	m_free_size = -1;
 	m_free_grps = -1;
 }
 
+/// 全て同じ状態のワードを返す
+/// @param[in] val 値
+/// @return ワード
+wxUint32 DiskBasicAvailabillity::FillWord(int val)
+{
+	return (wxUint32)(val & ItemMask) * 0x11111111U;
+}
+
 /// 追加
 /// @param[in] val   値
 /// @param[in] size  空きサイズ
 /// @param[in] group 空きグループ数
 void DiskBasicAvailabillity::Add(int val, int size, int group)
 {
-	wxArrayInt::Add(val);
+	size_t sub = m_count % ItemsPerWord;
+	if (sub == 0) {
+		m_words.Add(0);
+	}
+	wxUint32 word = (wxUint32)m_words.Last();
+	word |= ((wxUint32)(val & ItemMask) << (sub * BitsPerItem));
+	m_words.Last() = (int)word;
+	m_count++;
 	m_free_size += size;
 	m_free_grps += group;
 }
@@ -63,8 +81,12 @@ void DiskBasicAvailabillity::Add(int val, int size, int group)
 /// @param[in] val 値
 void DiskBasicAvailabillity::Set(size_t idx, int val)
 {
-	if (idx < Count()) {
-		Item(idx) = val;
+	if (idx < m_count) {
+		int shift = (int)(idx % ItemsPerWord) * BitsPerItem;
+		wxUint32 word = (wxUint32)m_words.Item(idx / ItemsPerWord);
+		word &= ~((wxUint32)ItemMask << shift);
+		word |= ((wxUint32)(val & ItemMask) << shift);
+		m_words.Item(idx / ItemsPerWord) = (int)word;
 	}
 }
 
@@ -74,12 +96,95 @@ void DiskBasicAvailabillity::Set(size_t idx, int val)
 int DiskBasicAvailabillity::Get(size_t idx) const
 {
 	int val = 0;
-	if (idx < Count()) {
-		val = Item(idx);
+	if (idx < m_count) {
+		wxUint32 word = (wxUint32)m_words.Item(idx / ItemsPerWord);
+		val = (int)((word >> ((idx % ItemsPerWord) * BitsPerItem)) & ItemMask);
 	}
 	return val;
 }
 
+/// 変更 空きサイズも増減する (Safety)
+/// @param[in] idx  位置
+/// @param[in] val  値
+/// @param[in] size １グループのサイズ
+void DiskBasicAvailabillity::Modify(size_t idx, int val, int size)
+{
+	if (idx >= Count()) return;
+
+	int prev = Get(idx);
+	if (prev == val) return;
+
+	if (prev == FAT_AVAIL_FREE) {
+		m_free_size -= size;
+		m_free_grps--;
+	}
+	if (val == FAT_AVAIL_FREE) {
+		m_free_size += size;
+		m_free_grps++;
+	}
+	Set(idx, val);
+}
+
+/// 指定位置から同じ状態が続く数を返す
+///
+/// ワード全体が同じ状態なら８グループまとめて進める。
+/// @param[in] idx   開始位置
+/// @param[in] limit 最大数
+/// @return 数
+size_t DiskBasicAvailabillity::GetRunLength(size_t idx, size_t limit) const
+{
+	if (idx >= m_count) return 0;
+	if (limit > m_count - idx) limit = m_count - idx;
+
+	int val = Get(idx);
+	wxUint32 fill = FillWord(val);
+	size_t len = 0;
+	while(len < limit) {
+		size_t pos = idx + len;
+		if ((pos % ItemsPerWord) == 0 && (limit - len) >= ItemsPerWord
+		&& (wxUint32)m_words.Item(pos / ItemsPerWord) == fill) {
+			len += ItemsPerWord;
+			continue;
+		}
+		if (Get(pos) != val) break;
+		len++;
+	}
+	return len;
+}
+
+/// 範囲内で指定した状態のグループ数を返す
+/// @param[in] start 開始位置
+/// @param[in] end   終了位置(含まない)
+/// @param[in] val   状態
+/// @return 数
+size_t DiskBasicAvailabillity::CountInRange(size_t start, size_t end, int val) const
+{
+	if (end > m_count) end = m_count;
+
+	wxUint32 fill = FillWord(val);
+	size_t cnt = 0;
+	size_t pos = start;
+	while(pos < end) {
+		if ((pos % ItemsPerWord) == 0 && (end - pos) >= ItemsPerWord) {
+			// 一致するニブルが0になる
+			wxUint32 diff = (wxUint32)m_words.Item(pos / ItemsPerWord) ^ fill;
+			if (diff == 0) {
+				cnt += ItemsPerWord;
+			} else {
+				for(int i = 0; i < ItemsPerWord; i++) {
+					if ((diff & ItemMask) == 0) cnt++;
+					diff >>= BitsPerItem;
+				}
+			}
+			pos += ItemsPerWord;
+			continue;
+		}
+		if (Get(pos) == val) cnt++;
+		pos++;
+	}
+	return cnt;
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 // ビット ON/OFF バッファ １つ
@@ -112,7 +217,7 @@ BitMLBuffer::BitMLBuffer(DiskImageDisk *disk, int block_num, int start, int size
 /// @param[in] val true:セット / false:リセット
 void BitMLBuffer::Modify(wxUint32 num, bool val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_start);
 	wxUint32 pos = num >> 3;
 	wxUint32 bit = num & 7;
 	if (val) {
@@ -127,7 +232,7 @@ void BitMLBuffer::Modify(wxUint32 num, bool val)
 /// @return    true:セット / false:リセット
 bool BitMLBuffer::IsSet(wxUint32 num) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_start);
 	wxUint32 pos = num >> 3;
 	wxUint32 bit = num & 7;
 	return ((buffer[pos] & (0x80 >> bit)) != 0);
@@ -144,9 +249,9 @@ void BitMLBuffer::GetPos(wxUint32 num, wxUint32 &pos, wxUint32 &bit) const
 }
 
 /// バッファを返す
-wxUint8 *BitMLBuffer::GetBuffer()
+const wxUint8 *BitMLBuffer::GetBuffer()
 {
-	return p_disk->GetSector(m_block_num)->GetSectorBuffer(m_start);
+	return p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_start);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -274,7 +379,7 @@ DiskBasicFatBuffer::~DiskBasicFatBuffer()
 /// @param[in] code コード
 void DiskBasicFatBuffer::Fill(wxUint8 code)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		memset(buffer, code, m_size);
 	}
@@ -284,7 +389,7 @@ void DiskBasicFatBuffer::Fill(wxUint8 code)
 /// @param[in] len サイズ
 void DiskBasicFatBuffer::Copy(const wxUint8 *buf, size_t len)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		len = len < (size_t)m_size ? len : m_size;
 		memcpy(buffer, buf, len);
@@ -310,7 +415,7 @@ wxUint32 DiskBasicFatBuffer::ConvPos(wxUint32 accume_pos) const
 /// @return 値
 wxUint32 DiskBasicFatBuffer::Get(size_t pos) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
 	return buffer ? buffer[pos] : INVALID_GROUP_NUMBER;
 }
 /// 指定位置にデータをセット(8ビット)
@@ -318,7 +423,7 @@ wxUint32 DiskBasicFatBuffer::Get(size_t pos) const
 /// @param[in] val 値
 void DiskBasicFatBuffer::Set(size_t pos, wxUint32 val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		buffer[pos] = (wxUint8)val;
 	}
@@ -358,7 +463,7 @@ bool DiskBasicFatBuffer::BitTest(wxUint32 pos, wxUint8 mask, bool invert)
 /// @return 値
 wxUint32 DiskBasicFatBuffer::Get16LE(size_t pos) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
 	return buffer ? ((wxUint32)buffer[pos] | buffer[pos+1] << 8) : INVALID_GROUP_NUMBER;
 }
 /// 指定位置にデータをセット(16ビット、リトルエンディアン)
@@ -366,7 +471,7 @@ wxUint32 DiskBasicFatBuffer::Get16LE(size_t pos) const
 /// @param[in] val    値
 void DiskBasicFatBuffer::Set16LE(size_t pos, wxUint32 val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		buffer[pos]   = (val & 0xff);
 		buffer[pos+1] = ((val >> 8) & 0xff);
@@ -377,7 +482,7 @@ void DiskBasicFatBuffer::Set16LE(size_t pos, wxUint32 val)
 /// @return 値 
 wxUint32 DiskBasicFatBuffer::Get16BE(size_t pos) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
 	return buffer ? ((wxUint32)buffer[pos] << 8 | buffer[pos+1]) : INVALID_GROUP_NUMBER;
 }
 /// 指定位置にデータをセット(16ビット、ビッグエンディアン)
@@ -385,7 +490,7 @@ wxUint32 DiskBasicFatBuffer::Get16BE(size_t pos) const
 /// @param[in] val    値
 void DiskBasicFatBuffer::Set16BE(size_t pos, wxUint32 val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		buffer[pos]   = ((val >> 8) & 0xff);
 		buffer[pos+1] = (val & 0xff);
@@ -396,7 +501,7 @@ void DiskBasicFatBuffer::Set16BE(size_t pos, wxUint32 val)
 /// @return 値
 wxUint32 DiskBasicFatBuffer::Get32LE(size_t pos) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
 	return buffer ? ((wxUint32)buffer[pos] | buffer[pos+1] << 8 | buffer[pos+2] << 16 | buffer[pos+3] << 24) : INVALID_GROUP_NUMBER;
 }
 /// 指定位置にデータをセット(32ビット、リトルエンディアン)
@@ -404,7 +509,7 @@ wxUint32 DiskBasicFatBuffer::Get32LE(size_t pos) const
 /// @param[in] val    値
 void DiskBasicFatBuffer::Set32LE(size_t pos, wxUint32 val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		buffer[pos]   = (val & 0xff);
 		buffer[pos+1] = ((val >> 8) & 0xff);
@@ -417,7 +522,7 @@ void DiskBasicFatBuffer::Set32LE(size_t pos, wxUint32 val)
 /// @return 値 
 wxUint32 DiskBasicFatBuffer::Get32BE(size_t pos) const
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
 	return buffer ? ((wxUint32)buffer[pos] << 24 | buffer[pos+1] << 16 | buffer[pos+2] << 8 | buffer[pos+3]) : INVALID_GROUP_NUMBER;
 }
 /// 指定位置にデータをセット(32ビット、ビッグエンディアン)
@@ -425,7 +530,7 @@ wxUint32 DiskBasicFatBuffer::Get32BE(size_t pos) const
 /// @param[in] val    値
 void DiskBasicFatBuffer::Set32BE(size_t pos, wxUint32 val)
 {
-	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBuffer(m_buffer_start);
+	wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForWrite(m_buffer_start);
 	if (buffer) {
 		buffer[pos]   = ((val >> 24) & 0xff);
 		buffer[pos+1] = ((val >> 16) & 0xff);
@@ -433,6 +538,17 @@ void DiskBasicFatBuffer::Set32BE(size_t pos, wxUint32 val)
 		buffer[pos+3] = (val & 0xff);
 	}
 }
+/// バッファの内容をコピー
+/// @param[out] dst コピー先 バッファサイズ以上あること
+void DiskBasicFatBuffer::CopyTo(wxUint8 *dst) const
+{
+	const wxUint8 *buffer = p_disk->GetSector(m_block_num)->GetSectorBufferForRead(m_buffer_start);
+	if (buffer) {
+		memcpy(dst, buffer, m_size);
+	} else {
+		memset(dst, 0, m_size);
+	}
+}
 
 #include <wx/arrimpl.cpp>
 WX_DEFINE_OBJARRAY(ArrayDiskBasicFatBuffer);
@@ -826,6 +942,26 @@ void DiskBasicFatBuffers::SetData32BE(wxUint32 pos, wxUint32 val)
 #endif
 }
 
+/// 全バッファのサイズを返す
+size_t DiskBasicFatBuffers::GetTotalSize() const
+{
+	size_t size = 0;
+	for(size_t idx = 0; idx < Count(); idx++) {
+		size += Item(idx).GetSize();
+	}
+	return size;
+}
+/// 全バッファの内容を連続したメモリにコピー
+/// @param[out] dst コピー先 GetTotalSize()以上あること
+void DiskBasicFatBuffers::CopyTo(wxUint8 *dst) const
+{
+	for(size_t idx = 0; idx < Count(); idx++) {
+		const DiskBasicFatBuffer *buf = &Item(idx);
+		buf->CopyTo(dst);
+		dst += buf->GetSize();
+	}
+}
+
 WX_DEFINE_OBJARRAY(ArrayArrayDiskBasicFatBuffer);
 
 //////////////////////////////////////////////////////////////////////
@@ -1102,6 +1238,594 @@ void DiskBasicFatArea::SetData32BE(size_t idx, wxUint32 pos, wxUint32 val)
 	bufs->SetData32BE(pos, val);
 }
 
+//////////////////////////////////////////////////////////////////////
+//
+// デコードしたFAT
+//
+//////////////////////////////////////////////////////////////////////
+
+DiskBasicFatTable::DiskBasicFatTable()
+{
+	p_table = NULL;
+	m_count = 0;
+	m_format = FAT_TABLE_NONE;
+	p_free = NULL;
+	m_free_words = 0;
+	m_unused_code = 0;
+	m_next_free = 0;
+}
+DiskBasicFatTable::~DiskBasicFatTable()
+{
+	delete [] p_table;
+	delete [] p_free;
+}
+/// FATバッファからデコード
+///
+/// セクタの内容を一旦連続したメモリにコピーしてからエントリを展開する
+/// 同時に空きグループのビットマップも作成する
+/// @param[in] format      エントリ形式
+/// @param[in] bufs        FAT１つ分のバッファ
+/// @param[in] unused_code 未使用を表すコード
+void DiskBasicFatTable::Decode(int format, const DiskBasicFatBuffers &bufs, wxUint32 unused_code)
+{
+	Clear();
+
+	size_t size = bufs.GetTotalSize();
+	size_t count = 0;
+	switch(format) {
+	case FAT_TABLE_12LE:
+		count = size * 2 / 3;
+		break;
+	case FAT_TABLE_16LE:
+	case FAT_TABLE_16BE:
+		count = size / 2;
+		break;
+	case FAT_TABLE_32LE:
+	case FAT_TABLE_32BE:
+		count = size / 4;
+		break;
+	default:
+		return;
+	}
+	if (count == 0) return;
+
+	wxUint8 *raw = new wxUint8[size];
+	bufs.CopyTo(raw);
+
+	p_table = new wxUint32[count];
+	for(size_t num = 0; num < count; num++) {
+		const wxUint8 *p;
+		wxUint32 val;
+		switch(format) {
+		case FAT_TABLE_12LE:
+			p = &raw[num * 3 / 2];
+			if (num & 1) {
+				val = ((wxUint32)p[0] >> 4) | ((wxUint32)p[1] << 4);
+			} else {
+				val = (wxUint32)p[0] | (((wxUint32)p[1] & 0x0f) << 8);
+			}
+			break;
+		case FAT_TABLE_16LE:
+			p = &raw[num * 2];
+			val = (wxUint32)p[0] | ((wxUint32)p[1] << 8);
+			break;
+		case FAT_TABLE_16BE:
+			p = &raw[num * 2];
+			val = ((wxUint32)p[0] << 8) | (wxUint32)p[1];
+			break;
+		case FAT_TABLE_32LE:
+			p = &raw[num * 4];
+			val = (wxUint32)p[0] | ((wxUint32)p[1] << 8) | ((wxUint32)p[2] << 16) | ((wxUint32)p[3] << 24);
+			break;
+		default:
+			p = &raw[num * 4];
+			val = ((wxUint32)p[0] << 24) | ((wxUint32)p[1] << 16) | ((wxUint32)p[2] << 8) | (wxUint32)p[3];
+			break;
+		}
+		p_table[num] = val;
+	}
+	delete [] raw;
+
+	m_count = count;
+	m_format = format;
+
+	// 空きビットマップ
+	m_unused_code = unused_code;
+	m_free_words = (count + 31) / 32;
+	p_free = new wxUint32[m_free_words];
+	memset(p_free, 0, sizeof(wxUint32) * m_free_words);
+	for(size_t num = 0; num < count; num++) {
+		if (p_table[num] == unused_code) {
+			p_free[num >> 5] |= (1U << (num & 31));
+		}
+	}
+	m_next_free = 0;
+}
+/// クリア
+void DiskBasicFatTable::Clear()
+{
+	delete [] p_table;
+	p_table = NULL;
+	m_count = 0;
+	m_format = FAT_TABLE_NONE;
+	delete [] p_free;
+	p_free = NULL;
+	m_free_words = 0;
+	m_next_free = 0;
+}
+/// 値を返す
+/// @param[in] num グループ番号
+/// @return 値 範囲外の時はINVALID_GROUP_NUMBER
+wxUint32 DiskBasicFatTable::Get(wxUint32 num) const
+{
+	return num < m_count ? p_table[num] : INVALID_GROUP_NUMBER;
+}
+/// 値をセット
+/// @param[in] num グループ番号
+/// @param[in] val 値
+void DiskBasicFatTable::Set(wxUint32 num, wxUint32 val)
+{
+	if (num < m_count) {
+		p_table[num] = val;
+		bool free = (val == m_unused_code);
+		SetFreeBit(num, free);
+		if (!free && num >= m_next_free) {
+			// 確保したら次の位置から探す
+			m_next_free = num + 1;
+		}
+	}
+}
+/// 空きビットを更新
+/// @param[in] num  グループ番号
+/// @param[in] free 空きか
+inline void DiskBasicFatTable::SetFreeBit(wxUint32 num, bool free)
+{
+	if (free) {
+		p_free[num >> 5] |= (1U << (num & 31));
+	} else {
+		p_free[num >> 5] &= ~(1U << (num & 31));
+	}
+}
+/// 最下位のセットされたビット位置を返す
+/// @param[in] word 0以外の値
+/// @return ビット位置(0 - 31)
+int DiskBasicFatTable::LowestBit(wxUint32 word)
+{
+	// de Bruijn系列で最下位ビットの位置を求める
+	static const int table[32] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+	return table[((word & (0U - word)) * 0x077CB531U) >> 27];
+}
+/// 範囲内で空きを探す
+///
+/// ビットマップを32ビットずつ調べ、空きのないワードは読み飛ばす。
+/// @param[in] start 開始グループ番号
+/// @param[in] end   終了グループ番号(含む)
+/// @return グループ番号 / INVALID_GROUP_NUMBER 空きなし
+wxUint32 DiskBasicFatTable::FindFreeInRange(wxUint32 start, wxUint32 end) const
+{
+	if (start > end) return INVALID_GROUP_NUMBER;
+
+	size_t widx = (start >> 5);
+	size_t wend = (end >> 5);
+	// 先頭ワードは開始位置より前のビットを落とす
+	wxUint32 word = p_free[widx] & (0xffffffffU << (start & 31));
+	for(;;) {
+		if (widx == wend) {
+			// 最終ワードは終了位置より後ろのビットを落とす
+			if ((end & 31) != 31) word &= ((1U << ((end & 31) + 1)) - 1);
+		}
+		if (word) {
+			return (wxUint32)(widx << 5) + LowestBit(word);
+		}
+		if (widx >= wend) break;
+		widx++;
+		word = p_free[widx];
+	}
+	return INVALID_GROUP_NUMBER;
+}
+/// 空きグループを探す
+///
+/// 指定位置から終了位置まで探し、なければ開始位置に戻って探す。
+/// @param[in] curr  探し始める位置
+/// @param[in] start 開始グループ番号
+/// @param[in] end   終了グループ番号(含む)
+/// @return グループ番号 / INVALID_GROUP_NUMBER 空きなし
+wxUint32 DiskBasicFatTable::FindFree(wxUint32 curr, wxUint32 start, wxUint32 end) const
+{
+	if (!p_free || m_count == 0) return INVALID_GROUP_NUMBER;
+	if (end >= m_count) end = (wxUint32)m_count - 1;
+	if (curr < start || curr > end) curr = start;
+
+	wxUint32 num = FindFreeInRange(curr, end);
+	if (num == INVALID_GROUP_NUMBER && curr > start) {
+		// ないときは最初からさがす
+		num = FindFreeInRange(start, curr - 1);
+	}
+	return num;
+}
+/// 連続した空きグループの一覧を作成
+///
+/// ビットマップを32ビットずつ調べ、すべて空きかすべて使用中のワードはまとめて処理する。
+/// @param[in]  start 開始グループ番号
+/// @param[in]  end   終了グループ番号(含む)
+/// @param[out] runs  空き領域(グループ番号順)
+void DiskBasicFatTable::GetFreeRuns(wxUint32 start, wxUint32 end, DiskBasicGroupRuns &runs) const
+{
+	runs.Empty();
+	if (!p_free || m_count == 0) return;
+	if (end >= m_count) end = (wxUint32)m_count - 1;
+	if (start > end) return;
+
+	wxUint32 run_start = 0;
+	int len = 0;
+	size_t wsta = (start >> 5);
+	size_t wend = (end >> 5);
+	for(size_t widx = wsta; widx <= wend; widx++) {
+		wxUint32 word = p_free[widx];
+		wxUint32 base = (wxUint32)(widx << 5);
+		// 範囲外のビットを落とす
+		if (widx == wsta) word &= (0xffffffffU << (start & 31));
+		if (widx == wend && (end & 31) != 31) word &= ((1U << ((end & 31) + 1)) - 1);
+
+		if (word == 0xffffffffU) {
+			// すべて空き
+			if (len == 0) run_start = base;
+			len += 32;
+			continue;
+		}
+		int bit = 0;
+		while(bit < 32) {
+			wxUint32 rest = (word >> bit);
+			if (rest & 1) {
+				// 空きが続く
+				int n = LowestBit(~rest);
+				if (len == 0) run_start = base + bit;
+				len += n;
+				bit += n;
+			} else {
+				// 使用中が続く
+				if (len > 0) {
+					runs.Add(DiskBasicGroupRun(run_start, len));
+					len = 0;
+				}
+				if (!rest) break;
+				bit += LowestBit(rest);
+			}
+		}
+	}
+	if (len > 0) {
+		runs.Add(DiskBasicGroupRun(run_start, len));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// グループ番号ごとのビットマップ
+//
+//////////////////////////////////////////////////////////////////////
+
+DiskBasicGroupBitmap::DiskBasicGroupBitmap()
+{
+	p_bits = NULL;
+	m_count = 0;
+	m_words = 0;
+}
+DiskBasicGroupBitmap::~DiskBasicGroupBitmap()
+{
+	delete [] p_bits;
+}
+/// 指定ビット数で作成 すべて0
+/// @param[in] count ビット数
+void DiskBasicGroupBitmap::Create(size_t count)
+{
+	Clear();
+	if (count == 0) return;
+
+	m_count = count;
+	m_words = (count + 31) / 32;
+	p_bits = new wxUint32[m_words];
+	memset(p_bits, 0, sizeof(wxUint32) * m_words);
+}
+/// クリア
+void DiskBasicGroupBitmap::Clear()
+{
+	delete [] p_bits;
+	p_bits = NULL;
+	m_count = 0;
+	m_words = 0;
+}
+/// 立っているビットの数を返す
+/// @param[in] word ワード
+/// @return ビット数
+int DiskBasicGroupBitmap::CountBits(wxUint32 word)
+{
+	word = word - ((word >> 1) & 0x55555555U);
+	word = (word & 0x33333333U) + ((word >> 2) & 0x33333333U);
+	word = (word + (word >> 4)) & 0x0f0f0f0fU;
+	return (int)((word * 0x01010101U) >> 24);
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// FATのチェイン検査
+//
+//////////////////////////////////////////////////////////////////////
+
+/// スレッドで走査する最大数
+#define FAT_SCAN_MAX_THREADS	8
+/// 1スレッドで走査する最小のグループ数
+#define FAT_SCAN_MIN_GROUPS		0x10000
+
+DiskBasicFatChecker::DiskBasicFatChecker()
+{
+	p_table = NULL;
+	m_start_group = 0;
+	m_end_group = 0;
+	m_unused_code = 0;
+	m_final_code = 0;
+	m_bad_code = 0;
+	m_used_groups = 0;
+	m_free_groups = 0;
+	m_bad_groups = 0;
+	m_invalid_groups = 0;
+}
+/// 初期化
+/// @param[in] table       デコードしたFAT
+/// @param[in] start_group 開始グループ番号
+/// @param[in] end_group   最終グループ番号(含む)
+/// @param[in] unused_code 未使用を表すコード
+/// @param[in] final_code  これ以上は終端を表すコード 1つ前は不良を表す
+void DiskBasicFatChecker::Setup(const DiskBasicFatTable *table, wxUint32 start_group, wxUint32 end_group, wxUint32 unused_code, wxUint32 final_code)
+{
+	p_table = (table && table->Count() > 0 ? table : NULL);
+	m_start_group = start_group;
+	m_end_group = end_group;
+	if (!p_table) {
+		m_end_group = 0;
+	} else if (m_end_group >= (wxUint32)table->Count()) {
+		m_end_group = (wxUint32)table->Count() - 1;
+	}
+	m_unused_code = unused_code;
+	m_final_code = final_code;
+	m_bad_code = final_code - 1;
+
+	size_t count = (size_t)m_end_group + 1;
+	m_used.Create(count);
+	m_referred.Create(count);
+	m_cross.Create(count);
+	m_visited.Create(count);
+	m_current.Create(count);
+
+	m_used_groups = 0;
+	m_free_groups = 0;
+	m_bad_groups = 0;
+	m_invalid_groups = 0;
+}
+/// 同じ条件で走査用に初期化
+///
+/// チェインをたどるためのビットマップは作らない
+/// @param[in] src 元
+void DiskBasicFatChecker::SetupPart(const DiskBasicFatChecker &src)
+{
+	p_table = src.p_table;
+	m_start_group = src.m_start_group;
+	m_end_group = src.m_end_group;
+	m_unused_code = src.m_unused_code;
+	m_final_code = src.m_final_code;
+	m_bad_code = src.m_bad_code;
+
+	size_t count = (size_t)m_end_group + 1;
+	m_used.Create(count);
+	m_referred.Create(count);
+	m_cross.Create(count);
+}
+/// 範囲内のエントリを走査
+///
+/// 各エントリの指す次のグループに参照の印をつけ、
+/// すでに印があれば複数から参照されているとする。
+/// @param[in] from 開始グループ番号
+/// @param[in] to   終了グループ番号(含む)
+void DiskBasicFatChecker::ScanRange(wxUint32 from, wxUint32 to)
+{
+	for(wxUint32 num = from; num <= to; num++) {
+		wxUint32 val = p_table->Get(num);
+		if (val == m_unused_code) {
+			m_free_groups++;
+			continue;
+		}
+		if (val == m_bad_code) {
+			m_bad_groups++;
+			continue;
+		}
+		m_used_groups++;
+		m_used.Set(num);
+		if (val >= m_final_code) {
+			// 終端
+			continue;
+		}
+		if (!IsValidGroup(val)) {
+			m_invalid_groups++;
+			continue;
+		}
+		if (m_referred.Test(val)) {
+			m_cross.Set(val);
+		} else {
+			m_referred.Set(val);
+		}
+	}
+}
+/// 走査した結果を合わせる
+/// @param[in] src 他のスレッドで走査した結果
+void DiskBasicFatChecker::Merge(const DiskBasicFatChecker &src)
+{
+	for(size_t i=0; i<m_referred.GetWordCount(); i++) {
+		wxUint32 dst_ref = m_referred.GetWord(i);
+		wxUint32 src_ref = src.m_referred.GetWord(i);
+		// 両方から参照されていれば重複
+		m_cross.SetWord(i, m_cross.GetWord(i) | src.m_cross.GetWord(i) | (dst_ref & src_ref));
+		m_referred.SetWord(i, dst_ref | src_ref);
+		m_used.SetWord(i, m_used.GetWord(i) | src.m_used.GetWord(i));
+	}
+	m_used_groups += src.m_used_groups;
+	m_free_groups += src.m_free_groups;
+	m_bad_groups += src.m_bad_groups;
+	m_invalid_groups += src.m_invalid_groups;
+}
+/// FAT全体を走査
+///
+/// グループ数が多い時は範囲を分けて複数のスレッドで走査し、最後に合わせる。
+void DiskBasicFatChecker::Scan()
+{
+	if (!p_table || m_end_group < m_start_group) return;
+
+	wxUint32 total = m_end_group - m_start_group + 1;
+	int threads = wxThread::GetCPUCount();
+	if (threads > FAT_SCAN_MAX_THREADS) threads = FAT_SCAN_MAX_THREADS;
+	if ((wxUint32)threads > total / FAT_SCAN_MIN_GROUPS) threads = (int)(total / FAT_SCAN_MIN_GROUPS);
+	if (threads < 1) threads = 1;
+
+	wxUint32 step = total / threads;
+	DiskBasicFatScanner **scanners = new DiskBasicFatScanner *[threads];
+	scanners[0] = NULL;
+	for(int i=1; i<threads; i++) {
+		wxUint32 from = m_start_group + step * i;
+		wxUint32 to = (i == threads - 1 ? m_end_group : from + step - 1);
+		scanners[i] = new DiskBasicFatScanner(from, to);
+		scanners[i]->GetPart().SetupPart(*this);
+		if (scanners[i]->Run() != wxTHREAD_NO_ERROR) {
+			// 起動できないときはここで走査する
+			delete scanners[i];
+			scanners[i] = NULL;
+			ScanRange(from, to);
+		}
+	}
+
+	// 最初の範囲はここで走査する
+	ScanRange(m_start_group, threads > 1 ? m_start_group + step - 1 : m_end_group);
+
+	for(int i=1; i<threads; i++) {
+		if (!scanners[i]) continue;
+		scanners[i]->Wait();
+		Merge(scanners[i]->GetPart());
+		delete scanners[i];
+	}
+	delete [] scanners;
+}
+/// チェインをたどる
+///
+/// たどったグループに印をつけ、すでに印があれば共有かループとする。
+/// @param[in]  start  開始グループ番号
+/// @param[out] groups たどったグループ数
+/// @return チェインの状態 en_chain_status
+int DiskBasicFatChecker::WalkChain(wxUint32 start, wxUint32 &groups)
+{
+	groups = 0;
+	if (!p_table) return CHAIN_BROKEN;
+
+	int status = CHAIN_OK;
+	wxUint32 num = start;
+	for(;;) {
+		if (!IsValidGroup(num) || !m_used.Test(num)) {
+			// 範囲外か未使用のグループを指している
+			status = CHAIN_BROKEN;
+			break;
+		}
+		if (m_current.Test(num)) {
+			// このチェインの中に戻ってきた
+			status = CHAIN_LOOPED;
+			break;
+		}
+		if (m_visited.Test(num)) {
+			// 他のチェインでたどったグループ
+			status = CHAIN_CROSS_LINKED;
+			break;
+		}
+		if (m_cross.Test(num) || (num == start && m_referred.Test(num))) {
+			// 複数から参照されている
+			status = CHAIN_CROSS_LINKED;
+		}
+		m_visited.Set(num);
+		m_current.Set(num);
+		groups++;
+
+		wxUint32 next = p_table->Get(num);
+		if (next >= m_final_code) {
+			// 終端
+			break;
+		}
+		num = next;
+	}
+
+	// このチェインの印を消す
+	num = start;
+	for(wxUint32 n = 0; n < groups; n++) {
+		m_current.Reset(num);
+		num = p_table->Get(num);
+	}
+	return status;
+}
+/// どのファイルからもたどれないチェインを数える
+///
+/// 他から参照されていない使用中のグループをチェインの先頭とする。
+/// @param[out] chains チェイン数
+/// @param[out] groups グループ数
+void DiskBasicFatChecker::CountLostChains(wxUint32 &chains, wxUint32 &groups) const
+{
+	chains = 0;
+	groups = 0;
+	for(size_t i=0; i<m_used.GetWordCount(); i++) {
+		wxUint32 lost = m_used.GetWord(i) & ~m_visited.GetWord(i);
+		if (!lost) continue;
+		groups += DiskBasicGroupBitmap::CountBits(lost);
+		chains += DiskBasicGroupBitmap::CountBits(lost & ~m_referred.GetWord(i));
+	}
+	if (groups > 0 && chains == 0) {
+		// 先頭のないループのみ
+		chains = 1;
+	}
+}
+/// 複数から参照されているグループ数
+wxUint32 DiskBasicFatChecker::GetCrossLinkedGroups() const
+{
+	wxUint32 count = 0;
+	for(size_t i=0; i<m_cross.GetWordCount(); i++) {
+		count += DiskBasicGroupBitmap::CountBits(m_cross.GetWord(i));
+	}
+	return count;
+}
+/// 他から参照されているグループ数
+wxUint32 DiskBasicFatChecker::GetReferredGroups() const
+{
+	wxUint32 count = 0;
+	for(size_t i=0; i<m_referred.GetWordCount(); i++) {
+		count += DiskBasicGroupBitmap::CountBits(m_referred.GetWord(i));
+	}
+	return count;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// FATの一部を走査するスレッド
+//
+//////////////////////////////////////////////////////////////////////
+
+DiskBasicFatScanner::DiskBasicFatScanner(wxUint32 from, wxUint32 to)
+	: wxThread(wxTHREAD_JOINABLE)
+{
+	m_from = from;
+	m_to = to;
+}
+/// スレッド本体
+wxThread::ExitCode DiskBasicFatScanner::Entry()
+{
+	m_part.ScanRange(m_from, m_to);
+
+	return (ExitCode)0;
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 // FATアクセス
@@ -1129,6 +1853,8 @@ double DiskBasicFat::Assign(bool is_formatting)
 	int sector_num = p_basic->GetFatStartSector();
 
 	m_bufs.Empty();
+	m_table.Clear();
+	m_next_free_hint = 0;
 
 	p_type = p_basic->GetType();
 
@@ -1153,6 +1879,9 @@ double DiskBasicFat::Assign(bool is_formatting)
 
 		p_type->CalcManagedStartGroup();
 
+		// FAT領域はキャッシュに固定しておく
+		p_basic->PinSectors(m_start, m_size * m_count);
+
 		// set buffer pointer for useful accessing
 		DiskImageDisk *disk = p_basic->GetDisk();
 		int start_sector = m_start;
@@ -1214,6 +1943,9 @@ void DiskBasicFat::Clear()
 	m_start_pos = 0;
 
 	m_bufs.Clear();
+	m_table.Clear();
+	m_next_free_hint = 0;
+	m_raw_modify_count = 0;
 }
 /// FATエリアのアサインを解除
 void DiskBasicFat::Empty()
@@ -1228,7 +1960,7 @@ wxUint8 DiskBasicFat::Get(int pos) const
 	wxUint8 code = 0;
 	DiskImageSector *sector = p_basic->GetSector(m_start);
 	if (sector) {
-		wxUint8 *buf = sector->GetSectorBuffer();
+		const wxUint8 *buf = sector->GetSectorBufferForRead();
 		int size = sector->GetSectorBufferSize();
 		if (buf && pos < size) {
 			code = buf[pos];
@@ -1246,7 +1978,7 @@ void DiskBasicFat::Set(int pos, wxUint8 code)
 	for(int fat_num = 0; fat_num < m_vcount; fat_num++) {
 		DiskImageSector *sector = p_basic->GetSector(start_sector);
 		if (sector) {
-			wxUint8 *buf = sector->GetSectorBuffer();
+			wxUint8 *buf = sector->GetSectorBufferForWrite();
 			int size = sector->GetSectorBufferSize();
 			if (buf && pos < size) {
 				buf[pos] = code;
@@ -1254,6 +1986,7 @@ void DiskBasicFat::Set(int pos, wxUint8 code)
 		}
 		start_sector += m_size;
 	}
+	m_table.Clear();
 }
 
 /// FAT領域の最初のセクタにデータを書く
@@ -1269,6 +2002,7 @@ void DiskBasicFat::Copy(const wxUint8 *buf, size_t len)
 		}
 		start_sector += m_size;
 	}
+	m_table.Clear();
 }
 
 /// FAT領域を指定コードで埋める
@@ -1287,6 +2021,152 @@ void DiskBasicFat::Fill(wxUint8 code)
 		start_sector += m_size;
 		end_sector += m_size;
 	}
+	m_table.Clear();
+}
+
+/// FATの値を返す
+///
+/// デコード済みならデコードした値を返す。
+/// デコードするまでは最初のFATのセクタから直接読むので、
+/// ディスクを開くだけならFAT全体を展開しない。
+/// @param[in] format エントリ形式 DiskBasicFatTable::en_fat_table_format
+/// @param[in] num    グループ番号
+/// @return 値 範囲外の時はINVALID_GROUP_NUMBER
+wxUint32 DiskBasicFat::GetGroupNumber(int format, wxUint32 num)
+{
+	DiscardStaleTable();
+	if (m_table.IsDecoded(format)) {
+		return m_table.Get(num);
+	}
+	return GetRawGroupNumber(format, num);
+}
+
+/// FAT全体をデコードする
+///
+/// 空きの検索や使用状況の計算などFAT全体が必要な時に呼ぶ。
+/// 同時に空きグループのビットマップも作成する。
+/// @param[in] format エントリ形式 DiskBasicFatTable::en_fat_table_format
+/// @return false デコードできない
+bool DiskBasicFat::DecodeTable(int format)
+{
+	DiscardStaleTable();
+	if (!m_table.IsDecoded(format)) {
+		if (m_bufs.Count() == 0) return false;
+		m_table.Decode(format, m_bufs.Item(0), p_basic->GetGroupUnusedCode());
+		m_table.SetNextFree(m_next_free_hint);
+		m_raw_modify_count = GetRawModifyCount();
+	}
+	return m_table.IsDecoded(format);
+}
+
+/// セクタが直接変更されていたらデコードしたFATを捨てる
+void DiskBasicFat::DiscardStaleTable()
+{
+	if (m_table.Count() > 0 && m_raw_modify_count != GetRawModifyCount()) {
+		// セクタ編集などでFATが直接変更されたのでデコードしなおす
+		m_next_free_hint = m_table.GetNextFree();
+		m_table.Clear();
+	}
+}
+
+/// FATの値をセクタから直接読む
+/// @param[in] format エントリ形式 DiskBasicFatTable::en_fat_table_format
+/// @param[in] num    グループ番号
+/// @return 値 範囲外の時はINVALID_GROUP_NUMBER
+wxUint32 DiskBasicFat::GetRawGroupNumber(int format, wxUint32 num) const
+{
+	switch(format) {
+	case DiskBasicFatTable::FAT_TABLE_12LE:
+		return m_bufs.GetData12LE(0, num);
+	case DiskBasicFatTable::FAT_TABLE_16LE:
+		return m_bufs.GetData16LE(0, num);
+	case DiskBasicFatTable::FAT_TABLE_16BE:
+		return m_bufs.GetData16BE(0, num);
+	case DiskBasicFatTable::FAT_TABLE_32LE:
+		return m_bufs.GetData32LE(0, num);
+	case DiskBasicFatTable::FAT_TABLE_32BE:
+		return m_bufs.GetData32BE(0, num);
+	default:
+		return INVALID_GROUP_NUMBER;
+	}
+}
+
+/// セクタを直接変更した回数を返す
+///
+/// 生セクタの編集などはFATを通さないので、回数が変わったらデコードしたFATを捨てる。
+wxUint32 DiskBasicFat::GetRawModifyCount() const
+{
+	DiskImageDisk *disk = p_basic->GetDisk();
+	if (!disk || !disk->GetFile()) return 0;
+	return disk->GetFile()->GetRawModifyCount();
+}
+
+/// FATの値をセット
+///
+/// 有効なすべてのFATに書き込み、デコードした値も更新する。
+/// @param[in] format エントリ形式 DiskBasicFatTable::en_fat_table_format
+/// @param[in] num    グループ番号
+/// @param[in] val    値
+void DiskBasicFat::SetGroupNumber(int format, wxUint32 num, wxUint32 val)
+{
+	switch(format) {
+	case DiskBasicFatTable::FAT_TABLE_12LE:
+		m_bufs.SetData12LE(num, val);
+		val &= 0xfff;
+		break;
+	case DiskBasicFatTable::FAT_TABLE_16LE:
+		m_bufs.SetData16LE(num, val);
+		val &= 0xffff;
+		break;
+	case DiskBasicFatTable::FAT_TABLE_16BE:
+		m_bufs.SetData16BE(num, val);
+		val &= 0xffff;
+		break;
+	case DiskBasicFatTable::FAT_TABLE_32LE:
+		m_bufs.SetData32LE(num, val);
+		break;
+	case DiskBasicFatTable::FAT_TABLE_32BE:
+		m_bufs.SetData32BE(num, val);
+		break;
+	default:
+		return;
+	}
+	if (m_table.IsDecoded(format)) {
+		m_table.Set(num, val);
+	}
+}
+
+/// 次に空きを探し始めるグループ番号をセット
+///
+/// FAT32のFSInfoなどから得たヒントを設定する。
+/// @param[in] val グループ番号
+void DiskBasicFat::SetNextFreeGroupNumber(wxUint32 val)
+{
+	m_next_free_hint = val;
+	m_table.SetNextFree(val);
+}
+
+/// 空きグループ番号を返す
+///
+/// デコードしたFATの空きビットマップから探す。
+/// @param[in] curr_group  探し始めるグループ番号
+/// @param[in] start_group 開始グループ番号
+/// @param[in] end_group   終了グループ番号(含む)
+/// @return グループ番号 / INVALID_GROUP_NUMBER 空きなし
+wxUint32 DiskBasicFat::FindEmptyGroupNumber(wxUint32 curr_group, wxUint32 start_group, wxUint32 end_group) const
+{
+	return m_table.FindFree(curr_group, start_group, end_group);
+}
+
+/// 連続した空きグループの一覧を作成
+///
+/// デコードしたFATの空きビットマップから作成する。
+/// @param[in]  start_group 開始グループ番号
+/// @param[in]  end_group   終了グループ番号(含む)
+/// @param[out] runs        空き領域(グループ番号順)
+void DiskBasicFat::GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, DiskBasicGroupRuns &runs) const
+{
+	m_table.GetFreeRuns(start_group, end_group, runs);
 }
 
 /// FATバッファを返す
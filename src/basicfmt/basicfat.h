@@ -11,6 +11,7 @@
 #include "../common.h"
 #include <wx/string.h>
 #include <wx/dynarray.h>
+#include <wx/thread.h>
 #include "basiccommon.h"
 #include "../diskimg/diskimage.h"
 
@@ -30,12 +31,26 @@ enum en_fat_availability {
 };
 
 /// @brief 使用状況テーブル
-class DiskBasicAvailabillity : public wxArrayInt
+///
+/// １グループの状態(en_fat_availability)を4ビットに詰めて保持する。
+class DiskBasicAvailabillity
 {
+public:
+	enum en_packed_bits {
+		BitsPerItem = 4,	///< １グループのビット数
+		ItemsPerWord = 8,	///< １ワードに入るグループ数
+		ItemMask = 0x0f
+	};
+
 private:
+	wxArrayInt m_words;		///< 4ビットずつ詰めた状態
+	size_t  m_count;		///< グループ数
 	wxInt64 m_free_size;	///< 空きサイズ
 	wxInt64 m_free_grps;	///< 空きグループ数
 
+	/// @brief 全て同じ状態のワードを返す
+	static wxUint32 FillWord(int val);
+
 public:
 	DiskBasicAvailabillity();
 	/// @brief 初期化 空きサイズを 0 にする
@@ -50,6 +65,14 @@ public:
 	void Set(size_t idx, int val);
 	/// @brief ゲット (Safety)
 	int  Get(size_t idx) const;
+	/// @brief 変更 空きサイズも増減する (Safety)
+	void Modify(size_t idx, int val, int size);
+	/// @brief グループ数を返す
+	size_t Count() const { return m_count; }
+	/// @brief 指定位置から同じ状態が続く数を返す
+	size_t GetRunLength(size_t idx, size_t limit) const;
+	/// @brief 範囲内で指定した状態のグループ数を返す
+	size_t CountInRange(size_t start, size_t end, int val) const;
 	/// @brief 空きサイズを返す
 	wxInt64 GetFreeSize() const { return m_free_size; }
 	/// @brief 空きグループ数を返す
@@ -84,7 +107,7 @@ public:
 	/// @brief 指定位置のビット位置を計算
 	virtual void GetPos(wxUint32 num, wxUint32 &pos, wxUint32 &bit) const;
 	/// @brief バッファを返す
-	wxUint8 *GetBuffer();
+	const wxUint8 *GetBuffer();
 	/// @brief バッファ開始位置を返す
 	int		 GetStart() const { return m_start; }
 	/// @brief サイズ(ビット数)を返す
@@ -172,6 +195,8 @@ public:
 	wxUint32 Get32BE(size_t pos) const;
 	/// @brief 指定位置にデータをセット(32ビット、ビッグエンディアン)
 	void	 Set32BE(size_t pos, wxUint32 val);
+	/// @brief バッファの内容をコピー
+	void	 CopyTo(wxUint8 *dst) const;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -233,6 +258,11 @@ public:
 	wxUint32 GetData32BE(wxUint32 pos) const;
 	/// @brief 32ビットデータ(ビッグエンディアン)をセット
 	void     SetData32BE(wxUint32 pos, wxUint32 val);
+
+	/// @brief 全バッファのサイズを返す
+	size_t   GetTotalSize() const;
+	/// @brief 全バッファの内容を連続したメモリにコピー
+	void     CopyTo(wxUint8 *dst) const;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -312,6 +342,203 @@ public:
 	void     SetData32BE(size_t idx, wxUint32 pos, wxUint32 val);
 };
 
+//////////////////////////////////////////////////////////////////////
+
+/// @brief デコードしたFAT
+///
+/// 最初のFATの値をグループ番号順の配列に展開して保持する
+class DiskBasicFatTable
+{
+public:
+	/// @brief FATのエントリ形式
+	enum en_fat_table_format {
+		FAT_TABLE_NONE = 0,
+		FAT_TABLE_12LE,
+		FAT_TABLE_16LE,
+		FAT_TABLE_16BE,
+		FAT_TABLE_32LE,
+		FAT_TABLE_32BE
+	};
+
+private:
+	wxUint32 *p_table;	///< グループ番号ごとの値
+	size_t	m_count;	///< エントリ数
+	int		m_format;	///< エントリ形式
+
+	wxUint32 *p_free;	///< 空きグループのビットマップ(1:空き)
+	size_t	m_free_words;	///< ビットマップのワード数
+	wxUint32 m_unused_code;	///< 未使用を表すコード
+	wxUint32 m_next_free;	///< 次に空きを探し始める位置
+
+	/// @brief 空きビットを更新
+	inline void SetFreeBit(wxUint32 num, bool free);
+	/// @brief 最下位のセットされたビット位置を返す
+	static int LowestBit(wxUint32 word);
+	/// @brief 範囲内で空きを探す
+	wxUint32 FindFreeInRange(wxUint32 start, wxUint32 end) const;
+
+	DiskBasicFatTable(const DiskBasicFatTable &src) {}
+	DiskBasicFatTable &operator=(const DiskBasicFatTable &src) { return *this; }
+
+public:
+	DiskBasicFatTable();
+	~DiskBasicFatTable();
+
+	/// @brief FATバッファからデコード
+	void	Decode(int format, const DiskBasicFatBuffers &bufs, wxUint32 unused_code);
+	/// @brief クリア
+	void	Clear();
+	/// @brief 指定形式でデコード済みか
+	bool	IsDecoded(int format) const { return (p_table != NULL && m_format == format); }
+	/// @brief エントリ数を返す
+	size_t	Count() const { return m_count; }
+	/// @brief 値を返す
+	wxUint32 Get(wxUint32 num) const;
+	/// @brief 値をセット
+	void	Set(wxUint32 num, wxUint32 val);
+	/// @brief 空きグループを探す
+	wxUint32 FindFree(wxUint32 curr, wxUint32 start, wxUint32 end) const;
+	/// @brief 連続した空きグループの一覧を作成
+	void	GetFreeRuns(wxUint32 start, wxUint32 end, DiskBasicGroupRuns &runs) const;
+	/// @brief 次に空きを探し始める位置
+	wxUint32 GetNextFree() const { return m_next_free; }
+	/// @brief 次に空きを探し始める位置をセット
+	void	SetNextFree(wxUint32 val) { m_next_free = val; }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/// @brief グループ番号ごとのビットマップ
+class DiskBasicGroupBitmap
+{
+private:
+	wxUint32 *p_bits;	///< ビット
+	size_t	m_count;	///< ビット数
+	size_t	m_words;	///< ワード数
+
+	DiskBasicGroupBitmap(const DiskBasicGroupBitmap &src) {}
+	DiskBasicGroupBitmap &operator=(const DiskBasicGroupBitmap &src) { return *this; }
+
+public:
+	DiskBasicGroupBitmap();
+	~DiskBasicGroupBitmap();
+
+	/// @brief 指定ビット数で作成 すべて0
+	void	Create(size_t count);
+	/// @brief クリア
+	void	Clear();
+	/// @brief ビット数を返す
+	size_t	Count() const { return m_count; }
+	/// @brief ワード数を返す
+	size_t	GetWordCount() const { return m_words; }
+	/// @brief ワードを返す
+	wxUint32 GetWord(size_t idx) const { return p_bits[idx]; }
+	/// @brief ワードをセット
+	void	SetWord(size_t idx, wxUint32 val) { p_bits[idx] = val; }
+	/// @brief ビットが立っているか
+	bool	Test(wxUint32 num) const { return num < m_count && (p_bits[num >> 5] & (1U << (num & 31))) != 0; }
+	/// @brief ビットを立てる
+	void	Set(wxUint32 num) { if (num < m_count) p_bits[num >> 5] |= (1U << (num & 31)); }
+	/// @brief ビットを落とす
+	void	Reset(wxUint32 num) { if (num < m_count) p_bits[num >> 5] &= ~(1U << (num & 31)); }
+	/// @brief 立っているビットの数を返す
+	static int CountBits(wxUint32 word);
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/// @brief FATのチェイン検査
+///
+/// FATを一度だけ走査して参照ビットマップを作り、
+/// その後ファイルごとにチェインを一度だけたどる。
+class DiskBasicFatChecker
+{
+public:
+	/// @brief チェインの状態
+	enum en_chain_status {
+		CHAIN_OK = 0,
+		CHAIN_CROSS_LINKED,	///< 他のチェインと共有している
+		CHAIN_LOOPED,		///< ループしている
+		CHAIN_BROKEN,		///< 途中で切れている
+	};
+
+private:
+	const DiskBasicFatTable *p_table;
+	wxUint32 m_start_group;	///< 開始グループ番号
+	wxUint32 m_end_group;	///< 最終グループ番号
+	wxUint32 m_unused_code;	///< 未使用を表すコード
+	wxUint32 m_final_code;	///< これ以上は終端を表すコード
+	wxUint32 m_bad_code;	///< 不良を表すコード
+
+	DiskBasicGroupBitmap m_used;		///< 使用中
+	DiskBasicGroupBitmap m_referred;	///< 他のエントリから参照されている
+	DiskBasicGroupBitmap m_cross;		///< 複数のエントリから参照されている
+	DiskBasicGroupBitmap m_visited;		///< チェインをたどった
+	DiskBasicGroupBitmap m_current;		///< たどっているチェイン
+
+	wxUint32 m_used_groups;		///< 使用中のグループ数
+	wxUint32 m_free_groups;		///< 空きグループ数
+	wxUint32 m_bad_groups;		///< 不良グループ数
+	wxUint32 m_invalid_groups;	///< 範囲外を指しているグループ数
+
+	DiskBasicFatChecker(const DiskBasicFatChecker &src) {}
+	DiskBasicFatChecker &operator=(const DiskBasicFatChecker &src) { return *this; }
+
+	/// @brief 同じ条件で走査用に初期化
+	void	SetupPart(const DiskBasicFatChecker &src);
+	/// @brief 走査した結果を合わせる
+	void	Merge(const DiskBasicFatChecker &src);
+
+public:
+	DiskBasicFatChecker();
+	~DiskBasicFatChecker() {}
+
+	/// @brief 初期化
+	void	Setup(const DiskBasicFatTable *table, wxUint32 start_group, wxUint32 end_group, wxUint32 unused_code, wxUint32 final_code);
+	/// @brief 範囲内のエントリを走査
+	void	ScanRange(wxUint32 from, wxUint32 to);
+	/// @brief FAT全体を走査
+	void	Scan();
+	/// @brief チェインをたどる
+	int		WalkChain(wxUint32 start, wxUint32 &groups);
+	/// @brief どのファイルからもたどれないチェインを数える
+	void	CountLostChains(wxUint32 &chains, wxUint32 &groups) const;
+
+	/// @brief グループ番号が範囲内か
+	bool	IsValidGroup(wxUint32 num) const { return (num >= m_start_group && num <= m_end_group); }
+	/// @brief 複数から参照されているグループ数
+	wxUint32 GetCrossLinkedGroups() const;
+	/// @brief 他から参照されているグループ数
+	wxUint32 GetReferredGroups() const;
+	/// @brief 使用中のグループ数
+	wxUint32 GetUsedGroups() const { return m_used_groups; }
+	/// @brief 空きグループ数
+	wxUint32 GetFreeGroups() const { return m_free_groups; }
+	/// @brief 不良グループ数
+	wxUint32 GetBadGroups() const { return m_bad_groups; }
+	/// @brief 範囲外を指しているグループ数
+	wxUint32 GetInvalidGroups() const { return m_invalid_groups; }
+};
+
+/// @brief FATの一部を走査するスレッド
+class DiskBasicFatScanner : public wxThread
+{
+private:
+	DiskBasicFatChecker m_part;	///< 走査結果
+	wxUint32 m_from;	///< 開始グループ番号
+	wxUint32 m_to;		///< 終了グループ番号
+
+protected:
+	ExitCode Entry() wxOVERRIDE;
+
+public:
+	DiskBasicFatScanner(wxUint32 from, wxUint32 to);
+	~DiskBasicFatScanner() {}
+
+	/// @brief 走査結果を返す
+	DiskBasicFatChecker &GetPart() { return m_part; }
+};
+
 class DiskBasic;
 class DiskBasicType;
 
@@ -330,9 +557,19 @@ private:
 	int m_start_pos;	///< 開始位置
 
 	DiskBasicFatArea m_bufs;
+	DiskBasicFatTable m_table;	///< デコードしたFAT
+	wxUint32 m_next_free_hint;	///< 次に空きを探し始める位置(デコード時に使用)
+	wxUint32 m_raw_modify_count;	///< デコードした時のセクタを直接変更した回数
 
 	DiskBasicFat();
 
+	/// @brief セクタを直接変更した回数を返す
+	wxUint32 GetRawModifyCount() const;
+	/// @brief セクタが直接変更されていたらデコードしたFATを捨てる
+	void DiscardStaleTable();
+	/// @brief FATの値をセクタから直接読む
+	wxUint32 GetRawGroupNumber(int format, wxUint32 num) const;
+
 public:
 	DiskBasicFat(DiskBasic *basic);
 	~DiskBasicFat();
@@ -353,6 +590,25 @@ public:
 	/// @brief FAT領域を指定コードで埋める
 	void Fill(wxUint8 code);
 
+	/// @brief FATの値を返す
+	wxUint32 GetGroupNumber(int format, wxUint32 num);
+	/// @brief FATの値をセット
+	void SetGroupNumber(int format, wxUint32 num, wxUint32 val);
+	/// @brief FAT全体をデコードする
+	bool DecodeTable(int format);
+	/// @brief デコード済みか
+	bool IsTableDecoded() const { return m_table.Count() > 0; }
+	/// @brief 空きグループ番号を返す
+	wxUint32 FindEmptyGroupNumber(wxUint32 curr_group, wxUint32 start_group, wxUint32 end_group) const;
+	/// @brief 連続した空きグループの一覧を作成
+	void	GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, DiskBasicGroupRuns &runs) const;
+	/// @brief 次に空きを探し始めるグループ番号
+	wxUint32 GetNextFreeGroupNumber() const { return m_table.Count() > 0 ? m_table.GetNextFree() : m_next_free_hint; }
+	/// @brief 次に空きを探し始めるグループ番号をセット
+	void SetNextFreeGroupNumber(wxUint32 val);
+	/// @brief デコードしたFATを返す
+	const DiskBasicFatTable &GetTable() const { return m_table; }
+
 	/// @brief FAT領域を返す
 	DiskBasicFatArea	 *GetDiskBasicFatArea() { return &m_bufs; }
 	/// @brief FATバッファを返す
@@ -20,6 +20,7 @@
 #include "basictype_hfs.h"
 #include "../logging.h"
 #include "../utils.h"
+#include "../config.h"
 
 
 #ifdef DeleteFile
@@ -31,6 +32,9 @@
 
 //#define DEBUG_DISK_FULL_TEST 1
 
+/// 連続したセクタをまとめて読み書きする時の最大サイズ(バイト)
+#define BASIC_ACCESS_CHUNK_SIZE	(4 * 1024 * 1024)
+
 //////////////////////////////////////////////////////////////////////
 //
 //
@@ -52,6 +56,114 @@ DiskBasicIdentifiedData::DiskBasicIdentifiedData(const wxString &volume_name, in
 	m_volume_skew = volume_skew;
 }
 
+//////////////////////////////////////////////////////////////////////
+//
+//
+//
+DiskBasicDefragInfo::DiskBasicDefragInfo()
+{
+	Clear();
+}
+/// クリア
+void DiskBasicDefragInfo::Clear()
+{
+	m_files = 0;
+	m_fragmented[DEFRAG_BEFORE] = 0;
+	m_fragmented[DEFRAG_AFTER] = 0;
+	m_extents[DEFRAG_BEFORE] = 0;
+	m_extents[DEFRAG_AFTER] = 0;
+	m_moved_files = 0;
+	m_moved_size = 0;
+}
+/// ファイルを追加
+/// @param[in] extents_before 実行前の連続領域の数
+/// @param[in] extents_after  実行後の連続領域の数
+void DiskBasicDefragInfo::AddFile(int extents_before, int extents_after)
+{
+	m_files++;
+	if (extents_before > 1) m_fragmented[DEFRAG_BEFORE]++;
+	if (extents_after > 1) m_fragmented[DEFRAG_AFTER]++;
+	m_extents[DEFRAG_BEFORE] += extents_before;
+	m_extents[DEFRAG_AFTER] += extents_after;
+}
+/// 移動したファイルを追加
+/// @param[in] size データサイズ
+void DiskBasicDefragInfo::AddMoved(wxInt64 size)
+{
+	m_moved_files++;
+	m_moved_size += size;
+}
+/// 断片化しているファイルの割合(%)
+double DiskBasicDefragInfo::GetFragmentation(en_defrag_phase phase) const
+{
+	if (m_files <= 0) return 0.0;
+	return (double)m_fragmented[phase] * 100.0 / (double)m_files;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+//
+//
+DiskBasicCheckInfo::DiskBasicCheckInfo()
+{
+	Clear();
+}
+/// クリア
+void DiskBasicCheckInfo::Clear()
+{
+	m_files = 0;
+	m_dirs = 0;
+	for(int i=0; i<CHECK_PROBLEMS; i++) {
+		m_problems[i] = 0;
+	}
+	m_detail_kinds.Empty();
+	m_detail_paths.Empty();
+	m_lost_chains = 0;
+	m_lost_groups = 0;
+	m_used_groups = 0;
+	m_free_groups = 0;
+	m_bad_groups = 0;
+}
+/// ファイルを追加
+/// @param[in] is_dir ディレクトリか
+void DiskBasicCheckInfo::AddFile(bool is_dir)
+{
+	if (is_dir) m_dirs++;
+	else m_files++;
+}
+/// 問題を追加
+/// @param[in] kind 問題の種類
+/// @param[in] path ファイルのパス
+void DiskBasicCheckInfo::AddProblem(en_check_problem kind, const wxString &path)
+{
+	m_problems[kind]++;
+	m_detail_kinds.Add(kind);
+	m_detail_paths.Add(path);
+}
+/// どこからもたどれないチェインをセット
+/// @param[in] chains チェイン数
+/// @param[in] groups グループ数
+void DiskBasicCheckInfo::SetLostChains(wxUint32 chains, wxUint32 groups)
+{
+	m_lost_chains = chains;
+	m_lost_groups = groups;
+}
+/// グループ数をセット
+/// @param[in] used 使用中のグループ数
+/// @param[in] free 空きグループ数
+/// @param[in] bad  不良グループ数
+void DiskBasicCheckInfo::SetGroups(wxUint32 used, wxUint32 free, wxUint32 bad)
+{
+	m_used_groups = used;
+	m_free_groups = free;
+	m_bad_groups = bad;
+}
+/// 問題があるか
+bool DiskBasicCheckInfo::HasProblems() const
+{
+	return (m_detail_paths.Count() > 0 || m_lost_chains > 0);
+}
+
 //////////////////////////////////////////////////////////////////////
 //
 //
@@ -231,6 +343,8 @@ int DiskBasic::ParseBasic(DiskImageDisk *newdisk, int newside, const DiskBasicPa
 	// 新しいディスクにあるBASICヒント
 	DiskImageFile *file = newdisk->GetFile();
 	wxString hint = file->GetBasicTypeHint();
+	// 前回の解析結果
+	DiskImageIndex *index = file->GetIndex();
 	// 新しいディスクにあるBASIC種類一覧
 	BasicParamNames types = newdisk->GetBasicTypes();
 	DiskBasicParamPtrs valid_params;
@@ -253,22 +367,43 @@ int DiskBasic::ParseBasic(DiskImageDisk *newdisk, int newside, const DiskBasicPa
 			return errinfo.GetValid();
 		}
 
-		for(size_t n=0; n<types.Count(); n++) {
-			match = gDiskBasicTemplates.FindType(hint, types.Item(n).GetName());
+		// 前回決定したBASIC種類がわかっていれば、候補を調べる前にそれで解析する
+		match = NULL;
+		wxString indexed = index ? index->GetBasicType(newdisk, newside) : wxString();
+		for(size_t n=0; n<types.Count() && !indexed.IsEmpty(); n++) {
+			if (types.Item(n).GetName() != indexed) continue;
+			match = gDiskBasicTemplates.FindType(hint, indexed);
 			if (match) {
-				// フォーマットされているか？
-				myLog.SetInfo(wxT("Parsing format: ") + match->GetBasicTypeName());
+				myLog.SetInfo(wxT("Indexed format: ") + match->GetBasicTypeName());
 				valid_ratio = ParseFormattedDisk(newdisk, match, is_formatting);
 				myLog.SetInfo(wxT("  Result => %.2f"), valid_ratio);
+				if (valid_ratio < 0.6) {
+					// 一致しないので候補を調べなおす
+					match = NULL;
+					m_formatted = false;
+				}
+			}
+			break;
+		}
+
+		for(size_t n=0; n<types.Count() && !match; n++) {
+			const DiskBasicParam *param = gDiskBasicTemplates.FindType(hint, types.Item(n).GetName());
+			if (param) {
+				// フォーマットされているか？
+				myLog.SetInfo(wxT("Parsing format: ") + param->GetBasicTypeName());
+				valid_ratio = ParseFormattedDisk(newdisk, param, is_formatting);
+				myLog.SetInfo(wxT("  Result => %.2f"), valid_ratio);
 				if (valid_ratio >= 0.0) {
 					// 候補にする
-					valid_params.Add(match);
+					valid_params.Add(param);
 					valid_ratios.Add(valid_ratio);
 				}
 			}
 		}
 
-		errinfo.Clear();
+		if (!match) {
+			errinfo.Clear();
+		}
 		if (valid_params.Count() > 0) {
 			// それらしいものを候補とする
 			int idx = MaxRatio(valid_ratios);
@@ -288,6 +423,10 @@ int DiskBasic::ParseBasic(DiskImageDisk *newdisk, int newside, const DiskBasicPa
 	if (valid_ratio >= 0.6) {
 		errinfo.Clear();
 		m_parsed = true;
+		// 解析結果を記録
+		if (index && match) {
+			index->SetBasicType(newdisk, newside, match->GetBasicTypeName());
+		}
 	}
 	if (m_forcely) {
 		m_parsed = true;
@@ -361,13 +500,15 @@ double DiskBasic::ParseFormattedDisk(DiskImageDisk *newdisk, const DiskBasicPara
 /// パラメータをクリア
 void DiskBasic::Clear()
 {
-	p_disk = NULL;
 	m_formatted = false;
 	m_parsed = false;
 	m_assigned = false;
 	m_forcely = false;
 	selected_side = -1;
 
+	UnpinAllSectors();
+	p_disk = NULL;
+
 	DiskBasicParam::ClearBasicParam();
 
 	if (type) type->ClearDiskFreeSize();
@@ -402,7 +543,7 @@ wxString DiskBasic::GetDescriptionDetails() const
 }
 
 /// FATエリアの空き状況を取得
-void DiskBasic::GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const
+void DiskBasic::GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr) const
 {
 	if (type) {
 		type->GetFatAvailability(offset, arr);
@@ -460,6 +601,9 @@ double DiskBasic::AssignFat(bool is_formatting)
 
 	fat->Empty();
 
+	// 前回固定したセクタは解除
+	UnpinAllSectors();
+
 	// 固有のパラメータ
 	AssignParameter();
 
@@ -526,6 +670,7 @@ void DiskBasic::ClearParseAndAssign(bool forcely)
 	m_forcely = forcely;
 	dir->ReleaseRoot(type);
 	dir->SetCurrentAsRoot();
+	UnpinAllSectors();
 }
 
 /// ロードできるか
@@ -658,6 +803,8 @@ int DiskBasic::AccessUnitData(int fileunit_num, DiskBasicDirItem *item, wxInputS
 	int sector_start = 0;
 	int sector_end = 0;
 	int rc = 0;
+	int sector_size = p_disk->GetSectorSize();
+	Utils::TempData gbuffer;
 
 	wxFileOffset osize = 0;
 	if (ostream) osize = ostream->TellO();
@@ -677,36 +824,77 @@ int DiskBasic::AccessUnitData(int fileunit_num, DiskBasicDirItem *item, wxInputS
 		return -1;
 	}
 
-	int gidx_end = (int)gitems.Count() - 1;
-	for(int gidx = 0; gidx <= gidx_end && remain > 0 && rc == 0; gidx++) {
-		DiskBasicGroupItem *gitem = &gitems.Item(gidx);
+	// 連続したグループ単位で読む
+	int eidx_end = (int)gitems.GetExtentCount() - 1;
+	if (eidx_end >= 0) {
+		// 最初のグループを先読み
+		const DiskBasicGroupExtent *ext = &gitems.GetExtent(0);
+		ReadAhead(ext->GetSectorStart(), ext->GetSectorEnd() - ext->GetSectorStart() + 1);
+	}
+	int chunk_count = (sector_size > 0 ? BASIC_ACCESS_CHUNK_SIZE / sector_size : 1);
+	if (chunk_count < 1) chunk_count = 1;
+	for(int eidx = 0; eidx <= eidx_end && remain > 0 && rc == 0; eidx++) {
+		const DiskBasicGroupExtent *ext = &gitems.GetExtent(eidx);
 
-		sector_start = gitem->GetSectorStart();
-		sector_end = gitem->GetSectorEnd();
+		sector_start = ext->GetSectorStart();
+		sector_end = ext->GetSectorEnd();
 
+		// 連続したセクタを BASIC_ACCESS_CHUNK_SIZE ごとにまとめて読む
+		int chunk_start = sector_start;
+		int read_count = 0;
 		for(int block_num = sector_start; block_num <= sector_end && remain > 0; block_num++) {
-			DiskImageSector *sector = GetSector(block_num);
-			if (!sector) {
-				// セクタがない！
-				errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, gitem->GetGroup(), block_num);
-				rc = -1;
-				continue;
+			if (block_num == sector_start || block_num - chunk_start >= chunk_count) {
+				chunk_start = block_num;
+				read_count = 0;
+				int count = sector_end - chunk_start + 1;
+				if (count > chunk_count) count = chunk_count;
+				// サイズの異なるセクタがある時は１セクタずつ読む
+				if (sector_size > 0 && IsUniformSectorSize(chunk_start, count)) {
+					gbuffer.SetSize((size_t)count * sector_size);
+					read_count = ReadSectors(chunk_start, count, gbuffer.GetData(), gbuffer.GetSize());
+				}
+				if (eidx < eidx_end && block_num + chunk_count > sector_end) {
+					// 次のグループを先読み
+					const DiskBasicGroupExtent *next = &gitems.GetExtent(eidx + 1);
+					ReadAhead(next->GetSectorStart(), next->GetSectorEnd() - next->GetSectorStart() + 1);
+				}
+			}
+
+			// セクタを含むグループ
+			size_t gpos = ext->FindBySector(block_num);
+			wxUint32 group_num = ext->GetGroup(gpos);
+			int group_end = ext->GetSectorEnd(gpos);
+
+			int bufsize;
+			const wxUint8 *buf;
+			if (block_num - chunk_start < read_count) {
+				bufsize = sector_size;
+				buf = gbuffer.GetData((size_t)(block_num - chunk_start) * sector_size);
+			} else {
+				// まとめて読めなかったセクタ
+				DiskImageSector *sector = GetSector(block_num);
+				if (!sector) {
+					// セクタがない！
+					errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, group_num, block_num);
+					rc = -1;
+					continue;
+				}
+				bufsize = sector->GetSectorSize();
+//				bufsize /= gitem->div_nums;
+				buf = sector->GetSectorBufferForRead();
+//				buf += (bufsize * gitem->div_num);
 			}
-			int bufsize = sector->GetSectorSize();
-//			bufsize /= gitem->div_nums;
-			wxUint8 *buf = sector->GetSectorBuffer();
-//			buf += (bufsize * gitem->div_num);
 
 			// データの読み込み
-			bufsize = type->AccessFile(fileunit_num, item, istream, ostream, buf, bufsize, remain, block_num, sector_end);
+			bufsize = type->AccessFile(fileunit_num, item, istream, ostream, buf, bufsize, remain, block_num, group_end);
 			if (bufsize < 0) {
 				if (bufsize == -2) {
 					// セクタがおかしいぞ
-					errinfo.SetError(DiskBasicError::ERRV3_INVALID_SECTOR, gitem->GetGroup(), block_num, bufsize);
+					errinfo.SetError(DiskBasicError::ERRV3_INVALID_SECTOR, group_num, block_num, bufsize);
 					rc = -1;
 				} else {
 					// データが異なる
-					errinfo.SetError(DiskBasicError::ERRV2_VERIFY_FILE, gitem->GetGroup(), block_num);
+					errinfo.SetError(DiskBasicError::ERRV2_VERIFY_FILE, group_num, block_num);
 					rc = 1;
 				}
 				break;
@@ -942,8 +1130,8 @@ bool DiskBasic::SaveFile(wxInputStream &istream, DiskBasicDirItem *dir_item, Dis
 		// 機種個別の処理を行う
 		type->AdditionalProcessOnSavedFile(item);
 
-		// 空きサイズを計算
-		type->CalcDiskFreeSize(true);
+		// 空きサイズを更新
+		type->UpdateDiskFreeSize();
 
 	} while(0);
 
@@ -1020,6 +1208,8 @@ bool DiskBasic::SaveUnitData(int fileunit_num, wxInputStream &istream, int isize
 //	wxUint32 group_num, next_group;
 	int sector_start, sector_end;
 	int seq_num = 0;
+	int sector_size = p_disk->GetSectorSize();
+	Utils::TempData gbuffer;
 	for(int gidx = 0; gidx < (int)gitems.Count(); gidx++) {
 		DiskBasicGroupItem *gitem = &gitems.Item(gidx);
 		DiskBasicGroupItem *next_gitem = NULL;
@@ -1032,16 +1222,38 @@ bool DiskBasic::SaveUnitData(int fileunit_num, wxInputStream &istream, int isize
 		sector_start = gitem->GetSectorStart();
 		sector_end = gitem->GetSectorEnd();
 
-		for(block_num = sector_start; block_num <= sector_end; block_num++) {
-			DiskImageSector *sector = GetSector(block_num);
-			if (!sector) {
-				errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, gitem->GetGroup(), block_num);
-				rc = -2;
-				continue;
+		if (sector_size <= 0 || sector_end < sector_start) {
+			continue;
+		}
+
+		int count = sector_end - sector_start + 1;
+		if (!IsUniformSectorSize(sector_start, count)) {
+			// サイズの異なるセクタがある時は１セクタずつ書き込む
+			for(block_num = sector_start; block_num <= sector_end; block_num++) {
+				DiskImageSector *sector = GetSector(block_num);
+				if (!sector) {
+					errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, gitem->GetGroup(), block_num);
+					rc = -2;
+					continue;
+				}
+				int bufsize = sector->GetSectorSize();
+				wxUint8 *buf = sector->GetSectorBufferForWrite();
+
+				// ディスク内に書き込む
+				int last_size = type->WriteFile(item, istream, buf, bufsize, isize, block_num, gitem, next_gitem, sector_end, seq_num);
+				isize -= last_size;
+				file_size += last_size;
+				seq_num++;
 			}
-			int bufsize = sector->GetSectorSize();
+			continue;
+		}
+
+		// グループ内のセクタをバッファに作成してからまとめて書き込む
+		gbuffer.SetSize((size_t)count * sector_size);
+		for(block_num = sector_start; block_num <= sector_end; block_num++) {
+			int bufsize = sector_size;
 //			bufsize /= gitem->div_nums;
-			wxUint8 *buf = sector->GetSectorBuffer();
+			wxUint8 *buf = gbuffer.GetData((size_t)(block_num - sector_start) * sector_size);
 //			buf += (bufsize * gitem->div_num);
 
 			// ディスク内に書き込む
@@ -1050,6 +1262,11 @@ bool DiskBasic::SaveUnitData(int fileunit_num, wxInputStream &istream, int isize
 			file_size += last_size;
 			seq_num++;
 		}
+		int written = WriteSectors(sector_start, count, gbuffer.GetData(), gbuffer.GetSize());
+		for(block_num = sector_start + written; block_num <= sector_end; block_num++) {
+			errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, gitem->GetGroup(), block_num);
+			rc = -2;
+		}
 	}
 
 	return (rc >= 0);
@@ -1159,8 +1376,8 @@ bool DiskBasic::DeleteFile(DiskBasicDirItem *item, const DiskBasicGroups &group_
 	item->Refresh();
 	item->SetModify();
 
-	// 空きサイズを計算
-	type->CalcDiskFreeSize(true);
+	// 空きサイズを更新
+	type->UpdateDiskFreeSize();
 
 	// 必要ならアイテムも削除
 	type->ReleaseDirectoryItem(item);
@@ -1331,6 +1548,446 @@ int DiskBasic::FormatDisk(const DiskBasicIdentifiedData &data)
 	return errinfo.GetValid();
 }
 
+/// デフラグできるか
+bool DiskBasic::IsDefragmentable()
+{
+	errinfo.Clear();
+	if (!p_disk || !type) {
+		errinfo.SetError(DiskBasicError::ERR_UNSELECT_DISK);
+		return false;
+	}
+	if (!type->SupportDefragment()) {
+		errinfo.SetError(DiskBasicError::ERR_DEFRAG_UNSUPPORTED);
+		return false;
+	}
+	return true;
+}
+
+/// デフラグ
+///
+/// 断片化しているファイルを、収まる最小の連続した空き領域に移動する。
+/// 移動元の領域は空きとなり以降のファイルの移動先になる。
+/// ディレクトリは移動しない。
+/// 先にすべてのチェインをたどり、ループや切れたチェイン、サイズと合わないファイルは移動しない。
+/// 他のファイルとグループを共有している場合は移動元の開放で壊れるので行わない。
+/// @param [out] info  計画と結果
+/// @param [in]  apply falseのときは計画のみでディスクは変更しない
+/// @return true 成功
+bool DiskBasic::Defragment(DiskBasicDefragInfo &info, bool apply)
+{
+	info.Clear();
+
+	if (!IsDefragmentable()) {
+		return false;
+	}
+	if (apply && !IsWritableIntoDisk()) {
+		return false;
+	}
+
+	// チェインを検査する
+	DiskBasicFatChecker checker;
+	if (!type->ScanFatChains(checker)) {
+		errinfo.SetError(DiskBasicError::ERR_CHECK_UNSUPPORTED);
+		return false;
+	}
+
+	wxInt64 bytes_per_group = (wxInt64)GetSectorsPerGroup() * p_disk->GetSectorSize();
+
+	// 対象ファイルを集める
+	DiskBasicDirItems items;
+	bool cross_linked = false;
+	DiskBasicDirItem *root = GetRootDirectory();
+	if (root && root->GetStartGroup(0) != 0) {
+		// ルートディレクトリがチェインを持つ場合(FAT32)
+		wxUint32 groups = 0;
+		if (checker.WalkChain(root->GetStartGroup(0), groups) == DiskBasicFatChecker::CHAIN_CROSS_LINKED) {
+			cross_linked = true;
+		}
+	}
+	CollectDefragTargets(checker, root, bytes_per_group, items, cross_linked, 0);
+	if (cross_linked) {
+		errinfo.SetError(DiskBasicError::ERR_DEFRAG_CROSS_LINKED);
+		return false;
+	}
+
+	// 空き領域の一覧
+	DiskBasicGroupRuns runs;
+	type->GetEmptyGroupRuns(2, GetFatEndGroup(), 1, runs);
+	wxArrayInt run_starts;
+	wxArrayInt run_lens;
+	for(size_t r=0; r<runs.Count(); r++) {
+		run_starts.Add((int)runs.Item(r).GetGroup());
+		run_lens.Add(runs.Item(r).GetCount());
+	}
+
+	bool valid = true;
+	for(size_t i=0; i<items.Count(); i++) {
+		DiskBasicDirItem *item = items.Item(i);
+		DiskBasicGroups group_items;
+		item->GetAllGroups(group_items);
+
+		int extents = (int)group_items.GetExtentCount();
+		int groups = (int)group_items.Count();
+		if (!valid || extents <= 1) {
+			info.AddFile(extents, extents);
+			continue;
+		}
+
+		// 収まる最小の空き領域
+		int match = -1;
+		for(size_t r=0; r<run_lens.Count(); r++) {
+			int rlen = run_lens.Item(r);
+			if (rlen >= groups && (match < 0 || rlen < run_lens.Item(match))) match = (int)r;
+		}
+		if (match < 0) {
+			info.AddFile(extents, extents);
+			continue;
+		}
+
+		wxUint32 new_start = (wxUint32)run_starts.Item(match);
+		if (apply && !MoveFileGroups(item, group_items, new_start)) {
+			info.AddFile(extents, extents);
+			valid = false;
+			continue;
+		}
+		run_starts.Item(match) += groups;
+		run_lens.Item(match) -= groups;
+
+		// 移動元は空きになる
+		for(size_t e=0; e<group_items.GetExtentCount(); e++) {
+			const DiskBasicGroupExtent *ext = &group_items.GetExtent(e);
+			AddDefragFreeRun(run_starts, run_lens, (int)ext->GetGroup(), (int)ext->Count());
+		}
+
+		info.AddFile(extents, 1);
+		info.AddMoved(bytes_per_group * groups);
+	}
+
+	if (apply && info.GetMovedFiles() > 0) {
+		// 空きサイズを更新
+		type->UpdateDiskFreeSize();
+	}
+
+	return valid;
+}
+
+/// デフラグの対象ファイルを集める
+///
+/// ディレクトリも含めてすべてのチェインを一度ずつたどる。
+/// チェインが正常でサイズと合うファイルだけを対象にする。
+/// @param [in,out] checker         チェイン検査
+/// @param [in]     dir_item        ディレクトリアイテム
+/// @param [in]     bytes_per_group グループのバイト数
+/// @param [out]    items           対象ファイル
+/// @param [out]    cross_linked    グループを共有しているチェインがあればtrue
+/// @param [in]     depth           ディレクトリの深さ
+void DiskBasic::CollectDefragTargets(DiskBasicFatChecker &checker, DiskBasicDirItem *dir_item, wxInt64 bytes_per_group, DiskBasicDirItems &items, bool &cross_linked, int depth)
+{
+	if (!dir_item || depth > gConfig.GetDirDepth()) return;
+
+	if (!AssignDirectory(dir_item)) return;
+
+	DiskBasicDirItems *children = dir_item->GetChildren();
+	if (!children) return;
+
+	for(size_t i=0; i<children->Count(); i++) {
+		DiskBasicDirItem *item = children->Item(i);
+		if (!item || !item->IsUsed()) continue;
+
+		// カレントや親ディレクトリは除く
+		if (item->IsDirectory() && !item->IsVisibleOnTree()) continue;
+
+		wxUint32 start = item->GetStartGroup(0);
+		if (start == 0) continue;
+
+		wxUint32 groups = 0;
+		int status = checker.WalkChain(start, groups);
+		if (status == DiskBasicFatChecker::CHAIN_CROSS_LINKED) {
+			cross_linked = true;
+			continue;
+		}
+		if (status != DiskBasicFatChecker::CHAIN_OK) {
+			// ループや切れたチェインはたどらない
+			continue;
+		}
+
+		if (item->IsDirectory()) {
+			CollectDefragTargets(checker, item, bytes_per_group, items, cross_linked, depth + 1);
+			continue;
+		}
+		if (item->GetFileSize() <= 0 || bytes_per_group <= 0) continue;
+
+		// サイズに必要なグループ数とチェインの長さが合わないものは移動しない
+		wxInt64 need_groups = ((wxInt64)item->GetFileSize() + bytes_per_group - 1) / bytes_per_group;
+		if (need_groups != (wxInt64)groups) continue;
+
+		items.Add(item);
+	}
+}
+
+/// 空き領域の一覧に追加する
+///
+/// 前後に接する空き領域があればひとつにまとめる。
+/// @param [in,out] run_starts 空き領域の開始グループ
+/// @param [in,out] run_lens   空き領域のグループ数
+/// @param [in]     start      追加する開始グループ
+/// @param [in]     len        追加するグループ数
+void DiskBasic::AddDefragFreeRun(wxArrayInt &run_starts, wxArrayInt &run_lens, int start, int len)
+{
+	if (len <= 0) return;
+
+	for(size_t r=0; r<run_lens.Count(); ) {
+		int rstart = run_starts.Item(r);
+		int rlen = run_lens.Item(r);
+		if (rlen > 0 && rstart + rlen != start && start + len != rstart) {
+			r++;
+			continue;
+		}
+		if (rlen > 0) {
+			// 隣接しているのでまとめる
+			if (rstart < start) start = rstart;
+			len += rlen;
+		}
+		// 使い切った領域もここで除く
+		run_starts.RemoveAt(r);
+		run_lens.RemoveAt(r);
+	}
+	run_starts.Add(start);
+	run_lens.Add(len);
+}
+
+/// ファイルのグループを連続した領域に移動する
+///
+/// データを移動先に書き込んでからチェインと開始グループを書き換え、
+/// 最後に移動元を開放する。
+/// データは BASIC_ACCESS_CHUNK_SIZE ごとに区切ってコピーする。
+/// @param [in] item        ディレクトリアイテム
+/// @param [in] group_items 移動元のグループリスト
+/// @param [in] new_start   移動先の開始グループ番号
+/// @return true 成功
+bool DiskBasic::MoveFileGroups(DiskBasicDirItem *item, const DiskBasicGroups &group_items, wxUint32 new_start)
+{
+	int sector_size = p_disk->GetSectorSize();
+	int groups = (int)group_items.Count();
+	int bytes_per_group = GetSectorsPerGroup() * sector_size;
+	if (groups <= 0 || bytes_per_group <= 0 || group_items.GetExtentCount() == 0) return false;
+
+	// 移動先のセクタ
+	DiskBasicGroups new_items;
+	wxInt64 remain = (wxInt64)bytes_per_group * groups;
+	for(int n=0; n<groups; n++) {
+		wxUint32 next_group = (n + 1 < groups ? new_start + n + 1 : 0);
+		int remain_size = (remain > 0x7fffffff ? 0x7fffffff : (int)remain);
+		GetNumsFromGroup(new_start + n, next_group, sector_size, remain_size, new_items);
+		remain -= bytes_per_group;
+	}
+
+	// 移動元から移動先へ区切りながらコピーする
+	int chunk_count = BASIC_ACCESS_CHUNK_SIZE / sector_size;
+	if (chunk_count < 1) chunk_count = 1;
+	Utils::TempData gbuffer;
+	size_t src_idx = 0;
+	size_t dst_idx = 0;
+	int src_pos = 0;
+	int dst_pos = 0;
+	while(src_idx < group_items.GetExtentCount() && dst_idx < new_items.GetExtentCount()) {
+		const DiskBasicGroupExtent *src = &group_items.GetExtent(src_idx);
+		const DiskBasicGroupExtent *dst = &new_items.GetExtent(dst_idx);
+		int src_remain = src->GetSectorEnd() - src->GetSectorStart() + 1 - src_pos;
+		int dst_remain = dst->GetSectorEnd() - dst->GetSectorStart() + 1 - dst_pos;
+		if (src_remain <= 0) {
+			src_idx++;
+			src_pos = 0;
+			continue;
+		}
+		if (dst_remain <= 0) {
+			dst_idx++;
+			dst_pos = 0;
+			continue;
+		}
+		int count = chunk_count;
+		if (count > src_remain) count = src_remain;
+		if (count > dst_remain) count = dst_remain;
+
+		size_t buffer_size = (size_t)count * sector_size;
+		if (!IsUniformSectorSize(src->GetSectorStart() + src_pos, count)
+		 || !IsUniformSectorSize(dst->GetSectorStart() + dst_pos, count)) {
+			// サイズの異なるセクタがある時は１セクタずつコピーする
+			count = 1;
+			DiskImageSector *sector = GetSector(src->GetSectorStart() + src_pos);
+			if (sector) buffer_size = (size_t)sector->GetSectorSize();
+		}
+		gbuffer.SetSize(buffer_size);
+		int read_count = ReadSectors(src->GetSectorStart() + src_pos, count, gbuffer.GetData(), gbuffer.GetSize());
+		if (read_count < count) {
+			errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, src->GetGroup(), src->GetSectorStart() + src_pos + read_count);
+			return false;
+		}
+		int written = WriteSectors(dst->GetSectorStart() + dst_pos, count, gbuffer.GetData(), gbuffer.GetSize());
+		if (written < count) {
+			errinfo.SetError(DiskBasicError::ERRV2_NO_SECTOR, dst->GetGroup(), dst->GetSectorStart() + dst_pos + written);
+			return false;
+		}
+		src_pos += count;
+		dst_pos += count;
+	}
+
+	// チェインを書き換える 終端コードは元のものを使う
+	const DiskBasicGroupExtent *last = &group_items.GetExtent(group_items.GetExtentCount() - 1);
+	wxUint32 end_code = type->GetGroupNumber(last->GetGroup(last->Count() - 1));
+	for(int n=0; n<groups; n++) {
+		wxUint32 num = new_start + n;
+		type->SetGroupNumber(num, n + 1 < groups ? num + 1 : end_code);
+		type->UpdateAvailability(num);
+	}
+
+	// 開始グループを書き換える
+	item->SetStartGroup(0, new_start);
+	item->SetModify();
+
+	// 移動元を開放
+	type->DeleteGroups(group_items);
+
+	item->Refresh();
+
+	return true;
+}
+
+/// ボリュームをチェックできるか
+bool DiskBasic::IsCheckableVolume()
+{
+	errinfo.Clear();
+	if (!p_disk || !type) {
+		errinfo.SetError(DiskBasicError::ERR_UNSELECT_DISK);
+		return false;
+	}
+	if (!type->SupportCheckVolume()) {
+		errinfo.SetError(DiskBasicError::ERR_CHECK_UNSUPPORTED);
+		return false;
+	}
+	return true;
+}
+
+/// ボリュームをチェック
+///
+/// FAT全体を一度走査してから、ディレクトリをたどって各ファイルのチェインを一度だけたどる。
+/// グループの共有、ループ、切れたチェイン、ファイルサイズとの不一致、
+/// どこからもたどれないチェインを調べる。ディスクは変更しない。
+/// @param [out] info 結果
+/// @return true 成功
+bool DiskBasic::CheckVolume(DiskBasicCheckInfo &info)
+{
+	info.Clear();
+
+	if (!IsCheckableVolume()) {
+		return false;
+	}
+
+	DiskBasicFatChecker checker;
+	if (!type->ScanFatChains(checker)) {
+		errinfo.SetError(DiskBasicError::ERR_CHECK_UNSUPPORTED);
+		return false;
+	}
+
+	wxInt64 bytes_per_group = (wxInt64)GetSectorsPerGroup() * p_disk->GetSectorSize();
+
+	// ルートディレクトリがチェインを持つ場合(FAT32)
+	DiskBasicDirItem *root = GetRootDirectory();
+	if (root && root->GetStartGroup(0) != 0) {
+		CheckFileChain(checker, root, true, wxT("/"), bytes_per_group, info);
+	}
+	CheckDirectoryChains(checker, root, wxT("/"), bytes_per_group, info, 0);
+
+	wxUint32 lost_chains = 0;
+	wxUint32 lost_groups = 0;
+	checker.CountLostChains(lost_chains, lost_groups);
+	info.SetLostChains(lost_chains, lost_groups);
+	info.SetGroups(checker.GetUsedGroups(), checker.GetFreeGroups(), checker.GetBadGroups());
+
+	return true;
+}
+
+/// ディレクトリ内のファイルのチェインをチェック
+/// @param [in,out] checker         チェイン検査
+/// @param [in]     dir_item        ディレクトリアイテム
+/// @param [in]     path            ディレクトリのパス
+/// @param [in]     bytes_per_group グループのバイト数
+/// @param [out]    info            結果
+/// @param [in]     depth           ディレクトリの深さ
+void DiskBasic::CheckDirectoryChains(DiskBasicFatChecker &checker, DiskBasicDirItem *dir_item, const wxString &path, wxInt64 bytes_per_group, DiskBasicCheckInfo &info, int depth)
+{
+	if (!dir_item || depth > gConfig.GetDirDepth()) return;
+
+	if (!AssignDirectory(dir_item)) return;
+
+	DiskBasicDirItems *children = dir_item->GetChildren();
+	if (!children) return;
+
+	for(size_t i=0; i<children->Count(); i++) {
+		DiskBasicDirItem *item = children->Item(i);
+		if (!item || !item->IsUsedAndVisible()) continue;
+
+		// カレントや親ディレクトリは除く
+		if (item->IsDirectory() && !item->IsVisibleOnTree()) continue;
+
+		wxString name = path + item->GetFileNameStr();
+		bool valid = CheckFileChain(checker, item, item->IsDirectory(), name, bytes_per_group, info);
+		if (valid && item->IsDirectory()) {
+			CheckDirectoryChains(checker, item, name + wxT("/"), bytes_per_group, info, depth + 1);
+		}
+	}
+}
+
+/// ファイルのチェインをチェック
+/// @param [in,out] checker         チェイン検査
+/// @param [in]     item            ディレクトリアイテム
+/// @param [in]     is_dir          ディレクトリか
+/// @param [in]     path            ファイルのパス
+/// @param [in]     bytes_per_group グループのバイト数
+/// @param [out]    info            結果
+/// @return false チェインをたどれない
+bool DiskBasic::CheckFileChain(DiskBasicFatChecker &checker, DiskBasicDirItem *item, bool is_dir, const wxString &path, wxInt64 bytes_per_group, DiskBasicCheckInfo &info)
+{
+	info.AddFile(is_dir);
+
+	wxUint32 start = item->GetStartGroup(0);
+	if (start == 0) {
+		// 空のファイル ディレクトリは必ずチェインを持つ
+		if (is_dir) {
+			info.AddProblem(DiskBasicCheckInfo::CHECK_BROKEN, path);
+			return false;
+		}
+		if (item->GetFileSize() > 0) {
+			info.AddProblem(DiskBasicCheckInfo::CHECK_SIZE_MISMATCH, path);
+		}
+		return true;
+	}
+
+	wxUint32 groups = 0;
+	switch(checker.WalkChain(start, groups)) {
+	case DiskBasicFatChecker::CHAIN_CROSS_LINKED:
+		info.AddProblem(DiskBasicCheckInfo::CHECK_CROSS_LINKED, path);
+		return true;
+	case DiskBasicFatChecker::CHAIN_LOOPED:
+		info.AddProblem(DiskBasicCheckInfo::CHECK_LOOPED, path);
+		return false;
+	case DiskBasicFatChecker::CHAIN_BROKEN:
+		info.AddProblem(DiskBasicCheckInfo::CHECK_BROKEN, path);
+		return false;
+	default:
+		break;
+	}
+
+	if (!is_dir && bytes_per_group > 0) {
+		// サイズに必要なグループ数とチェインの長さを比べる
+		wxInt64 need_groups = ((wxInt64)item->GetFileSize() + bytes_per_group - 1) / bytes_per_group;
+		if (need_groups != (wxInt64)groups) {
+			info.AddProblem(DiskBasicCheckInfo::CHECK_SIZE_MISMATCH, path);
+		}
+	}
+	return true;
+}
+
 /// ルートディレクトリを返す
 DiskBasicDirItem *DiskBasic::GetRootDirectory()
 {
@@ -1362,6 +2019,16 @@ bool DiskBasic::AssignDirectory(DiskBasicDirItem *dir_item)
 	return dir->Assign(dir_item);
 }
 
+/// 配下のサブディレクトリをすべてアサイン
+/// @param [in]  dir_item 起点のディレクトリのアイテム
+/// @param [out] info     走査結果
+bool DiskBasic::AssignDirectoryTree(DiskBasicDirItem *dir_item, DiskBasicDirTreeInfo &info)
+{
+	if (!p_disk) return false;
+
+	return dir->AssignTree(dir_item, info);
+}
+
 /// ディレクトリを変更
 /// @param [in,out] dst_item 移動先ディレクトリのアイテム
 bool DiskBasic::ChangeDirectory(DiskBasicDirItem * &dst_item)
@@ -1369,7 +2036,7 @@ bool DiskBasic::ChangeDirectory(DiskBasicDirItem * &dst_item)
 	if (!p_disk) return false;
 
 	bool valid = dir->Change(dst_item);
-	if (valid) {
+	if (valid && !type->IsAvailabilityTracked()) {
 		// 残りサイズ計算
 		type->CalcDiskFreeSize(false);
 	}
@@ -1515,8 +2182,8 @@ int DiskBasic::MakeDirectory(DiskBasicDirItem *dir_item, const wxString &filenam
 
 	// グループ数を計算
 	item->CalcFileSize();
-	// 空きサイズを計算
-	type->CalcDiskFreeSize(true);
+	// 空きサイズを更新
+	type->UpdateDiskFreeSize();
 
 	return 0;
 }
@@ -1620,6 +2287,101 @@ void DiskBasic::RefreshCache(int block_num)
 	p_disk->RefreshCache(block_num);
 }
 
+/// 指定範囲のセクタを先読みする
+/// @param [in] block_num     パーティション内のセクタ位置
+/// @param [in] count         セクタ数
+void DiskBasic::ReadAhead(int block_num, int count)
+{
+	p_disk->ReadAhead(block_num, count);
+}
+
+/// 指定範囲のセクタをキャッシュに固定する
+///
+/// FATやディレクトリなど繰り返し参照する領域をキャッシュから追い出さないようにする。
+/// @param [in] block_num     パーティション内のセクタ位置
+/// @param [in] count         セクタ数
+/// @return false 固定できない
+bool DiskBasic::PinSectors(int block_num, int count)
+{
+	if (!p_disk || count <= 0) return false;
+
+	if (!p_disk->PinSectors(block_num, count)) return false;
+
+	pinned_sectors.Add(block_num);
+	pinned_sectors.Add(count);
+	return true;
+}
+
+/// グループのセクタをキャッシュに固定する
+///
+/// 連続するセクタはまとめて固定する。
+/// @param [in] group_items   グループリスト
+void DiskBasic::PinSectors(const DiskBasicGroups &group_items)
+{
+	int start = -1;
+	int count = 0;
+	for(size_t i=0; i<group_items.GetExtentCount(); i++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(i);
+		int sector_start = ext->GetSectorStart();
+		int sector_end = ext->GetSectorEnd();
+		if (sector_end < sector_start) sector_end = sector_start;
+		if (start >= 0 && start + count == sector_start) {
+			count += (sector_end - sector_start + 1);
+			continue;
+		}
+		if (start >= 0) {
+			PinSectors(start, count);
+		}
+		start = sector_start;
+		count = sector_end - sector_start + 1;
+	}
+	if (start >= 0) {
+		PinSectors(start, count);
+	}
+}
+
+/// キャッシュに固定したセクタをすべて解除する
+void DiskBasic::UnpinAllSectors()
+{
+	if (p_disk) {
+		for(size_t i=0; i + 1<pinned_sectors.Count(); i += 2) {
+			p_disk->UnpinSectors(pinned_sectors.Item(i), pinned_sectors.Item(i + 1));
+		}
+	}
+	pinned_sectors.Empty();
+}
+
+/// 連続したセクタのデータをバッファに読み込む
+/// @param [in]  block_num     パーティション内の開始セクタ位置
+/// @param [in]  count         セクタ数
+/// @param [out] buffer        バッファ
+/// @param [in]  size          バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskBasic::ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size)
+{
+	return p_disk->ReadSectors(block_num, count, buffer, size);
+}
+
+/// 連続したセクタにバッファのデータを書き込む
+/// @param [in]  block_num     パーティション内の開始セクタ位置
+/// @param [in]  count         セクタ数
+/// @param [in]  buffer        バッファ
+/// @param [in]  size          バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskBasic::WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size)
+{
+	return p_disk->WriteSectors(block_num, count, buffer, size);
+}
+
+/// 連続したセクタがすべてディスクのセクタサイズと同じか
+/// @param [in]  block_num     パーティション内の開始セクタ位置
+/// @param [in]  count         セクタ数
+/// @return true:すべて同じ ReadSectors() / WriteSectors() でまとめて扱える
+bool DiskBasic::IsUniformSectorSize(int block_num, int count)
+{
+	return p_disk->IsUniformSectorSize(block_num, count);
+}
+
 /// グループ番号からセクタ番号を計算してリストに入れる
 /// @note 管理エリアがあれば飛ばす、開始グループ番号のオフセット分を引く などの機種依存を考慮
 /// @param [in] group_num     グループ番号
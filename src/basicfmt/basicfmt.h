@@ -29,6 +29,9 @@ class DiskBasicDirItem;
 class DiskBasicDirItems;
 class DiskBasicDirItemAttr;
 class DiskBasicGroups;
+class DiskBasicAvailabillity;
+class DiskBasicFatChecker;
+class DiskBasicDirTreeInfo;
 class AttrControls;
 
 //////////////////////////////////////////////////////////////////////
@@ -66,6 +69,116 @@ public:
 
 //////////////////////////////////////////////////////////////////////
 
+/// デフラグの計画と結果
+class DiskBasicDefragInfo
+{
+private:
+	int		m_files;			///< 対象ファイル数
+	int		m_fragmented[2];	///< 断片化しているファイル数 [0]:実行前 [1]:実行後
+	int		m_extents[2];		///< 連続領域の総数 [0]:実行前 [1]:実行後
+	int		m_moved_files;		///< 移動するファイル数
+	wxInt64	m_moved_size;		///< 移動するデータサイズ(bytes)
+
+public:
+	/// 実行前か実行後か
+	enum en_defrag_phase {
+		DEFRAG_BEFORE = 0,
+		DEFRAG_AFTER = 1,
+	};
+	DiskBasicDefragInfo();
+	~DiskBasicDefragInfo() {}
+
+	/// @brief クリア
+	void	Clear();
+	/// @brief ファイルを追加
+	void	AddFile(int extents_before, int extents_after);
+	/// @brief 移動したファイルを追加
+	void	AddMoved(wxInt64 size);
+
+	/// @brief 対象ファイル数
+	int		GetFiles() const { return m_files; }
+	/// @brief 断片化しているファイル数
+	int		GetFragmentedFiles(en_defrag_phase phase) const { return m_fragmented[phase]; }
+	/// @brief 連続領域の総数
+	int		GetExtents(en_defrag_phase phase) const { return m_extents[phase]; }
+	/// @brief 断片化しているファイルの割合(%)
+	double	GetFragmentation(en_defrag_phase phase) const;
+	/// @brief 移動するファイル数
+	int		GetMovedFiles() const { return m_moved_files; }
+	/// @brief 移動するデータサイズ
+	wxInt64	GetMovedSize() const { return m_moved_size; }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/// ボリュームのチェック結果
+class DiskBasicCheckInfo
+{
+public:
+	/// 問題の種類
+	enum en_check_problem {
+		CHECK_CROSS_LINKED = 0,	///< 他のファイルとグループを共有している
+		CHECK_LOOPED,			///< チェインがループしている
+		CHECK_BROKEN,			///< チェインが途中で切れている
+		CHECK_SIZE_MISMATCH,	///< ファイルサイズとチェインの長さが合わない
+		CHECK_PROBLEMS
+	};
+
+private:
+	int		m_files;			///< ファイル数
+	int		m_dirs;				///< ディレクトリ数
+	int		m_problems[CHECK_PROBLEMS];	///< 問題の種類ごとのファイル数
+	wxArrayInt		m_detail_kinds;	///< 問題のあったファイルの問題の種類
+	wxArrayString	m_detail_paths;	///< 問題のあったファイルのパス
+	wxUint32 m_lost_chains;		///< どこからもたどれないチェイン数
+	wxUint32 m_lost_groups;		///< どこからもたどれないグループ数
+	wxUint32 m_used_groups;		///< 使用中のグループ数
+	wxUint32 m_free_groups;		///< 空きグループ数
+	wxUint32 m_bad_groups;		///< 不良グループ数
+
+public:
+	DiskBasicCheckInfo();
+	~DiskBasicCheckInfo() {}
+
+	/// @brief クリア
+	void	Clear();
+	/// @brief ファイルを追加
+	void	AddFile(bool is_dir);
+	/// @brief 問題を追加
+	void	AddProblem(en_check_problem kind, const wxString &path);
+	/// @brief どこからもたどれないチェインをセット
+	void	SetLostChains(wxUint32 chains, wxUint32 groups);
+	/// @brief グループ数をセット
+	void	SetGroups(wxUint32 used, wxUint32 free, wxUint32 bad);
+
+	/// @brief 問題があるか
+	bool	HasProblems() const;
+	/// @brief ファイル数
+	int		GetFiles() const { return m_files; }
+	/// @brief ディレクトリ数
+	int		GetDirectories() const { return m_dirs; }
+	/// @brief 問題のあったファイル数
+	int		GetProblems(en_check_problem kind) const { return m_problems[kind]; }
+	/// @brief 問題のあったファイルの数
+	size_t	GetDetailCount() const { return m_detail_paths.Count(); }
+	/// @brief 問題のあったファイルの問題の種類
+	int		GetDetailKind(size_t idx) const { return m_detail_kinds.Item(idx); }
+	/// @brief 問題のあったファイルのパス
+	const wxString &GetDetailPath(size_t idx) const { return m_detail_paths.Item(idx); }
+	/// @brief どこからもたどれないチェイン数
+	wxUint32 GetLostChains() const { return m_lost_chains; }
+	/// @brief どこからもたどれないグループ数
+	wxUint32 GetLostGroups() const { return m_lost_groups; }
+	/// @brief 使用中のグループ数
+	wxUint32 GetUsedGroups() const { return m_used_groups; }
+	/// @brief 空きグループ数
+	wxUint32 GetFreeGroups() const { return m_free_groups; }
+	/// @brief 不良グループ数
+	wxUint32 GetBadGroups() const { return m_bad_groups; }
+};
+
+//////////////////////////////////////////////////////////////////////
+
 class ArrayOfDiskBasic;
 
 /// DISK BASIC ディスク毎のリスト
@@ -126,6 +239,8 @@ private:
 
 	DiskBasicError errinfo;				///< エラー情報保存用
 
+	wxArrayInt	pinned_sectors;			///< キャッシュに固定したセクタ 開始位置とセクタ数の組
+
 	/// BASIC種類を設定
 	void			CreateType();
 	/// 指定のDISK BASICでフォーマットされているかを解析＆チェック
@@ -133,6 +248,18 @@ private:
 
 	int				MaxRatio(wxArrayDouble &values);
 
+	/// デフラグの対象ファイルを集める
+	void			CollectDefragTargets(DiskBasicFatChecker &checker, DiskBasicDirItem *dir_item, wxInt64 bytes_per_group, DiskBasicDirItems &items, bool &cross_linked, int depth);
+	/// ファイルのグループを連続した領域に移動する
+	bool			MoveFileGroups(DiskBasicDirItem *item, const DiskBasicGroups &group_items, wxUint32 new_start);
+	/// 空き領域の一覧に追加する 隣接する空き領域とはまとめる
+	void			AddDefragFreeRun(wxArrayInt &run_starts, wxArrayInt &run_lens, int start, int len);
+
+	/// ディレクトリ内のファイルのチェインをチェック
+	void			CheckDirectoryChains(DiskBasicFatChecker &checker, DiskBasicDirItem *dir_item, const wxString &path, wxInt64 bytes_per_group, DiskBasicCheckInfo &info, int depth);
+	/// ファイルのチェインをチェック
+	bool			CheckFileChain(DiskBasicFatChecker &checker, DiskBasicDirItem *item, bool is_dir, const wxString &path, wxInt64 bytes_per_group, DiskBasicCheckInfo &info);
+
 public:
 	DiskBasic();
 	~DiskBasic();
@@ -201,7 +328,7 @@ public:
 	wxInt64			GetFreeDiskSize() const;
 
 	/// FATエリアの空き状況を取得
-	void			GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const;
+	void			GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr) const;
 	//@}
 	/// @name 書き込み
 	//@{
@@ -249,6 +376,20 @@ public:
 	/// ディスクを論理フォーマット
 	int				FormatDisk(const DiskBasicIdentifiedData &data);
 	//@}
+	/// @name デフラグ
+	//@{
+	/// デフラグできるか
+	bool			IsDefragmentable();
+	/// デフラグ
+	bool			Defragment(DiskBasicDefragInfo &info, bool apply);
+	//@}
+	/// @name ボリュームのチェック
+	//@{
+	/// ボリュームをチェックできるか
+	bool			IsCheckableVolume();
+	/// ボリュームをチェック
+	bool			CheckVolume(DiskBasicCheckInfo &info);
+	//@}
 	/// @name ディレクトリ操作
 	//@{
 	/// ルートディレクトリを返す
@@ -261,6 +402,8 @@ public:
 	DiskBasicDirItems *GetCurrentDirectoryItems(DiskBasicDirItem **dir_item = NULL);
 	/// ディレクトリをアサイン
 	bool			AssignDirectory(DiskBasicDirItem *dir_item);
+	/// 配下のサブディレクトリをすべてアサイン
+	bool			AssignDirectoryTree(DiskBasicDirItem *dir_item, DiskBasicDirTreeInfo &info);
 	/// ディレクトリを読み直す
 	bool			ReassignDirectory(DiskBasicDirItem *dir_item);
 	/// ディレクトリを変更
@@ -307,6 +450,20 @@ public:
 
 	/// キャッシュを更新する
 	void			RefreshCache(int block_num);
+	/// 指定範囲のセクタを先読みする
+	void			ReadAhead(int block_num, int count);
+	/// 指定範囲のセクタをキャッシュに固定する
+	bool			PinSectors(int block_num, int count);
+	/// グループのセクタをキャッシュに固定する
+	void			PinSectors(const DiskBasicGroups &group_items);
+	/// キャッシュに固定したセクタをすべて解除する
+	void			UnpinAllSectors();
+	/// 連続したセクタのデータをバッファに読み込む
+	int				ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size);
+	/// 連続したセクタにバッファのデータを書き込む
+	int				WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size);
+	/// 連続したセクタがすべてディスクのセクタサイズと同じか
+	bool			IsUniformSectorSize(int block_num, int count);
 
 	/// 開始セクタ番号を返す
 	int				GetSectorNumberBase() const;
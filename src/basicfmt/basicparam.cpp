@@ -47,6 +47,7 @@ void DiskBasicParamBase::ClearBasicParamBase()
 	to_upper_before_dialog = false;
 	to_upper_after_renamed = false;
 	big_endian			 = false;
+	contiguous_allocation = false;
 	various_params.clear();
 }
 
@@ -186,6 +187,8 @@ bool DiskBasicParamBases::Load(const wxXmlNode *node, const wxString &name, cons
 		param.GetValidVolumeName().SetMaxLength(Utils::ToInt(value));
 	} else if (name == "Endian") {
 		param.BigEndian(value.Upper() == "BIG");
+	} else if (name == "ContiguousAllocation") {
+		param.ContiguousAllocation(Utils::ToBool(value));
 	} else if (!name.IsEmpty()) {
 		wxVariant nval;
 		param.GetVariousParam(name, nval);
@@ -51,6 +51,7 @@ protected:
 	bool to_upper_before_dialog;		///< ファイル名ダイアログ表示前に大文字に変換するか
 	bool to_upper_after_renamed;		///< ファイル名ダイアログ入力後に大文字に変換するか
 	bool big_endian;					///< バイトオーダ ビッグエンディアンか
+	bool contiguous_allocation;			///< ファイル書き込み時に連続した空きグループを優先して確保するか
 	VariantHash various_params;			///< その他固有のパラメータ
 
 	/// @brief 初期化
@@ -117,6 +118,8 @@ public:
 	bool				ToUpperAfterRenamed() const { return to_upper_after_renamed; }
 	/// @brief バイトオーダ ビッグエンディアンか
 	bool				IsBigEndian() const			{ return big_endian; }
+	/// @brief 連続した空きグループを優先して確保するか
+	bool				IsContiguousAllocation() const	{ return contiguous_allocation; }
 	/// @brief 固有のパラメータ
 	const VariantHash &	GetVariousParams() const	{ return various_params; }
 	/// @brief 固有のパラメータ
@@ -178,6 +181,8 @@ public:
 	void 				ToUpperAfterRenamed(bool val)		{ to_upper_after_renamed = val; }
 	/// @brief バイトオーダ ビッグエンディアンか
 	void				BigEndian(bool val)					{ big_endian = val; }
+	/// @brief 連続した空きグループを優先して確保するか
+	void				ContiguousAllocation(bool val)		{ contiguous_allocation = val; }
 	/// @brief 固有のパラメータ
 	void				SetVariousParam(const wxString &key, const wxVariant &val);
 	/// @brief 固有のパラメータ
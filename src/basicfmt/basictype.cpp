@@ -452,6 +452,124 @@ wxUint32 DiskBasicType::GetNextEmptyGroupNumber(wxUint32 curr_group)
 	return new_num;
 }
 
+/// 確保できる空きグループか
+/// @param [in] num グループ番号(0...)
+/// @return true 空いている
+bool DiskBasicType::IsEmptyGroupNumber(wxUint32 num)
+{
+	return (GetGroupNumber(num) == basic->GetGroupUnusedCode());
+}
+
+/// 連続した空きグループの一覧を作成
+///
+/// IsEmptyGroupNumber() で１グループずつ調べる。
+/// @param [in]  start_group 検索開始グループ番号
+/// @param [in]  end_group   検索終了グループ番号
+/// @param [in]  step        グループ番号の間隔
+/// @param [out] runs        空き領域(グループ番号順) グループ数はstep単位
+void DiskBasicType::GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, wxUint32 step, DiskBasicGroupRuns &runs)
+{
+	runs.Empty();
+	if (step == 0) return;
+
+	wxUint32 run_start = 0;
+	int len = 0;
+	for(wxUint32 num = start_group; num <= end_group; num += step) {
+		if (IsEmptyGroupNumber(num)) {
+			if (len == 0) run_start = num;
+			len++;
+		} else if (len > 0) {
+			runs.Add(DiskBasicGroupRun(run_start, len));
+			len = 0;
+		}
+		if (num > end_group - step) break;
+	}
+	if (len > 0) {
+		runs.Add(DiskBasicGroupRun(run_start, len));
+	}
+}
+
+/// 連続した空きグループを探して確保する順に並べる
+///
+/// 指定したグループから始まる空き領域があればそこから先に確保する。
+/// 残りは必要数がおさまる連続領域があれば最も小さいものを選ぶ。
+/// ない場合は大きい領域から順に選び、なるべく少ない領域数で確保する。
+/// @param [in]  start_group  検索開始グループ番号
+/// @param [in]  end_group    検索終了グループ番号
+/// @param [in]  step         グループ番号の間隔
+/// @param [in]  need_groups  必要なグループ数
+/// @param [in]  prefer_group 優先して確保するグループ番号 INVALID_GROUP_NUMBERのときはなし
+/// @param [out] plan         確保するグループ番号(優先分の後は番号順)
+/// @return true 必要数を確保できる
+bool DiskBasicType::PlanContiguousGroups(wxUint32 start_group, wxUint32 end_group, wxUint32 step, int need_groups, wxUint32 prefer_group, wxArrayInt &plan)
+{
+	plan.Empty();
+	if (need_groups <= 0 || step == 0) return false;
+
+	// 空き領域の一覧を作成
+	DiskBasicGroupRuns runs;
+	GetEmptyGroupRuns(start_group, end_group, step, runs);
+	int total = 0;
+	for(size_t i=0; i<runs.Count(); i++) {
+		total += runs.Item(i).GetCount();
+	}
+	if (total < need_groups) return false;
+
+	int remain = need_groups;
+
+	// 追加のときはチェインの直後から確保する
+	if (prefer_group != INVALID_GROUP_NUMBER) {
+		for(size_t i=0; i<runs.Count(); i++) {
+			const DiskBasicGroupRun *run = &runs.Item(i);
+			if (run->GetGroup() != prefer_group) continue;
+
+			int take = wxMin(run->GetCount(), remain);
+			wxUint32 num = run->GetGroup();
+			for(int n=0; n<take; n++) {
+				plan.Add((int)num);
+				num += step;
+			}
+			remain -= take;
+			runs.RemoveAt(i);
+			break;
+		}
+	}
+
+	// グループ数の小さい順に並べる
+	runs.Sort(&DiskBasicGroupRun::CompareByCount);
+
+	DiskBasicGroupRuns takes;
+	int last = (int)runs.Count() - 1;
+	while(remain > 0 && last >= 0) {
+		// おさまる領域のうち最小のもの
+		int lo = 0;
+		int hi = last + 1;
+		while(lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (runs.Item(mid).GetCount() < remain) lo = mid + 1;
+			else hi = mid;
+		}
+		// おさまらない場合は最大のもの
+		int match = (lo <= last ? lo : last);
+
+		int take = wxMin(runs.Item(match).GetCount(), remain);
+		takes.Add(DiskBasicGroupRun(runs.Item(match).GetGroup(), take));
+		remain -= take;
+		last--;
+	}
+
+	// 番号順に並べる
+	takes.Sort(&DiskBasicGroupRun::CompareByGroup);
+	for(size_t i=0; i<takes.Count(); i++) {
+		wxUint32 num = takes.Item(i).GetGroup();
+		for(int n=0; n<takes.Item(i).GetCount(); n++) {
+			plan.Add((int)num);
+			num += step;
+		}
+	}
+	return (remain <= 0);
+}
+
 /// システムグループ番号を返す
 wxUint32 DiskBasicType::GetGroupSystemCode() const
 {
@@ -558,6 +676,9 @@ bool DiskBasicType::AssignRootDirectory(int start_sector, int end_sector, DiskBa
 {
 	CalcGroupsOnRootDirectory(start_sector, end_sector, group_items);
 
+	// ルートディレクトリはキャッシュに固定しておく
+	basic->PinSectors(group_items);
+
 	return AssignDirectory(true, group_items, dir_item);
 }
 
@@ -1024,28 +1145,98 @@ void DiskBasicType::CalcDiskFreeSize(bool wrote)
 {
 	fat_availability.Empty();
 
+	int grp_size = basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup();
+
 	// 使用済みかチェック
 	for(wxUint32 pos = 0; pos <= basic->GetFatEndGroup(); pos++) {
-		int fsize = 0;
-		int grps = 0;
-		wxUint32 gnum = GetGroupNumber(pos);
-		int fsts = FAT_AVAIL_USED;
-		if (gnum == basic->GetGroupUnusedCode()) {
-			fsize = (basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup());
-			grps = 1;
-			fsts = FAT_AVAIL_FREE;
-		} else if (gnum == basic->GetGroupSystemCode()) {
-			fsts = FAT_AVAIL_SYSTEM;
-		} else if (gnum >= basic->GetGroupFinalCode()) {
-			fsts = FAT_AVAIL_USED_LAST;
+		int fsts = GetGroupAvailability(pos, GetGroupNumber(pos));
+		if (fsts == FAT_AVAIL_FREE) {
+			fat_availability.Add(fsts, grp_size, 1);
+		} else {
+			fat_availability.Add(fsts, 0, 0);
 		}
-		fat_availability.Add(fsts, fsize, grps);
 	}
 
 //	free_disk_size = (int)fat_availability.GetFreeSize();
 //	free_groups = (int)fat_availability.GetFreeGroups();
 }
 
+/// グループの使用状況を返す
+/// @param [in] num  グループ番号
+/// @param [in] gnum FATの値
+/// @return 使用状況 en_fat_availability
+int DiskBasicType::GetGroupAvailability(wxUint32 num, wxUint32 gnum) const
+{
+	int fsts = FAT_AVAIL_USED;
+	if (gnum == basic->GetGroupUnusedCode()) {
+		fsts = FAT_AVAIL_FREE;
+	} else if (gnum == basic->GetGroupSystemCode()) {
+		fsts = FAT_AVAIL_SYSTEM;
+	} else if (gnum >= basic->GetGroupFinalCode()) {
+		fsts = FAT_AVAIL_USED_LAST;
+	}
+	return fsts;
+}
+
+/// 使用状況を更新しているか
+///
+/// CalcDiskFreeSize()で全グループの使用状況を計算済みなら、
+/// 以降は確保や削除に合わせて差分で更新する。
+bool DiskBasicType::IsAvailabilityTracked() const
+{
+	return CanTrackAvailability() && fat_availability.Count() > basic->GetFatEndGroup();
+}
+
+/// 指定グループの使用状況を更新
+///
+/// FATを書き換えた後に呼ぶ。空きサイズ、空きグループ数も増減する。
+/// @param [in] num グループ番号
+void DiskBasicType::UpdateAvailability(wxUint32 num)
+{
+	if (!IsAvailabilityTracked()) return;
+	if (num > basic->GetFatEndGroup()) return;
+
+	int fsts = GetGroupAvailability(num, GetGroupNumber(num));
+	fat_availability.Modify(num, fsts, basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup());
+}
+
+/// 書き込み後に残りディスクサイズを更新
+///
+/// 差分で更新できない場合のみ全グループを計算しなおす。
+void DiskBasicType::UpdateDiskFreeSize()
+{
+	if (!IsAvailabilityTracked()) {
+		CalcDiskFreeSize(true);
+		return;
+	}
+#ifdef _DEBUG
+	VerifyDiskFreeSize();
+#endif
+}
+
+/// 残りディスクサイズを計算しなおして一致するか確認
+///
+/// 差分で更新した結果と全グループを計算した結果を比較する。
+/// 計算しなおした結果が残る。
+/// @return 一致したらtrue
+bool DiskBasicType::VerifyDiskFreeSize()
+{
+	DiskBasicAvailabillity prev = fat_availability;
+
+	CalcDiskFreeSize(true);
+
+	bool match = (prev.GetFreeSize() == fat_availability.GetFreeSize()
+		&& prev.GetFreeGroups() == fat_availability.GetFreeGroups()
+		&& prev.Count() == fat_availability.Count());
+	for(size_t pos = 0; match && pos < prev.Count(); pos++) {
+		match = (prev.Get(pos) == fat_availability.Get(pos));
+	}
+	if (!match) {
+		myLog.SetError("DiskBasicType::VerifyDiskFreeSize: free groups mismatch (%d -> %d)", (int)prev.GetFreeGroups(), (int)fat_availability.GetFreeGroups());
+	}
+	return match;
+}
+
 /// 残りディスクサイズをクリア
 void DiskBasicType::ClearDiskFreeSize()
 {
@@ -1076,7 +1267,7 @@ wxInt64 DiskBasicType::GetFreeGroupSize() const
 /// FATの空き状況を配列で返す
 /// @param [out] offset オフセット
 /// @param [out] arr    空き状況を入れた配列
-void DiskBasicType::GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const
+void DiskBasicType::GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr)
 {
 	*offset = 0;
 	*arr = &fat_availability;
@@ -1103,7 +1294,21 @@ int DiskBasicType::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *item,
 	int sizeremain = data_size;
 
 	int bytes_per_group = basic->GetSectorsPerGroup() * basic->GetDisk()->GetSectorSize();
-	wxUint32 group_num = GetEmptyGroupNumber();
+
+	// 連続した空きグループを優先して確保する
+	wxArrayInt plan;
+	size_t plan_pos = 0;
+	if (basic->IsContiguousAllocation() && bytes_per_group > 0) {
+		wxUint32 prefer_group = INVALID_GROUP_NUMBER;
+		if (flags == ALLOCATE_GROUPS_APPEND) {
+			// 追加のときは今の最終グループの次から
+			wxUint32 last_group = GetLastGroupOfChain(item->GetStartGroup(0));
+			if (last_group != INVALID_GROUP_NUMBER) prefer_group = last_group + 1;
+		}
+		PlanContiguousGroups(0, basic->GetFatEndGroup(), 1, (data_size + bytes_per_group - 1) / bytes_per_group, prefer_group, plan);
+	}
+
+	wxUint32 group_num = (plan.Count() > 0 ? (wxUint32)plan.Item(0) : GetEmptyGroupNumber());
 	int limit = basic->GetFatEndGroup() + 1;
 	while(rc >= 0 && limit >= 0 && sizeremain > 0) {
 		if (group_num == INVALID_GROUP_NUMBER) {
@@ -1113,6 +1318,7 @@ int DiskBasicType::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *item,
 		}
 		// 位置を予約
 		SetGroupNumber(group_num, basic->GetGroupFinalCode());
+		UpdateAvailability(group_num);
 
 		// グループ番号の書き込み
 		if (first_group) {
@@ -1121,7 +1327,13 @@ int DiskBasicType::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *item,
 		}
 
 		// 次の空きグループをさがす
-		wxUint32 next_group_num = GetNextEmptyGroupNumber(group_num);
+		wxUint32 next_group_num;
+		if (plan.Count() > 0) {
+			plan_pos++;
+			next_group_num = (plan_pos < plan.Count() ? (wxUint32)plan.Item(plan_pos) : INVALID_GROUP_NUMBER);
+		} else {
+			next_group_num = GetNextEmptyGroupNumber(group_num);
+		}
 
 //		myLog.SetDebug("  group_num:0x%03x next:0x%03x", group_num, next_group_num);
 
@@ -1135,6 +1347,7 @@ int DiskBasicType::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *item,
 
 		// グループ番号設定
 		SetGroupNumber(group_num, next_group_num);
+		UpdateAvailability(group_num);
 
 		group_num = next_group_num;
 
@@ -1190,6 +1403,7 @@ int DiskBasicType::ChainGroups(wxUint32 group_num, wxUint32 append_group_num)
 		wxUint32 next_group_num = GetGroupNumber(group_num);
 		if (next_group_num >= basic->GetGroupFinalCode()) {
 			SetGroupNumber(group_num, append_group_num);
+			UpdateAvailability(group_num);
 			break;
 		}
 		group_num = next_group_num;
@@ -1198,6 +1412,29 @@ int DiskBasicType::ChainGroups(wxUint32 group_num, wxUint32 append_group_num)
 	return (limit >= 0 ? 0 : -1);
 }
 
+/// チェインの最終グループ番号を返す
+///
+/// 指定したグループ番号からFATをたどる
+///
+/// @param [in] group_num グループ番号
+/// @return 最終グループ番号 / INVALID_GROUP_NUMBER チェインが壊れている
+wxUint32 DiskBasicType::GetLastGroupOfChain(wxUint32 group_num)
+{
+	int limit = basic->GetFatEndGroup() + 1;
+	while(limit >= 0) {
+		wxUint32 next_group_num = GetGroupNumber(group_num);
+		if (next_group_num >= basic->GetGroupFinalCode()) {
+			return group_num;
+		}
+		if (next_group_num == basic->GetGroupUnusedCode() || next_group_num > basic->GetFatEndGroup()) {
+			break;
+		}
+		group_num = next_group_num;
+		limit--;
+	}
+	return INVALID_GROUP_NUMBER;
+}
+
 /// グループ番号から開始セクタ番号を得る
 /// @param [in] group_num グループ番号
 /// @return 開始セクタ番号
@@ -1263,10 +1500,34 @@ bool DiskBasicType::IsRootDirectory(wxUint32 group_num)
 /// @param [in,out] pitem     ファイル名、属性を持っている仮ディレクトリアイテム
 /// @param [out]    next_item 未使用アイテムの次位置にあるアイテム
 /// @return NULL:空きなし
-DiskBasicDirItem *DiskBasicType::GetEmptyDirectoryItem(DiskBasicDirItem *WXUNUSED(parent), DiskBasicDirItems *items, DiskBasicDirItem *WXUNUSED(pitem), DiskBasicDirItem **next_item)
+DiskBasicDirItem *DiskBasicType::GetEmptyDirectoryItem(DiskBasicDirItem *parent, DiskBasicDirItems *items, DiskBasicDirItem *WXUNUSED(pitem), DiskBasicDirItem **next_item)
 {
 	DiskBasicDirItem *match_item = NULL;
-	if (items) {
+	DiskBasicDirFreeSlots *slots = NULL;
+	if (parent && items && parent->GetChildren() == items) {
+		slots = parent->GetFreeSlots();
+	}
+	if (slots) {
+		// 未使用アイテムの一覧から探す
+		int pos;
+		while((pos = slots->FindFirst()) != wxNOT_FOUND) {
+			DiskBasicDirItem *item = items->Item(pos);
+			if (!item->IsUsed()) {
+				match_item = item;
+				break;
+			}
+			// 使用中なら一覧を直して次を探す
+			slots->Update(item);
+		}
+		if (match_item && next_item) {
+			pos++;
+			if (pos < (int)items->Count() && !items->Item(pos)->IsUsed()) {
+				*next_item = items->Item(pos);
+			} else {
+				*next_item = NULL;
+			}
+		}
+	} else if (items) {
 		for(size_t i=0; i < items->Count(); i++) {
 			DiskBasicDirItem *item = items->Item(i);
 			if (!item->IsUsed()) {
@@ -1461,9 +1722,12 @@ int DiskBasicType::WriteFile(DiskBasicDirItem *item, wxInputStream &istream, wxU
 /// @param [in] group_items グループリスト
 void DiskBasicType::DeleteGroups(const DiskBasicGroups &group_items)
 {
-	for(size_t gidx=0; gidx<group_items.Count(); gidx++) {
-		// FATエントリを削除
-		DeleteGroupNumber(group_items.Item(gidx).GetGroup());
+	for(size_t eidx=0; eidx<group_items.GetExtentCount(); eidx++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(eidx);
+		for(size_t n=0; n<ext->Count(); n++) {
+			// FATエントリを削除
+			DeleteGroupNumber(ext->GetGroup(n));
+		}
 	}
 }
 
@@ -1473,6 +1737,7 @@ void DiskBasicType::DeleteGroupNumber(wxUint32 group_num)
 {
 	// FATに未使用コードを設定
 	SetGroupNumber(group_num, basic->GetGroupUnusedCode());
+	UpdateAvailability(group_num);
 }
 
 //
@@ -203,6 +203,12 @@ public:
 	virtual wxUint32 GetEmptyGroupNumber();
 	/// @brief 次の空きFAT位置を返す
 	virtual wxUint32 GetNextEmptyGroupNumber(wxUint32 curr_group);
+	/// @brief 確保できる空きグループか
+	virtual bool	IsEmptyGroupNumber(wxUint32 num);
+	/// @brief 連続した空きグループの一覧を作成
+	virtual void	GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, wxUint32 step, DiskBasicGroupRuns &runs);
+	/// @brief 連続した空きグループを探して確保する順に並べる
+	bool			PlanContiguousGroups(wxUint32 start_group, wxUint32 end_group, wxUint32 step, int need_groups, wxUint32 prefer_group, wxArrayInt &plan);
 	/// @brief システムグループ番号を返す
 	virtual wxUint32 GetGroupSystemCode() const;
 	/// @brief FAT種類を返す（機種依存）
@@ -223,6 +229,10 @@ public:
 	virtual void	GetEndNumOnFat(int &block_num, int &sector_pos) const;
 	/// @brief "FAT"などのタイトル名（ダイアログ用）
 	virtual wxString GetTitleForFat() const;
+	/// @brief ボリュームのチェックができるか
+	virtual bool	SupportCheckVolume() const { return false; }
+	/// @brief FATを走査してチェインの検査を準備する
+	virtual bool	ScanFatChains(DiskBasicFatChecker &checker) { return false; }
 
 	/// @brief 管理エリアのトラック番号からグループ番号を計算
 	virtual wxUint32 CalcManagedStartGroup();
@@ -269,6 +279,18 @@ public:
 	virtual void	GetUsableDiskSize(wxInt64 &disk_size, wxInt64 &group_size) const;
 	/// @brief 残りディスクサイズを計算
 	virtual void	CalcDiskFreeSize(bool wrote);
+	/// @brief グループの使用状況を返す
+	virtual int		GetGroupAvailability(wxUint32 num, wxUint32 gnum) const;
+	/// @brief 確保や削除に合わせて使用状況を更新できるか
+	virtual bool	CanTrackAvailability() const { return true; }
+	/// @brief 使用状況を更新しているか
+	bool			IsAvailabilityTracked() const;
+	/// @brief 指定グループの使用状況を更新
+	void			UpdateAvailability(wxUint32 num);
+	/// @brief 書き込み後に残りディスクサイズを更新
+	virtual void	UpdateDiskFreeSize();
+	/// @brief 残りディスクサイズを計算しなおして一致するか確認
+	bool			VerifyDiskFreeSize();
 	/// @brief 残りディスクサイズをクリア
 	void			ClearDiskFreeSize();
 	/// @brief 残りディスクサイズを得る(CalcDiskFreeSize()で計算した結果)
@@ -278,7 +300,7 @@ public:
 	/// @brief 残りグループ数を得る(CalcDiskFreeSize()で計算した結果)
 	wxInt64			GetFreeGroupSize() const;
 	/// @brief FATの空き状況を配列で返す
-	void			GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const;
+	virtual void	GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr);
 	//@}
 
 	/// @name file chain
@@ -289,6 +311,8 @@ public:
 	virtual int		AllocateGroups(DiskBasicDirItem *item, int data_size, AllocateGroupFlags flags, DiskBasicGroups &group_items);
 	/// @brief グループをつなげる
 	virtual int		ChainGroups(wxUint32 group_num, wxUint32 append_group_num);
+	/// @brief チェインの最終グループ番号を返す
+	wxUint32		GetLastGroupOfChain(wxUint32 group_num);
 
 	/// @brief グループ番号からパーティション内の開始セクタ番号を得る
 	virtual int		GetStartSectorFromGroup(wxUint32 group_num);
@@ -379,6 +403,8 @@ public:
 	//@{
 	/// @brief ファイルを削除できるか
 	virtual bool	SupportDeleting() const { return true; }
+	/// @brief デフラグできるか
+	virtual bool	SupportDefragment() const { return false; }
 	/// @brief 指定したグループ番号のFAT領域を削除する
 	virtual void	DeleteGroups(const DiskBasicGroups &group_items);
 	/// @brief 指定したグループ番号のFAT領域を削除する
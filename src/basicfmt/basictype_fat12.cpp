@@ -33,6 +33,14 @@ double DiskBasicTypeFAT12::CheckFat(bool is_formatting)
 	return valid_ratio;
 }
 
+/// FATを走査してチェインの検査を準備する
+/// @param [out] checker チェイン検査
+/// @return false FATをデコードできない
+bool DiskBasicTypeFAT12::ScanFatChains(DiskBasicFatChecker &checker)
+{
+	return SetupFatChecker(checker, 2, 0xff8);
+}
+
 /// 残りディスクサイズを計算
 void DiskBasicTypeFAT12::CalcDiskFreeSize(bool wrote)
 {
@@ -68,12 +76,18 @@ int DiskBasicTypeFAT12::CalcDataSizeOnLastSector(DiskBasicDirItem *item, wxInput
 /// @param [in] val 値
 void DiskBasicTypeFAT12::SetGroupNumber(wxUint32 num, wxUint32 val)
 {
-	fat->GetDiskBasicFatArea()->SetData12LE(num, val);
+	fat->SetGroupNumber(DiskBasicFatTable::FAT_TABLE_12LE, num, val);
 }
 
 /// FAT位置を返す
 /// @param [in] num グループ番号(0...)
 wxUint32 DiskBasicTypeFAT12::GetGroupNumber(wxUint32 num) const
 {
-	return fat->GetDiskBasicFatArea()->GetData12LE(0, num);
+	return fat->GetGroupNumber(DiskBasicFatTable::FAT_TABLE_12LE, num);
+}
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeFAT12::DecodeFat()
+{
+	return fat->DecodeTable(DiskBasicFatTable::FAT_TABLE_12LE);
 }
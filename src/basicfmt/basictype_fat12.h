@@ -33,12 +33,16 @@ public:
 	virtual void		SetGroupNumber(wxUint32 num, wxUint32 val);
 	/// @brief FAT位置を返す
 	virtual wxUint32	GetGroupNumber(wxUint32 num) const;
+	/// @brief FAT全体をデコードする
+	virtual bool		DecodeFat();
 	//@}
 
 	/// @name check / assign FAT area
 	//@{
 	/// @brief FATエリアをチェック
 	virtual double 	CheckFat(bool is_formatting);
+	/// @brief FATを走査してチェインの検査を準備する
+	virtual bool	ScanFatChains(DiskBasicFatChecker &checker);
 	//@}
 
 	/// @name disk size
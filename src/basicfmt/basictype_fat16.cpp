@@ -31,6 +31,14 @@ double DiskBasicTypeFAT16::CheckFat(bool is_formatting)
 	return valid_ratio;
 }
 
+/// FATを走査してチェインの検査を準備する
+/// @param [out] checker チェイン検査
+/// @return false FATをデコードできない
+bool DiskBasicTypeFAT16::ScanFatChains(DiskBasicFatChecker &checker)
+{
+	return SetupFatChecker(checker, 2, 0xfff8);
+}
+
 /// 残りディスクサイズを計算
 void DiskBasicTypeFAT16::CalcDiskFreeSize(bool wrote)
 {
@@ -42,13 +50,19 @@ void DiskBasicTypeFAT16::CalcDiskFreeSize(bool wrote)
 /// @param [in] val 値
 void DiskBasicTypeFAT16::SetGroupNumber(wxUint32 num, wxUint32 val)
 {
-	fat->GetDiskBasicFatArea()->SetData16LE(num, val);
+	fat->SetGroupNumber(DiskBasicFatTable::FAT_TABLE_16LE, num, val);
 }
 /// FAT位置を返す
 /// @param [in] num グループ番号(0...)
 wxUint32 DiskBasicTypeFAT16::GetGroupNumber(wxUint32 num) const
 {
-	return fat->GetDiskBasicFatArea()->GetData16LE(0, num);
+	return fat->GetGroupNumber(DiskBasicFatTable::FAT_TABLE_16LE, num);
+}
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeFAT16::DecodeFat()
+{
+	return fat->DecodeTable(DiskBasicFatTable::FAT_TABLE_16LE);
 }
 
 //
@@ -64,11 +78,17 @@ DiskBasicTypeFAT16BE::DiskBasicTypeFAT16BE(DiskBasic *basic, DiskBasicFat *fat,
 /// @param [in] val 値
 void DiskBasicTypeFAT16BE::SetGroupNumber(wxUint32 num, wxUint32 val)
 {
-	fat->GetDiskBasicFatArea()->SetData16BE(num, val);
+	fat->SetGroupNumber(DiskBasicFatTable::FAT_TABLE_16BE, num, val);
 }
 /// FAT位置を返す
 /// @param [in] num グループ番号(0...)
 wxUint32 DiskBasicTypeFAT16BE::GetGroupNumber(wxUint32 num) const
 {
-	return fat->GetDiskBasicFatArea()->GetData16BE(0, num);
+	return fat->GetGroupNumber(DiskBasicFatTable::FAT_TABLE_16BE, num);
+}
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeFAT16BE::DecodeFat()
+{
+	return fat->DecodeTable(DiskBasicFatTable::FAT_TABLE_16BE);
 }
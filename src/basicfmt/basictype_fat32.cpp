@@ -31,6 +31,14 @@ double DiskBasicTypeFAT32::CheckFat(bool is_formatting)
 	return valid_ratio;
 }
 
+/// FATを走査してチェインの検査を準備する
+/// @param [out] checker チェイン検査
+/// @return false FATをデコードできない
+bool DiskBasicTypeFAT32::ScanFatChains(DiskBasicFatChecker &checker)
+{
+	return SetupFatChecker(checker, 2, 0x0ffffff8);
+}
+
 /// 残りディスクサイズを計算
 void DiskBasicTypeFAT32::CalcDiskFreeSize(bool wrote)
 {
@@ -42,13 +50,19 @@ void DiskBasicTypeFAT32::CalcDiskFreeSize(bool wrote)
 /// @param [in] val 値
 void DiskBasicTypeFAT32::SetGroupNumber(wxUint32 num, wxUint32 val)
 {
-	fat->GetDiskBasicFatArea()->SetData32LE(num, val);
+	fat->SetGroupNumber(DiskBasicFatTable::FAT_TABLE_32LE, num, val);
 }
 /// FAT位置を返す
 /// @param [in] num グループ番号(0...)
 wxUint32 DiskBasicTypeFAT32::GetGroupNumber(wxUint32 num) const
 {
-	return fat->GetDiskBasicFatArea()->GetData32LE(0, num);
+	return fat->GetGroupNumber(DiskBasicFatTable::FAT_TABLE_32LE, num);
+}
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeFAT32::DecodeFat()
+{
+	return fat->DecodeTable(DiskBasicFatTable::FAT_TABLE_32LE);
 }
 
 //
@@ -64,11 +78,17 @@ DiskBasicTypeFAT32BE::DiskBasicTypeFAT32BE(DiskBasic *basic, DiskBasicFat *fat,
 /// @param [in] val 値
 void DiskBasicTypeFAT32BE::SetGroupNumber(wxUint32 num, wxUint32 val)
 {
-	fat->GetDiskBasicFatArea()->SetData32BE(num, val);
+	fat->SetGroupNumber(DiskBasicFatTable::FAT_TABLE_32BE, num, val);
 }
 /// FAT位置を返す
 /// @param [in] num グループ番号(0...)
 wxUint32 DiskBasicTypeFAT32BE::GetGroupNumber(wxUint32 num) const
 {
-	return fat->GetDiskBasicFatArea()->GetData32BE(0, num);
+	return fat->GetGroupNumber(DiskBasicFatTable::FAT_TABLE_32BE, num);
+}
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeFAT32BE::DecodeFat()
+{
+	return fat->DecodeTable(DiskBasicFatTable::FAT_TABLE_32BE);
 }
@@ -17,12 +17,31 @@ DiskBasicTypeFATBase::DiskBasicTypeFATBase(DiskBasic *basic, DiskBasicFat *fat,
 	: DiskBasicType(basic, fat, dir)
 {
 	m_fat_type = FAT_TYPE_12; // FAT12 default
+	m_avail_start_group = 2;
+	m_avail_used_group = 0xff8;
+}
+
+/// 空きFAT位置を返す
+///
+/// 前回確保した位置の次から探す。
+/// @return INVALID_GROUP_NUMBER: 空きなし
+wxUint32 DiskBasicTypeFATBase::GetEmptyGroupNumber()
+{
+	if (!DecodeFat()) {
+		return DiskBasicType::GetEmptyGroupNumber();
+	}
+	return fat->FindEmptyGroupNumber(fat->GetNextFreeGroupNumber(), 2, basic->GetFatEndGroup());
 }
 
 /// 次の空き位置を返す
 /// @return INVALID_GROUP_NUMBER: 空きなし
 wxUint32 DiskBasicTypeFATBase::GetNextEmptyGroupNumber(wxUint32 curr_group)
 {
+	if (DecodeFat()) {
+		// 空きビットマップから探す
+		return fat->FindEmptyGroupNumber(curr_group, 2, basic->GetFatEndGroup());
+	}
+
 	wxUint32 new_num = INVALID_GROUP_NUMBER;
 
 	// グループが連続するように検索
@@ -47,7 +66,27 @@ wxUint32 DiskBasicTypeFATBase::GetNextEmptyGroupNumber(wxUint32 curr_group)
 	return new_num;
 }
 
+/// 連続した空きグループの一覧を作成
+///
+/// FATをデコードしていれば空きビットマップから作成する。
+/// @param [in]  start_group 検索開始グループ番号
+/// @param [in]  end_group   検索終了グループ番号
+/// @param [in]  step        グループ番号の間隔
+/// @param [out] runs        空き領域(グループ番号順)
+void DiskBasicTypeFATBase::GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, wxUint32 step, DiskBasicGroupRuns &runs)
+{
+	if (step != 1 || !DecodeFat()) {
+		DiskBasicType::GetEmptyGroupRuns(start_group, end_group, step, runs);
+		return;
+	}
+	if (start_group < 2) start_group = 2;
+	fat->GetEmptyGroupRuns(start_group, end_group, runs);
+}
+
 /// FATエリアの重複チェック
+///
+/// 解析時に何度も呼ばれるので先頭の一部だけ調べる。
+/// FAT全体の検査はボリュームのチェック(ScanFatChains)で行う。
 /// @param [in] is_formatting フォーマット中か
 /// @param [in] start_group 重複チェックを開始するグループ番号
 /// @param [in] max_group 重複チェックを行う最大グループ番号
@@ -80,6 +119,21 @@ double DiskBasicTypeFATBase::CheckFatDuplicated(bool is_formatting, wxUint32 sta
 	return valid_ratio;
 }
 
+/// FAT全体を走査してチェインの検査を準備する
+/// @param [out] checker     チェイン検査
+/// @param [in]  start_group 開始グループ番号
+/// @param [in]  used_group  これ以上は終端を表すグループ番号
+/// @return false FATをデコードできない
+bool DiskBasicTypeFATBase::SetupFatChecker(DiskBasicFatChecker &checker, wxUint32 start_group, wxUint32 used_group)
+{
+	if (!DecodeFat()) {
+		return false;
+	}
+	checker.Setup(&fat->GetTable(), start_group, basic->GetFatEndGroup(), basic->GetGroupUnusedCode(), used_group);
+	checker.Scan();
+	return true;
+}
+
 /// 管理エリアのトラック番号からグループ番号を計算
 wxUint32 DiskBasicTypeFATBase::CalcManagedStartGroup()
 {
@@ -102,27 +156,48 @@ void DiskBasicTypeFATBase::CalcDiskFreeSizeBase(bool wrote, wxUint32 start_group
 {
 	fat_availability.Empty();
 
+	// 差分で更新する時のために覚えておく
+	m_avail_start_group = start_group;
+	m_avail_used_group = used_group;
+
 	// システム領域
 	for(wxUint32 pos = 0; pos < start_group; pos++) {
 		fat_availability.Add(FAT_AVAIL_SYSTEM, 0, 0);
 	}
 
+	int grp_size = basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup();
+
+	// FAT全体を参照するのでデコードしておく
+	DecodeFat();
+
 	// クラスタは2から始まる(MS-DOS)
 	for(wxUint32 pos = start_group; pos <= basic->GetFatEndGroup(); pos++) {
-		int fsize = 0;
-		int grps = 0; 
 		wxUint32 gnum = GetGroupNumber(pos);
-		int fsts = FAT_AVAIL_USED;
-		if (gnum == basic->GetGroupUnusedCode()) {
-			fsize = (basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup());
-			grps  = 1;
-			fsts = FAT_AVAIL_FREE;
-		} else if (gnum >= used_group) { // 0xff8 0xfff8 0x0ffffff8
-			fsts = FAT_AVAIL_USED_LAST;
+		int fsts = GetGroupAvailability(pos, gnum);
+		if (fsts == FAT_AVAIL_FREE) {
+			fat_availability.Add(fsts, grp_size, 1);
+		} else {
+			fat_availability.Add(fsts, 0, 0);
 		}
-		fat_availability.Add(fsts, fsize, grps);
-//		myLog.SetDebug("DiskBasicTypeFATBase::CalcDiskFreeSizeBase: pos:%d gnum:%d size:%d grps:%d", pos, gnum, fsize, grps);
+//		myLog.SetDebug("DiskBasicTypeFATBase::CalcDiskFreeSizeBase: pos:%d gnum:%d fsts:%d", pos, gnum, fsts);
+	}
+}
+
+/// グループの使用状況を返す(MS-DOS用)
+/// @param [in] num  グループ番号
+/// @param [in] gnum FATの値
+/// @return 使用状況 en_fat_availability
+int DiskBasicTypeFATBase::GetGroupAvailability(wxUint32 num, wxUint32 gnum) const
+{
+	int fsts = FAT_AVAIL_USED;
+	if (num < m_avail_start_group) {
+		fsts = FAT_AVAIL_SYSTEM;
+	} else if (gnum == basic->GetGroupUnusedCode()) {
+		fsts = FAT_AVAIL_FREE;
+	} else if (gnum >= m_avail_used_group) { // 0xff8 0xfff8 0x0ffffff8
+		fsts = FAT_AVAIL_USED_LAST;
 	}
+	return fsts;
 }
 
 /// グループ番号からセクタ番号を得る(MS-DOS用)
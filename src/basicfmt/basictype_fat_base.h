@@ -29,25 +29,37 @@ public:
 
 protected:
 	enFatType m_fat_type;	// FAT12 = 0 / 16 = 1
+	wxUint32 m_avail_start_group;	///< 使用状況: 開始グループ番号
+	wxUint32 m_avail_used_group;	///< 使用状況: 使用中(最終)グループ番号
 
-	DiskBasicTypeFATBase() : DiskBasicType() {}
-	DiskBasicTypeFATBase(const DiskBasicType &src) : DiskBasicType(src) {}
+	DiskBasicTypeFATBase() : DiskBasicType() { m_avail_start_group = 2; m_avail_used_group = 0xff8; }
+	DiskBasicTypeFATBase(const DiskBasicType &src) : DiskBasicType(src) { m_avail_start_group = 2; m_avail_used_group = 0xff8; }
 public:
 	DiskBasicTypeFATBase(DiskBasic *basic, DiskBasicFat *fat, DiskBasicDir *dir);
 	virtual ~DiskBasicTypeFATBase() {}
 
 	/// @name access to FAT area
 	//@{
+	/// @brief 空きFAT位置を返す
+	virtual wxUint32 GetEmptyGroupNumber();
 	/// @brief 次の空きFAT位置を返す
 	virtual wxUint32 GetNextEmptyGroupNumber(wxUint32 curr_group);
+	/// @brief 連続した空きグループの一覧を作成
+	virtual void	GetEmptyGroupRuns(wxUint32 start_group, wxUint32 end_group, wxUint32 step, DiskBasicGroupRuns &runs);
 	/// @brief FAT種類を返す
 	virtual int GetFatType() const { return (int)m_fat_type; }
+	/// @brief FAT全体をデコードする
+	virtual bool	DecodeFat() { return false; }
 	//@}
 
 	/// @name check / assign FAT area
 	//@{
 	/// @brief FATエリアの重複チェック
 	double 			CheckFatDuplicated(bool is_formatting, wxUint32 start_group, wxUint32 max_group);
+	/// @brief FAT全体を走査してチェインの検査を準備する
+	bool			SetupFatChecker(DiskBasicFatChecker &checker, wxUint32 start_group, wxUint32 used_group);
+	/// @brief ボリュームのチェックができるか
+	virtual bool	SupportCheckVolume() const { return true; }
 	/// @brief 管理エリアのトラック番号からグループ番号を計算
 	virtual wxUint32 CalcManagedStartGroup();
 	//@}
@@ -58,12 +70,20 @@ public:
 	virtual void	GetUsableDiskSize(wxInt64 &disk_size, wxInt64 &group_size) const;
 	/// @brief 残りディスクサイズを計算
 	void			CalcDiskFreeSizeBase(bool wrote, wxUint32 start_group, wxUint32 used_group);
+	/// @brief グループの使用状況を返す
+	virtual int		GetGroupAvailability(wxUint32 num, wxUint32 gnum) const;
 	//@}
 
 	/// @name file size
 	//@{
 	//@}
 
+	/// @name delete
+	//@{
+	/// @brief デフラグできるか
+	virtual bool	SupportDefragment() const { return true; }
+	//@}
+
 	/// @name file chain
 	//@{
 	/// @brief グループ番号から開始セクタ番号を得る
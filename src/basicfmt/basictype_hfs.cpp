@@ -40,7 +40,7 @@ double DiskBasicTypeHFS::CheckFat(bool is_formatting)
 		return -1.0;
 	}
 
-	p_hfs_mdb = (hfs_mdb_t *)sector->GetSectorBuffer();
+	p_hfs_mdb = (hfs_mdb_t *)sector->GetSectorBufferForRead();
 	if (!p_hfs_mdb) {
 		return -1.0;
 	}
@@ -61,7 +61,7 @@ double DiskBasicTypeHFS::CheckFat(bool is_formatting)
 		if (!sector) {
 			return -1.0;
 		}
-		wxUint8 *buffer = sector->GetSectorBuffer();
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			return -1.0;
 		}
@@ -89,7 +89,7 @@ double DiskBasicTypeHFS::ParseParamOnDisk(bool is_formatting)
 		return -1.0;
 	}
 
-	hfs_boot_blk_hdr_t *boot = (hfs_boot_blk_hdr_t *)sector->GetSectorBuffer();
+	const hfs_boot_blk_hdr_t *boot = (const hfs_boot_blk_hdr_t *)sector->GetSectorBufferForRead();
 	if (!boot) {
 		return -1.0;
 	}
@@ -103,7 +103,7 @@ double DiskBasicTypeHFS::ParseParamOnDisk(bool is_formatting)
 		return -1.0;
 	}
 
-	p_hfs_mdb = (hfs_mdb_t *)sector->GetSectorBuffer();
+	p_hfs_mdb = (hfs_mdb_t *)sector->GetSectorBufferForRead();
 	if (!p_hfs_mdb) {
 		return -1.0;
 	}
@@ -229,7 +229,7 @@ bool DiskBasicTypeHFS::CalcGroupsOnRootDirectory(int start_sector, int end_secto
 
 //		sec_num = sector->GetSectorNumber();
 
-		wxUint8 *buffer = sector->GetSectorBuffer(); 
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			valid = false;
 			break;
@@ -261,8 +261,18 @@ double DiskBasicTypeHFS::CheckDirectory(bool is_root, const DiskBasicGroups &gro
 
 	size_t end_idx = group_items.Count();
 
-	for(size_t idx = 0; idx < end_idx; idx++) {
-		const DiskBasicGroupItem *gitem = group_items.ItemPtr(idx);
+	// 連続したグループを順にたどる
+	size_t eidx = 0;
+	size_t epos = 0;
+	DiskBasicGroupItem gitem_cur;
+	const DiskBasicGroupItem *gitem = &gitem_cur;
+	for(size_t idx = 0; idx < end_idx && eidx < group_items.GetExtentCount(); idx++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(eidx);
+		ext->GetItem(epos, gitem_cur);
+		if (++epos >= ext->Count()) {
+			eidx++;
+			epos = 0;
+		}
 //		wxUint32 grp_num = gitem->GetGroup();
 		int block_num = gitem->GetSectorStart();
 
@@ -271,20 +281,20 @@ double DiskBasicTypeHFS::CheckDirectory(bool is_root, const DiskBasicGroups &gro
 			valid = false;
 			break;
 		}
-		wxUint8 *buffer = sector->GetSectorBuffer();
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			valid = false;
 			break;
 		}
 
-		hfs_node_descriptor_t *node = (hfs_node_descriptor_t *)buffer;
+		const hfs_node_descriptor_t *node = (const hfs_node_descriptor_t *)buffer;
 		if (node->type == ndHdrNode) {
 			// ヘッダノードは常に最初
 			if (idx != 0) {
 				valid = false;
 				break;
 			}
-			hfs_bt_hdr_rec_t *header = (hfs_bt_hdr_rec_t *)&buffer[0xe];
+			const hfs_bt_hdr_rec_t *header = (const hfs_bt_hdr_rec_t *)&buffer[0xe];
 
 			end_idx = (size_t)wxUINT32_SWAP_ON_LE(header->totalNodes) - wxUINT32_SWAP_ON_LE(header->freeNodes);
 			continue;
@@ -308,7 +318,7 @@ double DiskBasicTypeHFS::CheckDirectory(bool is_root, const DiskBasicGroups &gro
 			int pos = (int)rpos;
 
 			// レコードのキー部分
-			hfs_cat_key_rec_t* rec_key = (hfs_cat_key_rec_t *)&buffer[rpos];
+			const hfs_cat_key_rec_t *rec_key = (const hfs_cat_key_rec_t *)&buffer[rpos];
 			if (rec_key->keyLength > 37) {
 				// キー長すぎる
 				continue;
@@ -320,7 +330,7 @@ double DiskBasicTypeHFS::CheckDirectory(bool is_root, const DiskBasicGroups &gro
 				rpos++;
 			}
 			// レコードのデータ部分
-			hfs_cat_data_rec_t *rec_dat = (hfs_cat_data_rec_t *)&buffer[rpos];
+			const hfs_cat_data_rec_t *rec_dat = (const hfs_cat_data_rec_t *)&buffer[rpos];
 			if(rec_dat->recType != FILETYPE_HFS_DIR && rec_dat->recType != FILETYPE_HFS_FILE) {
 				// スレッドは無視
 				continue;
@@ -387,8 +397,18 @@ bool DiskBasicTypeHFS::AssignDirectory(bool is_root, const DiskBasicGroups &grou
 
 	size_t end_idx = group_items.Count();
 
-	for(size_t idx = 0; idx < end_idx; idx++) {
-		const DiskBasicGroupItem *gitem = group_items.ItemPtr(idx);
+	// 連続したグループを順にたどる
+	size_t eidx = 0;
+	size_t epos = 0;
+	DiskBasicGroupItem gitem_cur;
+	const DiskBasicGroupItem *gitem = &gitem_cur;
+	for(size_t idx = 0; idx < end_idx && eidx < group_items.GetExtentCount(); idx++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(eidx);
+		ext->GetItem(epos, gitem_cur);
+		if (++epos >= ext->Count()) {
+			eidx++;
+			epos = 0;
+		}
 //		wxUint32 grp_num = gitem->GetGroup();
 		int block_num = gitem->GetSectorStart();
 
@@ -397,20 +417,20 @@ bool DiskBasicTypeHFS::AssignDirectory(bool is_root, const DiskBasicGroups &grou
 			valid = false;
 			break;
 		}
-		wxUint8 *buffer = sector->GetSectorBuffer();
+		const wxUint8 *buffer = sector->GetSectorBufferForRead();
 		if (!buffer) {
 			valid = false;
 			break;
 		}
 
-		hfs_node_descriptor_t *node = (hfs_node_descriptor_t *)buffer;
+		const hfs_node_descriptor_t *node = (const hfs_node_descriptor_t *)buffer;
 		if (node->type == ndHdrNode) {
 			// ヘッダノードは常に最初
 			if (idx != 0) {
 				valid = false;
 				break;
 			}
-			hfs_bt_hdr_rec_t *header = (hfs_bt_hdr_rec_t *)&buffer[0xe];
+			const hfs_bt_hdr_rec_t *header = (const hfs_bt_hdr_rec_t *)&buffer[0xe];
 
 			end_idx = (size_t)wxUINT32_SWAP_ON_LE(header->totalNodes) - wxUINT32_SWAP_ON_LE(header->freeNodes);
 			continue;
@@ -434,7 +454,7 @@ bool DiskBasicTypeHFS::AssignDirectory(bool is_root, const DiskBasicGroups &grou
 			int pos = (int)rpos;
 
 			// レコードのキー部分
-			hfs_cat_key_rec_t* rec_key = (hfs_cat_key_rec_t *)&buffer[rpos];
+			const hfs_cat_key_rec_t *rec_key = (const hfs_cat_key_rec_t *)&buffer[rpos];
 			if (rec_key->keyLength > 37) {
 				// キー長すぎる
 				continue;
@@ -452,7 +472,7 @@ bool DiskBasicTypeHFS::AssignDirectory(bool is_root, const DiskBasicGroups &grou
 				rpos++;
 			}
 			// レコードのデータ部分
-			hfs_cat_data_rec_t *rec_dat = (hfs_cat_data_rec_t *)&buffer[rpos];
+			const hfs_cat_data_rec_t *rec_dat = (const hfs_cat_data_rec_t *)&buffer[rpos];
 			if(rec_dat->recType != FILETYPE_HFS_DIR && rec_dat->recType != FILETYPE_HFS_FILE) {
 				// スレッドは無視
 				continue;
@@ -160,6 +160,8 @@ public:
 	virtual void	GetUsableDiskSize(wxInt64 &disk_size, wxInt64 &group_size) const;
 	/// @brief 残りディスクサイズを計算
 	virtual void	CalcDiskFreeSize(bool wrote);
+	/// @brief 確保や削除に合わせて使用状況を更新できるか
+	virtual bool	CanTrackAvailability() const { return false; }
 	//@}
 
 	/// @name file size
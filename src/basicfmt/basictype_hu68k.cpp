@@ -48,6 +48,19 @@ wxUint32 DiskBasicTypeHU68K::GetGroupNumber(wxUint32 num) const
 		return 0;
 	}
 }
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeHU68K::DecodeFat()
+{
+	switch (m_fat_type) {
+	case FAT_TYPE_12:
+		return DiskBasicTypeFAT12::DecodeFat();
+	case FAT_TYPE_16:
+		return DiskBasicTypeFAT16BE::DecodeFat();
+	default:
+		return false;
+	}
+}
 
 /// システムグループ番号を返す
 wxUint32 DiskBasicTypeHU68K::GetGroupSystemCode() const
@@ -94,6 +107,21 @@ double DiskBasicTypeHU68K::CheckFat(bool is_formatting)
 	}
 }
 
+/// FATを走査してチェインの検査を準備する
+/// @param [out] checker チェイン検査
+/// @return false FATをデコードできない
+bool DiskBasicTypeHU68K::ScanFatChains(DiskBasicFatChecker &checker)
+{
+	switch (m_fat_type) {
+	case FAT_TYPE_12:
+		return DiskBasicTypeFAT12::ScanFatChains(checker);
+	case FAT_TYPE_16:
+		return DiskBasicTypeFAT16BE::ScanFatChains(checker);
+	default:
+		return false;
+	}
+}
+
 /// ディスクから各パラメータを取得＆必要なパラメータを計算
 /// @param [in] is_formatting フォーマット中か
 /// @retval 1.0  正常
@@ -165,9 +193,9 @@ double DiskBasicTypeHU68K::ParseHU68KParamOnDisk(DiskImageDisk *disk, bool is_fo
 	// MS-DOS ディスク上のパラメータを読む
 	DiskImageSector *sector = disk->GetSector(0);
 	if (!sector) return -1.0;
-	wxUint8 *datas = sector->GetSectorBuffer();
+	const wxUint8 *datas = sector->GetSectorBufferForRead();
 	if (!datas) return -1.0;
-	hu68k_bpb_t *bpb = (hu68k_bpb_t *)datas;
+	const hu68k_bpb_t *bpb = (const hu68k_bpb_t *)datas;
 
 	nums++;
 	if (bpb->SecPerClus == 0) {
@@ -367,7 +395,7 @@ bool DiskBasicTypeHU68K::CreateBiosParameterBlock(const char *jmp, const char *n
 
 	sec = basic->GetSector(0);
 	if (!sec) return false;
-	wxUint8 *buf = sec->GetSectorBuffer();
+	wxUint8 *buf = sec->GetSectorBufferForWrite();
 	if (!buf) return false;
 
 	if(sec_buf) *sec_buf = buf;
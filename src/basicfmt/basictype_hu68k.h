@@ -61,6 +61,8 @@ public:
 	virtual void		SetGroupNumber(wxUint32 num, wxUint32 val);
 	/// @brief FAT位置を返す
 	virtual wxUint32	GetGroupNumber(wxUint32 num) const;
+	/// @brief FAT全体をデコードする
+	virtual bool		DecodeFat();
 	/// @brief システムグループ番号を返す
 	virtual wxUint32	GetGroupSystemCode() const;
 	//@}
@@ -69,6 +71,8 @@ public:
 	//@{
 	/// @brief FATエリアをチェック
 	virtual double 	CheckFat(bool is_formatting);
+	/// @brief FATを走査してチェインの検査を準備する
+	virtual bool	ScanFatChains(DiskBasicFatChecker &checker);
 	/// @brief ディスクから各パラメータを取得＆必要なパラメータを計算
 	virtual double	ParseParamOnDisk(bool is_formatting);
 	/// @brief ディスクからHuman68kパラメータを取得
@@ -17,6 +17,8 @@
 DiskBasicTypeMSDOS::DiskBasicTypeMSDOS(DiskBasic *basic, DiskBasicFat *fat, DiskBasicDir *dir)
 	: DiskBasicTypeFAT32(basic, fat, dir)
 {
+	m_fsinfo_sector = -1;
+	m_avail_deferred = false;
 }
 
 /// FAT位置をセット
@@ -53,6 +55,21 @@ wxUint32 DiskBasicTypeMSDOS::GetGroupNumber(wxUint32 num) const
 		return 0;
 	}
 }
+/// FAT全体をデコードする
+/// @return false デコードできない
+bool DiskBasicTypeMSDOS::DecodeFat()
+{
+	switch (m_fat_type) {
+	case FAT_TYPE_12:
+		return DiskBasicTypeFAT12::DecodeFat();
+	case FAT_TYPE_16:
+		return DiskBasicTypeFAT16::DecodeFat();
+	case FAT_TYPE_32:
+		return DiskBasicTypeFAT32::DecodeFat();
+	default:
+		return false;
+	}
+}
 
 /// システムグループ番号を返す
 wxUint32 DiskBasicTypeMSDOS::GetGroupSystemCode() const
@@ -70,8 +87,13 @@ wxUint32 DiskBasicTypeMSDOS::GetGroupSystemCode() const
 }
 
 /// 残りディスクサイズを計算
+///
+/// FAT32で読み込み時にFSInfoが有効なら、その値を使ってFATの走査を省略する。
+/// 使用状況の配列は必要になった時に作成する。
 void DiskBasicTypeMSDOS::CalcDiskFreeSize(bool wrote)
 {
+	m_avail_deferred = false;
+
 	switch (m_fat_type) {
 	case FAT_TYPE_12:
 		DiskBasicTypeFAT12::CalcDiskFreeSize(wrote);
@@ -80,13 +102,118 @@ void DiskBasicTypeMSDOS::CalcDiskFreeSize(bool wrote)
 		DiskBasicTypeFAT16::CalcDiskFreeSize(wrote);
 		break;
 	case FAT_TYPE_32:
+		if (!wrote) {
+			wxUint32 free_count = 0;
+			wxUint32 next_free = 0;
+			if (ReadFSInfo(free_count, next_free)) {
+				fat_availability.Empty();
+				fat_availability.SetFreeGroups(free_count);
+				fat_availability.SetFreeSize((wxInt64)free_count * basic->GetDisk()->GetSectorSize() * basic->GetSectorsPerGroup());
+				fat->SetNextFreeGroupNumber(next_free);
+				m_avail_deferred = true;
+				break;
+			}
+		}
 		DiskBasicTypeFAT32::CalcDiskFreeSize(wrote);
+		if (wrote) {
+			WriteFSInfo();
+		}
 		break;
 	default:
 		break;
 	}
 }
 
+/// 書き込み後に残りディスクサイズを更新
+///
+/// FAT32ならFSInfoも更新する。
+void DiskBasicTypeMSDOS::UpdateDiskFreeSize()
+{
+	DiskBasicType::UpdateDiskFreeSize();
+
+	if (m_fat_type == FAT_TYPE_32) {
+		WriteFSInfo();
+	}
+}
+
+/// FATの空き状況を配列で返す
+/// @param [out] offset オフセット
+/// @param [out] arr    空き状況を入れた配列
+void DiskBasicTypeMSDOS::GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr)
+{
+	if (m_avail_deferred) {
+		// 保留していた使用状況をここで計算
+		DiskBasicTypeFAT32::CalcDiskFreeSize(false);
+		m_avail_deferred = false;
+	}
+	DiskBasicType::GetFatAvailability(offset, arr);
+}
+
+/// FSInfoから空きクラスタ数と次の空きクラスタを読む
+/// @param [out] free_count 空きクラスタ数
+/// @param [out] next_free  次の空きクラスタ番号
+/// @return 値が有効ならtrue
+bool DiskBasicTypeMSDOS::ReadFSInfo(wxUint32 &free_count, wxUint32 &next_free)
+{
+	if (m_fsinfo_sector < 0) return false;
+
+	DiskImageSector *sector = basic->GetSector(m_fsinfo_sector);
+	if (!sector) return false;
+	const wxUint8 *datas = sector->GetSectorBufferForRead();
+	if (!datas) return false;
+	const fat32_fsinfo_t *fsi = (const fat32_fsinfo_t *)datas;
+
+	if (wxUINT32_SWAP_ON_BE(fsi->FSI_LeadSig) != FAT32_FSI_LEAD_SIG
+	 || wxUINT32_SWAP_ON_BE(fsi->FSI_StrucSig) != FAT32_FSI_STRUC_SIG
+	 || wxUINT32_SWAP_ON_BE(fsi->FSI_TrailSig) != FAT32_FSI_TRAIL_SIG) {
+		return false;
+	}
+
+	// 空きクラスタ数はクラスタ数を超えないこと
+	free_count = wxUINT32_SWAP_ON_BE(fsi->FSI_Free_Count);
+	if (free_count == FAT32_FSI_UNKNOWN || free_count > basic->GetFatEndGroup() - 1) {
+		return false;
+	}
+	// 次の空きはヒントなので範囲外なら先頭から
+	next_free = wxUINT32_SWAP_ON_BE(fsi->FSI_Nxt_Free);
+	if (next_free < 2 || next_free > basic->GetFatEndGroup()) {
+		next_free = 2;
+	}
+	return true;
+}
+
+/// FSInfoに空きクラスタ数と次の空きクラスタを書く
+void DiskBasicTypeMSDOS::WriteFSInfo()
+{
+	if (m_fsinfo_sector < 0) return;
+
+	DiskImageSector *sector = basic->GetSector(m_fsinfo_sector);
+	if (!sector) return;
+	const fat32_fsinfo_t *fsi = (const fat32_fsinfo_t *)sector->GetSectorBufferForRead();
+	if (!fsi) return;
+
+	// 署名が正しいときだけ更新する
+	if (wxUINT32_SWAP_ON_BE(fsi->FSI_LeadSig) != FAT32_FSI_LEAD_SIG
+	 || wxUINT32_SWAP_ON_BE(fsi->FSI_StrucSig) != FAT32_FSI_STRUC_SIG
+	 || wxUINT32_SWAP_ON_BE(fsi->FSI_TrailSig) != FAT32_FSI_TRAIL_SIG) {
+		return;
+	}
+
+	wxUint32 free_count = (wxUint32)fat_availability.GetFreeGroups();
+	wxUint32 next_free = fat->GetNextFreeGroupNumber();
+	if (next_free < 2 || next_free > basic->GetFatEndGroup()) {
+		next_free = FAT32_FSI_UNKNOWN;
+	}
+	if (wxUINT32_SWAP_ON_BE(fsi->FSI_Free_Count) == free_count
+	 && wxUINT32_SWAP_ON_BE(fsi->FSI_Nxt_Free) == next_free) {
+		return;
+	}
+
+	fat32_fsinfo_t *wfsi = (fat32_fsinfo_t *)sector->GetSectorBufferForWrite();
+	wfsi->FSI_Free_Count = wxUINT32_SWAP_ON_BE(free_count);
+	wfsi->FSI_Nxt_Free = wxUINT32_SWAP_ON_BE(next_free);
+}
+
 /// FATエリアをチェック
 /// @param [in] is_formatting フォーマット中か
 /// @retval 1.0       正常
@@ -106,6 +233,23 @@ double DiskBasicTypeMSDOS::CheckFat(bool is_formatting)
 	}
 }
 
+/// FATを走査してチェインの検査を準備する
+/// @param [out] checker チェイン検査
+/// @return false FATをデコードできない
+bool DiskBasicTypeMSDOS::ScanFatChains(DiskBasicFatChecker &checker)
+{
+	switch (m_fat_type) {
+	case FAT_TYPE_12:
+		return DiskBasicTypeFAT12::ScanFatChains(checker);
+	case FAT_TYPE_16:
+		return DiskBasicTypeFAT16::ScanFatChains(checker);
+	case FAT_TYPE_32:
+		return DiskBasicTypeFAT32::ScanFatChains(checker);
+	default:
+		return false;
+	}
+}
+
 /// ディスクから各パラメータを取得＆必要なパラメータを計算
 /// @param [in] is_formatting フォーマット中か
 /// @retval 1.0       正常
@@ -147,9 +291,9 @@ double DiskBasicTypeMSDOS::ParseMSDOSParamOnDisk(DiskImageDisk *disk, bool is_fo
 	// MS-DOS ディスク上のパラメータを読む
 	DiskImageSector *sector = disk->GetSector(0);
 	if (!sector) return -1.0;
-	wxUint8 *datas = sector->GetSectorBuffer();
+	const wxUint8 *datas = sector->GetSectorBufferForRead();
 	if (!datas) return -1.0;
-	fat_bpb_t *bpb = (fat_bpb_t *)datas;
+	const fat_bpb_t *bpb = (const fat_bpb_t *)datas;
 
 	nums++;
 	if (bpb->BPB_SecPerClus == 0) {
@@ -196,6 +340,7 @@ double DiskBasicTypeMSDOS::ParseMSDOSParamOnDisk(DiskImageDisk *disk, bool is_fo
 
 	// FATタイプの決定
 	m_fat_type = FAT_TYPE_12;
+	m_fsinfo_sector = -1;
 
 	wxUint32 data_sectors = sector_mag * wxUINT16_SWAP_ON_BE(bpb->BPB_TotSec16);
 	if (data_sectors == 0) {
@@ -214,13 +359,21 @@ double DiskBasicTypeMSDOS::ParseMSDOSParamOnDisk(DiskImageDisk *disk, bool is_fo
 
 	// FAT32か？
 	if (bpb->BPB_FATSz16 == 0) {
-		fat32_bs_t *fat32_bs = (fat32_bs_t *)(datas + 36);
+		const fat32_bs_t *fat32_bs = (const fat32_bs_t *)(datas + 36);
 		if (fat32_bs->BPB_FatSz32 == 0) {
 			return -1.0;
 		}
 
 		m_fat_type = FAT_TYPE_32;	// FAT32
 
+		// FSInfoのセクタ 0と0xffffはなし
+		// ディスク上のセクタが512バイト未満だとFSInfoが分割されるので使用しない
+		int fsinfo = wxUINT16_SWAP_ON_BE(fat32_bs->BPB_FSInfo);
+		if (nums == valids && fsinfo > 0 && fsinfo != 0xffff && sector_size_on_disk >= (int)sizeof(fat32_fsinfo_t)
+		 && sector_mag * fsinfo < basic->GetReservedSectors()) {
+			m_fsinfo_sector = sector_mag * fsinfo;
+		}
+
 		// FAT1つのセクタ数
 		basic->SetSectorsPerFat(sector_mag * wxUINT32_SWAP_ON_BE(fat32_bs->BPB_FatSz32));
 		// ディレクトリのエントリ数
@@ -329,6 +482,8 @@ bool DiskBasicTypeMSDOS::AssignRootDirectory(int start_sector, int end_sector, D
 			dir_item->SetStartGroup(0, val);
 		}
 		dir_item->GetAllGroups(group_items);
+		// ルートディレクトリはキャッシュに固定しておく
+		basic->PinSectors(group_items);
 		return DiskBasicType::AssignDirectory(true, group_items, dir_item);
 	} else {
 		return DiskBasicType::AssignRootDirectory(start_sector, end_sector, group_items, dir_item);
@@ -368,7 +523,7 @@ bool DiskBasicTypeMSDOS::CreateBiosParameterBlock(const char *jmp, const char *n
 	DiskImageDisk *disk = basic->GetDisk();
 	DiskImageSector *sec = basic->GetSector(0);
 	if (!sec) return false;
-	wxUint8 *buf = sec->GetSectorBuffer();
+	wxUint8 *buf = sec->GetSectorBufferForWrite();
 	if (!buf) return false;
 
 	if(sec_buf) *sec_buf = buf;
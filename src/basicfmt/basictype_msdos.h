@@ -61,8 +61,24 @@ typedef struct st_fat32_bs {
 	wxUint8  BS_BootCode[420];
 	wxUint16 BS_Sign;
 } fat32_bs_t;
+
+/// FAT32 FSInfo
+typedef struct st_fat32_fsinfo {
+	wxUint32 FSI_LeadSig;
+	wxUint8  FSI_Reserved1[480];
+	wxUint32 FSI_StrucSig;
+	wxUint32 FSI_Free_Count;
+	wxUint32 FSI_Nxt_Free;
+	wxUint8  FSI_Reserved2[12];
+	wxUint32 FSI_TrailSig;
+} fat32_fsinfo_t;
 #pragma pack()
 
+#define FAT32_FSI_LEAD_SIG	0x41615252
+#define FAT32_FSI_STRUC_SIG	0x61417272
+#define FAT32_FSI_TRAIL_SIG	0xaa550000
+#define FAT32_FSI_UNKNOWN	0xffffffff
+
 
 /** @class DiskBasicTypeMSDOS
 
@@ -76,12 +92,20 @@ DiskBasicParam 固有のパラメータ
 class DiskBasicTypeMSDOS : public DiskBasicTypeFAT32
 {
 protected:
-	DiskBasicTypeMSDOS() : DiskBasicTypeFAT32() {}
-	DiskBasicTypeMSDOS(const DiskBasicType &src) : DiskBasicTypeFAT32(src) {}
+	int  m_fsinfo_sector;	///< FSInfoのセクタ番号 -1:なし
+	bool m_avail_deferred;	///< 使用状況の計算を保留しているか
+
+	DiskBasicTypeMSDOS() : DiskBasicTypeFAT32() { m_fsinfo_sector = -1; m_avail_deferred = false; }
+	DiskBasicTypeMSDOS(const DiskBasicType &src) : DiskBasicTypeFAT32(src) { m_fsinfo_sector = -1; m_avail_deferred = false; }
 
 	/// ボリュームラベルを更新 なければ作成
 	bool			ModifyOrMakeVolumeLabel(const wxString &filename);
 
+	/// FSInfoから空きクラスタ数と次の空きクラスタを読む
+	bool			ReadFSInfo(wxUint32 &free_count, wxUint32 &next_free);
+	/// FSInfoに空きクラスタ数と次の空きクラスタを書く
+	void			WriteFSInfo();
+
 public:
 	DiskBasicTypeMSDOS(DiskBasic *basic, DiskBasicFat *fat, DiskBasicDir *dir);
 
@@ -91,6 +115,8 @@ public:
 	virtual void		SetGroupNumber(wxUint32 num, wxUint32 val);
 	/// @brief FAT位置を返す
 	virtual wxUint32	GetGroupNumber(wxUint32 num) const;
+	/// @brief FAT全体をデコードする
+	virtual bool		DecodeFat();
 	/// @brief システムグループ番号を返す
 	virtual wxUint32	GetGroupSystemCode() const;
 	//@}
@@ -99,6 +125,8 @@ public:
 	//@{
 	/// @brief FATエリアをチェック
 	virtual double 	CheckFat(bool is_formatting);
+	/// @brief FATを走査してチェインの検査を準備する
+	virtual bool	ScanFatChains(DiskBasicFatChecker &checker);
 	/// @brief ディスクから各パラメータを取得＆必要なパラメータを計算
 	virtual double	ParseParamOnDisk(bool is_formatting);
 	/// @brief ディスクからMSDOSパラメータを取得
@@ -117,6 +145,10 @@ public:
 	//@{
 	/// @brief 残りディスクサイズを計算
 	virtual void	CalcDiskFreeSize(bool wrote);
+	/// @brief 書き込み後に残りディスクサイズを更新
+	virtual void	UpdateDiskFreeSize();
+	/// @brief FATの空き状況を配列で返す
+	virtual void	GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr);
 	//@}
 
 	/// @name directory
@@ -129,7 +129,7 @@ wxUint32 OS9AllocMap::FindEmpty() const
 	wxUint32 bytes = 0;
 	wxUint32 lsn = 0;
 	for(size_t map_idx = 0; map_idx < Count() && bytes < map_bytes && match_lsn == INVALID_GROUP_NUMBER; map_idx++) {
-		wxUint8 *buf = Item(map_idx).GetBuffer();
+		const wxUint8 *buf = Item(map_idx).GetBuffer();
 		int size = (int)Item(map_idx).GetSize();
 
 		for(int pos = 0; pos < size && lsn <= end_lsn && bytes < map_bytes && match_lsn == INVALID_GROUP_NUMBER; pos++) {
@@ -189,7 +189,7 @@ double DiskBasicTypeOS9::ParseParamOnDisk(bool is_formatting)
 	if (!sector) {
 		return -1.0;
 	}
-	os9_ident = (os9_ident_t *)sector->GetSectorBuffer(div_num * sector_size_on_prm);
+	os9_ident = (os9_ident_t *)sector->GetSectorBufferForRead(div_num * sector_size_on_prm);
 	if (!os9_ident) {
 		return -1.0;
 	}
@@ -215,7 +215,7 @@ double DiskBasicTypeOS9::ParseParamOnDisk(bool is_formatting)
 				break;
 			}
 			// 各セクタの先頭がTotal Sizeと同じになるか
-			os9_lsn_t *tot = (os9_lsn_t *)sector->GetSectorBuffer();
+			const os9_lsn_t *tot = (const os9_lsn_t *)sector->GetSectorBufferForRead();
 			if (total_groups == GET_OS9_LSN((*tot))) {
 				// このセクタが本来のIdent
 				match = true;
@@ -223,7 +223,7 @@ double DiskBasicTypeOS9::ParseParamOnDisk(bool is_formatting)
 			}
 		}
 		if (match) {
-			os9_ident = (os9_ident_t *)sector->GetSectorBuffer();
+			os9_ident = (os9_ident_t *)sector->GetSectorBufferForRead();
 			basic->SetManagedSectorNumber(managed_sector_pos);
 		} else {
 			return -1.0;
@@ -272,7 +272,7 @@ double DiskBasicTypeOS9::ParseParamOnDisk(bool is_formatting)
 	if (!sector) {
 		return -1.0;
 	}
-	directory_os9_fd_t *fdd = (directory_os9_fd_t *)sector->GetSectorBuffer();
+	const directory_os9_fd_t *fdd = (const directory_os9_fd_t *)sector->GetSectorBufferForRead();
 
 	for(int i = 0; i < 48; i++) {
 		wxUint32 start_lsn = GET_OS9_LSN(fdd->FD_SEG[i].LSN);
@@ -381,7 +381,7 @@ bool DiskBasicTypeOS9::CalcGroupsOnRootDirectory(int start_sector, int end_secto
 	if (!sector) {
 		return false;
 	}
-	directory_os9_fd_t *fdd = (directory_os9_fd_t *)sector->GetSectorBuffer();
+	const directory_os9_fd_t *fdd = (const directory_os9_fd_t *)sector->GetSectorBufferForRead();
 	if (!fdd) {
 		return false;
 	}
@@ -422,9 +422,17 @@ bool DiskBasicTypeOS9::IsEmptyDirectory(bool is_root, const DiskBasicGroups &gro
 	int index_number = 0;
 //	DiskBasicDirItem *nitem = dir->NewItem(0, 0, NULL);
 	DiskBasicDirItem *nitem = dir->NewItem(0, 0);
-	for(size_t idx = 0; idx < group_items.Count(); idx++) {
-		const DiskBasicGroupItem *gitem = group_items.ItemPtr(idx);
-		for(int sec_pos = gitem->GetSectorStart(); sec_pos <= gitem->GetSectorEnd() && valid && !last; sec_pos++) {
+	DiskBasicGroupItem gitem_cur;
+	const DiskBasicGroupItem *gitem = &gitem_cur;
+	for(size_t eidx = 0; eidx < group_items.GetExtentCount(); eidx++) {
+		// 連続したグループ内のセクタを順にたどる
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(eidx);
+		size_t gpos = 0;
+		ext->GetItem(gpos, gitem_cur);
+		for(int sec_pos = ext->GetSectorStart(); sec_pos <= ext->GetSectorEnd() && valid && !last; sec_pos++) {
+			if (sec_pos > gitem->GetSectorEnd()) {
+				ext->GetItem(++gpos, gitem_cur);
+			}
 			DiskImageSector *sector = basic->GetSector(sec_pos);
 			if (!sector) {
 				valid = false;
@@ -448,7 +456,7 @@ bool DiskBasicTypeOS9::IsEmptyDirectory(bool is_root, const DiskBasicGroups &gro
 				int fd_sector_pos = GetStartSectorFromGroup(start_nsl);
 				DiskImageSector *fd_sector = basic->GetSector(fd_sector_pos);
 				if (fd_sector) {
-					directory_os9_fd_t *fd_buf = (directory_os9_fd_t *)fd_sector->GetSectorBuffer();
+					const directory_os9_fd_t *fd_buf = (const directory_os9_fd_t *)fd_sector->GetSectorBufferForRead();
 					if (fd_buf) {
 						DiskBasicDirItemOS9FD *fd = &((DiskBasicDirItemOS9 *)nitem)->GetFD();
 						fd->Set(basic, fd_sector_pos, start_nsl);
@@ -556,6 +564,14 @@ wxUint32 DiskBasicTypeOS9::GetNextEmptyGroupNumber(wxUint32 curr_group)
 	return INVALID_GROUP_NUMBER;
 }
 
+/// 確保できる空きグループか
+/// @param [in] num LSN
+/// @return true 空いている
+bool DiskBasicTypeOS9::IsEmptyGroupNumber(wxUint32 num)
+{
+	return !alloc_map.IsUsedLSN(num);
+}
+
 /// ファイルをセーブする前の準備を行う
 /// @param [in]     istream   ストリームバッファ
 /// @param [in,out] file_size 出力サイズ
@@ -574,7 +590,7 @@ bool DiskBasicTypeOS9::PrepareToSaveFile(wxInputStream &istream, int &file_size,
 	if (!sector) {
 		return false;
 	}
-	wxUint8 *buf = sector->GetSectorBuffer();
+	wxUint8 *buf = (wxUint8 *)sector->GetSectorBufferForRead();
 	if (!buf) {
 		return false;
 	}
@@ -626,6 +642,21 @@ int DiskBasicTypeOS9::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *ite
 	// 新規作成でDD_BITが2以上のとき
 	bool is_first_lsn = (flags == ALLOCATE_GROUPS_NEW && basic->GetGroupWidth() > 1);
 
+	// 連続した空きグループを優先して確保する
+	wxArrayInt plan;
+	size_t plan_pos = 0;
+	int bytes_per_group = sector_size * basic->GetGroupWidth();
+	if (basic->IsContiguousAllocation() && bytes_per_group > 0) {
+		int need_size = data_size - file_size;
+		if (is_first_lsn) need_size -= (sector_size * (basic->GetGroupWidth() - 1));
+		if (need_size > 0) {
+			// 追加のときは最後のセグメントの次から
+			wxUint32 prefer_lsn = INVALID_GROUP_NUMBER;
+			if (seg_idx >= 0) prefer_lsn = fd->GetLSN(seg_idx) + fd->GetSIZ(seg_idx);
+			PlanContiguousGroups(0, basic->GetFatEndGroup(), (wxUint32)basic->GetGroupWidth(), (need_size + bytes_per_group - 1) / bytes_per_group, prefer_lsn, plan);
+		}
+	}
+
 	// データ用のセクタを確保する
 	int rc = 0;
 	wxUint32 lsn = 0;
@@ -639,6 +670,8 @@ int DiskBasicTypeOS9::AllocateUnitGroups(int fileunit_num, DiskBasicDirItem *ite
 			lsn = fd->GetMyLSN() + 1;
 			start++;
 			is_first_lsn = false;
+		} else if (plan_pos < plan.Count()) {
+			lsn = (wxUint32)plan.Item(plan_pos++);
 		} else {
 			lsn = GetEmptyGroupNumber();
 		}
@@ -834,7 +867,7 @@ bool DiskBasicTypeOS9::AdditionalProcessOnFormatted(const DiskBasicIdentifiedDat
 	// Ident
 	DiskImageSector *sector = basic->GetSector(basic->GetManagedSectorNumber());
 	if (!sector) return false;
-	os9_ident = (os9_ident_t *)sector->GetSectorBuffer();
+	os9_ident = (os9_ident_t *)sector->GetSectorBufferForWrite();
 	if (!os9_ident) return false;
 
 	DiskImageDisk *disk = basic->GetDisk();
@@ -1015,5 +1048,7 @@ void DiskBasicTypeOS9::SetIdentifiedData(const DiskBasicIdentifiedData &data)
 	if (fmt->HasVolumeName()) {
 		wxCharBuffer vol = data.GetVolumeName().To8BitData();
 		DiskBasicDirItemOS9::EncodeString(os9_ident->DD_NAM, sizeof(os9_ident->DD_NAM), vol, vol.length());
+		DiskImageSector *sector = basic->GetSector(basic->GetManagedSectorNumber());
+		if (sector) sector->SetModify();
 	}
 }
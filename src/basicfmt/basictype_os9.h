@@ -100,6 +100,8 @@ public:
 	virtual wxUint32 GetEmptyGroupNumber();
 	/// @brief 次の空きFAT位置を返す 未使用
 	virtual wxUint32 GetNextEmptyGroupNumber(wxUint32 curr_group);
+	/// @brief 確保できる空きグループか
+	virtual bool	IsEmptyGroupNumber(wxUint32 num);
 	//@}
 
 	/// @name check / assign FAT area
@@ -134,6 +136,8 @@ public:
 	virtual void	GetUsableDiskSize(wxInt64 &disk_size, wxInt64 &group_size) const;
 	/// @brief 残りディスクサイズを計算
 	virtual void	CalcDiskFreeSize(bool wrote);
+	/// @brief 確保や削除に合わせて使用状況を更新できるか
+	virtual bool	CanTrackAvailability() const { return false; }
 	//@}
 
 	/// @name file size
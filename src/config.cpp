@@ -109,6 +109,12 @@ Params::Params()
 	mTextEditor.Empty();
 	mCacheLimitSize = CACHE_LIMIT_SIZE;
 	mCacheShrinkSize = CACHE_SHRINK_SIZE;
+	mMemoryMappedFile = false;
+	mCacheWriteBack = false;
+	mCacheHighWater = 50;
+	mReadAheadBlocks = 4;
+	mCacheStatsInterval = 0;
+	mIndexFile = false;
 	mLanguage.Empty();
 	mLPanelWidth = mWindowWidth * 20 / 100;	// 20%
 	mTrkPanelWidth = mWindowWidth * 23 / 100;	// 23%
@@ -266,6 +272,24 @@ void Config::Load()
 	ini->Read(wxT("CacheShrinkSize"), &mCacheShrinkSize);
 	// セクタキャッシュのサイズを調整
 	CalcCacheSize(mCacheLimitSize, mCacheShrinkSize);
+	// ディスクイメージをメモリにマップしてアクセスするか
+	ini->Read(wxT("UseMemoryMappedFile"), &mMemoryMappedFile);
+	// 変更したデータをバックグラウンドで書き込むか
+	ini->Read(wxT("UseCacheWriteBack"), &mCacheWriteBack);
+	// バックグラウンドで書き込みを始めるキャッシュ使用率
+	ini->Read(wxT("CacheHighWater"), &mCacheHighWater);
+	if (mCacheHighWater < 5) mCacheHighWater = 5;
+	else if (mCacheHighWater > 95) mCacheHighWater = 95;
+	// 先読みするセクタブロック数
+	ini->Read(wxT("ReadAheadBlocks"), &mReadAheadBlocks);
+	if (mReadAheadBlocks < 0) mReadAheadBlocks = 0;
+	else if (mReadAheadBlocks > 64) mReadAheadBlocks = 64;
+	// キャッシュの統計情報をログに出力する間隔
+	ini->Read(wxT("CacheStatsInterval"), &mCacheStatsInterval);
+	if (mCacheStatsInterval < 0) mCacheStatsInterval = 0;
+	else if (mCacheStatsInterval > 3600) mCacheStatsInterval = 3600;
+	// 解析結果をインデックスファイルに保存するか
+	ini->Read(wxT("UseIndexFile"), &mIndexFile);
 	// 言語
 	ini->Read(wxT("Language"), &mLanguage);
 	// ファイルリストのカラム
@@ -343,6 +367,18 @@ void Config::Save()
 	ini->Write(wxT("CacheLimitSize"), mCacheLimitSize);
 	// セクタキャッシュの縮小サイズ
 	ini->Write(wxT("CacheShrinkSize"), mCacheShrinkSize);
+	// ディスクイメージをメモリにマップしてアクセスするか
+	ini->Write(wxT("UseMemoryMappedFile"), mMemoryMappedFile);
+	// 変更したデータをバックグラウンドで書き込むか
+	ini->Write(wxT("UseCacheWriteBack"), mCacheWriteBack);
+	// バックグラウンドで書き込みを始めるキャッシュ使用率
+	ini->Write(wxT("CacheHighWater"), mCacheHighWater);
+	// 先読みするセクタブロック数
+	ini->Write(wxT("ReadAheadBlocks"), mReadAheadBlocks);
+	// キャッシュの統計情報をログに出力する間隔
+	ini->Write(wxT("CacheStatsInterval"), mCacheStatsInterval);
+	// 解析結果をインデックスファイルに保存するか
+	ini->Write(wxT("UseIndexFile"), mIndexFile);
 	// 言語
 	ini->Write(wxT("Language"), mLanguage);
 	// ファイルリストのカラム
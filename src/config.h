@@ -81,6 +81,12 @@ protected:
 	wxString	mTextEditor;		///< テキストエディタのパス
 	int			mCacheLimitSize;	///< セクタキャッシュの限界サイズ(MB)
 	int			mCacheShrinkSize;	///< セクタキャッシュの縮小サイズ(MB)
+	bool		mMemoryMappedFile;	///< ディスクイメージをメモリにマップしてアクセスするか
+	bool		mCacheWriteBack;	///< 変更したデータをバックグラウンドで書き込むか
+	int			mCacheHighWater;	///< バックグラウンドで書き込みを始めるキャッシュ使用率(%)
+	int			mReadAheadBlocks;	///< 先読みするセクタブロック数(0で先読みしない)
+	int			mCacheStatsInterval;	///< キャッシュの統計情報をログに出力する間隔(秒 0で出力しない)
+	bool		mIndexFile;			///< 解析結果をインデックスファイルに保存するか
 	wxString	mLanguage;			///< 言語
 	FileColumnParams mFileColumn;	///< ファイルリストの各カラムの設定
 	int			mLPanelWidth;		///< 左パネル（ツリー）の幅
@@ -142,6 +148,18 @@ public:
 	int				GetCacheLimitSize() const { return mCacheLimitSize; }
 	void			SetCacheShrinkSize(int val) { mCacheShrinkSize = val; }
 	int				GetCacheShrinkSize() const { return mCacheShrinkSize; }
+	void			UseMemoryMappedFile(bool val) { mMemoryMappedFile = val; }
+	bool			DoesUseMemoryMappedFile() const { return mMemoryMappedFile; }
+	void			UseCacheWriteBack(bool val) { mCacheWriteBack = val; }
+	bool			DoesUseCacheWriteBack() const { return mCacheWriteBack; }
+	void			SetCacheHighWater(int val) { mCacheHighWater = val; }
+	int				GetCacheHighWater() const { return mCacheHighWater; }
+	void			SetReadAheadBlocks(int val) { mReadAheadBlocks = val; }
+	int				GetReadAheadBlocks() const { return mReadAheadBlocks; }
+	void			SetCacheStatsInterval(int val) { mCacheStatsInterval = val; }
+	int				GetCacheStatsInterval() const { return mCacheStatsInterval; }
+	void			UseIndexFile(bool val) { mIndexFile = val; }
+	bool			DoesUseIndexFile() const { return mIndexFile; }
 	void			SetLanguage(const wxString &val) { mLanguage = val; }
 	const wxString &GetLanguage() const { return mLanguage; }
 	FileColumnParams *GetFileColumnParams() { return &mFileColumn; }
@@ -7,11 +7,13 @@
 
 #include "diskimage.h"
 #include <wx/wfstream.h>
+#include <wx/fileconf.h>
 #include <wx/xml/xml.h>
 #include "diskparser.h"
 #include "diskwriter.h"
 #include "../basicfmt/basicparam.h"
 #include "../basicfmt/basicfmt.h"
+#include "../utils.h"
 
 
 // ----------------------------------------------------------------------
@@ -138,6 +140,84 @@ int DiskImageDisk::GetSectorSize() const
 	return parent ? parent->GetSectorSize() : 0;
 }
 
+/// 連続したセクタを返す
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[out] sectors   セクタ
+/// @return 得られたセクタ数
+int DiskImageDisk::GetSectors(int block_num, int count, DiskImageSectors &sectors)
+{
+	int num = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(block_num + num);
+		if (!sector) break;
+		sectors.Add(sector);
+	}
+	return num;
+}
+
+/// 連続したセクタのデータをバッファに読み込む
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[out] buffer    バッファ
+/// @param[in]  size      バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskImageDisk::ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size)
+{
+	int num = 0;
+	size_t pos = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(block_num + num);
+		if (!sector) break;
+		size_t len = (size_t)sector->GetSectorSize();
+		const wxUint8 *buf = sector->GetSectorBufferForRead();
+		if (!buf || len == 0 || pos + len > size) break;
+		memcpy(&buffer[pos], buf, len);
+		pos += len;
+	}
+	return num;
+}
+
+/// 連続したセクタにバッファのデータを書き込む
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[in]  buffer    バッファ
+/// @param[in]  size      バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskImageDisk::WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size)
+{
+	int num = 0;
+	size_t pos = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(block_num + num);
+		if (!sector) break;
+		size_t len = (size_t)sector->GetSectorSize();
+		if (len == 0 || pos + len > size) break;
+		wxUint8 *buf = sector->GetSectorBufferForWrite();
+		if (!buf) break;
+		memcpy(buf, &buffer[pos], len);
+		pos += len;
+	}
+	return num;
+}
+
+/// 連続したセクタがすべてディスクのセクタサイズと同じか
+///
+/// ReadSectors() / WriteSectors() は各セクタの実際のサイズで詰めるので、
+/// 異なるものがあるとディスクのセクタサイズで位置を計算できない。
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @return true:すべて同じ
+bool DiskImageDisk::IsUniformSectorSize(int block_num, int count)
+{
+	int sector_size = GetSectorSize();
+	for(int num = 0; num < count; num++) {
+		DiskImageSector *sector = GetSector(block_num + num);
+		if (sector && sector->GetSectorSize() != sector_size) return false;
+	}
+	return true;
+}
+
 /// BASIC種類を設定
 void DiskImageDisk::AddBasicType(const wxString &name)
 {
@@ -171,6 +251,215 @@ bool DiskImageDisk::GetNumberFromBlockNum(int block_num, int &track_num, int &si
 	return false;
 }
 
+// ----------------------------------------------------------------------
+//
+//
+//
+DiskImageCacheStats::DiskImageCacheStats()
+{
+	Clear();
+}
+/// クリア
+void DiskImageCacheStats::Clear()
+{
+	m_lookups = 0;
+	m_hits = 0;
+	m_misses = 0;
+	m_evictions = 0;
+	m_dirty_evictions = 0;
+	m_read_bytes = 0;
+	m_written_bytes = 0;
+	m_flushes = 0;
+	m_flush_time = 0;
+	m_cached_count = 0;
+	m_limit_count = 0;
+}
+/// ヒット率(%)
+int DiskImageCacheStats::GetHitRate() const
+{
+	if (m_lookups == 0) return 0;
+	return (int)(m_hits * 100 / m_lookups);
+}
+/// メッセージにする
+/// @param[out] msgs メッセージ
+void DiskImageCacheStats::GetMessages(wxArrayString &msgs) const
+{
+	wxString fmt = wxT("%") wxLongLongFmtSpec wxT("u");
+	msgs.Add(wxString::Format(wxT("Cache blocks: %d/%d"), (int)m_cached_count, (int)m_limit_count));
+	msgs.Add(wxString::Format(wxT("Cache lookups: ") + fmt + wxT(" hits: ") + fmt + wxT(" (%d%%) misses: ") + fmt
+		, m_lookups, m_hits, GetHitRate(), m_misses));
+	msgs.Add(wxString::Format(wxT("Cache evictions: ") + fmt + wxT(" dirty: ") + fmt
+		, m_evictions, m_dirty_evictions));
+	msgs.Add(wxString::Format(wxT("Cache read: ") + fmt + wxT(" bytes written: ") + fmt + wxT(" bytes")
+		, m_read_bytes, m_written_bytes));
+	msgs.Add(wxString::Format(wxT("Cache flushes: ") + fmt + wxT(" time: ") + fmt + wxT(" ms")
+		, m_flushes, m_flush_time));
+}
+
+// ----------------------------------------------------------------------
+//
+//
+//
+/// CRC32を計算するサンプルのサイズ
+#define INDEX_SAMPLE_SIZE	65536
+
+DiskImageIndex::DiskImageIndex()
+{
+}
+
+DiskImageIndex::~DiskImageIndex()
+{
+}
+
+/// インデックスファイルのパス
+/// @param [in] image_path ディスクイメージのパス
+wxString DiskImageIndex::MakePath(const wxString &image_path)
+{
+	return image_path + wxT(".dfidx");
+}
+
+/// イメージの状態を表す文字列を作成
+///
+/// ファイルサイズ、更新日時と、先頭・中央・末尾それぞれ64KBのCRC32からなる。
+/// @param [in]  image_path ディスクイメージのパス
+/// @param [out] stamp      状態を表す文字列
+/// @return false:ファイルを読めない
+bool DiskImageIndex::MakeStamp(const wxString &image_path, wxString &stamp)
+{
+	wxFileName fn(image_path);
+	wxULongLong size = fn.GetSize();
+	if (size == wxInvalidSize) return false;
+	wxDateTime mtime = fn.GetModificationTime();
+	if (!mtime.IsValid()) return false;
+
+	wxFileInputStream fstream(image_path);
+	if (!fstream.IsOk()) return false;
+
+	// 先頭、中央、末尾を読む 小さいファイルは重なる部分を読まない
+	wxFileOffset total = (wxFileOffset)size.GetValue();
+	wxFileOffset offsets[3];
+	offsets[0] = 0;
+	offsets[1] = (total / 2) & ~(wxFileOffset)(INDEX_SAMPLE_SIZE - 1);
+	offsets[2] = total - INDEX_SAMPLE_SIZE;
+
+	wxUint8 *buffer = new wxUint8[INDEX_SAMPLE_SIZE * 3];
+	int len = 0;
+	for(int i=0; i<3; i++) {
+		if (i > 0 && offsets[i] < offsets[i - 1] + INDEX_SAMPLE_SIZE) {
+			offsets[i] = offsets[i - 1] + INDEX_SAMPLE_SIZE;
+		}
+		if (offsets[i] >= total) break;
+		fstream.SeekI(offsets[i]);
+		fstream.Read(&buffer[len], INDEX_SAMPLE_SIZE);
+		len += (int)fstream.LastRead();
+	}
+	wxUint32 crc = Utils::CRC32(buffer, len);
+	delete [] buffer;
+
+	stamp = size.ToString();
+	stamp += wxT(",");
+	stamp += mtime.GetValue().ToString();
+	stamp += wxString::Format(wxT(",%08x"), crc);
+
+	return true;
+}
+
+/// ディスク、サイドを表すキーを作成
+///
+/// パーティションの位置が変わったら別のディスクとみなす。
+/// @param [in] disk ディスク
+/// @param [in] side サイド番号 両面なら -1
+wxString DiskImageIndex::MakeKey(const DiskImageDisk *disk, int side)
+{
+	return wxString::Format(wxT("Disk%d_%u_%u_Side%d")
+		, disk->GetNumber(), disk->GetStartSectorNumber(), disk->GetNumberOfSectors(), side);
+}
+
+/// インデックスファイルを読み込む
+///
+/// 読み込んだファイルは削除する。閉じるまでに書き込みがあっても古い内容は残らない。
+/// @param [in] image_path ディスクイメージのパス
+/// @return false:ファイルがないかイメージが変更されている
+bool DiskImageIndex::Load(const wxString &image_path)
+{
+	Clear();
+
+	wxString path = MakePath(image_path);
+	if (!wxFileName::FileExists(path)) return false;
+
+	bool valid = false;
+	{
+		wxFileInputStream fstream(path);
+		if (fstream.IsOk()) {
+			wxFileConfig ini(fstream);
+			wxString stamp, cur_stamp;
+			ini.Read(wxT("/Image/Stamp"), &stamp);
+			valid = (!stamp.IsEmpty() && MakeStamp(image_path, cur_stamp) && stamp == cur_stamp);
+			if (valid) {
+				ini.SetPath(wxT("/BasicTypes"));
+				wxString key;
+				long idx;
+				bool cont = ini.GetFirstEntry(key, idx);
+				while(cont) {
+					m_types[key] = ini.Read(key);
+					cont = ini.GetNextEntry(key, idx);
+				}
+			}
+		}
+	}
+	wxRemoveFile(path);
+
+	return valid;
+}
+
+/// インデックスファイルに保存
+/// @param [in] image_path ディスクイメージのパス
+/// @return false:保存しなかった
+bool DiskImageIndex::Save(const wxString &image_path) const
+{
+	if (m_types.empty()) return false;
+
+	wxString stamp;
+	if (!MakeStamp(image_path, stamp)) return false;
+
+	wxFileConfig ini(wxEmptyString, wxEmptyString, wxEmptyString, wxEmptyString, 0);
+	ini.Write(wxT("/Image/Stamp"), stamp);
+	DiskImageIndexTypes::const_iterator it;
+	for(it = m_types.begin(); it != m_types.end(); it++) {
+		ini.Write(wxT("/BasicTypes/") + it->first, it->second);
+	}
+
+	wxFileOutputStream fstream(MakePath(image_path));
+	if (!fstream.IsOk()) return false;
+	return ini.Save(fstream);
+}
+
+/// クリア
+void DiskImageIndex::Clear()
+{
+	m_types.clear();
+}
+
+/// 決定したBASIC種類を返す
+/// @param [in] disk ディスク
+/// @param [in] side サイド番号 両面なら -1
+/// @return BASIC種類名 わからない時は空文字
+wxString DiskImageIndex::GetBasicType(const DiskImageDisk *disk, int side) const
+{
+	DiskImageIndexTypes::const_iterator it = m_types.find(MakeKey(disk, side));
+	if (it == m_types.end()) return wxEmptyString;
+	return it->second;
+}
+
+/// 決定したBASIC種類を設定
+/// @param [in] disk ディスク
+/// @param [in] side サイド番号 両面なら -1
+/// @param [in] name BASIC種類名
+void DiskImageIndex::SetBasicType(const DiskImageDisk *disk, int side, const wxString &name)
+{
+	m_types[MakeKey(disk, side)] = name;
+}
+
 // ----------------------------------------------------------------------
 //
 //
@@ -178,15 +467,20 @@ bool DiskImageDisk::GetNumberFromBlockNum(int block_num, int &track_num, int &si
 DiskImageFile::DiskImageFile()
 	: DiskParam()
 {
+	p_index = NULL;
+	m_raw_modify_count = 0;
 }
 
 DiskImageFile::DiskImageFile(const DiskParam &disk_param)
 	: DiskParam(disk_param)
 {
+	p_index = NULL;
+	m_raw_modify_count = 0;
 }
 
 DiskImageFile::~DiskImageFile()
 {
+	delete p_index;
 }
 
 size_t DiskImageFile::Add(DiskImageDisk *newdsk, short mod_flags)
@@ -226,6 +520,75 @@ wxString DiskImageFile::GetFilePath() const
 	return m_filename.GetFullPath();
 }
 
+/// 解析結果のインデックスを設定
+/// @param[in] val インデックス 以後このクラスで削除する
+void DiskImageFile::SetIndex(DiskImageIndex *val)
+{
+	if (p_index != val) delete p_index;
+	p_index = val;
+}
+
+/// 連続したセクタを返す
+/// @param[in]  sector_pos 開始セクタ位置
+/// @param[in]  count      セクタ数
+/// @param[out] sectors    セクタ
+/// @return 得られたセクタ数
+int DiskImageFile::GetSectors(int sector_pos, int count, DiskImageSectors &sectors)
+{
+	int num = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(sector_pos + num);
+		if (!sector) break;
+		sectors.Add(sector);
+	}
+	return num;
+}
+
+/// 連続したセクタのデータをバッファに読み込む
+/// @param[in]  sector_pos 開始セクタ位置
+/// @param[in]  count      セクタ数
+/// @param[out] buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskImageFile::ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size)
+{
+	int num = 0;
+	size_t pos = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(sector_pos + num);
+		if (!sector) break;
+		size_t len = (size_t)sector->GetSectorSize();
+		const wxUint8 *buf = sector->GetSectorBufferForRead();
+		if (!buf || len == 0 || pos + len > size) break;
+		memcpy(&buffer[pos], buf, len);
+		pos += len;
+	}
+	return num;
+}
+
+/// 連続したセクタにバッファのデータを書き込む
+/// @param[in]  sector_pos 開始セクタ位置
+/// @param[in]  count      セクタ数
+/// @param[in]  buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskImageFile::WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size)
+{
+	int num = 0;
+	size_t pos = 0;
+	for(; num < count; num++) {
+		DiskImageSector *sector = GetSector(sector_pos + num);
+		if (!sector) break;
+		size_t len = (size_t)sector->GetSectorSize();
+		if (len == 0 || pos + len > size) break;
+		wxUint8 *buf = sector->GetSectorBufferForWrite();
+		if (!buf) break;
+		memcpy(buf, &buffer[pos], len);
+		pos += len;
+	}
+	return num;
+}
+
 /// ファイル名を設定
 void DiskImageFile::SetFileName(const wxString &path)
 {
@@ -579,6 +942,15 @@ void DiskImage::GetStatusMessage(wxString &str) const
 	p_file->GetStatusMessage(str);
 }
 
+/// キャッシュの統計情報
+/// @param[out] stats 統計情報
+/// @return false:キャッシュを使用していない
+bool DiskImage::GetCacheStats(DiskImageCacheStats &stats) const
+{
+	if (!p_file) return false;
+	return p_file->GetCacheStats(stats);
+}
+
 /// エラーメッセージ
 const wxArrayString &DiskImage::GetErrorMessage(int maxrow)
 {
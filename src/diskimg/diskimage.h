@@ -104,9 +104,15 @@ public:
 	virtual wxUint8 *GetSectorBuffer() { return NULL; }
 	/// セクタデータへのポインタを返す
 	virtual wxUint8 *GetSectorBuffer(int offset) { return NULL; }
+	/// 読み込み用にセクタデータへのポインタを返す
+	virtual const wxUint8 *GetSectorBufferForRead(int offset = 0) { return GetSectorBuffer(offset); }
+	/// 書き込み用にセクタデータへのポインタを返す(変更済みにする)
+	virtual wxUint8 *GetSectorBufferForWrite(int offset = 0) { SetModify(); return GetSectorBuffer(offset); }
 
 	/// 変更されているか
 	virtual bool	IsModified() const { return false; }
+	/// 変更済みにする
+	virtual void	SetModify() {}
 	/// 変更済みをクリア
 	virtual void	ClearModify() {}
 
@@ -129,6 +135,8 @@ public:
 	virtual void DecRefs() {}
 };
 
+WX_DEFINE_ARRAY(DiskImageSector *, DiskImageSectors);
+
 // ----------------------------------------------------------------------
 
 /// １ディスクのヘッダを渡すクラス
@@ -194,6 +202,22 @@ public:
 	virtual DiskImageSector *GetSector(int block_num) { return NULL; }
 	/// キャッシュを更新する
 	virtual void	RefreshCache(int block_num) {}
+	/// キャッシュの世代を返す 0:セクタへのポインタを保持できない
+	virtual wxUint32 GetCacheGeneration() const { return 0; }
+	/// 指定範囲のセクタを先読みする
+	virtual void	ReadAhead(int block_num, int count) {}
+	/// 指定範囲のセクタをキャッシュに固定する
+	virtual bool	PinSectors(int block_num, int count) { return false; }
+	/// 指定範囲のセクタの固定を解除する
+	virtual void	UnpinSectors(int block_num, int count) {}
+	/// 連続したセクタを返す
+	virtual int		GetSectors(int block_num, int count, DiskImageSectors &sectors);
+	/// 連続したセクタのデータをバッファに読み込む
+	virtual int		ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size);
+	/// 連続したセクタにバッファのデータを書き込む
+	virtual int		WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size);
+	/// 連続したセクタがすべてディスクのセクタサイズと同じか
+	virtual bool	IsUniformSectorSize(int block_num, int count);
 
 	/// 書き込み禁止かどうかを返す
 	virtual bool	IsWriteProtected() const { return true; }
@@ -241,8 +265,8 @@ public:
 	/// 変更済みをクリア
 	virtual void	ClearModify() {}
 
-	/// データをすべて出力	
-	virtual void	Flush() {}
+	/// データをすべて出力 false:書き込みエラー
+	virtual bool	Flush() { return true; }
 
 	/// パラメータ変更フラグを設定
 	virtual void	SetParamChanged(bool val) {}
@@ -277,6 +301,72 @@ WX_DEFINE_ARRAY(DiskImageDisk *, DiskImageDisks);
 
 // ----------------------------------------------------------------------
 
+/// セクタキャッシュの統計情報
+class DiskImageCacheStats
+{
+public:
+	wxUint64 m_lookups;			///< キャッシュを検索した回数
+	wxUint64 m_hits;			///< キャッシュにあった回数
+	wxUint64 m_misses;			///< キャッシュになかった回数
+	wxUint64 m_evictions;		///< キャッシュから追い出した回数
+	wxUint64 m_dirty_evictions;	///< 変更のあるまま追い出した回数
+	wxUint64 m_read_bytes;		///< ファイルから読み込んだバイト数
+	wxUint64 m_written_bytes;	///< ファイルに書き込んだバイト数
+	wxUint64 m_flushes;			///< 出力した回数
+	wxUint64 m_flush_time;		///< 出力にかかった時間(ms)
+	size_t   m_cached_count;	///< キャッシュしているブロック数
+	size_t   m_limit_count;		///< キャッシュできる最大ブロック数
+
+	DiskImageCacheStats();
+
+	/// クリア
+	void Clear();
+	/// ヒット率(%)
+	int GetHitRate() const;
+	/// メッセージにする
+	void GetMessages(wxArrayString &msgs) const;
+};
+
+// ----------------------------------------------------------------------
+
+WX_DECLARE_STRING_HASH_MAP(wxString, DiskImageIndexTypes);
+
+/// 解析結果を保存するインデックスファイル
+///
+/// ディスクイメージと同じフォルダに拡張子 ".dfidx" を付けて置く。
+/// ファイルサイズ、更新日時、先頭・中央・末尾のCRC32が一致するときだけ使用する。
+/// 読み込んだら削除し、変更なしで閉じた時に書き直す。
+class DiskImageIndex
+{
+private:
+	DiskImageIndexTypes m_types;	///< ディスク、サイド毎のBASIC種類
+
+	/// インデックスファイルのパス
+	static wxString MakePath(const wxString &image_path);
+	/// イメージの状態を表す文字列を作成
+	static bool MakeStamp(const wxString &image_path, wxString &stamp);
+	/// ディスク、サイドを表すキーを作成
+	static wxString MakeKey(const DiskImageDisk *disk, int side);
+
+public:
+	DiskImageIndex();
+	~DiskImageIndex();
+
+	/// インデックスファイルを読み込む
+	bool Load(const wxString &image_path);
+	/// インデックスファイルに保存
+	bool Save(const wxString &image_path) const;
+	/// クリア
+	void Clear();
+
+	/// 決定したBASIC種類を返す
+	wxString GetBasicType(const DiskImageDisk *disk, int side) const;
+	/// 決定したBASIC種類を設定
+	void SetBasicType(const DiskImageDisk *disk, int side, const wxString &name);
+};
+
+// ----------------------------------------------------------------------
+
 /// ディスクイメージへのポインタを保持するクラス
 class DiskImageFile : public DiskParam
 {
@@ -284,8 +374,10 @@ protected:
 	wxFileName m_filename;
 	wxString   m_file_format;	///< ファイルフォーマット種類
 	wxString m_basic_type_hint;	///< BASIC種類ヒント
+	DiskImageIndex *p_index;	///< 解析結果のインデックス（使用しない時NULL）
+	wxUint32 m_raw_modify_count;	///< DISK BASICを通さずにセクタを変更した回数
 
-	DiskImageFile(const DiskImageFile &src) : DiskParam() {}
+	DiskImageFile(const DiskImageFile &src) : DiskParam() { p_index = NULL; m_raw_modify_count = 0; }
 
 public:
 	DiskImageFile();
@@ -323,6 +415,20 @@ public:
 	virtual DiskImageSector *GetSector(int sector_pos) { return NULL; }
 	/// キャッシュを更新する
 	virtual void RefreshCache(int sector_pos) {}
+	/// キャッシュの世代を返す 0:セクタへのポインタを保持できない
+	virtual wxUint32 GetCacheGeneration() const { return 0; }
+	/// 指定範囲のセクタを先読みする
+	virtual void ReadAhead(int sector_pos, int count) {}
+	/// 指定範囲のセクタをキャッシュに固定する
+	virtual bool PinSectors(int sector_pos, int count) { return false; }
+	/// 指定範囲のセクタの固定を解除する
+	virtual void UnpinSectors(int sector_pos, int count) {}
+	/// 連続したセクタを返す
+	virtual int GetSectors(int sector_pos, int count, DiskImageSectors &sectors);
+	/// 連続したセクタのデータをバッファに読み込む
+	virtual int ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size);
+	/// 連続したセクタにバッファのデータを書き込む
+	virtual int WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size);
 	/// キャッシュをクリア ファイル更新もしない
 	virtual void ClearCacheAll() {}
 	/// キャッシュをクリアする
@@ -339,10 +445,10 @@ public:
 	/// 範囲内のセクタ変更をクリア
 	virtual void ClearModify(wxUint32 start, wxUint32 size) {}
 
-	/// データをすべて出力	
-	virtual void Flush() {}
-	/// 範囲内のデータを出力
-	virtual void Flush(wxUint32 start, wxUint32 size) {}
+	/// データをすべて出力 false:書き込みエラー
+	virtual bool Flush() { return true; }
+	/// 範囲内のデータを出力 false:書き込みエラー
+	virtual bool Flush(wxUint32 start, wxUint32 size) { return true; }
 
 	/// 書き込み禁止かどうかを返す
 	virtual bool	IsWriteProtected() const { return true; }
@@ -374,8 +480,20 @@ public:
 	virtual const wxString &GetBasicTypeHint() const { return m_basic_type_hint; }
 	virtual void SetBasicTypeHint(const wxString &val) { m_basic_type_hint = val; };
 
+	/// DISK BASICを通さずにセクタを変更した時に呼ぶ
+	void IncreaseRawModifyCount() { m_raw_modify_count++; }
+	/// DISK BASICを通さずにセクタを変更した回数
+	wxUint32 GetRawModifyCount() const { return m_raw_modify_count; }
+
+	/// 解析結果のインデックスを返す
+	virtual DiskImageIndex *GetIndex() { return p_index; }
+	/// 解析結果のインデックスを設定
+	virtual void SetIndex(DiskImageIndex *val);
+
 	/// ステータスメッセージ
 	virtual void GetStatusMessage(wxString &str) const {}
+	/// キャッシュの統計情報
+	virtual bool GetCacheStats(DiskImageCacheStats &stats) const { return false; }
 
 	/// セクタ位置からトラック、サイド、セクタ番号を得る
 	virtual bool GetNumberFromSectorPos(int sector_pos, int &track_num, int &side_num, int &sector_num) const;
@@ -477,6 +595,8 @@ public:
 
 	/// ステータスメッセージ
 	virtual void GetStatusMessage(wxString &str) const;
+	/// キャッシュの統計情報
+	virtual bool GetCacheStats(DiskImageCacheStats &stats) const;
 
 	/// エラーメッセージ
 	virtual const wxArrayString &GetErrorMessage(int maxrow = 20);
@@ -15,6 +15,18 @@
 #include "../basicfmt/basicparam.h"
 #include "../basicfmt/basicfmt.h"
 #include "../config.h"
+#include "../logging.h"
+#ifdef USE_SECTOR_BLOCK_CACHE
+#ifdef __WXMSW__
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#endif
 
 
 #define DISK_IMAGE_HEADER_KIND 2
@@ -31,6 +43,8 @@ DiskPlainSector::DiskPlainSector()
 	m_size = 0;
 	m_offset = 0;
 
+	m_modified = false;
+	m_exposed = false;
 	m_crc_32 = 0xffffffff;
 }
 
@@ -48,7 +62,9 @@ DiskPlainSector::DiskPlainSector(int n_num, DiskImageSectorHeader &n_header, wxU
 	}
 	m_offset = n_offset;
 
-	m_crc_32 = Utils::CRC32(m_data, m_size);
+	m_modified = false;
+	m_exposed = false;
+	m_crc_32 = 0xffffffff;
 }
 
 DiskPlainSector::~DiskPlainSector()
@@ -78,7 +94,9 @@ void DiskPlainSector::Set(int n_num, DiskImageSectorHeader &n_header, wxUint8 *n
 	memcpy(m_data, n_data, n_size);
 	m_offset = n_offset;
 
-	m_crc_32 = Utils::CRC32(m_data, m_size);
+	m_modified = false;
+	m_exposed = false;
+	m_crc_32 = 0xffffffff;
 }
 /// セクタの情報を設定(データはポインタを保持する)
 void DiskPlainSector::SetPtr(int n_num, DiskImageSectorHeader &n_header, wxUint8 *n_data, int n_size, wxFileOffset n_offset)
@@ -95,7 +113,9 @@ void DiskPlainSector::SetPtr(int n_num, DiskImageSectorHeader &n_header, wxUint8
 	m_size = n_size;
 	m_offset = n_offset;
 
-	m_crc_32 = Utils::CRC32(m_data, m_size);
+	m_modified = false;
+	m_exposed = false;
+	m_crc_32 = 0xffffffff;
 }
 /// セクタの情報をクリア
 void DiskPlainSector::Clear()
@@ -103,6 +123,8 @@ void DiskPlainSector::Clear()
 	SetNumber(-1);
 
 	m_offset = 0;
+	m_modified = false;
+	m_exposed = false;
 	m_crc_32 = 0xffffffff;
 }
 
@@ -113,7 +135,7 @@ bool DiskPlainSector::Replace(DiskImageSector *src_sector)
 	if (!m_data) {
 		return false;
 	}
-	wxUint8 *src_data = src_sector->GetSectorBuffer();
+	const wxUint8 *src_data = src_sector->GetSectorBufferForRead();
 	if (!src_data) {
 		// データなし
 		return false;
@@ -122,6 +144,7 @@ bool DiskPlainSector::Replace(DiskImageSector *src_sector)
 	if (sz > 0) {
 		memset(m_data, 0, m_size);
 		memcpy(m_data, src_data, sz);
+		SetModify();
 	}
 	return true;
 }
@@ -147,6 +170,7 @@ bool DiskPlainSector::Fill(wxUint8 code, int len, int start)
 	else if ((start + len) > m_size) len = m_size - start;
 
 	memset(&m_data[start], code, len);
+	SetModify();
 
 	return true;
 }
@@ -171,6 +195,7 @@ bool DiskPlainSector::Copy(const void *buf, int len, int start)
 	if ((start + len) > m_size) len = m_size - start;
 
 	memcpy(&m_data[start], buf, len);
+	SetModify();
 
 	return true;
 }
@@ -235,6 +260,7 @@ void DiskPlainSector::Set(int pos, wxUint8 val)
 		pos += m_size;
 	}
 	m_data[pos] = val;
+	SetModify();
 }
 
 /// 指定位置のセクタデータを設定
@@ -253,21 +279,51 @@ void DiskPlainSector::Set16(int pos, wxUint16 val, bool big_endian)
 		m_data[pos] = (val & 0xff);
 		m_data[pos+1] = (val >> 8) & 0xff;
 	}
+	SetModify();
 }
 
 /// 変更されているか
 bool DiskPlainSector::IsModified() const
 {
-	wxUint32 crc = Utils::CRC32(m_data, m_size);
+	return m_modified || (m_exposed && IsChangedSinceExposed());
+}
 
-	return (m_crc_32 != crc);
+/// 変更済みにする
+void DiskPlainSector::SetModify()
+{
+	m_modified = true;
 }
 
 /// 変更済みをクリア
 void DiskPlainSector::ClearModify()
 {
-	wxUint32 crc = Utils::CRC32(m_data, m_size);
-	m_crc_32 = crc;
+	m_modified = false;
+	if (m_exposed) {
+		UpdateExposedData();
+	}
+}
+
+/// バッファへのポインタを外部に渡す
+///
+/// ポインタ経由で書き換えられた場合に備えて、この時点のCRCを保存しておく
+void DiskPlainSector::Expose()
+{
+	if (m_exposed) return;
+
+	UpdateExposedData();
+	m_exposed = true;
+}
+
+/// ポインタを渡した時点から内容が変わったか
+bool DiskPlainSector::IsChangedSinceExposed() const
+{
+	return (m_crc_32 != Utils::CRC32(m_data, m_size));
+}
+
+/// ポインタを渡した時点の内容として現在の内容を保存
+void DiskPlainSector::UpdateExposedData()
+{
+	m_crc_32 = Utils::CRC32(m_data, m_size);
 }
 
 /// 同じセクタか
@@ -299,14 +355,32 @@ int DiskPlainSector::GetSize() const
 }
 
 /// セクタデータへのポインタを返す
+///
+/// 書き込みに使われることもあるので変更を監視する
 wxUint8 *DiskPlainSector::GetSectorBuffer()
 {
+	Expose();
 	return m_data;
 }
 
 /// セクタデータへのポインタを返す
 wxUint8 *DiskPlainSector::GetSectorBuffer(int offset)
 {
+	Expose();
+	return &m_data[offset];
+}
+
+/// 読み込み用にセクタデータへのポインタを返す
+const wxUint8 *DiskPlainSector::GetSectorBufferForRead(int offset)
+{
+	return m_data ? &m_data[offset] : NULL;
+}
+
+/// 書き込み用にセクタデータへのポインタを返す(変更済みにする)
+wxUint8 *DiskPlainSector::GetSectorBufferForWrite(int offset)
+{
+	if (!m_data) return NULL;
+	SetModify();
 	return &m_data[offset];
 }
 
@@ -385,12 +459,14 @@ DiskPlainSectorForBlock::DiskPlainSectorForBlock()
 	: DiskPlainSector()
 {
 	p_block = NULL;
+	m_index = 0;
 }
 
 DiskPlainSectorForBlock::DiskPlainSectorForBlock(int n_num, DiskImageSectorHeader &n_header, wxUint8 *n_data, int n_size, wxFileOffset n_offset)
 	: DiskPlainSector(n_num, n_header, n_data, n_size, n_offset)
 {
 	p_block = NULL;
+	m_index = 0;
 }
 
 DiskPlainSectorForBlock::~DiskPlainSectorForBlock()
@@ -426,6 +502,50 @@ wxUint8 *DiskPlainSectorForBlock::GetSectorBuffer(int offset)
 	UpdateAccessTime();
 	return DiskPlainSector::GetSectorBuffer(offset);
 }
+/// 読み込み用にセクタデータへのポインタを返す
+const wxUint8 *DiskPlainSectorForBlock::GetSectorBufferForRead(int offset)
+{
+	UpdateAccessTime();
+	return DiskPlainSector::GetSectorBufferForRead(offset);
+}
+/// 書き込み用にセクタデータへのポインタを返す(変更済みにする)
+wxUint8 *DiskPlainSectorForBlock::GetSectorBufferForWrite(int offset)
+{
+	UpdateAccessTime();
+	return DiskPlainSector::GetSectorBufferForWrite(offset);
+}
+/// 変更されているか
+bool DiskPlainSectorForBlock::IsModified() const
+{
+	if (!p_block) return DiskPlainSector::IsModified();
+	return p_block->IsModified(m_index);
+}
+/// 変更済みにする
+void DiskPlainSectorForBlock::SetModify()
+{
+	if (!p_block) {
+		DiskPlainSector::SetModify();
+		return;
+	}
+	p_block->SetModify(m_index);
+}
+/// 変更済みをクリア
+void DiskPlainSectorForBlock::ClearModify()
+{
+	if (!p_block) {
+		DiskPlainSector::ClearModify();
+		return;
+	}
+	p_block->ClearModify(m_index);
+}
+/// バッファへのポインタを外部に渡す
+void DiskPlainSectorForBlock::Expose()
+{
+	if (m_exposed) return;
+
+	DiskPlainSector::Expose();
+	if (p_block) p_block->SetExposed(m_index);
+}
 /// アクセス時間を更新
 void DiskPlainSectorForBlock::UpdateAccessTime()
 {
@@ -533,10 +653,11 @@ bool DiskPlainDisk::IsModified()
 }
 
 /// データをすべて出力
-void DiskPlainDisk::Flush()
+/// @return false:書き込みエラー
+bool DiskPlainDisk::Flush()
 {
 	// このパーティション内でキャッシュを検索しデータをすべて出力
-	((DiskPlainFile *)parent)->Flush(m_start_block, m_block_size);
+	return ((DiskPlainFile *)parent)->Flush(m_start_block, m_block_size);
 }
 
 /// ディスク名を返す
@@ -595,6 +716,119 @@ void DiskPlainDisk::RefreshCache(int block_num)
 	parent->RefreshCache(pos);
 }
 
+/// キャッシュの世代を返す
+///
+/// 世代が変わらない間は GetSector() で得たセクタは有効
+wxUint32 DiskPlainDisk::GetCacheGeneration() const
+{
+	if (!parent) return 0;
+
+	return parent->GetCacheGeneration();
+}
+
+/// 指定範囲のセクタを先読みする
+/// @param[in] block_num 開始セクタ位置
+/// @param[in] count     セクタ数
+void DiskPlainDisk::ReadAhead(int block_num, int count)
+{
+	if (!parent) return;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return;
+
+	parent->ReadAhead(m_start_block + block_num, count);
+}
+
+/// 指定範囲のセクタをキャッシュに固定する
+/// @param[in] block_num 開始セクタ位置
+/// @param[in] count     セクタ数
+/// @return false:固定できない
+bool DiskPlainDisk::PinSectors(int block_num, int count)
+{
+	if (!parent) return false;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return false;
+
+	return parent->PinSectors(m_start_block + block_num, count);
+}
+
+/// 指定範囲のセクタの固定を解除する
+/// @param[in] block_num 開始セクタ位置
+/// @param[in] count     セクタ数
+void DiskPlainDisk::UnpinSectors(int block_num, int count)
+{
+	if (!parent) return;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return;
+
+	parent->UnpinSectors(m_start_block + block_num, count);
+}
+
+/// 連続したセクタを返す
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[out] sectors   セクタ
+/// @return 得られたセクタ数
+int DiskPlainDisk::GetSectors(int block_num, int count, DiskImageSectors &sectors)
+{
+	if (!parent) return 0;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return 0;
+
+	return parent->GetSectors(m_start_block + block_num, count, sectors);
+}
+
+/// 連続したセクタのデータをバッファに読み込む
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[out] buffer    バッファ
+/// @param[in]  size      バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskPlainDisk::ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size)
+{
+	if (!parent) return 0;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return 0;
+
+	return parent->ReadSectors(m_start_block + block_num, count, buffer, size);
+}
+
+/// 連続したセクタにバッファのデータを書き込む
+/// @param[in]  block_num 開始セクタ位置
+/// @param[in]  count     セクタ数
+/// @param[in]  buffer    バッファ
+/// @param[in]  size      バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskPlainDisk::WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size)
+{
+	if (!parent) return 0;
+
+	count = LimitSectorCount(block_num, count);
+	if (count <= 0) return 0;
+
+	return parent->WriteSectors(m_start_block + block_num, count, buffer, size);
+}
+
+/// パーティション内に収まるセクタ数を返す
+/// @param[in] block_num 開始セクタ位置
+/// @param[in] count     セクタ数
+/// @return セクタ数 範囲外なら0
+int DiskPlainDisk::LimitSectorCount(int block_num, int count) const
+{
+	if (block_num < 0 || (wxUint32)block_num >= m_block_size) {
+		// out of range
+		return 0;
+	}
+	if ((wxUint32)(block_num + count) > m_block_size) {
+		count = (int)m_block_size - block_num;
+	}
+	return count;
+}
+
 /// 書き込み禁止かどうかを返す
 /// @return true:書き込み禁止
 bool DiskPlainDisk::IsWriteProtected() const
@@ -871,12 +1105,14 @@ void DiskPlainSectorCache::RemoveSector(DiskPlainSectorForCache *item)
 		wxFileStream *stream = p_parent->GetStream();
 
 		stream->SeekO(item->GetFileOffset(), wxFromStart);
-		stream->Write(item->GetSectorBuffer(), item->GetSectorSize()).LastWrite();
+		stream->Write(item->GetSectorBufferForRead(), item->GetSectorSize()).LastWrite();
 	}
 
 	// キャッシュから消す
 	p_cache->Remove(item);
 	delete item;
+
+	p_parent->IncreaseCacheGeneration();
 }
 /// 指定したセクタ番号のセクタデータがキャッシュにあるか
 /// @param[in] sector_pos : セクタ通し番号
@@ -1026,10 +1262,12 @@ void DiskPlainSectorCache::ClearModify(wxUint32 start, wxUint32 size)
 	}
 }
 /// データをすべて出力
-void DiskPlainSectorCache::Flush()
+/// @return false:書き込みエラー
+bool DiskPlainSectorCache::Flush()
 {
-	if (p_parent->IsWriteProtected()) return;
+	if (p_parent->IsWriteProtected()) return true;
 
+	bool ok = true;
 	for(size_t i=0; i<p_cache->Count(); i++) {
 		DiskPlainSectorForCache *itm = p_cache->Item(i);
 //		wxUint32 num = (wxUint32)itm->GetNumber();
@@ -1039,17 +1277,24 @@ void DiskPlainSectorCache::Flush()
 			wxFileStream *stream = p_parent->GetStream();
 
 			stream->SeekO(itm->GetFileOffset(), wxFromStart);
-			stream->Write(itm->GetSectorBuffer(), itm->GetSectorSize()).LastWrite();
+			if (stream->Write(itm->GetSectorBufferForRead(), itm->GetSectorSize()).LastWrite() != (size_t)itm->GetSectorSize()) {
+				// 書けなかったものは変更済みのまま
+				ok = false;
+				continue;
+			}
 
 			itm->ClearModify();
 		}
 	}
+	return ok;
 }
 /// 範囲内のデータを出力
-void DiskPlainSectorCache::Flush(wxUint32 start, wxUint32 size)
+/// @return false:書き込みエラー
+bool DiskPlainSectorCache::Flush(wxUint32 start, wxUint32 size)
 {
-	if (p_parent->IsWriteProtected()) return;
+	if (p_parent->IsWriteProtected()) return true;
 
+	bool ok = true;
 	wxUint32 end = start + size;
 	for(size_t i=0; i<p_cache->Count(); i++) {
 		DiskPlainSectorForCache *itm = p_cache->Item(i);
@@ -1061,11 +1306,16 @@ void DiskPlainSectorCache::Flush(wxUint32 start, wxUint32 size)
 			wxFileStream *stream = p_parent->GetStream();
 
 			stream->SeekO(itm->GetFileOffset(), wxFromStart);
-			stream->Write(itm->GetSectorBuffer(), itm->GetSectorSize()).LastWrite();
+			if (stream->Write(itm->GetSectorBufferForRead(), itm->GetSectorSize()).LastWrite() != (size_t)itm->GetSectorSize()) {
+				// 書けなかったものは変更済みのまま
+				ok = false;
+				continue;
+			}
 
 			itm->ClearModify();
 		}
 	}
+	return ok;
 }
 /// ステータスメッセージ
 void DiskPlainSectorCache::GetStatusMessage(wxString &str) const
@@ -1081,77 +1331,205 @@ DiskPlainSectorBlock::DiskPlainSectorBlock()
 {
 	m_seq_num = 0;
 	p_data = NULL;
+	p_buffer = NULL;
+	m_buffer_size = 0;
 	m_offset = 0;
 	UpdateAccessTime();
 	m_refs_count = 0;
+	p_lru_prev = NULL;
+	p_lru_next = NULL;
+	ClearFlags();
 }
 DiskPlainSectorBlock::DiskPlainSectorBlock(int seq_num)
 {
 	m_seq_num = seq_num;
 	p_data = NULL;
+	p_buffer = NULL;
+	m_buffer_size = 0;
 	m_offset = 0;
 	UpdateAccessTime();
 	m_refs_count = 0;
+	p_lru_prev = NULL;
+	p_lru_next = NULL;
+	ClearFlags();
+}
+/// ファイルから読み込んだデータをそのまま保持する
+/// @param[in] data 読み込んだデータ 所有権は移る
+DiskPlainSectorBlock::DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, Utils::TempData *data, int sector_pos, size_t sector_size, wxFileOffset offset)
+{
+	m_seq_num = seq_num;
+	p_data = data;
+	p_buffer = p_data->GetData();
+	m_buffer_size = p_data->GetSize();
+	m_offset = offset;
+	UpdateAccessTime();
+	m_refs_count = 0;
+	p_lru_prev = NULL;
+	p_lru_next = NULL;
+
+	SetSectors(header, sector_pos, sector_size);
 }
-DiskPlainSectorBlock::DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, const wxUint8 *data, size_t size, int sector_pos, size_t sector_size, wxFileOffset offset)
+/// メモリマップ上のデータを直接参照する
+DiskPlainSectorBlock::DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, wxUint8 *mapped_data, size_t size, int sector_pos, size_t sector_size, wxFileOffset offset, bool mapped)
 {
 	m_seq_num = seq_num;
-	p_data = new Utils::TempData(size);
-	p_data->SetData(data, size);
+	p_data = NULL;
+	p_buffer = mapped_data;
+	m_buffer_size = size;
 	m_offset = offset;
 	UpdateAccessTime();
 	m_refs_count = 0;
+	p_lru_prev = NULL;
+	p_lru_next = NULL;
+
+	SetSectors(header, sector_pos, sector_size);
+}
+DiskPlainSectorBlock::~DiskPlainSectorBlock()
+{
+	delete p_data;
+}
+/// 各セクタへのポインタを設定
+void DiskPlainSectorBlock::SetSectors(DiskImageSectorHeader &header, int sector_pos, size_t sector_size)
+{
+	ClearFlags();
 
-	// 各セクタへのポインタを設定
+	wxFileOffset offset = m_offset;
 	size_t pos = 0;
 	for(int i=0; i<NumOfSecs; i++) {
-		if (pos < size) {
-			m_cache[i].SetPtr(sector_pos, header, p_data->GetData(pos), (int)sector_size, offset);
+		if (pos < m_buffer_size) {
+			m_cache[i].SetPtr(sector_pos, header, &p_buffer[pos], (int)sector_size, offset);
 		} else {
 			// end of file
 			m_cache[i].SetPtr(sector_pos, header, NULL, 0, 0);
 		}
-		m_cache[i].SetSectorBlock(this);
+		m_cache[i].SetSectorBlock(this, i);
 		pos += sector_size;
 		offset += sector_size;
 		sector_pos++;
 	}
 }
-DiskPlainSectorBlock::~DiskPlainSectorBlock()
-{
-	delete p_data;
-}
 /// セクタを返す
 DiskPlainSector *DiskPlainSectorBlock::GetSector(int sector_pos)
 {
 	return &m_cache[sector_pos % NumOfSecs];
 }
+/// 連続したセクタのデータをバッファに読み込む
+/// @param[in]  index       ブロック内の開始位置
+/// @param[in]  count       セクタ数
+/// @param[out] buffer      バッファ
+/// @param[in]  sector_size セクタサイズ
+/// @return 読み込んだセクタ数 ファイル終端を超える分は含まない
+int DiskPlainSectorBlock::ReadSectors(int index, int count, wxUint8 *buffer, size_t sector_size)
+{
+	size_t pos = (size_t)index * sector_size;
+	if (pos >= m_buffer_size) return 0;
+	size_t remain = (m_buffer_size - pos) / sector_size;
+	if ((size_t)count > remain) count = (int)remain;
+	memcpy(buffer, &p_buffer[pos], (size_t)count * sector_size);
+	UpdateAccessTime();
+	return count;
+}
+/// 連続したセクタにバッファのデータを書き込む
+/// @param[in]  index       ブロック内の開始位置
+/// @param[in]  count       セクタ数
+/// @param[in]  buffer      バッファ
+/// @param[in]  sector_size セクタサイズ
+/// @return 書き込んだセクタ数 ファイル終端を超える分は含まない
+int DiskPlainSectorBlock::WriteSectors(int index, int count, const wxUint8 *buffer, size_t sector_size)
+{
+	size_t pos = (size_t)index * sector_size;
+	if (pos >= m_buffer_size) return 0;
+	size_t remain = (m_buffer_size - pos) / sector_size;
+	if ((size_t)count > remain) count = (int)remain;
+	memcpy(&p_buffer[pos], buffer, (size_t)count * sector_size);
+	for(int i=0; i<count; i++) {
+		SetModify(index + i);
+	}
+	UpdateAccessTime();
+	return count;
+}
 /// バッファを返す
 wxUint8 *DiskPlainSectorBlock::GetBufferData() const
 {
-	return p_data ? p_data->GetData() : NULL;
+	return p_buffer;
 }
 /// バッファサイズを返す
 size_t DiskPlainSectorBlock::GetBufferSize() const
 {
-	return p_data ? p_data->GetSize() : 0;
+	return m_buffer_size;
+}
+/// バッファを切り離して返す
+/// @note 以降はセクタにアクセスできないので削除する直前に使用すること
+Utils::TempData *DiskPlainSectorBlock::DetachBuffer()
+{
+	Utils::TempData *data = p_data;
+	p_data = NULL;
+	p_buffer = NULL;
+	m_buffer_size = 0;
+	return data;
+}
+/// フラグをクリア
+void DiskPlainSectorBlock::ClearFlags()
+{
+	memset(m_dirty, 0, sizeof(m_dirty));
+	memset(m_exposed, 0, sizeof(m_exposed));
 }
 /// 変更されているか
 bool DiskPlainSectorBlock::IsModified() const
 {
-	bool modified = false;
-	for(int i=0; !modified && i<NumOfSecs; i++) {
-		modified |= m_cache[i].IsModified();
+	for(int w=0; w<NumOfFlagWords; w++) {
+		if (m_dirty[w]) return true;
 	}
-	return modified;
+	// ポインタを渡したセクタは内容を比較する
+	for(int w=0; w<NumOfFlagWords; w++) {
+		wxUint32 bits = m_exposed[w];
+		for(int i=w*32; bits != 0; i++, bits >>= 1) {
+			if ((bits & 1) && m_cache[i].IsChangedSinceExposed()) return true;
+		}
+	}
+	return false;
 }
 /// 変更をクリア
 void DiskPlainSectorBlock::ClearModify()
 {
-	for(int i=0; i<NumOfSecs; i++) {
-		m_cache[i].ClearModify();
+	memset(m_dirty, 0, sizeof(m_dirty));
+	for(int w=0; w<NumOfFlagWords; w++) {
+		wxUint32 bits = m_exposed[w];
+		for(int i=w*32; bits != 0; i++, bits >>= 1) {
+			if (bits & 1) m_cache[i].UpdateExposedData();
+		}
+	}
+}
+/// 指定セクタが変更されているか
+/// @param[in] index ブロック内の位置
+bool DiskPlainSectorBlock::IsModified(int index) const
+{
+	wxUint32 bit = ((wxUint32)1 << (index & 31));
+	if (m_dirty[index >> 5] & bit) return true;
+	return ((m_exposed[index >> 5] & bit) != 0 && m_cache[index].IsChangedSinceExposed());
+}
+/// 指定セクタを変更済みにする
+/// @param[in] index ブロック内の位置
+void DiskPlainSectorBlock::SetModify(int index)
+{
+	m_dirty[index >> 5] |= ((wxUint32)1 << (index & 31));
+}
+/// 指定セクタの変更をクリア
+/// @param[in] index ブロック内の位置
+void DiskPlainSectorBlock::ClearModify(int index)
+{
+	wxUint32 bit = ((wxUint32)1 << (index & 31));
+	m_dirty[index >> 5] &= ~bit;
+	if (m_exposed[index >> 5] & bit) {
+		m_cache[index].UpdateExposedData();
 	}
 }
+/// 指定セクタのポインタを外部に渡したことを記録
+/// @param[in] index ブロック内の位置
+void DiskPlainSectorBlock::SetExposed(int index)
+{
+	m_exposed[index >> 5] |= ((wxUint32)1 << (index & 31));
+}
 /// アクセス時間を更新
 void DiskPlainSectorBlock::UpdateAccessTime()
 {
@@ -1163,215 +1541,1364 @@ int DiskPlainSectorBlock::Compare(DiskPlainSectorBlock *item1, DiskPlainSectorBl
 {
  	return (item1->m_seq_num - item2->m_seq_num);
 }
-/// アクセス日時を比較
-int DiskPlainSectorBlock::CompareAccessTime(DiskPlainSectorBlock *item1, DiskPlainSectorBlock *item2)
+/// 指定したセクタ範囲にかかるか
+/// @param[in] start 開始セクタ通し番号
+/// @param[in] size  セクタ数
+bool DiskPlainSectorBlock::IsInRange(int start, int size) const
 {
-    return (item1->m_accs_time - item2->m_accs_time) || (item2->m_seq_num - item1->m_seq_num);
+	int top = m_seq_num * NumOfSecs;
+	return (top < start + size && start < top + NumOfSecs);
 }
 
-//
+// ----------------------------------------------------------------------
 
-DiskPlainSectorBlockCache::DiskPlainSectorBlockCache(DiskPlainFile *parent, wxUint32 start_offset)
+DiskPlainBlockBufferPool::DiskPlainBlockBufferPool()
 {
-	p_parent = parent;
-	m_start_offset = start_offset;
-	p_cache = new DiskPlainSectorBlocks(DiskPlainSectorBlock::Compare);
-
-	size_t sector_size = parent->GetSectorSize();
-	if (sector_size == 0) sector_size = 256;
-
-	m_limit_count = (size_t)gConfig.GetCacheLimitSize() * 1024 * 1024 / sector_size / DiskPlainSectorBlock::NumOfSecs;
-	m_shrink_count = (size_t)gConfig.GetCacheShrinkSize() * 1024 * 1024 / sector_size / DiskPlainSectorBlock::NumOfSecs;
-
-	m_cache_overflowed = 0;
+	m_buffer_size = 0;
+	m_max_count = 0;
 }
-DiskPlainSectorBlockCache::~DiskPlainSectorBlockCache()
+DiskPlainBlockBufferPool::~DiskPlainBlockBufferPool()
 {
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		delete itm;
+	Clear();
+}
+/// バッファサイズと保持する最大数を設定
+/// @param[in] buffer_size バッファサイズ
+/// @param[in] max_count   保持する最大数
+void DiskPlainBlockBufferPool::SetSize(size_t buffer_size, size_t max_count)
+{
+	if (m_buffer_size != buffer_size) {
+		Clear();
 	}
-	delete p_cache;
+	m_buffer_size = buffer_size;
+	m_max_count = max_count;
 }
-/// セクタブロックをキャッシュに追加する
-DiskPlainSectorBlock *DiskPlainSectorBlockCache::AddSectorBlock(int sector_pos)
+/// バッファを得る
+/// @return バッファ データサイズはバッファサイズと同じ
+Utils::TempData *DiskPlainBlockBufferPool::Get()
 {
-	// キャッシュがいっぱい
-	if (p_cache->Count() >= m_limit_count) {
-		// メッセージ
-		if (!m_cache_overflowed) {
-			wxMessageBox(_("The data cache is reached the limited size. The modified data will be overwritten to the disk image. Are you sure?"),
-				_("Data Cache Overflow"), wxOK);
-		}
-		m_cache_overflowed++;
-		// 古いキャッシュを消す
-		RemoveByAccessTime();
+	Utils::TempData *data;
+	size_t cnt = m_free.Count();
+	if (cnt > 0) {
+		data = m_free.Item(cnt - 1);
+		m_free.RemoveAt(cnt - 1);
+		data->SetSize(m_buffer_size);
+	} else {
+		data = new Utils::TempData(m_buffer_size);
 	}
-
-	// ファイルからリードする
-
-	DiskPlainSectorHeader header;
-	size_t sector_size = p_parent->GetSectorSize();
-	size_t block_size = sector_size * DiskPlainSectorBlock::NumOfSecs;
-
-	if (block_size > m_temp.GetBufferSize()) {
-		// expand buffer
-		m_temp.SetSize(block_size);
+	return data;
+}
+/// バッファを返す
+/// @param[in] data バッファ NULLなら何もしない
+void DiskPlainBlockBufferPool::Release(Utils::TempData *data)
+{
+	if (!data) return;
+	if (m_free.Count() >= m_max_count || data->GetBufferSize() < m_buffer_size) {
+		delete data;
+		return;
 	}
+	m_free.Add(data);
+}
+/// 空いているバッファをすべて解放
+void DiskPlainBlockBufferPool::Clear()
+{
+	for(size_t i=0; i<m_free.Count(); i++) {
+		delete m_free.Item(i);
+	}
+	m_free.Clear();
+}
 
-	// ファイル読み込み
-	int seq_num = sector_pos / DiskPlainSectorBlock::NumOfSecs;
-	wxFileStream *stream = p_parent->GetStream();
-	wxFileOffset offset = seq_num * block_size + m_start_offset; 
-	stream->SeekI(offset, wxFromStart);
-	size_t read_size = stream->Read(m_temp.GetData(), block_size).LastRead();
-
-	// キャッシュに追加
-	int start_pos = seq_num * DiskPlainSectorBlock::NumOfSecs;
-	DiskPlainSectorBlock *block = new DiskPlainSectorBlock(seq_num, header, m_temp.GetData(), read_size, start_pos, sector_size, offset);
-	p_cache->Add(block);
+// ----------------------------------------------------------------------
 
-	return block;
+DiskPlainPinnedBlocks::DiskPlainPinnedBlocks()
+{
+	m_max_count = 0;
 }
-/// アクセスのないセクタデータをキャッシュから削除する
-void DiskPlainSectorBlockCache::RemoveByAccessTime()
+/// 指定範囲のブロックを固定する
+///
+/// 最大数を超える時は何もしない。
+/// @param[in] seq_start 開始ブロックの通し番号
+/// @param[in] seq_end   終了ブロックの通し番号
+/// @return false:最大数を超える
+bool DiskPlainPinnedBlocks::Pin(int seq_start, int seq_end)
 {
-	DiskPlainSectorBlocks temp(DiskPlainSectorBlock::CompareAccessTime);
-
-	size_t limit = p_cache->Count();
-	size_t i = 0;
-	for(; i<limit; i++) {
-		temp.Add(p_cache->Item(i));
+	size_t adding = 0;
+	for(int seq_num = seq_start; seq_num <= seq_end; seq_num++) {
+		if (m_counts.find(seq_num) == m_counts.end()) adding++;
 	}
-	if (limit > 32) {
-		limit -= 32;
+	if (m_counts.size() + adding > m_max_count) {
+		return false;
 	}
+	for(int seq_num = seq_start; seq_num <= seq_end; seq_num++) {
+		m_counts[seq_num]++;
+	}
+	return true;
+}
+/// 指定範囲のブロックの固定を解除する
+/// @param[in] seq_start 開始ブロックの通し番号
+/// @param[in] seq_end   終了ブロックの通し番号
+void DiskPlainPinnedBlocks::Unpin(int seq_start, int seq_end)
+{
+	for(int seq_num = seq_start; seq_num <= seq_end; seq_num++) {
+		DiskPlainPinCountMap::iterator it = m_counts.find(seq_num);
+		if (it == m_counts.end()) continue;
+		it->second--;
+		if (it->second <= 0) {
+			m_counts.erase(it);
+		}
+	}
+}
+/// 固定しているブロックか
+/// @param[in] seq_num ブロックの通し番号
+bool DiskPlainPinnedBlocks::IsPinned(int seq_num) const
+{
+	return (m_counts.find(seq_num) != m_counts.end());
+}
 
-	i = 0;
-	while (p_cache->Count() > m_shrink_count && i < limit) {
-		DiskPlainSectorBlock *itm = temp.Item(i);
-		i++;
-
-		if (itm->GetRefs() > 0) continue;
+// ----------------------------------------------------------------------
 
-		RemoveSectorBlock(itm);
-	}
+DiskPlainFileMap::DiskPlainFileMap()
+{
+	p_data = NULL;
+	m_size = 0;
+	p_stream = NULL;
+#ifdef __WXMSW__
+	m_handle = NULL;
+#endif
 }
-/// セクタブロックを削除する
-void DiskPlainSectorBlockCache::RemoveSectorBlock(DiskPlainSectorBlock *item)
+DiskPlainFileMap::~DiskPlainFileMap()
 {
-	if (!item) return;
+	Unmap();
+}
+/// ファイルをメモリにマップする
+/// @param[in] stream ファイルストリーム
+/// @return false:マップできない
+bool DiskPlainFileMap::Map(wxFileStream *stream)
+{
+	Unmap();
 
-	// データが更新されている場合はファイルにライト
-	if (item->IsModified()) {
-		wxFileStream *stream = p_parent->GetStream();
+	if (!stream) return false;
+	wxFile *file = static_cast<wxFileInputStream *>(stream)->GetFile();
+	if (!file || !file->IsOpened()) return false;
 
-		stream->SeekO(item->GetFileOffset(), wxFromStart);
-		stream->Write(item->GetBufferData(), item->GetBufferSize());
+	wxFileOffset length = file->Length();
+	if (length <= 0 || (wxFileOffset)(size_t)length != length) {
+		// 空のファイル or アドレス空間に収まらない
+		return false;
 	}
 
-	// キャッシュから消す
-	p_cache->Remove(item);
-	delete item;
+#ifdef __WXMSW__
+	HANDLE fh = (HANDLE)_get_osfhandle(file->fd());
+	if (fh == INVALID_HANDLE_VALUE) return false;
+	HANDLE mh = ::CreateFileMapping(fh, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mh) return false;
+	void *data = ::MapViewOfFile(mh, FILE_MAP_COPY, 0, 0, (SIZE_T)length);
+	if (!data) {
+		::CloseHandle(mh);
+		return false;
+	}
+	m_handle = mh;
+#else
+	void *data = mmap(NULL, (size_t)length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file->fd(), 0);
+	if (data == MAP_FAILED) return false;
+#endif
+	p_data = (wxUint8 *)data;
+	m_size = (size_t)length;
+	p_stream = stream;
+
+	return true;
 }
-/// 指定したセクタ番号のセクタデータがキャッシュにあるか
-/// @param[in] sector_pos : セクタ通し番号
-/// @return セクタデータ / NULL
-DiskPlainSector *DiskPlainSectorBlockCache::FindBySectorPos(int sector_pos)
+/// マップを解除する
+void DiskPlainFileMap::Unmap()
 {
-	size_t cnt = p_cache->Count();
-	if (cnt == 0) {
-		// ない
-		return NULL;
+	if (p_data) {
+#ifdef __WXMSW__
+		::UnmapViewOfFile(p_data);
+#else
+		munmap(p_data, m_size);
+#endif
+		p_data = NULL;
+	}
+#ifdef __WXMSW__
+	if (m_handle) {
+		::CloseHandle((HANDLE)m_handle);
+		m_handle = NULL;
+	}
+#endif
+	m_size = 0;
+}
+/// マップしなおす 変更内容は破棄
+/// @return false:マップできない
+bool DiskPlainFileMap::Remap()
+{
+	wxFileStream *stream = p_stream;
+	return Map(stream);
+}
+/// 指定位置のデータへのポインタを返す
+/// @param[in] offset ファイル先頭からのオフセット
+/// @return ポインタ / NULL 範囲外
+wxUint8 *DiskPlainFileMap::GetData(wxFileOffset offset) const
+{
+	if (!p_data || offset < 0 || offset >= (wxFileOffset)m_size) return NULL;
+	return &p_data[offset];
+}
+/// 指定位置から読めるサイズを返す
+/// @param[in] offset ファイル先頭からのオフセット
+/// @return サイズ
+size_t DiskPlainFileMap::GetRemainSize(wxFileOffset offset) const
+{
+	if (!p_data || offset < 0 || offset >= (wxFileOffset)m_size) return 0;
+	return m_size - (size_t)offset;
+}
+/// 指定範囲をまもなく読むことをOSに通知する
+/// @param[in] offset ファイル先頭からのオフセット
+/// @param[in] size   サイズ
+void DiskPlainFileMap::WillNeed(wxFileOffset offset, size_t size) const
+{
+	size_t remain = GetRemainSize(offset);
+	if (remain == 0) return;
+	if (size > remain) size = remain;
+#ifndef __WXMSW__
+	// ページ境界にそろえる
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t top = (size_t)offset;
+	if (page > 0) {
+		size += (top % page);
+		top -= (top % page);
+	}
+	posix_madvise(&p_data[top], size, POSIX_MADV_WILLNEED);
+#endif
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainWriteRequest::DiskPlainWriteRequest(int seq_num, wxFileOffset offset, Utils::TempData *data, int serial)
+{
+	m_seq_num = seq_num;
+	m_offset = offset;
+	p_data = data;
+	m_serial = serial;
+}
+DiskPlainWriteRequest::~DiskPlainWriteRequest()
+{
+	delete p_data;
+}
+/// オフセット順に比較 同じ位置なら登録順
+int DiskPlainWriteRequest::Compare(DiskPlainWriteRequest *item1, DiskPlainWriteRequest *item2)
+{
+	if (item1->m_offset != item2->m_offset) {
+		return (item1->m_offset < item2->m_offset ? -1 : 1);
+	}
+	return (item1->m_serial - item2->m_serial);
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainFileFlusher::DiskPlainFileFlusher(wxFileStream *stream, wxMutex *stream_mutex, size_t max_count)
+	: wxThread(wxTHREAD_JOINABLE)
+	, m_queued(m_mutex)
+	, m_written(m_mutex)
+	, m_queue(DiskPlainWriteRequest::Compare)
+{
+	p_stream = stream;
+	p_stream_mutex = stream_mutex;
+	m_max_count = (max_count > 0 ? max_count : 1);
+	m_serial = 0;
+	m_exit = false;
+	m_written_bytes = 0;
+}
+DiskPlainFileFlusher::~DiskPlainFileFlusher()
+{
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		delete m_queue.Item(i);
+	}
+}
+/// スレッドを開始
+bool DiskPlainFileFlusher::Start()
+{
+	return (Run() == wxTHREAD_NO_ERROR);
+}
+/// 書き込み待ちのデータをすべて書き込んでスレッドを終了
+void DiskPlainFileFlusher::Stop()
+{
+	m_mutex.Lock();
+	m_exit = true;
+	m_queued.Signal();
+	m_mutex.Unlock();
+
+	Wait();
+}
+/// スレッド本体
+wxThread::ExitCode DiskPlainFileFlusher::Entry()
+{
+	m_mutex.Lock();
+	for(;;) {
+		while (m_queue.Count() == 0 && !m_exit) {
+			m_queued.Wait();
+		}
+		if (m_queue.Count() == 0) {
+			// 終了要求があり書き込むものもない
+			break;
+		}
+		// オフセットの小さいものから書き込む
+		// 書き終わるまでキューに残しておき再読み込み時に参照できるようにする
+		DiskPlainWriteRequest *req = m_queue.Item(0);
+		m_mutex.Unlock();
+
+		p_stream_mutex->Lock();
+		p_stream->SeekO(req->GetFileOffset(), wxFromStart);
+		size_t written = p_stream->Write(req->GetData(), req->GetSize()).LastWrite();
+		p_stream_mutex->Unlock();
+
+		m_mutex.Lock();
+		m_written_bytes += written;
+		m_queue.Remove(req);
+		delete req;
+		m_written.Broadcast();
+	}
+	m_mutex.Unlock();
+
+	return (ExitCode)0;
+}
+/// 書き込み待ちに追加する
+/// @param[in] seq_num ブロックの通し番号
+/// @param[in] offset  ファイルオフセット
+/// @param[in] data    書き込むデータ 所有権は移る
+void DiskPlainFileFlusher::Push(int seq_num, wxFileOffset offset, Utils::TempData *data)
+{
+	wxMutexLocker lock(m_mutex);
+
+	// 書き込みが追いつかない時は空くまで待つ
+	while (m_queue.Count() >= m_max_count) {
+		m_written.Wait();
+	}
+	m_queue.Add(new DiskPlainWriteRequest(seq_num, offset, data, m_serial++));
+	m_queued.Signal();
+}
+/// 書き込み待ちのデータがあればバッファにコピーする
+/// @param[in]  seq_num ブロックの通し番号
+/// @param[out] buffer  バッファ
+/// @param[out] size    コピーしたサイズ
+/// @return true:あった
+bool DiskPlainFileFlusher::ReadPending(int seq_num, wxUint8 *buffer, size_t &size)
+{
+	wxMutexLocker lock(m_mutex);
+
+	// 同じブロックが複数ある時は最後に登録したもの
+	DiskPlainWriteRequest *match = NULL;
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		DiskPlainWriteRequest *req = m_queue.Item(i);
+		if (req->GetNumber() != seq_num) continue;
+		if (!match || match->GetSerial() < req->GetSerial()) {
+			match = req;
+		}
+	}
+	if (!match) return false;
+
+	size = match->GetSize();
+	memcpy(buffer, match->GetData(), size);
+	return true;
+}
+/// 書き込み待ちのデータがあるか
+/// @param[in] seq_num ブロックの通し番号
+bool DiskPlainFileFlusher::IsPending(int seq_num)
+{
+	wxMutexLocker lock(m_mutex);
+
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		if (m_queue.Item(i)->GetNumber() == seq_num) return true;
+	}
+	return false;
+}
+/// 書き込み待ちがなくなるまで待つ
+void DiskPlainFileFlusher::WaitForIdle()
+{
+	wxMutexLocker lock(m_mutex);
+
+	while (m_queue.Count() > 0) {
+		m_written.Wait();
+	}
+}
+/// 書き込み待ちの数
+size_t DiskPlainFileFlusher::GetPendingCount()
+{
+	wxMutexLocker lock(m_mutex);
+
+	return m_queue.Count();
+}
+/// 書き込んだバイト数
+wxUint64 DiskPlainFileFlusher::GetWrittenBytes()
+{
+	wxMutexLocker lock(m_mutex);
+
+	return m_written_bytes;
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainReadRequest::DiskPlainReadRequest(int seq_num, wxFileOffset offset, size_t size)
+{
+	m_seq_num = seq_num;
+	m_offset = offset;
+	m_size = size;
+	p_data = NULL;
+}
+DiskPlainReadRequest::~DiskPlainReadRequest()
+{
+	delete p_data;
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainFilePrefetcher::DiskPlainFilePrefetcher(wxFileStream *stream, wxMutex *stream_mutex, size_t max_count)
+	: wxThread(wxTHREAD_JOINABLE)
+	, m_requested(m_mutex)
+	, m_loaded(m_mutex)
+{
+	p_stream = stream;
+	p_stream_mutex = stream_mutex;
+	p_reading = NULL;
+	m_max_count = (max_count > 0 ? max_count : 1);
+	m_exit = false;
+	m_read_bytes = 0;
+}
+DiskPlainFilePrefetcher::~DiskPlainFilePrefetcher()
+{
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		delete m_queue.Item(i);
+	}
+}
+/// スレッドを開始
+bool DiskPlainFilePrefetcher::Start()
+{
+	return (Run() == wxTHREAD_NO_ERROR);
+}
+/// スレッドを終了 先読み待ちのデータは読まない
+void DiskPlainFilePrefetcher::Stop()
+{
+	m_mutex.Lock();
+	m_exit = true;
+	m_requested.Signal();
+	m_mutex.Unlock();
+
+	Wait();
+}
+/// 次に読み込むデータ
+DiskPlainReadRequest *DiskPlainFilePrefetcher::FindNextRequest() const
+{
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		DiskPlainReadRequest *req = m_queue.Item(i);
+		if (!req->IsLoaded()) return req;
+	}
+	return NULL;
+}
+/// 指定ブロックのデータ
+/// @return キュー内の位置 / -1
+int DiskPlainFilePrefetcher::FindRequest(int seq_num) const
+{
+	for(size_t i=0; i<m_queue.Count(); i++) {
+		if (m_queue.Item(i)->GetNumber() == seq_num) return (int)i;
+	}
+	return -1;
+}
+/// スレッド本体
+wxThread::ExitCode DiskPlainFilePrefetcher::Entry()
+{
+	m_mutex.Lock();
+	for(;;) {
+		DiskPlainReadRequest *req = NULL;
+		while (!m_exit && (req = FindNextRequest()) == NULL) {
+			m_requested.Wait();
+		}
+		if (m_exit) {
+			break;
+		}
+		// 読み込み中は取り出されないようにする
+		p_reading = req;
+		m_mutex.Unlock();
+
+		Utils::TempData *data = new Utils::TempData(req->GetSize());
+		p_stream_mutex->Lock();
+		p_stream->SeekI(req->GetFileOffset(), wxFromStart);
+		size_t read_size = p_stream->Read(data->GetData(), req->GetSize()).LastRead();
+		p_stream_mutex->Unlock();
+		data->SetSize(read_size);
+
+		m_mutex.Lock();
+		m_read_bytes += read_size;
+		req->SetData(data);
+		p_reading = NULL;
+		m_loaded.Broadcast();
+	}
+	m_mutex.Unlock();
+
+	return (ExitCode)0;
+}
+/// 先読みを依頼する
+/// @param[in] seq_num ブロックの通し番号
+/// @param[in] offset  ファイルオフセット
+/// @param[in] size    読み込むサイズ
+void DiskPlainFilePrefetcher::Request(int seq_num, wxFileOffset offset, size_t size)
+{
+	wxMutexLocker lock(m_mutex);
+
+	if (FindRequest(seq_num) >= 0) return;
+
+	// いっぱいなら古いものから捨てる
+	for(size_t i=0; m_queue.Count() >= m_max_count && i<m_queue.Count(); ) {
+		DiskPlainReadRequest *req = m_queue.Item(i);
+		if (req == p_reading) {
+			i++;
+			continue;
+		}
+		m_queue.RemoveAt(i);
+		delete req;
+	}
+	m_queue.Add(new DiskPlainReadRequest(seq_num, offset, size));
+	m_requested.Signal();
+}
+/// 先読みしたデータを取り出す
+///
+/// 読み込み中なら終わるまで待つ。読み込む前なら依頼を取り消す。
+/// @param[in]  seq_num ブロックの通し番号
+/// @param[out] buffer  バッファ NULLなら捨てる
+/// @param[out] size    コピーしたサイズ
+/// @return true:先読みしたデータがあった
+bool DiskPlainFilePrefetcher::Take(int seq_num, wxUint8 *buffer, size_t &size)
+{
+	wxMutexLocker lock(m_mutex);
+
+	int idx = FindRequest(seq_num);
+	if (idx < 0) return false;
+
+	DiskPlainReadRequest *req = m_queue.Item(idx);
+	while (req == p_reading) {
+		m_loaded.Wait();
+	}
+	// 待っている間に位置が変わることがある
+	m_queue.Remove(req);
+
+	bool found = false;
+	Utils::TempData *data = req->GetData();
+	if (buffer && data && data->GetSize() > 0) {
+		size = data->GetSize();
+		memcpy(buffer, data->GetData(), size);
+		found = true;
+	}
+	delete req;
+
+	return found;
+}
+/// 先読みしたデータをバッファごと取り出す
+///
+/// 読み込み中なら終わるまで待つ。読み込む前なら依頼を取り消す。
+/// @param[in]  seq_num ブロックの通し番号
+/// @return 読み込んだデータ 所有権は移る / NULL
+Utils::TempData *DiskPlainFilePrefetcher::Take(int seq_num)
+{
+	wxMutexLocker lock(m_mutex);
+
+	int idx = FindRequest(seq_num);
+	if (idx < 0) return NULL;
+
+	DiskPlainReadRequest *req = m_queue.Item(idx);
+	while (req == p_reading) {
+		m_loaded.Wait();
+	}
+	m_queue.Remove(req);
+
+	Utils::TempData *data = req->GetData();
+	req->SetData(NULL);
+	delete req;
+
+	if (data && data->GetSize() == 0) {
+		delete data;
+		data = NULL;
+	}
+	return data;
+}
+/// 読み込んだバイト数
+wxUint64 DiskPlainFilePrefetcher::GetReadBytes()
+{
+	wxMutexLocker lock(m_mutex);
+
+	return m_read_bytes;
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainWriteRun::DiskPlainWriteRun()
+{
+	Clear();
+}
+/// クリア
+void DiskPlainWriteRun::Clear()
+{
+	m_offset = 0;
+	m_size = 0;
+	m_count = 0;
+}
+/// 続けて追加できるか
+/// @param[in] offset ファイルオフセット
+/// @param[in] data   データ
+/// @param[in] block  データのあるブロック
+bool DiskPlainWriteRun::CanAppend(wxFileOffset offset, const wxUint8 *data, const DiskPlainSectorBlock *block) const
+{
+	if (m_count == 0) return true;
+	if (m_offset + (wxFileOffset)m_size != offset) return false;
+	// 同じブロックでメモリ上も連続していれば最後のデータを伸ばす
+	if (p_blocks[m_count - 1] == block && p_bufs[m_count - 1] + m_lens[m_count - 1] == data) return true;
+	return (m_count < MaxVectors);
+}
+/// データを追加 CanAppend()で確認してから呼ぶこと
+/// @param[in] offset ファイルオフセット
+/// @param[in] data   データ
+/// @param[in] len    サイズ
+/// @param[in] block  データのあるブロック
+/// @param[in] index  ブロック内のセクタ位置
+void DiskPlainWriteRun::Append(wxFileOffset offset, const wxUint8 *data, size_t len, DiskPlainSectorBlock *block, int index)
+{
+	if (m_count == 0) {
+		m_offset = offset;
+	} else if (p_blocks[m_count - 1] == block && p_bufs[m_count - 1] + m_lens[m_count - 1] == data) {
+		m_lens[m_count - 1] += len;
+		m_secs[m_count - 1]++;
+		m_size += len;
+		return;
+	}
+	p_bufs[m_count] = data;
+	m_lens[m_count] = len;
+	p_blocks[m_count] = block;
+	m_first[m_count] = index;
+	m_secs[m_count] = 1;
+	m_count++;
+	m_size += len;
+}
+/// 書き込んだセクタの変更をクリア Write()が成功した時に呼ぶ
+void DiskPlainWriteRun::ClearModify()
+{
+	for(int i=0; i<m_count; i++) {
+		for(int n=0; n<m_secs[i]; n++) {
+			p_blocks[i]->ClearModify(m_first[i] + n);
+		}
+	}
+}
+/// ファイルに書き込む
+/// @param[in] file ファイル
+/// @return false:書き込みエラー
+bool DiskPlainWriteRun::Write(wxFile *file) const
+{
+	if (m_count == 0) return true;
+
+	if (file->Seek(m_offset, wxFromStart) == wxInvalidOffset) return false;
+
+#ifdef __WXMSW__
+	// 連続しているのでそのまま続けて書く
+	for(int i=0; i<m_count; i++) {
+		if (file->Write(p_bufs[i], m_lens[i]) != m_lens[i]) return false;
+	}
+#else
+	// まとめて書く
+	struct iovec iov[MaxVectors];
+	for(int i=0; i<m_count; i++) {
+		iov[i].iov_base = (void *)p_bufs[i];
+		iov[i].iov_len = m_lens[i];
+	}
+	int idx = 0;
+	while (idx < m_count) {
+		if (iov[idx].iov_len == 0) {
+			// 書くデータがない
+			idx++;
+			continue;
+		}
+		ssize_t len = writev(file->fd(), &iov[idx], m_count - idx);
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (len == 0) {
+			// 1バイトも書けないときは進まないので失敗とする
+			return false;
+		}
+		// 途中までしか書けなかった時は残りを書く
+		while (idx < m_count && (size_t)len >= iov[idx].iov_len) {
+			len -= (ssize_t)iov[idx].iov_len;
+			idx++;
+		}
+		if (idx < m_count) {
+			iov[idx].iov_base = (void *)((wxUint8 *)iov[idx].iov_base + len);
+			iov[idx].iov_len -= (size_t)len;
+		}
+	}
+#endif
+	return true;
+}
+
+// ----------------------------------------------------------------------
+
+DiskPlainSectorBlockCache::DiskPlainSectorBlockCache(DiskPlainFile *parent, wxUint32 start_offset, DiskPlainFileMap *map)
+{
+	p_parent = parent;
+	m_start_offset = start_offset;
+	p_map = map;
+	p_lru_head = NULL;
+	p_lru_tail = NULL;
+
+	size_t sector_size = parent->GetSectorSize();
+	if (sector_size == 0) sector_size = 256;
+
+	m_limit_count = (size_t)gConfig.GetCacheLimitSize() * 1024 * 1024 / sector_size / DiskPlainSectorBlock::NumOfSecs;
+	m_shrink_count = (size_t)gConfig.GetCacheShrinkSize() * 1024 * 1024 / sector_size / DiskPlainSectorBlock::NumOfSecs;
+	m_high_water_count = (size_t)Config::FromPercentage(gConfig.GetCacheHighWater(), (int)m_limit_count);
+
+	m_cache_overflowed = 0;
+
+	// ブロック用バッファ 縮小時に解放した分を使いまわす
+	m_pool.SetSize(sector_size * DiskPlainSectorBlock::NumOfSecs, m_limit_count - m_shrink_count + 1);
+
+	// 管理領域を固定するのは縮小サイズの半分まで
+	m_pinned.SetMaxCount(m_shrink_count / 2);
+
+	// 変更したデータをバックグラウンドで書き込む
+	// メモリマップ時は変更したデータをFlush()まで保持するので使用しない
+	p_flusher = NULL;
+	if (!p_map && gConfig.DoesUseCacheWriteBack()) {
+		p_flusher = new DiskPlainFileFlusher(parent->GetStream(), &m_stream_mutex, m_limit_count);
+		if (!p_flusher->Start()) {
+			delete p_flusher;
+			p_flusher = NULL;
+		}
+	}
+
+	// 連続して読んでいる時は先読みする
+	// メモリマップ時はOSに通知するだけ
+	m_read_ahead_count = gConfig.GetReadAheadBlocks();
+	if ((size_t)m_read_ahead_count > m_shrink_count) m_read_ahead_count = (int)m_shrink_count;
+	m_last_miss_num = -2;
+	m_sequential_count = 0;
+	m_file_size = parent->GetStream()->GetLength();
+	p_prefetcher = NULL;
+	if (!p_map && m_read_ahead_count > 0) {
+		p_prefetcher = new DiskPlainFilePrefetcher(parent->GetStream(), &m_stream_mutex, m_read_ahead_count * 2);
+		if (!p_prefetcher->Start()) {
+			delete p_prefetcher;
+			p_prefetcher = NULL;
+		}
+	}
+}
+DiskPlainSectorBlockCache::~DiskPlainSectorBlockCache()
+{
+	// 先読みは途中でやめる
+	if (p_prefetcher) {
+		p_prefetcher->Stop();
+		delete p_prefetcher;
+	}
+	// 書き込み待ちのデータを書き込んでから終了
+	if (p_flusher) {
+		p_flusher->Stop();
+		delete p_flusher;
+	}
+
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		delete it->second;
+	}
+	m_cache.clear();
+}
+/// LRUリストの先頭に追加
+void DiskPlainSectorBlockCache::LinkLru(DiskPlainSectorBlock *block)
+{
+	block->SetLruPrev(NULL);
+	block->SetLruNext(p_lru_head);
+	if (p_lru_head) {
+		p_lru_head->SetLruPrev(block);
+	}
+	p_lru_head = block;
+	if (!p_lru_tail) {
+		p_lru_tail = block;
+	}
+}
+/// LRUリストから外す
+void DiskPlainSectorBlockCache::UnlinkLru(DiskPlainSectorBlock *block)
+{
+	DiskPlainSectorBlock *prev = block->GetLruPrev();
+	DiskPlainSectorBlock *next = block->GetLruNext();
+	if (prev) {
+		prev->SetLruNext(next);
+	} else {
+		p_lru_head = next;
+	}
+	if (next) {
+		next->SetLruPrev(prev);
+	} else {
+		p_lru_tail = prev;
+	}
+	block->SetLruPrev(NULL);
+	block->SetLruNext(NULL);
+}
+/// LRUリストの先頭に移動
+void DiskPlainSectorBlockCache::TouchLru(DiskPlainSectorBlock *block)
+{
+	if (p_lru_head == block) return;
+	UnlinkLru(block);
+	LinkLru(block);
+}
+/// 範囲内のブロックを通し番号順に集める
+/// @param[in]  start  開始セクタ通し番号
+/// @param[in]  size   セクタ数
+/// @param[out] blocks ブロック
+void DiskPlainSectorBlockCache::CollectBlocks(int start, int size, DiskPlainSectorBlocks &blocks) const
+{
+	DiskPlainSectorBlockMap::const_iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		DiskPlainSectorBlock *itm = it->second;
+		if (!itm->IsInRange(start, size)) continue;
+		blocks.Add(itm);
+	}
+}
+/// 全ブロックを通し番号順に集める
+/// @param[out] blocks ブロック
+void DiskPlainSectorBlockCache::CollectBlocks(DiskPlainSectorBlocks &blocks) const
+{
+	DiskPlainSectorBlockMap::const_iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		blocks.Add(it->second);
+	}
+}
+/// セクタブロックをキャッシュに追加する
+/// @param[in] sector_pos セクタ通し番号
+/// @param[in] read_ahead  連続して読んでいる時に先読みするか
+DiskPlainSectorBlock *DiskPlainSectorBlockCache::AddSectorBlock(int sector_pos, bool read_ahead)
+{
+	// キャッシュがいっぱい
+	if (m_cache.size() >= m_limit_count) {
+		// メッセージ メモリマップ時は変更したデータを書き出さないので不要
+		if (!m_cache_overflowed && !p_map) {
+			wxMessageBox(_("The data cache is reached the limited size. The modified data will be overwritten to the disk image. Are you sure?"),
+				_("Data Cache Overflow"), wxOK);
+		}
+		m_cache_overflowed++;
+		// 古いキャッシュを消す
+		RemoveByAccessTime();
+	} else if (p_flusher && m_cache_overflowed && m_cache.size() >= m_high_water_count) {
+		// 上書きを通知した後は、変更のある古いキャッシュを先に書き込んでおく
+		// 保存するまではファイルに書き込まない
+		WriteBackByAccessTime();
+	}
+
+	DiskPlainSectorHeader header;
+	size_t sector_size = p_parent->GetSectorSize();
+	size_t block_size = sector_size * DiskPlainSectorBlock::NumOfSecs;
+	int seq_num = sector_pos / DiskPlainSectorBlock::NumOfSecs;
+	int start_pos = seq_num * DiskPlainSectorBlock::NumOfSecs;
+	wxFileOffset offset = (wxFileOffset)seq_num * block_size + m_start_offset;
+
+	DiskPlainSectorBlock *block;
+	if (p_map) {
+		// メモリマップ上のデータを参照する
+		size_t map_size = p_map->GetRemainSize(offset);
+		if (map_size > block_size) map_size = block_size;
+		// 端数のセクタは含めない
+		map_size -= (map_size % sector_size);
+		m_stats.m_read_bytes += map_size;
+		block = new DiskPlainSectorBlock(seq_num, header, p_map->GetData(offset), map_size, start_pos, sector_size, offset, true);
+	} else {
+		// ファイルからブロックのバッファに直接リードする
+		Utils::TempData *data = m_pool.Get();
+
+		// 書き込み待ちのデータがあればそちらが最新
+		size_t read_size = 0;
+		bool loaded = (p_flusher && p_flusher->ReadPending(seq_num, data->GetData(), read_size));
+		if (p_prefetcher) {
+			if (loaded) {
+				// 書き込み待ちがあった時は先読みしたデータを捨てる
+				p_prefetcher->Take(seq_num, NULL, read_size);
+			} else {
+				// 先読みしたデータはバッファごと使う
+				Utils::TempData *prefetched = p_prefetcher->Take(seq_num);
+				if (prefetched) {
+					m_pool.Release(data);
+					data = prefetched;
+					read_size = data->GetSize();
+					loaded = true;
+				}
+			}
+		}
+		if (!loaded) {
+			// ファイル読み込み
+			wxMutexLocker lock(m_stream_mutex);
+			wxFileStream *stream = p_parent->GetStream();
+			stream->SeekI(offset, wxFromStart);
+			read_size = stream->Read(data->GetData(), block_size).LastRead();
+			m_stats.m_read_bytes += read_size;
+		}
+		data->SetSize(read_size);
+
+		block = new DiskPlainSectorBlock(seq_num, header, data, start_pos, sector_size, offset);
+	}
+
+	// キャッシュに追加
+	m_cache[seq_num] = block;
+	LinkLru(block);
+
+	if (read_ahead) {
+		DetectSequentialRead(seq_num);
+	}
+
+	return block;
+}
+/// 連続して読んでいるなら続きを先読みする
+/// @param[in] seq_num キャッシュになかったブロックの通し番号
+void DiskPlainSectorBlockCache::DetectSequentialRead(int seq_num)
+{
+	if (m_read_ahead_count <= 0) return;
+
+	if (seq_num == m_last_miss_num + 1) {
+		m_sequential_count++;
+	} else {
+		m_sequential_count = 0;
+	}
+	m_last_miss_num = seq_num;
+
+	if (m_sequential_count > 0) {
+		ReadAheadBlocks(seq_num + 1, m_read_ahead_count);
+	}
+}
+/// 指定ブロックから先読みする
+/// @param[in] seq_num 開始ブロックの通し番号
+/// @param[in] count   ブロック数
+void DiskPlainSectorBlockCache::ReadAheadBlocks(int seq_num, int count)
+{
+	size_t block_size = p_parent->GetSectorSize() * DiskPlainSectorBlock::NumOfSecs;
+	for(int i=0; i<count; i++, seq_num++) {
+		wxFileOffset offset = (wxFileOffset)seq_num * block_size + m_start_offset;
+		if (offset >= m_file_size) break;
+		// キャッシュにあるものは不要
+		if (m_cache.find(seq_num) != m_cache.end()) continue;
+
+		if (p_map) {
+			p_map->WillNeed(offset, block_size);
+		} else if (p_prefetcher) {
+			// 書き込み待ちのあるものはファイルが古い
+			if (p_flusher && p_flusher->IsPending(seq_num)) continue;
+			p_prefetcher->Request(seq_num, offset, block_size);
+		}
+	}
+}
+/// アクセスのないセクタデータをキャッシュから削除する
+///
+/// LRUリストの末尾(最もアクセスしていないもの)から削除する
+void DiskPlainSectorBlockCache::RemoveByAccessTime()
+{
+	DiskPlainSectorBlock *itm = p_lru_tail;
+	while (itm && m_cache.size() > m_shrink_count) {
+		DiskPlainSectorBlock *prev = itm->GetLruPrev();
+
+		if (itm->GetRefs() > 0
+		// 固定したブロックは残す
+		|| m_pinned.IsPinned(itm->GetNumber())
+		// メモリマップ上の変更はFlush()まで保持する
+		|| (itm->IsMapped() && itm->IsModified())) {
+			itm = prev;
+			continue;
+		}
+
+		bool modified = itm->IsModified();
+		if (RemoveSectorBlock(itm)) {
+			m_stats.m_evictions++;
+			if (modified) m_stats.m_dirty_evictions++;
+		}
+		itm = prev;
+	}
+}
+/// 変更のある古いブロックをバックグラウンドで書き込む
+///
+/// LRUリストの末尾から一定数だけ調べ、変更のあるものの複製を書き込み待ちにする
+void DiskPlainSectorBlockCache::WriteBackByAccessTime()
+{
+	if (p_parent->IsWriteProtected()) return;
+
+	DiskPlainSectorBlock *itm = p_lru_tail;
+	for(int i=0; itm && i<32; i++) {
+		if (itm->IsModified()) {
+			Utils::TempData *data = new Utils::TempData(itm->GetBufferSize());
+			data->SetData(itm->GetBufferData(), itm->GetBufferSize());
+			itm->ClearModify();
+			p_flusher->Push(itm->GetNumber(), itm->GetFileOffset(), data);
+		}
+		itm = itm->GetLruPrev();
+	}
+}
+/// ブロックをファイルに書き込む
+/// @return false:書き込みエラー
+bool DiskPlainSectorBlockCache::WriteSectorBlock(DiskPlainSectorBlock *item)
+{
+	DiskPlainSectorBlocks blocks(DiskPlainSectorBlock::Compare);
+	blocks.Add(item);
+	return WriteModifiedSectors(blocks, false);
+}
+/// まとめたデータを書き込み、書けたセクタの変更をクリアする
+///
+/// 書けなかったセクタは変更済みのまま残す。
+/// @param[in]     file ファイル
+/// @param[in,out] run  まとめたデータ 書き込み後はクリアする
+/// @return false:書き込みエラー
+bool DiskPlainSectorBlockCache::WriteRun(wxFile *file, DiskPlainWriteRun &run)
+{
+	bool ok = run.Write(file);
+	if (ok) {
+		run.ClearModify();
+		m_stats.m_written_bytes += run.GetSize();
+	}
+	run.Clear();
+	return ok;
+}
+/// ブロック内の変更したセクタをファイルに書き込み、変更をクリアする
+///
+/// ファイル上で連続する変更セクタはブロックをまたいでもまとめて書き込む。
+/// 書けなかったセクタは変更済みのまま残す。
+/// @param[in] blocks 通し番号順のブロック
+/// @param[in] sync   最後にディスクへの書き込みを完了させるか
+/// @return false:書き込みエラー
+bool DiskPlainSectorBlockCache::WriteModifiedSectors(DiskPlainSectorBlocks &blocks, bool sync)
+{
+	size_t sector_size = p_parent->GetSectorSize();
+	if (sector_size == 0) return false;
+
+	wxMutexLocker lock(m_stream_mutex);
+	wxFile *file = static_cast<wxFileInputStream *>(p_parent->GetStream())->GetFile();
+	if (!file || !file->IsOpened()) return false;
+
+	bool ok = true;
+	bool written = false;
+	DiskPlainWriteRun run;
+	for(size_t n=0; n<blocks.Count(); n++) {
+		DiskPlainSectorBlock *itm = blocks.Item(n);
+		if (!itm->IsModified()) continue;
+
+		const wxUint8 *buffer = itm->GetBufferData();
+		size_t buffer_size = itm->GetBufferSize();
+		for(int i=0; i<DiskPlainSectorBlock::NumOfSecs; i++) {
+			size_t pos = (size_t)i * sector_size;
+			if (pos >= buffer_size) break;
+			if (!itm->IsModified(i)) continue;
+
+			size_t len = buffer_size - pos;
+			if (len > sector_size) len = sector_size;
+			wxFileOffset offset = itm->GetFileOffset() + (wxFileOffset)pos;
+			if (!run.CanAppend(offset, &buffer[pos], itm)) {
+				ok &= WriteRun(file, run);
+			}
+			run.Append(offset, &buffer[pos], len, itm, i);
+			written = true;
+		}
+	}
+	ok &= WriteRun(file, run);
+
+	// 最後に一度だけ同期する
+	if (sync && written) {
+		file->Flush();
 	}
-	int seq_num = sector_pos / DiskPlainSectorBlock::NumOfSecs;
-	size_t index = cnt / 2;
-	DiskPlainSectorBlock *block = FindBySectorPosR(0, seq_num, index, 0, cnt - 1);
-	if (block) {
-		return block->GetSector(sector_pos % DiskPlainSectorBlock::NumOfSecs);
-	} else {
+
+	return ok;
+}
+/// セクタブロックを削除する
+/// @return false:書き込みエラーのため削除しなかった
+bool DiskPlainSectorBlockCache::RemoveSectorBlock(DiskPlainSectorBlock *item)
+{
+	if (!item) return true;
+
+	// データが更新されている場合はファイルにライト
+	if (item->IsModified()) {
+		if (p_flusher && !item->IsMapped()) {
+			// バッファごとバックグラウンドで書き込む
+			p_flusher->Push(item->GetNumber(), item->GetFileOffset(), item->DetachBuffer());
+		} else if (!WriteSectorBlock(item)) {
+			// 書けなかったデータを失わないようキャッシュに残す
+			return false;
+		}
+	}
+
+	// キャッシュから消す バッファは使いまわす
+	UnlinkLru(item);
+	m_cache.erase(item->GetNumber());
+	m_pool.Release(item->DetachBuffer());
+	delete item;
+
+	p_parent->IncreaseCacheGeneration();
+
+	return true;
+}
+/// 指定したセクタ番号のセクタデータがキャッシュにあるか
+/// @param[in] sector_pos : セクタ通し番号
+/// @return セクタデータ / NULL
+DiskPlainSector *DiskPlainSectorBlockCache::FindBySectorPos(int sector_pos)
+{
+	DiskPlainSectorBlock *block = FindBlock(sector_pos / DiskPlainSectorBlock::NumOfSecs);
+	if (!block) {
 		// ない
 		return NULL;
 	}
+	TouchLru(block);
+	return block->GetSector(sector_pos % DiskPlainSectorBlock::NumOfSecs);
 }
-/// 指定したセクタ番号のセクタデータがキャッシュにあるか（再帰）
-DiskPlainSectorBlock *DiskPlainSectorBlockCache::FindBySectorPosR(int depth, int seq_num, size_t index, size_t st, size_t ed)
+/// キャッシュにあるブロックを返す
+/// @param[in] seq_num ブロックの通し番号
+/// @return ブロック / NULL
+DiskPlainSectorBlock *DiskPlainSectorBlockCache::FindBlock(int seq_num)
 {
-	if (depth > 64) {
+	m_stats.m_lookups++;
+	DiskPlainSectorBlockMap::iterator it = m_cache.find(seq_num);
+	if (it == m_cache.end()) {
+		m_stats.m_misses++;
 		return NULL;
 	}
-
-	DiskPlainSectorBlock *itm = p_cache->Item(index);
-	int num = itm->GetNumber();
-	if (num > seq_num) {
-		// not match
-		if (index == st) {
-			return NULL;
-		} else {
-			ed = index - 1;
-			index = (ed + 1 - st) / 2 + st;
-			return FindBySectorPosR(depth + 1, seq_num, index, st, ed);
+	m_stats.m_hits++;
+	return it->second;
+}
+/// ブロックを返す なければファイルから読む
+/// @param[in] sector_pos : セクタ通し番号
+DiskPlainSectorBlock *DiskPlainSectorBlockCache::GetSectorBlock(int sector_pos)
+{
+	DiskPlainSectorBlock *block = FindBlock(sector_pos / DiskPlainSectorBlock::NumOfSecs);
+	if (block) {
+		TouchLru(block);
+		return block;
+	}
+	// キャッシュにないときはファイルからリードする
+	return AddSectorBlock(sector_pos);
+}
+/// セクタデータを得る
+DiskImageSector *DiskPlainSectorBlockCache::GetSector(int sector_pos)
+{
+	DiskPlainSectorBlock *block = GetSectorBlock(sector_pos);
+	return block->GetSector(sector_pos);
+}
+/// 連続したセクタを返す
+/// @param[in]  sector_pos 開始セクタ通し番号
+/// @param[in]  count      セクタ数
+/// @param[out] sectors    セクタ
+/// @return 得られたセクタ数
+int DiskPlainSectorBlockCache::GetSectors(int sector_pos, int count, DiskImageSectors &sectors)
+{
+	int done = 0;
+	while (done < count) {
+		int pos = sector_pos + done;
+		int idx = pos % DiskPlainSectorBlock::NumOfSecs;
+		int num = DiskPlainSectorBlock::NumOfSecs - idx;
+		if (num > count - done) num = count - done;
+
+		// ブロック単位でまとめて得る
+		DiskPlainSectorBlock *block = GetSectorBlock(pos);
+		for(int i=0; i<num; i++) {
+			sectors.Add(block->GetSector(idx + i));
 		}
-	} else if (num < seq_num) {
-		// not match
-		if (index == ed) {
-			return NULL;
+		done += num;
+	}
+	return done;
+}
+/// 連続したセクタのデータをバッファに読み込む
+///
+/// キャッシュにないブロックを丸ごと読む時はキャッシュを通さない。
+/// @param[in]  sector_pos 開始セクタ通し番号
+/// @param[in]  count      セクタ数
+/// @param[out] buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskPlainSectorBlockCache::ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size)
+{
+	size_t sector_size = p_parent->GetSectorSize();
+	if (sector_size == 0) return 0;
+	if ((size_t)count > size / sector_size) count = (int)(size / sector_size);
+
+	int done = 0;
+	while (done < count) {
+		int pos = sector_pos + done;
+		int seq_num = pos / DiskPlainSectorBlock::NumOfSecs;
+		int idx = pos % DiskPlainSectorBlock::NumOfSecs;
+		int num = DiskPlainSectorBlock::NumOfSecs - idx;
+		if (num > count - done) num = count - done;
+		wxUint8 *dst = &buffer[(size_t)done * sector_size];
+
+		int secs;
+		DiskPlainSectorBlock *block = FindBlock(seq_num);
+		if (!block && num == DiskPlainSectorBlock::NumOfSecs) {
+			size_t len = ReadBlockDirect(seq_num, dst, (size_t)num * sector_size);
+			secs = (int)(len / sector_size);
 		} else {
-			st = index + 1;
-			index = (ed + 1 - st) / 2 + st;
-			return FindBySectorPosR(depth + 1, seq_num, index, st, ed);
+			if (!block) {
+				block = AddSectorBlock(pos);
+			} else {
+				TouchLru(block);
+			}
+			secs = block->ReadSectors(idx, num, dst, sector_size);
 		}
-	} else {
-		// match
-		return itm;
+		done += secs;
+		if (secs < num) {
+			// ファイル終端
+			break;
+		}
+	}
+	return done;
+}
+/// 連続したセクタにバッファのデータを書き込む
+///
+/// 保存するまでファイルに反映しないので必ずキャッシュを通す。
+/// @param[in]  sector_pos 開始セクタ通し番号
+/// @param[in]  count      セクタ数
+/// @param[in]  buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskPlainSectorBlockCache::WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size)
+{
+	size_t sector_size = p_parent->GetSectorSize();
+	if (sector_size == 0) return 0;
+	if ((size_t)count > size / sector_size) count = (int)(size / sector_size);
+
+	int done = 0;
+	while (done < count) {
+		int pos = sector_pos + done;
+		int idx = pos % DiskPlainSectorBlock::NumOfSecs;
+		int num = DiskPlainSectorBlock::NumOfSecs - idx;
+		if (num > count - done) num = count - done;
+
+		DiskPlainSectorBlock *block = GetSectorBlock(pos);
+		int secs = block->WriteSectors(idx, num, &buffer[(size_t)done * sector_size], sector_size);
+		done += secs;
+		if (secs < num) {
+			// ファイル終端
+			break;
+		}
+	}
+	return done;
+}
+/// キャッシュを通さずにブロックのデータを読む
+/// @param[in]  seq_num ブロックの通し番号
+/// @param[out] buffer  バッファ
+/// @param[in]  size    ブロックサイズ
+/// @return 読み込んだサイズ
+size_t DiskPlainSectorBlockCache::ReadBlockDirect(int seq_num, wxUint8 *buffer, size_t size)
+{
+	wxFileOffset offset = (wxFileOffset)seq_num * size + m_start_offset;
+
+	if (p_map) {
+		// メモリマップ上のデータが最新
+		size_t map_size = p_map->GetRemainSize(offset);
+		if (map_size > size) map_size = size;
+		if (map_size > 0) {
+			memcpy(buffer, p_map->GetData(offset), map_size);
+		}
+		m_stats.m_read_bytes += map_size;
+		return map_size;
+	}
 
+	size_t read_size = 0;
+	// 書き込み待ちのデータがあればそちらが最新
+	if (p_flusher && p_flusher->ReadPending(seq_num, buffer, read_size)) {
+		return read_size;
+	}
+	// 先読みしたデータがあればそれを使う
+	if (p_prefetcher && p_prefetcher->Take(seq_num, buffer, read_size)) {
+		return read_size;
 	}
+
+	wxMutexLocker lock(m_stream_mutex);
+	wxFileStream *stream = p_parent->GetStream();
+	stream->SeekI(offset, wxFromStart);
+	read_size = stream->Read(buffer, size).LastRead();
+	m_stats.m_read_bytes += read_size;
+	return read_size;
 }
-/// セクタデータを得る
-DiskImageSector *DiskPlainSectorBlockCache::GetSector(int sector_pos)
+/// 指定範囲のセクタを先読みする
+/// @param[in] sector_pos 開始セクタ通し番号
+/// @param[in] count      セクタ数
+void DiskPlainSectorBlockCache::ReadAhead(int sector_pos, int count)
 {
-	// ファイルから指定位置をリードする
-	DiskImageSector *sector = FindBySectorPos(sector_pos);
-	if (sector) {
-		return sector;
+	if (m_read_ahead_count <= 0 || count <= 0) return;
+
+	int seq_num = sector_pos / DiskPlainSectorBlock::NumOfSecs;
+	int seq_end = (sector_pos + count - 1) / DiskPlainSectorBlock::NumOfSecs;
+	int blocks = seq_end - seq_num + 1;
+	if (blocks > m_read_ahead_count) blocks = m_read_ahead_count;
+	ReadAheadBlocks(seq_num, blocks);
+}
+/// 指定範囲のセクタをキャッシュに固定する
+///
+/// 固定した範囲はキャッシュから追い出さない。まだ読んでいないブロックはここで読んでおく。
+/// @param[in] sector_pos 開始セクタ通し番号
+/// @param[in] count      セクタ数
+/// @return false:固定できる最大数を超える
+bool DiskPlainSectorBlockCache::PinSectors(int sector_pos, int count)
+{
+	if (count <= 0) return false;
+
+	int seq_start = sector_pos / DiskPlainSectorBlock::NumOfSecs;
+	int seq_end = (sector_pos + count - 1) / DiskPlainSectorBlock::NumOfSecs;
+	if (!m_pinned.Pin(seq_start, seq_end)) {
+		return false;
 	}
-	// キャッシュにないときはファイルからリードする
-	DiskPlainSectorBlock *block = AddSectorBlock(sector_pos);
-	sector = block->GetSector(sector_pos);
-	return sector;
+
+	// ブロック単位で先頭から順に読む
+	for(int seq_num = seq_start; seq_num <= seq_end; seq_num++) {
+		if (m_cache.find(seq_num) != m_cache.end()) continue;
+		wxFileOffset offset = (wxFileOffset)seq_num * p_parent->GetSectorSize() * DiskPlainSectorBlock::NumOfSecs + m_start_offset;
+		if (offset >= m_file_size) break;
+		AddSectorBlock(seq_num * DiskPlainSectorBlock::NumOfSecs, false);
+	}
+	return true;
+}
+/// 指定範囲のセクタの固定を解除する
+/// @param[in] sector_pos 開始セクタ通し番号
+/// @param[in] count      セクタ数
+void DiskPlainSectorBlockCache::UnpinSectors(int sector_pos, int count)
+{
+	if (count <= 0) return;
+
+	int seq_start = sector_pos / DiskPlainSectorBlock::NumOfSecs;
+	int seq_end = (sector_pos + count - 1) / DiskPlainSectorBlock::NumOfSecs;
+	m_pinned.Unpin(seq_start, seq_end);
 }
 /// キャッシュを全てクリア ファイル更新もしない
 void DiskPlainSectorBlockCache::ClearCacheAll()
 {
-	size_t cnt = p_cache->Count();
-	for(size_t i=0; i<cnt; i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		delete itm;
+	// 追い出したデータは書き込み済みとして扱う
+	if (p_flusher) {
+		p_flusher->WaitForIdle();
+	}
+
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		delete it->second;
 	}
-	p_cache->Clear();
+	m_cache.clear();
+	p_lru_head = NULL;
+	p_lru_tail = NULL;
 	m_cache_overflowed = 0;
+
+	p_parent->IncreaseCacheGeneration();
+
+	// マップしなおして変更内容を破棄
+	if (p_map) {
+		p_map = p_parent->RemapFile();
+	}
 }
 /// キャッシュをクリア
 void DiskPlainSectorBlockCache::ClearCache(int start, int size)
 {
-	int end = start + size;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		int num = itm->GetNumber();
-		if (start > num || num >= end) continue;
-
-		RemoveSectorBlock(itm);
+	// 削除しながらハッシュをたどれないので先に集める
+	DiskPlainSectorBlocks blocks(DiskPlainSectorBlock::Compare);
+	CollectBlocks(start, size, blocks);
+	for(size_t i=0; i<blocks.Count(); i++) {
+		RemoveSectorBlock(blocks.Item(i));
 	}
 	m_cache_overflowed = 0;
 }
 /// セクタのリファレンス数をクリア
 void DiskPlainSectorBlockCache::ClearRefs(int start, int size)
 {
-	int end = start + size;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		int num = itm->GetNumber();
-		if (start > num || num >= end) continue;
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		DiskPlainSectorBlock *itm = it->second;
+		if (!itm->IsInRange(start, size)) continue;
 
 		itm->ClearRefs();
 	}
@@ -1379,96 +2906,139 @@ void DiskPlainSectorBlockCache::ClearRefs(int start, int size)
 /// 変更されているか
 bool DiskPlainSectorBlockCache::IsModified()
 {
-	bool modified = false;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		if (itm->IsModified()) {
-			modified = true;
-			break;
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		if (it->second->IsModified()) {
+			return true;
 		}
 	}
-	return modified;
+	return false;
 }
 /// 変更されているか
 bool DiskPlainSectorBlockCache::IsModified(int start, int size)
 {
-	int end = start + size;
-	bool modified = false;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		int num = itm->GetNumber();
-		if (start > num || num >= end) continue; 
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		DiskPlainSectorBlock *itm = it->second;
+		if (!itm->IsInRange(start, size)) continue;
 		if (itm->IsModified()) {
-			modified = true;
-			break;
+			return true;
 		}
 	}
-	return modified;
+	return false;
 }
 /// 変更をクリア
 void DiskPlainSectorBlockCache::ClearModify()
 {
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		DiskPlainSectorBlock *itm = it->second;
+		if (itm->IsMapped() && itm->IsModified()) RestoreMappedBlock(itm);
 		itm->ClearModify();
 	}
 }
 /// 変更をクリア
 void DiskPlainSectorBlockCache::ClearModify(int start, int size)
 {
-	int end = start + size;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		int num = itm->GetNumber();
-		if (start > num || num >= end) continue; 
+	DiskPlainSectorBlockMap::iterator it;
+	for(it = m_cache.begin(); it != m_cache.end(); it++) {
+		DiskPlainSectorBlock *itm = it->second;
+		if (!itm->IsInRange(start, size)) continue;
+		if (itm->IsMapped() && itm->IsModified()) RestoreMappedBlock(itm);
 		itm->ClearModify();
 	}
 }
+/// メモリマップ上のブロックの変更を破棄してファイルの内容に戻す
+///
+/// MAP_PRIVATEのページに残った変更が、ブロックを追い出した後に再び見えないようにする。
+/// @param[in] item ブロック
+void DiskPlainSectorBlockCache::RestoreMappedBlock(DiskPlainSectorBlock *item)
+{
+	if (!p_map) return;
+	wxUint8 *data = p_map->GetData(item->GetFileOffset());
+	size_t size = item->GetBufferSize();
+	if (!data || size > p_map->GetRemainSize(item->GetFileOffset())) return;
+
+	wxMutexLocker lock(m_stream_mutex);
+	wxFile *file = static_cast<wxFileInputStream *>(p_parent->GetStream())->GetFile();
+	if (!file || !file->IsOpened()) return;
+	if (file->Seek(item->GetFileOffset(), wxFromStart) == wxInvalidOffset) return;
+	file->Read(data, size);
+}
 /// データをすべて出力
-void DiskPlainSectorBlockCache::Flush()
+/// @return false:書き込みエラー 書けなかったセクタは変更済みのまま
+bool DiskPlainSectorBlockCache::Flush()
 {
-	if (p_parent->IsWriteProtected()) return;
+	if (p_parent->IsWriteProtected()) return true;
 
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
+	wxStopWatch sw;
 
-		// データが更新されている場合はファイルにライト
-		if (itm->IsModified()) {
-			wxFileStream *stream = p_parent->GetStream();
+	// 古いデータで上書きしないよう書き込み待ちを先に終わらせる
+	if (p_flusher) {
+		p_flusher->WaitForIdle();
+	}
 
-			stream->SeekO(itm->GetFileOffset(), wxFromStart);
-			stream->Write(itm->GetBufferData(), itm->GetBufferSize());
+	// ファイルの先頭から順に変更したセクタだけを書き込む
+	DiskPlainSectorBlocks blocks(DiskPlainSectorBlock::Compare);
+	CollectBlocks(blocks);
+	bool ok = WriteModifiedSectors(blocks, true);
 
-			itm->ClearModify();
-		}
-	}
+	m_stats.m_flushes++;
+	m_stats.m_flush_time += sw.Time();
+
+	return ok;
 }
 /// 範囲内のデータを出力
-void DiskPlainSectorBlockCache::Flush(int start, int size)
+/// @return false:書き込みエラー 書けなかったセクタは変更済みのまま
+bool DiskPlainSectorBlockCache::Flush(int start, int size)
 {
-	if (p_parent->IsWriteProtected()) return;
+	if (p_parent->IsWriteProtected()) return true;
 
-	int end = start + size;
-	for(size_t i=0; i<p_cache->Count(); i++) {
-		DiskPlainSectorBlock *itm = p_cache->Item(i);
-		int num = itm->GetNumber();
-		if (start > num || num >= end) continue; 
+	wxStopWatch sw;
 
-		// データが更新されている場合はファイルにライト
-		if (itm->IsModified()) {
-			wxFileStream *stream = p_parent->GetStream();
+	// 古いデータで上書きしないよう書き込み待ちを先に終わらせる
+	if (p_flusher) {
+		p_flusher->WaitForIdle();
+	}
 
-			stream->SeekO(itm->GetFileOffset(), wxFromStart);
-			stream->Write(itm->GetBufferData(), itm->GetBufferSize());
+	// ファイルの先頭から順に変更したセクタだけを書き込む
+	DiskPlainSectorBlocks blocks(DiskPlainSectorBlock::Compare);
+	CollectBlocks(start, size, blocks);
+	bool ok = WriteModifiedSectors(blocks, true);
 
-			itm->ClearModify();
-		}
-	}
+	m_stats.m_flushes++;
+	m_stats.m_flush_time += sw.Time();
+
+	return ok;
 }
 /// ステータスメッセージ
 void DiskPlainSectorBlockCache::GetStatusMessage(wxString &str) const
 {
-	str = wxString::Format(wxT("Cached: %d/%d"), (int)p_cache->Count(), (int)m_limit_count);
+	str = wxString::Format(wxT("Cached: %d/%d"), (int)m_cache.size(), (int)m_limit_count);
+	if (p_map) {
+		str += wxT(" (mapped)");
+	}
+	if (p_flusher) {
+		size_t pending = p_flusher->GetPendingCount();
+		if (pending > 0) {
+			str += wxString::Format(wxT(" Writing: %d"), (int)pending);
+		}
+	}
+}
+/// 統計情報
+/// @param[out] stats 統計情報
+void DiskPlainSectorBlockCache::GetStats(DiskImageCacheStats &stats) const
+{
+	stats = m_stats;
+	// バックグラウンドで読み書きした分を加える
+	if (p_flusher) {
+		stats.m_written_bytes += p_flusher->GetWrittenBytes();
+	}
+	if (p_prefetcher) {
+		stats.m_read_bytes += p_prefetcher->GetReadBytes();
+	}
+	stats.m_cached_count = m_cache.size();
+	stats.m_limit_count = m_limit_count;
 }
 
 #endif // USE_SECTOR_BLOCK_CACHE
@@ -1486,7 +3056,11 @@ DiskPlainFile::DiskPlainFile()
 	m_start_offset = 0;
 	m_block_size = 0;
 	p_cache = NULL;
+#ifdef USE_SECTOR_BLOCK_CACHE
+	p_map = NULL;
+#endif
 	m_write_protected = true;
+	m_cache_generation = 1;
 }
 
 DiskPlainFile::~DiskPlainFile()
@@ -1532,13 +3106,20 @@ void DiskPlainFile::Clear()
 		delete p_disks;
 		p_disks = NULL;
 	}
-	if (p_stream) {
-		delete p_stream;
-		p_stream = NULL;
-	}
 	if (p_cache) {
 		delete p_cache;
 		p_cache = NULL;
+		IncreaseCacheGeneration();
+	}
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (p_map) {
+		delete p_map;
+		p_map = NULL;
+	}
+#endif
+	if (p_stream) {
+		delete p_stream;
+		p_stream = NULL;
 	}
 }
 
@@ -1582,11 +3163,7 @@ DiskImageDisk *DiskPlainFile::GetDisk(size_t idx)
 DiskImageSector *DiskPlainFile::GetSector(int sector_pos)
 {
 	if (!p_cache) {
-#ifdef USE_SECTOR_BLOCK_CACHE
-		p_cache = new DiskPlainSectorBlockCache(this, m_start_offset);
-#else
-		p_cache = new DiskPlainSectorCache(this, m_start_offset);
-#endif
+		CreateCache();
 	}
 	return p_cache->GetSector(sector_pos);
 }
@@ -1595,14 +3172,145 @@ DiskImageSector *DiskPlainFile::GetSector(int sector_pos)
 void DiskPlainFile::RefreshCache(int sector_pos)
 {
 	if (!p_cache) {
+		CreateCache();
+	}
+	p_cache->GetSector(sector_pos);
+}
+
+/// 指定範囲のセクタを先読みする
+/// @param[in] sector_pos セクタ位置（0からの通し番号）
+/// @param[in] count      セクタ数
+void DiskPlainFile::ReadAhead(int sector_pos, int count)
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) {
+		CreateCache();
+	}
+	p_cache->ReadAhead(sector_pos, count);
+#endif
+}
+
+/// 指定範囲のセクタをキャッシュに固定する
+/// @param[in] sector_pos 開始セクタ位置（0からの通し番号）
+/// @param[in] count      セクタ数
+/// @return false:固定できない
+bool DiskPlainFile::PinSectors(int sector_pos, int count)
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) {
+		CreateCache();
+	}
+	return p_cache->PinSectors(sector_pos, count);
+#else
+	return false;
+#endif
+}
+
+/// 指定範囲のセクタの固定を解除する
+/// @param[in] sector_pos 開始セクタ位置（0からの通し番号）
+/// @param[in] count      セクタ数
+void DiskPlainFile::UnpinSectors(int sector_pos, int count)
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) return;
+	p_cache->UnpinSectors(sector_pos, count);
+#endif
+}
+
+/// 連続したセクタを返す
+/// @param[in]  sector_pos 開始セクタ位置（0からの通し番号）
+/// @param[in]  count      セクタ数
+/// @param[out] sectors    セクタ
+/// @return 得られたセクタ数
+int DiskPlainFile::GetSectors(int sector_pos, int count, DiskImageSectors &sectors)
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) {
+		CreateCache();
+	}
+	return p_cache->GetSectors(sector_pos, count, sectors);
+#else
+	return DiskImageFile::GetSectors(sector_pos, count, sectors);
+#endif
+}
+
+/// 連続したセクタのデータをバッファに読み込む
+/// @param[in]  sector_pos 開始セクタ位置（0からの通し番号）
+/// @param[in]  count      セクタ数
+/// @param[out] buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 読み込んだセクタ数
+int DiskPlainFile::ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size)
+{
 #ifdef USE_SECTOR_BLOCK_CACHE
-		p_cache = new DiskPlainSectorBlockCache(this, m_start_offset);
+	if (!p_cache) {
+		CreateCache();
+	}
+	return p_cache->ReadSectors(sector_pos, count, buffer, size);
 #else
-		p_cache = new DiskPlainSectorCache(this, m_start_offset);
+	return DiskImageFile::ReadSectors(sector_pos, count, buffer, size);
 #endif
+}
+
+/// 連続したセクタにバッファのデータを書き込む
+/// @param[in]  sector_pos 開始セクタ位置（0からの通し番号）
+/// @param[in]  count      セクタ数
+/// @param[in]  buffer     バッファ
+/// @param[in]  size       バッファサイズ
+/// @return 書き込んだセクタ数
+int DiskPlainFile::WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size)
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) {
+		CreateCache();
 	}
-	p_cache->GetSector(sector_pos);
+	return p_cache->WriteSectors(sector_pos, count, buffer, size);
+#else
+	return DiskImageFile::WriteSectors(sector_pos, count, buffer, size);
+#endif
 }
+
+/// キャッシュを作成
+void DiskPlainFile::CreateCache()
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	// 設定によりファイルをメモリにマップする できない時はファイルから読む
+	if (!p_map && gConfig.DoesUseMemoryMappedFile()) {
+		p_map = new DiskPlainFileMap();
+		if (!p_map->Map(p_stream)) {
+			delete p_map;
+			p_map = NULL;
+		}
+	}
+	p_cache = new DiskPlainSectorBlockCache(this, m_start_offset, p_map && p_map->IsMapped() ? p_map : NULL);
+#else
+	p_cache = new DiskPlainSectorCache(this, m_start_offset);
+#endif
+}
+/// キャッシュの世代を進める
+///
+/// キャッシュからセクタを削除した時に呼ぶ。
+/// 0 は保持できないことを示すので使わない。
+void DiskPlainFile::IncreaseCacheGeneration()
+{
+	m_cache_generation++;
+	if (m_cache_generation == 0) m_cache_generation = 1;
+}
+#ifdef USE_SECTOR_BLOCK_CACHE
+/// メモリマップをしなおす 変更内容は破棄
+///
+/// マップできない時はマップを削除し、以降はファイルから読む。
+/// @return マップ / NULL マップできない
+DiskPlainFileMap *DiskPlainFile::RemapFile()
+{
+	if (!p_map) return NULL;
+	if (!p_map->Remap()) {
+		delete p_map;
+		p_map = NULL;
+	}
+	return p_map;
+}
+#endif
 /// キャッシュをクリア ファイル更新もしない
 void DiskPlainFile::ClearCacheAll()
 {
@@ -1646,16 +3354,18 @@ void DiskPlainFile::ClearModify(wxUint32 start, wxUint32 size)
 	p_cache->ClearModify(start, size);
 }
 /// データをすべて出力
-void DiskPlainFile::Flush()
+/// @return false:書き込みエラー
+bool DiskPlainFile::Flush()
 {
-	if (!p_cache) return;
-	p_cache->Flush();
+	if (!p_cache) return true;
+	return p_cache->Flush();
 }
 /// 範囲内のデータを出力
-void DiskPlainFile::Flush(wxUint32 start, wxUint32 size)
+/// @return false:書き込みエラー
+bool DiskPlainFile::Flush(wxUint32 start, wxUint32 size)
 {
-	if (!p_cache) return;
-	p_cache->Flush(start, size);
+	if (!p_cache) return true;
+	return p_cache->Flush(start, size);
 }
 
 /// 書き込み禁止かどうかを返す
@@ -1695,6 +3405,20 @@ void DiskPlainFile::GetStatusMessage(wxString &str) const
 	p_cache->GetStatusMessage(str);
 }
 
+/// キャッシュの統計情報
+/// @param[out] stats 統計情報
+/// @return false:統計をとっていない
+bool DiskPlainFile::GetCacheStats(DiskImageCacheStats &stats) const
+{
+#ifdef USE_SECTOR_BLOCK_CACHE
+	if (!p_cache) return false;
+	p_cache->GetStats(stats);
+	return true;
+#else
+	return false;
+#endif
+}
+
 // ----------------------------------------------------------------------
 
 //
@@ -1771,6 +3495,15 @@ int DiskPlain::Open(const wxString &filepath, const wxString &file_format, const
 	DiskParser ps(filepath, fstream, p_file, m_result);
 	int valid_disk = ps.Parse(file_format, param_hint, NULL);
 
+	// 前回の解析結果を読み込む
+	if (valid_disk >= 0 && gConfig.DoesUseIndexFile()) {
+		DiskImageIndex *index = new DiskImageIndex();
+		if (index->Load(filepath)) {
+			myLog.SetInfo(wxT("Loaded the index file."));
+		}
+		p_file->SetIndex(index);
+	}
+
 	// エラーあり 閉じない
 //	if (valid_disk < 0) {
 //		ClearFile();
@@ -1844,6 +3577,10 @@ int DiskPlain::ReOpen(const BootParam &boot_param)
 /// 閉じる
 void DiskPlain::Close()
 {
+	// 変更がなければ解析結果を保存する
+	if (p_file && p_file->GetIndex() && !p_file->IsModified()) {
+		p_file->GetIndex()->Save(p_file->GetFilePath());
+	}
 	ClearFile();
 }
 
@@ -14,6 +14,7 @@
 //#include <wx/mstream.h>
 #include <wx/dynarray.h>
 #include <wx/hashmap.h>
+#include <wx/thread.h>
 #include "diskimage.h"
 #include "diskparam.h"
 #include "diskresult.h"
@@ -44,7 +45,12 @@ protected:
 	int m_size;				///< data size
 	wxFileOffset m_offset;	///< seek offset in file
 
-	wxUint32 m_crc_32;
+	bool m_modified;		///< 変更済み
+	bool m_exposed;			///< バッファへのポインタを外部に渡した
+	wxUint32 m_crc_32;		///< ポインタを渡した時点のCRC
+
+	/// バッファへのポインタを外部に渡す
+	virtual void Expose();
 
 	DiskPlainSector(const DiskPlainSector &src) {}
 	DiskPlainSector &operator=(const DiskPlainSector &src) { return *this; }
@@ -92,14 +98,27 @@ public:
 	virtual wxUint8 *GetSectorBuffer() wxOVERRIDE;
 	/// セクタデータへのポインタを返す
 	virtual wxUint8 *GetSectorBuffer(int offset) wxOVERRIDE;
+	/// 読み込み用にセクタデータへのポインタを返す
+	virtual const wxUint8 *GetSectorBufferForRead(int offset = 0) wxOVERRIDE;
+	/// 書き込み用にセクタデータへのポインタを返す(変更済みにする)
+	virtual wxUint8 *GetSectorBufferForWrite(int offset = 0) wxOVERRIDE;
 
 	/// ファイルオフセットを返す
 	wxFileOffset GetFileOffset() const { return m_offset; }
 
 	/// 変更されているか
-	bool	IsModified() const wxOVERRIDE;
+	virtual bool IsModified() const wxOVERRIDE;
+	/// 変更済みにする
+	virtual void SetModify() wxOVERRIDE;
 	/// 変更済みをクリア
-	void	ClearModify() wxOVERRIDE;
+	virtual void ClearModify() wxOVERRIDE;
+
+	/// ポインタを外部に渡したか
+	bool	IsExposed() const { return m_exposed; }
+	/// ポインタを渡した時点から内容が変わったか
+	bool	IsChangedSinceExposed() const;
+	/// ポインタを渡した時点の内容として現在の内容を保存
+	void	UpdateExposedData();
 
 	/// セクタ番号の比較
 	static int Compare(DiskPlainSector *item1, DiskPlainSector *item2);
@@ -173,6 +192,10 @@ class DiskPlainSectorForBlock : public DiskPlainSector
 {
 private:
 	DiskPlainSectorBlock *p_block;
+	int m_index;	///< ブロック内の位置
+
+	/// バッファへのポインタを外部に渡す
+	void Expose();
 
 public:
 	DiskPlainSectorForBlock();
@@ -180,7 +203,7 @@ public:
 	virtual ~DiskPlainSectorForBlock();
 
 	/// ブロックキャッシュを設定
-	void SetSectorBlock(DiskPlainSectorBlock *block) { p_block = block; }
+	void SetSectorBlock(DiskPlainSectorBlock *block, int index) { p_block = block; m_index = index; }
 
 	/// セクタの情報を設定
 	void Set(int n_num, DiskImageSectorHeader &n_header, wxUint8 *n_data, int n_size, wxFileOffset n_offset);
@@ -193,6 +216,17 @@ public:
 	wxUint8 *GetSectorBuffer();
 	/// セクタデータへのポインタを返す
 	wxUint8 *GetSectorBuffer(int offset);
+	/// 読み込み用にセクタデータへのポインタを返す
+	const wxUint8 *GetSectorBufferForRead(int offset = 0);
+	/// 書き込み用にセクタデータへのポインタを返す(変更済みにする)
+	wxUint8 *GetSectorBufferForWrite(int offset = 0);
+
+	/// 変更されているか
+	bool IsModified() const;
+	/// 変更済みにする
+	void SetModify();
+	/// 変更済みをクリア
+	void ClearModify();
 
 	/// アクセス時間を更新
 	void UpdateAccessTime();
@@ -236,6 +270,9 @@ private:
 
 	DiskBasics *p_basics;	///< ファイルシステム候補
 
+	/// パーティション内に収まるセクタ数を返す
+	int LimitSectorCount(int block_num, int count) const;
+
 	DiskPlainDisk() : DiskImageDisk() {}
 	DiskPlainDisk(const DiskPlainDisk &src) : DiskImageDisk(src) {}
 	DiskPlainDisk &operator=(const DiskPlainDisk &src) { return *this; }
@@ -265,6 +302,22 @@ public:
 	DiskImageSector *GetSector(int sector_pos) wxOVERRIDE;
 	/// キャッシュを更新する
 	void	RefreshCache(int sector_pos) wxOVERRIDE;
+	/// キャッシュの世代を返す
+	wxUint32 GetCacheGeneration() const wxOVERRIDE;
+	/// 指定範囲のセクタを先読みする
+	void	ReadAhead(int block_num, int count) wxOVERRIDE;
+	/// 指定範囲のセクタをキャッシュに固定する
+	bool	PinSectors(int block_num, int count) wxOVERRIDE;
+	/// 指定範囲のセクタの固定を解除する
+	void	UnpinSectors(int block_num, int count) wxOVERRIDE;
+	/// 連続したセクタを返す
+	int		GetSectors(int block_num, int count, DiskImageSectors &sectors) wxOVERRIDE;
+	/// 連続したセクタのデータをバッファに読み込む
+	int		ReadSectors(int block_num, int count, wxUint8 *buffer, size_t size) wxOVERRIDE;
+	/// 連続したセクタにバッファのデータを書き込む
+	int		WriteSectors(int block_num, int count, const wxUint8 *buffer, size_t size) wxOVERRIDE;
+	/// 連続したセクタがすべてディスクのセクタサイズと同じか べたイメージは常に同じ
+	bool	IsUniformSectorSize(int block_num, int count) wxOVERRIDE { return true; }
 
 	/// 書き込み禁止かどうかを返す
 	bool IsWriteProtected() const wxOVERRIDE;
@@ -313,7 +366,7 @@ public:
 	void	ClearModify() wxOVERRIDE;
 
 	/// データをすべて出力	
-	void	Flush() wxOVERRIDE;
+	bool	Flush() wxOVERRIDE;
 
 	/// パラメータ変更フラグを設定
 	void	SetParamChanged(bool val) wxOVERRIDE {}
@@ -394,9 +447,9 @@ public:
 	/// 範囲内のセクタ変更をクリア
 	void ClearModify(wxUint32 start, wxUint32 size);
 	/// データをすべて出力
-	void Flush();
+	bool Flush();
 	/// 範囲内のデータを出力
-	void Flush(wxUint32 start, wxUint32 size);
+	bool Flush(wxUint32 start, wxUint32 size);
 	/// ステータスメッセージ
 	void GetStatusMessage(wxString &str) const;
 };
@@ -410,23 +463,41 @@ class DiskPlainSectorBlock
 {
 public:
 	enum enFlags {
-		NumOfSecs = 128
+		NumOfSecs = 128,
+		NumOfFlagWords = (NumOfSecs + 31) / 32
 	};
 private:
 	DiskPlainSectorForBlock m_cache[NumOfSecs];
+	wxUint32 m_dirty[NumOfFlagWords];	///< 変更したセクタのビットマップ
+	wxUint32 m_exposed[NumOfFlagWords];	///< ポインタを外部に渡したセクタのビットマップ
 	int m_seq_num;	///< 通し番号
 	Utils::TempData *p_data;	///< cached data in file
+	wxUint8 *p_buffer;		///< data buffer (p_data or mapped memory)
+	size_t m_buffer_size;	///< size of data buffer
 	wxFileOffset m_offset;	///< seek offset in file
 	time_t m_accs_time;		///< access time
 	int m_refs_count;	///< lock in cache
+	DiskPlainSectorBlock *p_lru_prev;	///< LRUリストの前(新しい側)
+	DiskPlainSectorBlock *p_lru_next;	///< LRUリストの次(古い側)
+
+	/// 各セクタへのポインタを設定
+	void SetSectors(DiskImageSectorHeader &header, int sector_pos, size_t sector_size);
+	/// フラグをクリア
+	void ClearFlags();
+
 public:
 	DiskPlainSectorBlock();
 	DiskPlainSectorBlock(int seq_num);
-	DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, const wxUint8 *data, size_t size, int sector_pos, size_t sector_size, wxFileOffset offset);
+	DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, Utils::TempData *data, int sector_pos, size_t sector_size, wxFileOffset offset);
+	DiskPlainSectorBlock(int seq_num, DiskImageSectorHeader &header, wxUint8 *mapped_data, size_t size, int sector_pos, size_t sector_size, wxFileOffset offset, bool mapped);
 	~DiskPlainSectorBlock();
 
 	/// セクタを返す
 	DiskPlainSector *GetSector(int sector_pos);
+	/// 連続したセクタのデータをバッファに読み込む
+	int ReadSectors(int index, int count, wxUint8 *buffer, size_t sector_size);
+	/// 連続したセクタにバッファのデータを書き込む
+	int WriteSectors(int index, int count, const wxUint8 *buffer, size_t sector_size);
 	/// 通し番号を返す
 	int GetNumber() const { return m_seq_num; }
 	/// ファイルオフセットを返す
@@ -435,10 +506,22 @@ public:
 	wxUint8 *GetBufferData() const;
 	/// バッファサイズを返す
 	size_t GetBufferSize() const;
+	/// バッファを切り離して返す
+	Utils::TempData *DetachBuffer();
+	/// メモリマップ上のデータか
+	bool IsMapped() const { return (p_data == NULL && p_buffer != NULL); }
 	/// 変更されているか
 	bool IsModified() const;
 	/// 変更をクリア
 	void ClearModify();
+	/// 指定セクタが変更されているか
+	bool IsModified(int index) const;
+	/// 指定セクタを変更済みにする
+	void SetModify(int index);
+	/// 指定セクタの変更をクリア
+	void ClearModify(int index);
+	/// 指定セクタのポインタを外部に渡したことを記録
+	void SetExposed(int index);
 
 	/// アクセス時間を更新
 	void UpdateAccessTime();
@@ -454,22 +537,334 @@ public:
 	/// リファレンス数を減らす
 	void DecRefs() { m_refs_count--; }
 
+	/// 指定したセクタ範囲にかかるか
+	bool IsInRange(int start, int size) const;
+
+	/// LRUリストの前(新しい側)のブロック
+	DiskPlainSectorBlock *GetLruPrev() const { return p_lru_prev; }
+	/// LRUリストの次(古い側)のブロック
+	DiskPlainSectorBlock *GetLruNext() const { return p_lru_next; }
+	/// LRUリストの前のブロックを設定
+	void SetLruPrev(DiskPlainSectorBlock *val) { p_lru_prev = val; }
+	/// LRUリストの次のブロックを設定
+	void SetLruNext(DiskPlainSectorBlock *val) { p_lru_next = val; }
+
 	/// セクタ番号の比較
 	static int Compare(DiskPlainSectorBlock *item1, DiskPlainSectorBlock *item2);
-	/// アクセス時間の比較
-	static int CompareAccessTime(DiskPlainSectorBlock *item1, DiskPlainSectorBlock *item2);
 };
 
 // ----------------------------------------------------------------------
 
 WX_DEFINE_SORTED_ARRAY(DiskPlainSectorBlock *, DiskPlainSectorBlocks);
 
+WX_DEFINE_ARRAY(Utils::TempData *, DiskPlainBlockBuffers);
+
+WX_DECLARE_HASH_MAP( int, int, wxIntegerHash, wxIntegerEqual, DiskPlainPinCountMap );
+
+/// キャッシュから追い出さないセクタブロック
+///
+/// FATやディレクトリ領域など繰り返し参照するブロックを通し番号ごとに登録数で管理する。
+class DiskPlainPinnedBlocks
+{
+private:
+	DiskPlainPinCountMap m_counts;	///< 通し番号ごとの登録数
+	size_t m_max_count;				///< 固定できる最大ブロック数
+
+public:
+	DiskPlainPinnedBlocks();
+
+	/// 固定できる最大ブロック数を設定
+	void SetMaxCount(size_t val) { m_max_count = val; }
+	/// 指定範囲のブロックを固定する
+	bool Pin(int seq_start, int seq_end);
+	/// 指定範囲のブロックの固定を解除する
+	void Unpin(int seq_start, int seq_end);
+	/// 固定しているブロックか
+	bool IsPinned(int seq_num) const;
+	/// 固定しているブロック数
+	size_t Count() const { return m_counts.size(); }
+	/// クリア
+	void Clear() { m_counts.clear(); }
+};
+
+/// セクタブロック用バッファのプール
+///
+/// 同じサイズのバッファを使いまわしてブロックごとの確保と解放をなくす。
+class DiskPlainBlockBufferPool
+{
+private:
+	DiskPlainBlockBuffers m_free;	///< 空いているバッファ
+	size_t m_buffer_size;	///< バッファサイズ
+	size_t m_max_count;		///< 保持する最大数
+
+	DiskPlainBlockBufferPool(const DiskPlainBlockBufferPool &) {}
+	DiskPlainBlockBufferPool &operator=(const DiskPlainBlockBufferPool &) { return *this; }
+
+public:
+	DiskPlainBlockBufferPool();
+	~DiskPlainBlockBufferPool();
+
+	/// バッファサイズと保持する最大数を設定
+	void SetSize(size_t buffer_size, size_t max_count);
+	/// バッファを得る
+	Utils::TempData *Get();
+	/// バッファを返す
+	void Release(Utils::TempData *data);
+	/// 空いているバッファをすべて解放
+	void Clear();
+};
+
+/// 通し番号をキーにしたセクタブロックのハッシュ
+WX_DECLARE_HASH_MAP(int, DiskPlainSectorBlock *, wxIntegerHash, wxIntegerEqual, DiskPlainSectorBlockMap);
+
+// ----------------------------------------------------------------------
+
+/// ディスクイメージファイルをメモリにマップするクラス
+///
+/// 書き込み時コピー(copy-on-write)でマップするので、変更したデータは
+/// Flush()でファイルに書き込むまでファイルには反映されない。
+class DiskPlainFileMap
+{
+private:
+	wxUint8 *p_data;		///< マップした先頭アドレス
+	size_t m_size;			///< マップしたサイズ
+	wxFileStream *p_stream;	///< マップ元のファイル
+#ifdef __WXMSW__
+	void *m_handle;			///< ファイルマッピングオブジェクト
+#endif
+
+	DiskPlainFileMap(const DiskPlainFileMap &) {}
+	DiskPlainFileMap &operator=(const DiskPlainFileMap &) { return *this; }
+
+public:
+	DiskPlainFileMap();
+	~DiskPlainFileMap();
+
+	/// ファイルをメモリにマップする
+	bool Map(wxFileStream *stream);
+	/// マップを解除する
+	void Unmap();
+	/// マップしなおす 変更内容は破棄
+	bool Remap();
+	/// マップしているか
+	bool IsMapped() const { return (p_data != NULL); }
+	/// 指定位置のデータへのポインタを返す
+	wxUint8 *GetData(wxFileOffset offset) const;
+	/// 指定位置から読めるサイズを返す
+	size_t GetRemainSize(wxFileOffset offset) const;
+	/// 指定範囲をまもなく読むことをOSに通知する
+	void WillNeed(wxFileOffset offset, size_t size) const;
+	/// マップしたサイズを返す
+	size_t GetSize() const { return m_size; }
+};
+
+/// バックグラウンドでファイルに書き込むデータ
+class DiskPlainWriteRequest
+{
+private:
+	int m_seq_num;			///< ブロックの通し番号
+	wxFileOffset m_offset;	///< seek offset in file
+	Utils::TempData *p_data;	///< 書き込むデータ
+	int m_serial;			///< 登録順
+
+	DiskPlainWriteRequest() {}
+	DiskPlainWriteRequest(const DiskPlainWriteRequest &) {}
+	DiskPlainWriteRequest &operator=(const DiskPlainWriteRequest &) { return *this; }
+
+public:
+	DiskPlainWriteRequest(int seq_num, wxFileOffset offset, Utils::TempData *data, int serial);
+	~DiskPlainWriteRequest();
+
+	/// 通し番号を返す
+	int GetNumber() const { return m_seq_num; }
+	/// ファイルオフセットを返す
+	wxFileOffset GetFileOffset() const { return m_offset; }
+	/// データを返す
+	wxUint8 *GetData() const { return p_data->GetData(); }
+	/// データサイズを返す
+	size_t GetSize() const { return p_data->GetSize(); }
+	/// 登録順を返す
+	int GetSerial() const { return m_serial; }
+
+	/// オフセット順に比較
+	static int Compare(DiskPlainWriteRequest *item1, DiskPlainWriteRequest *item2);
+};
+
+WX_DEFINE_SORTED_ARRAY(DiskPlainWriteRequest *, DiskPlainWriteRequests);
+
+/// 変更したセクタブロックをバックグラウンドでファイルに書き込むスレッド
+///
+/// ファイルオフセット順に書き込む。
+/// ストリームへのアクセスは呼び出し元と共有するミューテックスで排他する。
+class DiskPlainFileFlusher : public wxThread
+{
+private:
+	wxFileStream *p_stream;		///< 書き込み先
+	wxMutex *p_stream_mutex;	///< ストリームの排他
+	wxMutex m_mutex;			///< キューの排他
+	wxCondition m_queued;		///< キューに追加した
+	wxCondition m_written;		///< 書き込みが終わった
+	DiskPlainWriteRequests m_queue;	///< 書き込み待ちのデータ
+	size_t m_max_count;		///< 書き込み待ちにできる最大数
+	int m_serial;			///< 登録順
+	bool m_exit;			///< 終了要求
+	wxUint64 m_written_bytes;	///< 書き込んだバイト数
+
+protected:
+	ExitCode Entry() wxOVERRIDE;
+
+public:
+	DiskPlainFileFlusher(wxFileStream *stream, wxMutex *stream_mutex, size_t max_count);
+	~DiskPlainFileFlusher();
+
+	/// スレッドを開始
+	bool Start();
+	/// 書き込み待ちのデータをすべて書き込んでスレッドを終了
+	void Stop();
+	/// 書き込み待ちに追加する dataの所有権は移る
+	void Push(int seq_num, wxFileOffset offset, Utils::TempData *data);
+	/// 書き込み待ちのデータがあればバッファにコピーする
+	bool ReadPending(int seq_num, wxUint8 *buffer, size_t &size);
+	/// 書き込み待ちのデータがあるか
+	bool IsPending(int seq_num);
+	/// 書き込み待ちがなくなるまで待つ
+	void WaitForIdle();
+	/// 書き込み待ちの数
+	size_t GetPendingCount();
+	/// 書き込んだバイト数
+	wxUint64 GetWrittenBytes();
+};
+
+// ----------------------------------------------------------------------
+
+/// 先読みするセクタブロック
+class DiskPlainReadRequest
+{
+private:
+	int m_seq_num;			///< ブロックの通し番号
+	wxFileOffset m_offset;	///< seek offset in file
+	size_t m_size;			///< 読み込むサイズ
+	Utils::TempData *p_data;	///< 読み込んだデータ(読み込み前はNULL)
+
+	DiskPlainReadRequest() {}
+	DiskPlainReadRequest(const DiskPlainReadRequest &) {}
+	DiskPlainReadRequest &operator=(const DiskPlainReadRequest &) { return *this; }
+
+public:
+	DiskPlainReadRequest(int seq_num, wxFileOffset offset, size_t size);
+	~DiskPlainReadRequest();
+
+	/// 通し番号を返す
+	int GetNumber() const { return m_seq_num; }
+	/// ファイルオフセットを返す
+	wxFileOffset GetFileOffset() const { return m_offset; }
+	/// 読み込むサイズを返す
+	size_t GetSize() const { return m_size; }
+	/// 読み込んだデータを返す
+	Utils::TempData *GetData() const { return p_data; }
+	/// 読み込んだデータを設定
+	void SetData(Utils::TempData *data) { p_data = data; }
+	/// 読み込み済みか
+	bool IsLoaded() const { return (p_data != NULL); }
+};
+
+WX_DEFINE_ARRAY(DiskPlainReadRequest *, DiskPlainReadRequests);
+
+/// セクタブロックをバックグラウンドで先読みするスレッド
+///
+/// 依頼された順に読み込む。
+/// ストリームへのアクセスは呼び出し元と共有するミューテックスで排他する。
+class DiskPlainFilePrefetcher : public wxThread
+{
+private:
+	wxFileStream *p_stream;		///< 読み込み元
+	wxMutex *p_stream_mutex;	///< ストリームの排他
+	wxMutex m_mutex;			///< キューの排他
+	wxCondition m_requested;	///< 先読みを依頼した
+	wxCondition m_loaded;		///< 読み込みが終わった
+	DiskPlainReadRequests m_queue;	///< 先読み待ちと読み込み済みのデータ
+	DiskPlainReadRequest *p_reading;	///< 読み込み中のデータ
+	size_t m_max_count;		///< 保持できる最大数
+	bool m_exit;			///< 終了要求
+	wxUint64 m_read_bytes;	///< 読み込んだバイト数
+
+	/// 次に読み込むデータ
+	DiskPlainReadRequest *FindNextRequest() const;
+	/// 指定ブロックのデータ
+	int FindRequest(int seq_num) const;
+
+protected:
+	ExitCode Entry() wxOVERRIDE;
+
+public:
+	DiskPlainFilePrefetcher(wxFileStream *stream, wxMutex *stream_mutex, size_t max_count);
+	~DiskPlainFilePrefetcher();
+
+	/// スレッドを開始
+	bool Start();
+	/// スレッドを終了
+	void Stop();
+	/// 先読みを依頼する
+	void Request(int seq_num, wxFileOffset offset, size_t size);
+	/// 先読みしたデータを取り出す
+	bool Take(int seq_num, wxUint8 *buffer, size_t &size);
+	/// 先読みしたデータをバッファごと取り出す
+	Utils::TempData *Take(int seq_num);
+	/// 読み込んだバイト数
+	wxUint64 GetReadBytes();
+};
+
+// ----------------------------------------------------------------------
+
+/// ファイル上で連続する領域にまとめて書き込むデータ
+///
+/// 隣り合うブロックのデータはメモリ上で離れているのでベクタで保持する。
+class DiskPlainWriteRun
+{
+public:
+	enum enFlags {
+		MaxVectors = 64
+	};
+private:
+	wxFileOffset m_offset;	///< 書き込み開始位置
+	size_t m_size;			///< 合計サイズ
+	const wxUint8 *p_bufs[MaxVectors];	///< 各データ
+	size_t m_lens[MaxVectors];	///< 各データのサイズ
+	DiskPlainSectorBlock *p_blocks[MaxVectors];	///< 各データのブロック
+	int m_first[MaxVectors];	///< 各データのブロック内の開始位置
+	int m_secs[MaxVectors];		///< 各データのセクタ数
+	int m_count;			///< データ数
+
+public:
+	DiskPlainWriteRun();
+
+	/// クリア
+	void Clear();
+	/// データがないか
+	bool IsEmpty() const { return (m_count == 0); }
+	/// 合計サイズ
+	size_t GetSize() const { return m_size; }
+	/// 続けて追加できるか
+	bool CanAppend(wxFileOffset offset, const wxUint8 *data, const DiskPlainSectorBlock *block) const;
+	/// データを追加
+	void Append(wxFileOffset offset, const wxUint8 *data, size_t len, DiskPlainSectorBlock *block, int index);
+	/// ファイルに書き込む
+	bool Write(wxFile *file) const;
+	/// 書き込んだセクタの変更をクリア
+	void ClearModify();
+};
+
+// ----------------------------------------------------------------------
+
 /// セクタデータを一時的に保持するクラス
 class DiskPlainSectorBlockCache
 {
 private:
 	DiskPlainFile *p_parent;
-	DiskPlainSectorBlocks *p_cache;
+	DiskPlainSectorBlockMap m_cache;	///< 通し番号をキーにしたブロック
+
+	DiskPlainSectorBlock *p_lru_head;	///< 最後にアクセスしたブロック
+	DiskPlainSectorBlock *p_lru_tail;	///< 最もアクセスしていないブロック
 
 	wxUint32 m_start_offset;	///< ファイルの開始オフセット
 
@@ -478,27 +873,84 @@ private:
 
 	int m_cache_overflowed;	///< キャッシュがいっぱいになった回数
 
-	Utils::TempData m_temp;
-
-	DiskPlainSectorBlock *FindBySectorPosR(int depth, int seq_num, size_t index, size_t st, size_t ed);
+	DiskPlainBlockBufferPool m_pool;	///< ブロック用バッファ
+
+	DiskPlainFileMap *p_map;	///< メモリマップ(使用しない時NULL)
+
+	DiskPlainFileFlusher *p_flusher;	///< バックグラウンド書き込み(使用しない時NULL)
+	wxMutex m_stream_mutex;		///< ストリームの排他
+	size_t m_high_water_count;	///< バックグラウンド書き込みを始めるアイテム数
+
+	DiskPlainFilePrefetcher *p_prefetcher;	///< 先読み(使用しない時NULL)
+	int m_read_ahead_count;		///< 先読みするブロック数
+	int m_last_miss_num;		///< 最後にファイルから読んだブロックの通し番号
+	int m_sequential_count;		///< 連続して読んだブロック数
+	wxFileOffset m_file_size;	///< ファイルサイズ
+
+	DiskImageCacheStats m_stats;	///< 統計情報(スレッド分は含まない)
+
+	DiskPlainPinnedBlocks m_pinned;	///< 追い出さないブロック
+
+	/// LRUリストの先頭に追加
+	void LinkLru(DiskPlainSectorBlock *block);
+	/// LRUリストから外す
+	void UnlinkLru(DiskPlainSectorBlock *block);
+	/// LRUリストの先頭に移動
+	void TouchLru(DiskPlainSectorBlock *block);
+	/// 範囲内のブロックを通し番号順に集める
+	void CollectBlocks(int start, int size, DiskPlainSectorBlocks &blocks) const;
+	/// 全ブロックを通し番号順に集める
+	void CollectBlocks(DiskPlainSectorBlocks &blocks) const;
+	/// ブロックをファイルに書き込む
+	bool WriteSectorBlock(DiskPlainSectorBlock *item);
+	/// まとめたデータを書き込み、書けたセクタの変更をクリアする
+	bool WriteRun(wxFile *file, DiskPlainWriteRun &run);
+	/// ブロック内の変更したセクタをファイルに書き込む
+	bool WriteModifiedSectors(DiskPlainSectorBlocks &blocks, bool sync);
+	/// 変更のある古いブロックをバックグラウンドで書き込む
+	void WriteBackByAccessTime();
+	/// 連続して読んでいるなら続きを先読みする
+	void DetectSequentialRead(int seq_num);
+	/// 指定ブロックから先読みする
+	void ReadAheadBlocks(int seq_num, int count);
+	/// キャッシュにあるブロックを返す
+	DiskPlainSectorBlock *FindBlock(int seq_num);
+	/// ブロックを返す なければファイルから読む
+	DiskPlainSectorBlock *GetSectorBlock(int sector_pos);
+	/// キャッシュを通さずにブロックのデータを読む
+	size_t ReadBlockDirect(int seq_num, wxUint8 *buffer, size_t size);
+	/// メモリマップ上のブロックの変更を破棄してファイルの内容に戻す
+	void RestoreMappedBlock(DiskPlainSectorBlock *item);
 
 	DiskPlainSectorBlockCache() {}
 	DiskPlainSectorBlockCache(const DiskPlainSectorBlockCache &) {}
 	DiskPlainSectorBlockCache &operator=(const DiskPlainSectorBlockCache &) { return *this; }
 
 public:
-	DiskPlainSectorBlockCache(DiskPlainFile *parent, wxUint32 start_offset);
+	DiskPlainSectorBlockCache(DiskPlainFile *parent, wxUint32 start_offset, DiskPlainFileMap *map = NULL);
 	~DiskPlainSectorBlockCache();
 	/// セクタブロックをキャッシュに追加する
-	DiskPlainSectorBlock *AddSectorBlock(int sector_pos); 
+	DiskPlainSectorBlock *AddSectorBlock(int sector_pos, bool read_ahead = true); 
 	/// アクセスのないセクタデータをキャッシュから削除する
 	void RemoveByAccessTime();
 	/// セクタブロックを削除する
-	void RemoveSectorBlock(DiskPlainSectorBlock *item);
+	bool RemoveSectorBlock(DiskPlainSectorBlock *item);
 	/// 指定したセクタ番号のセクタデータがキャッシュにあるか
 	DiskPlainSector *FindBySectorPos(int sector_pos);
 	/// セクタデータを得る
 	DiskImageSector *GetSector(int sector_pos);
+	/// 指定範囲のセクタを先読みする
+	void ReadAhead(int sector_pos, int count);
+	/// 指定範囲のセクタをキャッシュに固定する
+	bool PinSectors(int sector_pos, int count);
+	/// 指定範囲のセクタの固定を解除する
+	void UnpinSectors(int sector_pos, int count);
+	/// 連続したセクタを返す
+	int GetSectors(int sector_pos, int count, DiskImageSectors &sectors);
+	/// 連続したセクタのデータをバッファに読み込む
+	int ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size);
+	/// 連続したセクタにバッファのデータを書き込む
+	int WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size);
 	/// キャッシュをクリア
 	void ClearCacheAll();
 	/// キャッシュをクリア
@@ -514,11 +966,13 @@ public:
 	/// 範囲内のセクタ変更をクリア
 	void ClearModify(int start, int size);
 	/// データをすべて出力
-	void Flush();
+	bool Flush();
 	/// 範囲内のデータを出力
-	void Flush(int start, int size);
+	bool Flush(int start, int size);
 	/// ステータスメッセージ
 	void GetStatusMessage(wxString &str) const;
+	/// 統計情報
+	void GetStats(DiskImageCacheStats &stats) const;
 };
 
 #endif // USE_SECTOR_BLOCK_CACHE
@@ -536,13 +990,18 @@ private:
 	DiskImageDisks *p_disks;	///< パーティション情報
 #ifdef USE_SECTOR_BLOCK_CACHE
 	DiskPlainSectorBlockCache *p_cache;	///< セクタブロックキャッシュ
+	DiskPlainFileMap *p_map;	///< メモリマップ
 #else
 	DiskPlainSectorCache *p_cache;	///< セクタキャッシュ
 #endif
 	wxString m_desc;			///< 説明
+	wxUint32 m_cache_generation;	///< キャッシュからセクタを削除するたびに増える
 
 	DiskPlainFile(const DiskPlainFile &src) : DiskImageFile() {}
 
+	/// キャッシュを作成
+	void CreateCache();
+
 public:
 	DiskPlainFile();
 	~DiskPlainFile();
@@ -579,6 +1038,22 @@ public:
 	DiskImageSector *GetSector(int sector_pos) wxOVERRIDE;
 	/// キャッシュを更新する
 	void RefreshCache(int sector_pos) wxOVERRIDE;
+	/// キャッシュの世代を返す
+	wxUint32 GetCacheGeneration() const wxOVERRIDE { return m_cache_generation; }
+	/// キャッシュの世代を進める セクタを削除した時に呼ぶ
+	void IncreaseCacheGeneration();
+	/// 指定範囲のセクタを先読みする
+	void ReadAhead(int sector_pos, int count) wxOVERRIDE;
+	/// 指定範囲のセクタをキャッシュに固定する
+	bool PinSectors(int sector_pos, int count) wxOVERRIDE;
+	/// 指定範囲のセクタの固定を解除する
+	void UnpinSectors(int sector_pos, int count) wxOVERRIDE;
+	/// 連続したセクタを返す
+	int GetSectors(int sector_pos, int count, DiskImageSectors &sectors) wxOVERRIDE;
+	/// 連続したセクタのデータをバッファに読み込む
+	int ReadSectors(int sector_pos, int count, wxUint8 *buffer, size_t size) wxOVERRIDE;
+	/// 連続したセクタにバッファのデータを書き込む
+	int WriteSectors(int sector_pos, int count, const wxUint8 *buffer, size_t size) wxOVERRIDE;
 	/// キャッシュをクリア ファイル更新もしない
 	void ClearCacheAll() wxOVERRIDE;
 	/// キャッシュをクリアする
@@ -596,9 +1071,9 @@ public:
 	void ClearModify(wxUint32 start, wxUint32 size) wxOVERRIDE;
 
 	/// データをすべて出力	
-	void Flush() wxOVERRIDE;
+	bool Flush() wxOVERRIDE;
 	/// 範囲内のデータを出力
-	void Flush(wxUint32 start, wxUint32 size) wxOVERRIDE;
+	bool Flush(wxUint32 start, wxUint32 size) wxOVERRIDE;
 
 	/// 書き込み禁止かどうかを返す
 	bool IsWriteProtected() const wxOVERRIDE;
@@ -607,6 +1082,10 @@ public:
 
 	/// ファイルストリームを返す
 	wxFileStream *GetStream() { return p_stream; }
+#ifdef USE_SECTOR_BLOCK_CACHE
+	/// メモリマップをしなおす 変更内容は破棄
+	DiskPlainFileMap *RemapFile();
+#endif
 
 	/// ファイルの説明
 	wxString GetDescription() const wxOVERRIDE { return m_desc; }
@@ -617,6 +1096,8 @@ public:
 
 	/// ステータスメッセージ
 	void GetStatusMessage(wxString &str) const wxOVERRIDE;
+	/// キャッシュの統計情報
+	bool GetCacheStats(DiskImageCacheStats &stats) const wxOVERRIDE;
 };
 
 /// ベタディスクイメージ入出力
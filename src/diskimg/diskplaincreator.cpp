@@ -53,7 +53,7 @@ wxUint32 DiskPlainCreator::CreateFile()
 	DiskPlainSector *sector = new DiskPlainSector(0, header, NULL, sector_size, 0);
 
 	for(int n = 0; n < sector_nums; n++) {
-		size_t len = ostream.Write(sector->GetSectorBuffer(), sector->GetSectorBufferSize()).LastWrite();
+		size_t len = ostream.Write(sector->GetSectorBufferForRead(), sector->GetSectorBufferSize()).LastWrite();
 		if (len == 0) break;
 	}
 
@@ -53,7 +53,10 @@ int DiskPlainWriter::SaveDisk(DiskImage *image, int disk_number)
 /// べたイメージを保存
 int DiskPlainWriter::SaveFile(DiskImageFile *file)
 {
-	file->Flush();
+	if (!file->Flush()) {
+		p_result->SetError(DiskResult::ERR_CANNOT_SAVE);
+		return p_result->GetValid();
+	}
 
 	return 0;
 }
@@ -63,7 +66,10 @@ int DiskPlainWriter::SaveFile(DiskImageFile *file)
 /// @retval -1 エラー
 int DiskPlainWriter::SaveDisk(DiskImageDisk *disk)
 {
-	disk->Flush();
+	if (!disk->Flush()) {
+		p_result->SetError(DiskResult::ERR_CANNOT_SAVE);
+		return p_result->GetValid();
+	}
 
 	return 0;
 }
@@ -80,6 +80,28 @@ ConfigBox::ConfigBox(wxWindow* parent, wxWindowID id, Config *ini)
 
 	bszr->Add(szrH, flags);
 
+	// ディスクイメージをメモリにマップする
+	chkMemoryMapped = CreateCheckBoxH(page, IDC_CHECK_MEMORY_MAPPED, _("Map the disk image file into memory. (Effective from next opening)"), ini->DoesUseMemoryMappedFile(), bszr, flags);
+
+	// 変更したデータをバックグラウンドで書き込む
+	chkCacheWriteBack = CreateCheckBoxH(page, IDC_CHECK_CACHE_WRITE_BACK, _("Write the modified data back in the background. (Effective from next opening)"), ini->DoesUseCacheWriteBack(), bszr, flags);
+	szrH = new wxBoxSizer(wxHORIZONTAL);
+	spnCacheHighWater = CreateSpinCtrlH(page, IDC_SPIN_CACHE_HIGH_WATER, _("Start writing back when the cache usage exceeds"), 5, 95, ini->GetCacheHighWater(), _("%"), szrH, flags);
+	bszr->Add(szrH, flags);
+
+	// 先読みするブロック数
+	szrH = new wxBoxSizer(wxHORIZONTAL);
+	spnReadAhead = CreateSpinCtrlH(page, IDC_SPIN_READ_AHEAD, _("Read ahead on sequential access (0: disable)"), 0, 64, ini->GetReadAheadBlocks(), _("blocks"), szrH, flags);
+	bszr->Add(szrH, flags);
+
+	// 統計情報をログに出力する間隔
+	szrH = new wxBoxSizer(wxHORIZONTAL);
+	spnCacheStats = CreateSpinCtrlH(page, IDC_SPIN_CACHE_STATS, _("Write the statistics to the log every (0: disable)"), 0, 3600, ini->GetCacheStatsInterval(), _("seconds"), szrH, flags);
+	bszr->Add(szrH, flags);
+
+	// 解析結果をインデックスファイルに保存する
+	chkIndexFile = CreateCheckBoxH(page, IDC_CHECK_INDEX_FILE, _("Save the analysis result in an index file next to the disk image. (Effective from next opening)"), ini->DoesUseIndexFile(), bszr, flags);
+
 	szrPage->Add(bszr, flags);
 
 	// 言語
@@ -279,6 +301,12 @@ void ConfigBox::CommitData()
 	ini->CalcCacheSize(limit_size, shrink_size);
 	ini->SetCacheLimitSize(limit_size);
 	ini->SetCacheShrinkSize(shrink_size);
+	ini->UseMemoryMappedFile(chkMemoryMapped->GetValue());
+	ini->UseCacheWriteBack(chkCacheWriteBack->GetValue());
+	ini->SetCacheHighWater(spnCacheHighWater->GetValue());
+	ini->SetReadAheadBlocks(spnReadAhead->GetValue());
+	ini->SetCacheStatsInterval(spnCacheStats->GetValue());
+	ini->UseIndexFile(chkIndexFile->GetValue());
 	int sel = comLanguage->GetSelection();
 	wxString lang;
 	switch(sel) {
@@ -39,6 +39,12 @@ private:
 	wxCheckBox *chkInterDirItem;
 	wxSpinCtrl *spnCacheLimit;
 	wxSpinCtrl *spnCacheShrink;
+	wxCheckBox *chkMemoryMapped;
+	wxCheckBox *chkCacheWriteBack;
+	wxSpinCtrl *spnCacheHighWater;
+	wxSpinCtrl *spnReadAhead;
+	wxSpinCtrl *spnCacheStats;
+	wxCheckBox *chkIndexFile;
 	wxChoice   *comLanguage;
 
 public:
@@ -64,6 +70,12 @@ public:
 		IDC_CHECK_INTER_DIR_ITEM,
 		IDC_SPIN_CACHE_LIMIT,
 		IDC_SPIN_CACHE_SHRINK,
+		IDC_CHECK_MEMORY_MAPPED,
+		IDC_CHECK_CACHE_WRITE_BACK,
+		IDC_SPIN_CACHE_HIGH_WATER,
+		IDC_SPIN_READ_AHEAD,
+		IDC_SPIN_CACHE_STATS,
+		IDC_CHECK_INDEX_FILE,
 		IDC_COMBO_LANGUAGE,
 	};
 
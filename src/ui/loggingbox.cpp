@@ -13,6 +13,7 @@
 #include <wx/button.h>
 #include <wx/sizer.h>
 #include "uimainframe.h"
+#include "../diskimg/diskimage.h"
 #include "../logging.h"
 
 // Attach Event
@@ -97,6 +98,18 @@ void LoggingBox::OnButtonUpdate(wxCommandEvent& WXUNUSED(event))
 
 	wxString text;
 	myLog.GetLog(text);
+
+	// 現在のキャッシュの統計情報
+	UiDiskFrame *parent = (UiDiskFrame *)m_parent;
+	DiskImageCacheStats stats;
+	if (parent->GetDiskImage().GetCacheStats(stats)) {
+		wxArrayString msgs;
+		stats.GetMessages(msgs);
+		for(size_t i=0; i<msgs.Count(); i++) {
+			text += msgs.Item(i);
+			text += wxT("\n");
+		}
+	}
 	txtLogging->SetValue(text);
 	txtLogging->ShowPosition(txtLogging->GetLastPosition());
 }
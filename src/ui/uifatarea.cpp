@@ -73,7 +73,7 @@ void UiDiskFatAreaFrame::OnQuit(wxCommandEvent& WXUNUSED(event))
 	Close();
 }
 
-void UiDiskFatAreaFrame::SetData(wxUint32 offset, const wxArrayInt *arr)
+void UiDiskFatAreaFrame::SetData(wxUint32 offset, const DiskBasicAvailabillity *arr)
 {
 	panel->SetData(offset, arr);
 }
@@ -197,68 +197,89 @@ void UiDiskFatAreaPanel::OnPaint(wxPaintEvent& event)
 	}
 
 	y += (ll + margin);
-	int row = 0;
-	for(pos = 0; pos < datas.Count(); pos++) {
-		if ((x + sq.x + rpadding) > size.x) {
-			y += (sq.y + margin);
-			row++;
-			x = lpadding;
-		}
-		if (x == lpadding) {
-			if ((row % 4) == 0) {
-				int px0 = x - (1 - ((row / 4) & 1)) * ll;
-				int px1 = x + ll;
-				if (y >= start.y - ppuy && y < start.y + size.y + ppuy) {
-					dc.SetPen(*wxBLACK_PEN);
-					dc.DrawLine(px0, y, px1, y);
-					if ((row & 0xf) == 0) {
-						wxString str = wxString::Format(wxT("%x"), (row >> 4));
-						wxSize tsz = dc.GetTextExtent(str);
-						px1 = px1 + margin - tsz.x;
-						dc.DrawText(str, px1, y + 2);
-					}
-				}
+
+	// 表示範囲内の行のみ描画する
+	int cols = CalcColumns(size.x);
+	int rows = (int)((datas.Count() + cols - 1) / cols);
+	int pitch = (sq.y + margin);
+	int row_start = (start.y - ppuy - y) / pitch;
+	int row_end = (start.y + size.y + ppuy - y) / pitch + 1;
+	if (row_start < 0) row_start = 0;
+	if (row_end > rows) row_end = rows;
+
+	for(int row = row_start; row < row_end; row++) {
+		int py = y + row * pitch;
+		x = lpadding;
+		if ((row % 4) == 0) {
+			int px0 = x - (1 - ((row / 4) & 1)) * ll;
+			int px1 = x + ll;
+			dc.SetPen(*wxBLACK_PEN);
+			dc.DrawLine(px0, py, px1, py);
+			if ((row & 0xf) == 0) {
+				wxString str = wxString::Format(wxT("%x"), (row >> 4));
+				wxSize tsz = dc.GetTextExtent(str);
+				px1 = px1 + margin - tsz.x;
+				dc.DrawText(str, px1, py + 2);
 			}
-			x += (ll + margin);
 		}
+		x += (ll + margin);
 
-		if (y >= start.y - ppuy && y < start.y + size.y + ppuy) {
-			int sts = datas.Item(pos);
+		// 同じ状態が続く間はペンとブラシを変えない
+		size_t row_pos = (size_t)row * cols;
+		size_t row_last = row_pos + cols;
+		if (row_last > datas.Count()) row_last = datas.Count();
+		for(pos = row_pos; pos < row_last; ) {
+			int sts = datas.Get(pos);
+			size_t len = datas.GetRunLength(pos, row_last - pos);
 
 			dc.SetPen(*wxBLACK_PEN);
-			if (sts & 0x10000) {
-				// selected (red)
-				dc.SetBrush(brush_select);
-			} else if (sts & 0x20000) {
-				// selected (magenta)
-				dc.SetBrush(brush_extra);
-			} else {
-				if (sts < FAT_AVAIL_NULLEND) {
-					dc.SetPen(pens[sts]);
-					dc.SetBrush(brushes[sts]);
-				}
+			if (sts < FAT_AVAIL_NULLEND) {
+				dc.SetPen(pens[sts]);
+				dc.SetBrush(brushes[sts]);
 			}
-			dc.DrawRectangle(x, y, sq.x, sq.y);
-#if 0
-			if (sts == FAT_AVAIL_USED_LAST) {
-				dc.SetPen(*wxBLUE_PEN);
-				dc.DrawLine(x + sq.x - 2, y, x + sq.x - 2, y + sq.y);
+			for(size_t n = 0; n < len; n++) {
+				if (!highlights.empty()) {
+					UiDiskFatAreaHighlights::iterator it = highlights.find((wxUint32)(pos + n));
+					if (it != highlights.end()) {
+						// selected (red) / (magenta)
+						dc.SetPen(*wxBLACK_PEN);
+						dc.SetBrush(it->second & 0x10000 ? brush_select : brush_extra);
+						dc.DrawRectangle(x, py, sq.x, sq.y);
+						if (sts < FAT_AVAIL_NULLEND) {
+							dc.SetPen(pens[sts]);
+							dc.SetBrush(brushes[sts]);
+						}
+						x += (sq.x + margin);
+						continue;
+					}
+				}
+				dc.DrawRectangle(x, py, sq.x, sq.y);
+				x += (sq.x + margin);
 			}
-#endif
+			pos += len;
 		}
-		x += (sq.x + margin);
 	}
-	y += (sq.y + margin);
+	y += (rows > 0 ? rows : 1) * pitch;
 
 	SetVirtualSize(size.x, y);
 }
 
+/// １行に表示するグループ数を計算
+/// @param[in] width パネルの幅
+/// @return グループ数
+int UiDiskFatAreaPanel::CalcColumns(int width) const
+{
+	int avail = width - rpadding - sq.x - (lpadding + ll + margin);
+	if (avail < 0) return 1;
+	return avail / (sq.x + margin) + 1;
+}
+
 void UiDiskFatAreaPanel::OnSize(wxSizeEvent& event)
 {
 	Refresh(true);
 }
 
-void UiDiskFatAreaPanel::SetData(wxUint32 offset, const wxArrayInt *arr)
+void UiDiskFatAreaPanel::SetData(wxUint32 offset, const DiskBasicAvailabillity *arr)
 {
 	if (arr) {
 		this->offset = offset;
@@ -270,6 +291,7 @@ void UiDiskFatAreaPanel::SetData(wxUint32 offset, const wxArrayInt *arr)
 void UiDiskFatAreaPanel::ClearData()
 {
 	datas.Empty();
+	highlights.clear();
 	Refresh(true);
 }
 
@@ -277,29 +299,19 @@ void UiDiskFatAreaPanel::SetGroupBase(wxUint32 group_num, int highlight)
 {
 	wxUint32 pos = (group_num + offset);
 	if (pos < (wxUint32)datas.Count()) {
-		int val = datas.Item(pos);
-		val |= highlight;
-		datas.Item(pos) = val;
+		highlights[pos] |= highlight;
 	}
 }
 
 void UiDiskFatAreaPanel::UnsetGroupBase(wxUint32 group_num)
 {
 	wxUint32 pos = (group_num + offset);
-	if (pos < (wxUint32)datas.Count()) {
-		int val = datas.Item(pos);
-		val &= 0xffff;
-		datas.Item(pos) = val;
-	}
+	highlights.erase(pos);
 }
 
 void UiDiskFatAreaPanel::ClearGroupBase()
 {
-	for(size_t pos = 0; pos < datas.Count(); pos++) {
-		int val = datas.Item(pos);
-		val &= 0xffff;
-		datas.Item(pos) = val;
-	}
+	highlights.clear();
 }
 
 void UiDiskFatAreaPanel::SetGroup(wxUint32 group_num)
@@ -310,8 +322,11 @@ void UiDiskFatAreaPanel::SetGroup(wxUint32 group_num)
 
 void UiDiskFatAreaPanel::SetGroup(const DiskBasicGroups &group_items, const wxArrayInt &extra_group_nums)
 {
-	for(size_t n = 0; n < group_items.Count(); n++) {
-		SetGroupBase(group_items.Item(n).GetGroup(), 0x10000);
+	for(size_t e = 0; e < group_items.GetExtentCount(); e++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(e);
+		for(size_t n = 0; n < ext->Count(); n++) {
+			SetGroupBase(ext->GetGroup(n), 0x10000);
+		}
 	}
 	for(size_t n = 0; n < extra_group_nums.Count(); n++) {
 		SetGroupBase(extra_group_nums.Item(n), 0x20000);
@@ -321,8 +336,11 @@ void UiDiskFatAreaPanel::SetGroup(const DiskBasicGroups &group_items, const wxAr
 
 void UiDiskFatAreaPanel::UnsetGroup(const DiskBasicGroups &group_items, const wxArrayInt &extra_group_nums)
 {
-	for(size_t n = 0; n < group_items.Count(); n++) {
-		UnsetGroupBase(group_items.Item(n).GetGroup());
+	for(size_t e = 0; e < group_items.GetExtentCount(); e++) {
+		const DiskBasicGroupExtent *ext = &group_items.GetExtent(e);
+		for(size_t n = 0; n < ext->Count(); n++) {
+			UnsetGroupBase(ext->GetGroup(n));
+		}
 	}
 	for(size_t n = 0; n < extra_group_nums.Count(); n++) {
 		UnsetGroupBase(extra_group_nums.Item(n));
@@ -17,6 +17,7 @@
 #include <wx/dynarray.h>
 #include <wx/pen.h>
 #include <wx/brush.h>
+#include <wx/hashmap.h>
 #include "../basicfmt/basicfat.h"
 
 
@@ -25,6 +26,9 @@ class UiDiskFatAreaFrame;
 class UiDiskFatAreaPanel;
 class DiskBasicGroups;
 
+/// 強調表示するグループ
+WX_DECLARE_HASH_MAP(wxUint32, int, wxIntegerHash, wxIntegerEqual, UiDiskFatAreaHighlights);
+
 /// FAT使用状況ウィンドウ
 class UiDiskFatAreaFrame: public wxFrame
 {
@@ -39,7 +43,7 @@ public:
 	void OnClose(wxCommandEvent& event);
 	void OnQuit(wxCommandEvent& event);
 
-	void SetData(wxUint32 offset, const wxArrayInt *arr);
+	void SetData(wxUint32 offset, const DiskBasicAvailabillity *arr);
 	void ClearData();
 	void SetGroup(wxUint32 group_num);
 	void SetGroup(const DiskBasicGroups &group_items, const wxArrayInt &extra_group_nums);
@@ -64,7 +68,8 @@ private:
 	UiDiskFatAreaFrame *frame;
 
 	wxUint32   offset;	///< 開始グループ番号
-	wxArrayInt datas;	///< 各グループの状態
+	DiskBasicAvailabillity datas;	///< 各グループの状態
+	UiDiskFatAreaHighlights highlights;	///< 強調表示するグループ
 
 	wxPen   pens[FAT_AVAIL_NULLEND];
 
@@ -81,6 +86,7 @@ private:
 	void SetGroupBase(wxUint32 group_num, int highlight);
 	void UnsetGroupBase(wxUint32 group_num);
 	void ClearGroupBase();
+	int  CalcColumns(int width) const;
 
 public:
 	UiDiskFatAreaPanel(UiDiskFatAreaFrame *parent);
@@ -89,7 +95,7 @@ public:
 	void OnPaint(wxPaintEvent& event);
 	void OnSize(wxSizeEvent& event);
 
-	void SetData(wxUint32 offset, const wxArrayInt *arr);
+	void SetData(wxUint32 offset, const DiskBasicAvailabillity *arr);
 	void ClearData();
 	void SetGroup(wxUint32 group_num);
 	void SetGroup(const DiskBasicGroups &group_items, const wxArrayInt &extra_group_nums);
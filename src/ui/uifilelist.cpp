@@ -1165,7 +1165,7 @@ bool UiDiskFileList::SelectItem(const MyFileListItem &selected_item, int count)
 
 	if (count == 1) {
 		// ダンプリストをセット
-		frame->SetBinDumpData(sector->GetNumber(), sector->GetSectorBuffer(), sector->GetSectorSize(), m_current_basic->GetCharCode(), false);
+		frame->SetBinDumpData(sector->GetNumber(), sector->GetSectorBufferForRead(), sector->GetSectorSize(), m_current_basic->GetCharCode(), false);
 	}
 
 	if (count <= 2) {
@@ -1212,9 +1212,9 @@ bool UiDiskFileList::SetDumpData(DiskBasicGroupItem &group_item)
 			break;
 		}
 		if (s == group_item.GetSectorStart()) {
-			frame->SetBinDumpData(s, sector->GetSectorBuffer(), sector->GetSectorSize());
+			frame->SetBinDumpData(s, sector->GetSectorBufferForRead(), sector->GetSectorSize());
 		} else {
-			frame->AppendBinDumpData(s, sector->GetSectorBuffer(), sector->GetSectorSize());
+			frame->AppendBinDumpData(s, sector->GetSectorBufferForRead(), sector->GetSectorSize());
 		}
 	}
 	return true;
@@ -1236,9 +1236,9 @@ bool UiDiskFileList::SetDumpData(int sector_start, int sector_end)
 			break;
 		}
 		if (s == sector_start) {
-			frame->SetBinDumpData(s, sector->GetSectorBuffer(), sector->GetSectorSize());
+			frame->SetBinDumpData(s, sector->GetSectorBufferForRead(), sector->GetSectorSize());
 		} else {
-			frame->AppendBinDumpData(s, sector->GetSectorBuffer(), sector->GetSectorSize());
+			frame->AppendBinDumpData(s, sector->GetSectorBufferForRead(), sector->GetSectorSize());
 		}
 	}
 	return true;
@@ -2109,6 +2109,125 @@ void UiDiskFileList::ShowMakeDirectoryDialog()
 	delete temp_item;
 }
 
+/// デフラグの確認と実行
+void UiDiskFileList::ShowDefragmentDialog()
+{
+	if (!m_current_basic) return;
+
+	if (!m_current_basic->IsDefragmentable() || !m_current_basic->IsWritableIntoDisk()) {
+		m_current_basic->ShowErrorMessage();
+		return;
+	}
+
+	// 計画のみ行い効果を見積もる
+	DiskBasicDefragInfo info;
+	if (!m_current_basic->Defragment(info, false)) {
+		m_current_basic->ShowErrorMessage();
+		return;
+	}
+
+	wxString msg = wxString::Format(_("Fragmented files: %d / %d (%.1f%%)")
+		, info.GetFragmentedFiles(DiskBasicDefragInfo::DEFRAG_BEFORE), info.GetFiles()
+		, info.GetFragmentation(DiskBasicDefragInfo::DEFRAG_BEFORE));
+	if (info.GetMovedFiles() == 0) {
+		msg += wxT("\n\n");
+		msg += _("There is no file that can be defragmented.");
+		wxMessageBox(msg, _("Defragment"), wxOK | wxICON_INFORMATION);
+		return;
+	}
+	msg += wxT("\n");
+	msg += wxString::Format(_("After defragmenting: %d / %d (%.1f%%)")
+		, info.GetFragmentedFiles(DiskBasicDefragInfo::DEFRAG_AFTER), info.GetFiles()
+		, info.GetFragmentation(DiskBasicDefragInfo::DEFRAG_AFTER));
+	msg += wxT("\n");
+	msg += wxString::Format(_("Files to move: %d (%s bytes)")
+		, info.GetMovedFiles(), wxNumberFormatter::ToString((wxLongLong_t)info.GetMovedSize()));
+	msg += wxT("\n\n");
+	msg += _("Do you really want to defragment the disk?");
+	int ans = wxMessageBox(msg, _("Defragment"), wxYES_NO);
+	if (ans != wxYES) {
+		return;
+	}
+
+	bool sts = m_current_basic->Defragment(info, true);
+
+	// リスト更新
+	RefreshFiles();
+
+	if (!sts) {
+		m_current_basic->ShowErrorMessage();
+		return;
+	}
+	msg = wxString::Format(_("Fragmented files: %d / %d (%.1f%%)")
+		, info.GetFragmentedFiles(DiskBasicDefragInfo::DEFRAG_AFTER), info.GetFiles()
+		, info.GetFragmentation(DiskBasicDefragInfo::DEFRAG_AFTER));
+	wxMessageBox(msg, _("Defragment"), wxOK | wxICON_INFORMATION);
+}
+
+/// ボリュームのチェックと結果の表示
+void UiDiskFileList::ShowCheckVolumeDialog()
+{
+	if (!m_current_basic) return;
+
+	DiskBasicCheckInfo info;
+	bool sts = m_current_basic->CheckVolume(info);
+
+	// ディレクトリをたどったのでリスト更新
+	RefreshFiles();
+
+	if (!sts) {
+		m_current_basic->ShowErrorMessage();
+		return;
+	}
+
+	wxString msg = wxString::Format(_("Files: %d, Directories: %d"), info.GetFiles(), info.GetDirectories());
+	msg += wxT("\n");
+	msg += wxString::Format(_("Used groups: %u, Free groups: %u, Bad groups: %u")
+		, info.GetUsedGroups(), info.GetFreeGroups(), info.GetBadGroups());
+	msg += wxT("\n\n");
+	if (!info.HasProblems()) {
+		msg += _("No problem was found.");
+		wxMessageBox(msg, _("Check Volume"), wxOK | wxICON_INFORMATION);
+		return;
+	}
+
+	msg += wxString::Format(_("Cross-linked files: %d"), info.GetProblems(DiskBasicCheckInfo::CHECK_CROSS_LINKED));
+	msg += wxT("\n");
+	msg += wxString::Format(_("Looped chains: %d"), info.GetProblems(DiskBasicCheckInfo::CHECK_LOOPED));
+	msg += wxT("\n");
+	msg += wxString::Format(_("Broken chains: %d"), info.GetProblems(DiskBasicCheckInfo::CHECK_BROKEN));
+	msg += wxT("\n");
+	msg += wxString::Format(_("Size mismatched files: %d"), info.GetProblems(DiskBasicCheckInfo::CHECK_SIZE_MISMATCH));
+	msg += wxT("\n");
+	msg += wxString::Format(_("Lost chains: %u (%u groups)"), info.GetLostChains(), info.GetLostGroups());
+
+	// 問題のあったファイルは先頭から一部だけ表示する
+	size_t count = info.GetDetailCount();
+	if (count > 0) msg += wxT("\n");
+	for(size_t i=0; i<count && i<20; i++) {
+		msg += wxT("\n");
+		switch(info.GetDetailKind(i)) {
+		case DiskBasicCheckInfo::CHECK_CROSS_LINKED:
+			msg += wxString::Format(_("Cross-linked: %s"), info.GetDetailPath(i));
+			break;
+		case DiskBasicCheckInfo::CHECK_LOOPED:
+			msg += wxString::Format(_("Looped: %s"), info.GetDetailPath(i));
+			break;
+		case DiskBasicCheckInfo::CHECK_BROKEN:
+			msg += wxString::Format(_("Broken: %s"), info.GetDetailPath(i));
+			break;
+		default:
+			msg += wxString::Format(_("Size mismatched: %s"), info.GetDetailPath(i));
+			break;
+		}
+	}
+	if (count > 20) {
+		msg += wxT("\n");
+		msg += wxString::Format(_("... and %d more"), (int)(count - 20));
+	}
+	wxMessageBox(msg, _("Check Volume"), wxOK | wxICON_WARNING);
+}
+
 /// 選択している行数
 int UiDiskFileList::GetListSelectedItemCount() const
 {
@@ -2146,7 +2265,7 @@ bool UiDiskFileList::IsDeletableBasicFile()
 	return m_current_basic ? m_current_basic->IsDeletableFiles() : false;
 }
 /// FATエリアの空き状況を取得
-void UiDiskFileList::GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const
+void UiDiskFileList::GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr) const
 {
 	if (m_current_basic) m_current_basic->GetFatAvailability(offset, arr);
 }
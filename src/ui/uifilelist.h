@@ -57,6 +57,7 @@ class wxStaticText;
 class wxSizerItem;
 class DiskBasic;
 class DiskBasics;
+class DiskBasicAvailabillity;
 class DiskBasicGroupItem;
 class DiskBasicDirItem;
 class DiskBasicDirItems;
@@ -366,6 +367,10 @@ public:
 
 	/// ディレクトリ作成ダイアログ
 	void ShowMakeDirectoryDialog();
+	/// デフラグの確認と実行
+	void ShowDefragmentDialog();
+	/// ボリュームのチェックと結果の表示
+	void ShowCheckVolumeDialog();
 
 	/// 選択している行数
 	int  GetListSelectedItemCount() const;
@@ -384,7 +389,7 @@ public:
 	bool IsDeletableBasicFile();
 
 	/// FATエリアの空き状況を取得
-	void GetFatAvailability(wxUint32 *offset, const wxArrayInt **arr) const;
+	void GetFatAvailability(wxUint32 *offset, const DiskBasicAvailabillity **arr) const;
 
 	/// フォントをセット
 	void SetListFont(const wxFont &font);
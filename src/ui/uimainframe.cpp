@@ -249,6 +249,8 @@ wxBEGIN_EVENT_TABLE(UiDiskFrame, wxFrame)
 	EVT_MENU(IDM_EDIT_FILE_BINARY, UiDiskFrame::OnEditFileOnDisk)
 	EVT_MENU(IDM_EDIT_FILE_TEXT, UiDiskFrame::OnEditFileOnDisk)
 	EVT_MENU(IDM_MAKE_DIRECTORY_ON_DISK, UiDiskFrame::OnMakeDirectoryOnDisk)
+	EVT_MENU(IDM_DEFRAGMENT_DISK, UiDiskFrame::OnDefragmentDisk)
+	EVT_MENU(IDM_CHECK_VOLUME, UiDiskFrame::OnCheckVolume)
 	EVT_MENU(IDM_PROPERTY_DATA, UiDiskFrame::OnPropertyOnDisk)
 
 	EVT_MENU(IDM_BASIC_MODE, UiDiskFrame::OnBasicMode)
@@ -325,6 +327,7 @@ UiDiskFrame::UiDiskFrame(const wxString& title, const wxSize& size)
 	p_loggingbox = NULL;
 
 	// status timer
+	m_cache_stats_elapsed = 0;
 	m_status_timer.SetOwner(this, IDT_STATUS_TIMER);
 	m_status_timer.Start(1000);
 }
@@ -605,6 +608,16 @@ void UiDiskFrame::OnMakeDirectoryOnDisk(wxCommandEvent& WXUNUSED(event))
 {
 	MakeDirectoryOnDisk();
 }
+/// メニュー デフラグ選択
+void UiDiskFrame::OnDefragmentDisk(wxCommandEvent& WXUNUSED(event))
+{
+	DefragmentDisk();
+}
+/// メニュー ボリュームのチェック選択
+void UiDiskFrame::OnCheckVolume(wxCommandEvent& WXUNUSED(event))
+{
+	CheckVolume();
+}
 /// メニュー ファイル編集選択
 void UiDiskFrame::OnEditFileOnDisk(wxCommandEvent& event)
 {
@@ -718,6 +731,16 @@ void UiDiskFrame::OnTimerStatusTimer(wxTimerEvent& event)
 	wxString str;
 	p_image->GetStatusMessage(str);
 	SetStatusText(str, 1);
+
+	// キャッシュの統計情報を定期的にログに出力
+	int interval = gConfig.GetCacheStatsInterval();
+	if (interval > 0 && p_image->IsOpened()) {
+		m_cache_stats_elapsed++;
+		if (m_cache_stats_elapsed >= interval) {
+			m_cache_stats_elapsed = 0;
+			WriteCacheStatsToLog();
+		}
+	}
 }
 
 ////////////////////////////////////////
@@ -763,6 +786,9 @@ void UiDiskFrame::MakeMenu()
 	menuData->AppendSeparator();
 	menuData->Append( IDM_MAKE_DIRECTORY_ON_DISK, _("Make Directory(&F)...") );
 	menuData->AppendSeparator();
+	menuData->Append( IDM_DEFRAGMENT_DISK, _("Defra&gment...") );
+	menuData->Append( IDM_CHECK_VOLUME, _("Check &Volume...") );
+	menuData->AppendSeparator();
 	menuData->Append( IDM_PROPERTY_DATA, _("&Property") );
 	// mode menu
 	menuMode->AppendRadioItem( IDM_BASIC_MODE, _("BASIC Mode") );
@@ -933,6 +959,8 @@ void UiDiskFrame::UpdateMenuFileList(UiDiskFileList *list)
 	opened = (opened && list->IsAssignedBasicDisk());
 	menuData->Enable(IDM_IMPORT_DATA, opened);
 	menuData->Enable(IDM_PASTE_DATA, opened);
+	menuData->Enable(IDM_DEFRAGMENT_DISK, opened && list->GetDiskBasic()->GetType()->SupportDefragment());
+	menuData->Enable(IDM_CHECK_VOLUME, opened && list->GetDiskBasic()->GetType()->SupportCheckVolume());
 
 	int	cnt = list->GetListSelectedItemCount();
 	opened = (opened && cnt > 0);
@@ -991,6 +1019,8 @@ void UiDiskFrame::UpdateMenuRawDisk(UiDiskRawPanel *rawpanel)
 
 	menuData->Enable(IDM_RENAME_DATA_ON_DISK, false);
 	menuData->Enable(IDM_MAKE_DIRECTORY_ON_DISK, false);
+	menuData->Enable(IDM_DEFRAGMENT_DISK, false);
+	menuData->Enable(IDM_CHECK_VOLUME, false);
 	menuData->Enable(IDM_EDIT_FILE_TEXT, false);
 }
 
@@ -1702,6 +1732,24 @@ void UiDiskFrame::MakeDirectoryOnDisk()
 		return;
 	}
 }
+/// ディスクをデフラグ
+void UiDiskFrame::DefragmentDisk()
+{
+	UiDiskFileList *list = GetFileListPanel();
+	if (list) {
+		list->ShowDefragmentDialog();
+		return;
+	}
+}
+/// ボリュームをチェック
+void UiDiskFrame::CheckVolume()
+{
+	UiDiskFileList *list = GetFileListPanel();
+	if (list) {
+		list->ShowCheckVolumeDialog();
+		return;
+	}
+}
 /// ファイル編集
 void UiDiskFrame::EditFileOnDisk(enEditorTypes editor_type)
 {
@@ -2205,7 +2253,7 @@ void UiDiskFrame::SetFatAreaData()
 {
 	if (fatarea_frame) {
 		wxUint32 offset = 0;
-		const wxArrayInt *arr = NULL;
+		const DiskBasicAvailabillity *arr = NULL;
 		UiDiskFileList *list = GetFileListPanel();
 		if (list) {
 			list->GetFatAvailability(&offset, &arr);
@@ -2215,7 +2263,7 @@ void UiDiskFrame::SetFatAreaData()
 }
 
 /// 使用状況ウィンドウにデータを設定する
-void UiDiskFrame::SetFatAreaData(wxUint32 offset, const wxArrayInt *arr)
+void UiDiskFrame::SetFatAreaData(wxUint32 offset, const DiskBasicAvailabillity *arr)
 {
 	if (fatarea_frame && arr) {
 		fatarea_frame->SetData(offset, arr);
@@ -2324,6 +2372,17 @@ void UiDiskFrame::CloseLoggingWindow()
 	p_loggingbox = NULL;
 }
 
+/// キャッシュの統計情報をログに出力
+void UiDiskFrame::WriteCacheStatsToLog()
+{
+	DiskImageCacheStats stats;
+	if (!p_image->GetCacheStats(stats)) return;
+
+	wxArrayString msgs;
+	stats.GetMessages(msgs);
+	myLog.SetMessage(MyLogging::MyLog_Info, msgs);
+}
+
 /// ログウィンドウを閉じる時にウィンドウ側から呼ばれるコールバック
 void UiDiskFrame::LoggingWindowClosed()
 {
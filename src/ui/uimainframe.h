@@ -49,6 +49,7 @@ class DiskParamPtrs;
 class DiskBasic;
 class DiskBasics;
 class DiskBasicGroups;
+class DiskBasicAvailabillity;
 class DiskBasicDirItem;
 class DiskBasicDirItems;
 class DiskBasicParam;
@@ -146,6 +147,7 @@ private:
 	StatusCounters stat_counters;
 
 	wxTimer m_status_timer;
+	int m_cache_stats_elapsed;	///< キャッシュの統計情報を出力してからの秒数
 
 	Utils::StopWatch m_sw_export;	///< エクスポート時のストップウォッチ
 	Utils::StopWatch m_sw_import;	///< インポート時のストップウォッチ
@@ -215,6 +217,10 @@ public:
 	void OnPasteDataToDisk(wxCommandEvent& event);
 	/// メニュー ディレクトリ作成選択
 	void OnMakeDirectoryOnDisk(wxCommandEvent& event);
+	/// メニュー デフラグ選択
+	void OnDefragmentDisk(wxCommandEvent& event);
+	/// メニュー ボリュームのチェック選択
+	void OnCheckVolume(wxCommandEvent& event);
 	/// メニュー ファイル編集選択
 	void OnEditFileOnDisk(wxCommandEvent& event);
 	/// メニュー プロパティ選択
@@ -385,6 +391,10 @@ public:
 	void PasteDataToDisk();
 	/// ディスクにディレクトリを作成
 	void MakeDirectoryOnDisk();
+	/// ディスクをデフラグ
+	void DefragmentDisk();
+	/// ボリュームをチェック
+	void CheckVolume();
 	/// ファイル編集
 	void EditFileOnDisk(enEditorTypes editor_type);
 	/// ファイルのプロパティ
@@ -534,7 +544,7 @@ public:
 	/// 使用状況ウィンドウにデータを設定する
 	void SetFatAreaData();
 	/// 使用状況ウィンドウにデータを設定する
-	void SetFatAreaData(wxUint32 offset, const wxArrayInt *arr);
+	void SetFatAreaData(wxUint32 offset, const DiskBasicAvailabillity *arr);
 	/// 使用状況ウィンドウをクリア
 	void ClearFatAreaData();
 	/// 使用状況ウィンドウにフォーカスさせるグループ番号を設定する
@@ -562,6 +572,8 @@ public:
 	void CloseLoggingWindow();
 	/// ログウィンドウを閉じる時にウィンドウ側から呼ばれるコールバック
 	void LoggingWindowClosed();
+	/// キャッシュの統計情報をログに出力
+	void WriteCacheStatsToLog();
 	//@}
 
 	/// @name 設定ファイル
@@ -652,6 +664,8 @@ public:
 		IDM_COPY_DATA,
 		IDM_PASTE_DATA,
 		IDM_MAKE_DIRECTORY_ON_DISK,
+		IDM_DEFRAGMENT_DISK,
+		IDM_CHECK_VOLUME,
 		IDM_EDIT_FILE_BINARY,
 		IDM_EDIT_FILE_TEXT,
 		IDM_PROPERTY_DATA,
@@ -891,13 +891,16 @@ bool UiDiskRawTrack::ImportTrackDataFile(const wxString &path, int st_trk, int s
 		DiskImageSector *sector = p_file->GetSector(sec_pos);
 		if (!sector) continue;
 
-		wxUint8 *buf = sector->GetSectorBuffer();
+		wxUint8 *buf = sector->GetSectorBufferForWrite();
 		size_t bufsize = sector->GetSectorBufferSize();
 
 		infile.Read((void *)buf, bufsize);
 	}
 	infile.Close();
 
+	// DISK BASICの解析結果を更新させる
+	p_file->IncreaseRawModifyCount();
+
 	return true;
 }
 
@@ -1328,7 +1331,7 @@ void UiDiskRawSector::ShowPopupMenu()
 void UiDiskRawSector::SelectItem(int sector_pos, DiskImageSector *sector)
 {
 	// ダンプリストをセット
-	frame->SetBinDumpData(sector_pos, sector->GetSectorBuffer(), sector->GetSectorSize());
+	frame->SetBinDumpData(sector_pos, sector->GetSectorBufferForRead(), sector->GetSectorSize());
 
 	// メニューを更新
 	frame->UpdateMenuAndToolBarRawDisk(parent);
@@ -1598,7 +1601,7 @@ bool UiDiskRawSector::ExportDataFile(const wxString &path, DiskImageSector *sect
 	if (!sector) return false;
 
 	size_t bufsize = sector->GetSectorBufferSize();
-	wxUint8 *buf = sector->GetSectorBuffer();
+	const wxUint8 *buf = sector->GetSectorBufferForRead();
 	if (buf == NULL || bufsize <= 0) return false;
 
 	wxFile outfile(path, wxFile::write);
@@ -1646,6 +1649,7 @@ void UiDiskRawSector::DeleteSector()
 	ans = wxMessageBox(msg, _("Clear Sector"), wxYES_NO);
 	if (ans == wxYES) {
 		sector->Fill(0);
+		if (p_file) p_file->IncreaseRawModifyCount();
 
 		// 画面更新
 		parent->RefreshAllData();
@@ -1660,7 +1664,7 @@ void UiDiskRawSector::EditSector()
 	if (!sector) return;
 
 	size_t bufsize = sector->GetSectorBufferSize();
-	wxUint8 *buf = sector->GetSectorBuffer();
+	wxUint8 *buf = (wxUint8 *)sector->GetSectorBufferForRead();
 	if (buf == NULL || bufsize <= 0) {
 		wxMessageBox(_("No sector data exists."), _("Edit Sector"), wxICON_ERROR | wxOK);
 		return;
@@ -1707,6 +1711,8 @@ void UiDiskRawSector::EditSector()
 	infile.Read((void *)buf, bufsize);
 	infile.Close();
 	if (inverted) mem_invert(buf, bufsize);
+	sector->SetModify();
+	if (p_file) p_file->IncreaseRawModifyCount();
 }
 
 #endif /* !USE_CONSOLE */